@@ -20,6 +20,9 @@
 #define QUIC_TLS_VERIFY_NONE    0
 #define QUIC_TLS_VERIFY_PEER    1
 
+/* Key name(16) | HMAC key(32) | AES key(32) */
+#define QUIC_TICKET_KEY_LEN     80
+
 #define QUIC_TRANS_PARAM_ORIGINAL_DESTINATION_CONNECTION_ID     0x00
 #define QUIC_TRANS_PARAM_MAX_IDLE_TIMEOUT                       0x01
 #define QUIC_TRANS_PARAM_STATELESS_RESET_TOKEN                  0x02
@@ -41,6 +44,11 @@
 
 typedef void (*QUIC_CTX_keylog_cb_func)(const QUIC *, const char *);
 typedef int (*QUIC_CTX_verify_callback_func)(bool, X509_STORE_CTX *);
+/*
+ * Hand @job to an external executor, which must call QuicAsyncJobSign()
+ * and then QuicAsyncJobDone() on it exactly once.
+ */
+typedef int (*QUIC_ASYNC_SUBMIT_CB)(QUIC_ASYNC_JOB *job, void *arg);
 
 enum {
     QUIC_FILE_TYPE_ASN1,
@@ -54,10 +62,13 @@ enum {
     QUIC_CTRL_SET_SIGALGS,
     QUIC_CTRL_SET_TLSEXT_HOSTNAME,
     QUIC_CTRL_SET_MSS,
+    QUIC_CTRL_SET_CERT_COMPRESSION,
 };
 
 extern int QuicInit(void);
+extern int QuicInitEx(QUIC_LIB_CTX *libctx, const char *propq);
 extern void QuicExit(void);
+extern void QuicThreadExit(void);
 extern QUIC_CTX *QuicCtxNew(const QUIC_METHOD *meth);
 extern void QuicCtxFree(QUIC_CTX *ctx);
 extern int QuicCtxCtrl(QUIC_CTX *ctx, uint32_t cmd, void *parg, long larg);
@@ -79,6 +90,32 @@ extern void QUIC_CTX_set_keylog_callback(QUIC_CTX *ctx,
 extern void QUIC_CTX_set_verify(QUIC_CTX *ctx, uint32_t mode,
                         QUIC_CTX_verify_callback_func cb);
 extern void QUIC_CTX_set_verify_depth(QUIC_CTX *ctx, int depth);
+extern int QuicCtxSetAsyncWorkers(QUIC_CTX *ctx, int num);
+extern void QuicCtxSetAsyncCallback(QUIC_CTX *ctx, QUIC_ASYNC_SUBMIT_CB cb,
+                        void *arg);
+extern int QuicCtxSetKeySharePool(QUIC_CTX *ctx, size_t depth,
+                        bool background);
+extern size_t QuicCtxKeySharePoolRefill(QUIC_CTX *ctx, size_t budget);
+extern int QuicCtxSetKeySharePredict(QUIC_CTX *ctx, size_t entries);
+extern void QuicCtxKeySharePredictStats(QUIC_CTX *ctx, uint64_t *hits,
+                        uint64_t *misses);
+extern int QuicCtxSetCertVerifyCache(QUIC_CTX *ctx, size_t entries,
+                        uint32_t ttl);
+extern void QuicCtxCertVerifyCacheStats(QUIC_CTX *ctx, uint64_t *hits,
+                        uint64_t *misses);
+extern int QuicCtxSetVhostTable(QUIC_CTX *ctx, size_t hosts);
+extern int QuicCtxAddVhost(QUIC_CTX *ctx, const char *hostname,
+                        QUIC_CTX *host_ctx);
+extern int QuicCtxSetSessionCache(QUIC_CTX *ctx, size_t entries,
+                        uint32_t ttl);
+extern int QuicCtxSetAntiReplay(QUIC_CTX *ctx, uint32_t rate,
+                        uint32_t window);
+extern int QuicCtxSetClientSessionCache(QUIC_CTX *ctx, size_t entries);
+extern int QuicCtxRotateTicketKey(QUIC_CTX *ctx, const uint8_t *key,
+                        size_t len);
+extern int QuicCtxSetTicketKeyNum(QUIC_CTX *ctx, size_t num);
+extern int QuicAsyncJobSign(QUIC_ASYNC_JOB *job);
+extern void QuicAsyncJobDone(QUIC_ASYNC_JOB *job);
 extern int QuicCtxLoadVerifyLocations(QUIC_CTX *ctx, const char *CAfile,
                         const char *CApath);
 extern STACK_OF(X509_NAME) *QuicLoadClientCaFile(const char *file);
@@ -98,6 +135,7 @@ extern void QUIC_set_accept_state(QUIC *quic);
 extern void QUIC_set_connect_state(QUIC *quic);
 extern int QuicCtrl(QUIC *quic, uint32_t cmd, void *parg, long larg);
 extern int QuicDoHandshake(QUIC *quic);
+extern int QuicKeyUpdate(QUIC *quic);
 extern BIO *QUIC_get_rbio(const QUIC *quic);
 extern BIO *QUIC_get_wbio(const QUIC *quic);
 extern void QUIC_set_rbio(QUIC *quic, BIO *rbio);
@@ -108,5 +146,7 @@ extern QUIC_SESSION *QUIC_get_session(QUIC *quic);
 extern QUIC_SESSION *QUIC_get1_session(QUIC *quic);
 extern int QUIC_set_session(QUIC *quic, QUIC_SESSION *sess);
 extern int QUIC_get_error(QUIC *quic, int ret);
+extern int QUIC_get_async_fd(QUIC *quic);
+extern bool QuicKeySharePredicted(QUIC *quic);
 
 #endif
@@ -2,11 +2,16 @@
 #define TBQUIC_INCLUDE_TBQUIC_STREAM_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <tbquic/types.h>
 
 #define QUIC_STREAM_DATA_FLAGS_FIN      0x01
 #define QUIC_STREAM_DATA_FLAGS_RESET    0x02
 
+/* @acked is false if the data was dropped before all of it was acked */
+typedef void (*QUIC_STREAM_SEND_CB)(QUIC_STREAM_HANDLE h, void *data,
+                                    size_t len, bool acked, void *arg);
+
 struct QuicStreamIovec {            /* Scatter/gather array items */
     QUIC_STREAM_HANDLE handle;      /* Stream handle */
     uint32_t flags;                 /* Stream flags */
@@ -20,8 +25,26 @@ extern int QuicStreamSendEarlyData(QUIC *quic, QUIC_STREAM_HANDLE *h, bool uni,
                                     void *data, size_t len);
 extern int QuicStreamSend(QUIC *quic, QUIC_STREAM_HANDLE h,
                                 void *data, size_t len);
+/*
+ * Zero copy send: @data is encrypted from where it is and must stay
+ * untouched until @cb is called. Returns the length queued, which may be
+ * short of @len, and @cb is then called exactly once for it. On -1
+ * nothing references @data and @cb is never called.
+ */
+extern int QuicStreamSendZeroCopy(QUIC *quic, QUIC_STREAM_HANDLE h,
+                                void *data, size_t len,
+                                QUIC_STREAM_SEND_CB cb, void *arg);
 extern int QuicStreamRecv(QUIC *quic, QUIC_STREAM_HANDLE h, uint32_t *flags,
                             void *data, size_t len);
 extern int QuicStreamReadV(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t iovcnt);
+/*
+ * Zero copy receive: the iovecs point at the received datagrams, which
+ * stay valid until the loan is given back with QuicStreamRecvRelease(),
+ * at the latest before the connection is freed.
+ */
+extern int QuicStreamRecvBorrow(QUIC *quic, QUIC_STREAM_HANDLE h,
+                            uint32_t *flags, QUIC_STREAM_IOVEC *iov,
+                            size_t iovcnt, QUIC_STREAM_LOAN **loan);
+extern void QuicStreamRecvRelease(QUIC *quic, QUIC_STREAM_LOAN *loan);
 
 #endif
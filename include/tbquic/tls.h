@@ -20,6 +20,11 @@
 #define TLS_SUPPORTED_GROUPS_FFDHE6144     0x0103
 #define TLS_SUPPORTED_GROUPS_FFDHE8192     0x0104
 
+/* Certificate compression algorithms, RFC 8879 */
+#define TLSEXT_CERT_COMP_ZLIB       1
+#define TLSEXT_CERT_COMP_BROTLI     2
+#define TLSEXT_CERT_COMP_ZSTD       3
+
 /* Sigalgs values */
 #define TLSEXT_SIGALG_ECDSA_SECP256R1_SHA256                    0x0403
 #define TLSEXT_SIGALG_ECDSA_SECP384R1_SHA384                    0x0503
@@ -14,6 +14,9 @@ typedef enum QuicAlgId QUIC_ALG_ID;
 typedef struct QuicDispenser QUIC_DISPENSER;
 typedef int64_t QUIC_STREAM_HANDLE;
 typedef struct QuicStreamIovec QUIC_STREAM_IOVEC;
+typedef struct QuicStreamLoan QUIC_STREAM_LOAN;
 typedef struct QuicSession QUIC_SESSION;
+typedef struct ossl_lib_ctx_st QUIC_LIB_CTX;
+typedef struct QuicAsyncJob QUIC_ASYNC_JOB;
 
 #endif
@@ -0,0 +1,207 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "anti_replay.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <openssl/rand.h>
+
+#include "mem.h"
+#include "log.h"
+
+static void QuicAntiReplayLock(QuicAntiReplayShard *shard)
+{
+    /* The owner died with the lock held, the filters are still usable */
+    if (pthread_mutex_lock(&shard->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&shard->lock);
+    }
+}
+
+static void QuicAntiReplayUnlock(QuicAntiReplayShard *shard)
+{
+    pthread_mutex_unlock(&shard->lock);
+}
+
+static uint64_t QuicAntiReplayMix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+
+    return x;
+}
+
+static uint64_t *QuicAntiReplayFilter(QuicAntiReplay *ar, size_t shard,
+                                        uint64_t gen)
+{
+    return &ar->filters[(2 * shard + gen) * (ar->filter_bits / 64)];
+}
+
+static bool QuicAntiReplayTest(QuicAntiReplay *ar, const uint64_t *filter,
+                                uint64_t h1, uint64_t h2)
+{
+    uint64_t bit = 0;
+    int i = 0;
+
+    for (i = 0; i < QUIC_ANTI_REPLAY_HASH_NUM; i++) {
+        bit = (h1 + i * h2) % ar->filter_bits;
+        if (!(filter[bit / 64] & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Return true if all the bits were already set */
+static bool QuicAntiReplaySet(QuicAntiReplay *ar, uint64_t *filter,
+                                uint64_t h1, uint64_t h2)
+{
+    uint64_t bit = 0;
+    uint64_t mask = 0;
+    bool seen = true;
+    int i = 0;
+
+    for (i = 0; i < QUIC_ANTI_REPLAY_HASH_NUM; i++) {
+        bit = (h1 + i * h2) % ar->filter_bits;
+        mask = 1ULL << (bit % 64);
+        if (!(filter[bit / 64] & mask)) {
+            filter[bit / 64] |= mask;
+            seen = false;
+        }
+    }
+
+    return seen;
+}
+
+/*
+ * @rate is the expected number of 0-RTT handshakes per second, @window the
+ * allowed skew of the ticket age in seconds. Must be called before the
+ * worker processes are forked, the segment is inherited by all of them.
+ */
+QuicAntiReplay *QuicAntiReplayNew(uint32_t rate, uint32_t window)
+{
+    QuicAntiReplay *ar = NULL;
+    pthread_mutexattr_t attr;
+    uint64_t keys = 0;
+    uint64_t bits = 0;
+    size_t map_len = 0;
+    size_t i = 0;
+
+    if (rate == 0 || window == 0) {
+        return NULL;
+    }
+
+    keys = (uint64_t)rate * window * 2;
+    if (keys > QUIC_ANTI_REPLAY_KEY_MAX) {
+        return NULL;
+    }
+
+    /* Per shard, rounded up to whole words */
+    bits = keys * QUIC_ANTI_REPLAY_BITS_PER_KEY / QUIC_ANTI_REPLAY_SHARD_NUM;
+    bits = (bits + 63) / 64 * 64;
+    if (bits < 512) {
+        bits = 512;
+    }
+
+    map_len = sizeof(*ar) + 2 * QUIC_ANTI_REPLAY_SHARD_NUM * bits / 8;
+    ar = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ar == MAP_FAILED) {
+        QUIC_LOG("mmap anti-replay filter failed\n");
+        return NULL;
+    }
+
+    ar->map_len = map_len;
+    ar->window = window;
+    ar->filter_bits = bits;
+    if (RAND_bytes((void *)ar->salt, sizeof(ar->salt)) <= 0) {
+        munmap(ar, map_len);
+        return NULL;
+    }
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    for (i = 0; i < QUIC_ANTI_REPLAY_SHARD_NUM; i++) {
+        pthread_mutex_init(&ar->shards[i].lock, &attr);
+    }
+    pthread_mutexattr_destroy(&attr);
+
+    return ar;
+}
+
+/*
+ * Only unmap it from this process, the others may still be using it.
+ */
+void QuicAntiReplayFree(QuicAntiReplay *ar)
+{
+    if (ar == NULL) {
+        return;
+    }
+
+    munmap(ar, ar->map_len);
+}
+
+#ifndef QUIC_TEST
+static
+#endif
+int QuicAntiReplayDoCheck(QuicAntiReplay *ar, const uint8_t *key, size_t len,
+                            time_t now)
+{
+    QuicAntiReplayShard *shard = NULL;
+    uint64_t *cur = NULL;
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+    uint64_t epoch = 0;
+    uint64_t gen = 0;
+    size_t idx = 0;
+    bool seen = false;
+
+    if (len < QUIC_ANTI_REPLAY_KEY_LEN_MIN) {
+        return -1;
+    }
+
+    /* Binders are MAC output, salted so peers can not aim at a shard */
+    QuicMemcpy(&h1, key, sizeof(h1));
+    QuicMemcpy(&h2, key + sizeof(h1), sizeof(h2));
+    h1 = QuicAntiReplayMix(h1 ^ ar->salt[0]);
+    h2 = QuicAntiReplayMix(h2 ^ ar->salt[1]) | 1;
+    idx = h1 % QUIC_ANTI_REPLAY_SHARD_NUM;
+    h1 /= QUIC_ANTI_REPLAY_SHARD_NUM;
+
+    epoch = now / (2 * (uint64_t)ar->window);
+    gen = epoch & 1;
+    shard = &ar->shards[idx];
+
+    QuicAntiReplayLock(shard);
+    cur = QuicAntiReplayFilter(ar, idx, gen);
+    if (shard->epoch[gen] != epoch) {
+        memset(cur, 0, ar->filter_bits / 8);
+        shard->epoch[gen] = epoch;
+    }
+
+    seen = QuicAntiReplaySet(ar, cur, h1, h2);
+    if (!seen && shard->epoch[gen ^ 1] + 1 == epoch) {
+        seen = QuicAntiReplayTest(ar, QuicAntiReplayFilter(ar, idx, gen ^ 1),
+                                    h1, h2);
+    }
+    QuicAntiReplayUnlock(shard);
+
+    return seen ? -1 : 0;
+}
+
+/*
+ * Record @key, return -1 if it has been seen within the last generations.
+ * False positives only turn 0-RTT into 1-RTT.
+ */
+int QuicAntiReplayCheck(QuicAntiReplay *ar, const uint8_t *key, size_t len)
+{
+    return QuicAntiReplayDoCheck(ar, key, len, time(NULL));
+}
@@ -0,0 +1,51 @@
+#ifndef TBQUIC_QUIC_ANTI_REPLAY_H_
+#define TBQUIC_QUIC_ANTI_REPLAY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#define QUIC_ANTI_REPLAY_SHARD_NUM      64
+#define QUIC_ANTI_REPLAY_HASH_NUM       7
+/* About 1% false positives with 7 hashes */
+#define QUIC_ANTI_REPLAY_BITS_PER_KEY   10
+/* Upper bound of the keys recorded in one generation */
+#define QUIC_ANTI_REPLAY_KEY_MAX        (1 << 24)
+#define QUIC_ANTI_REPLAY_KEY_LEN_MIN    16
+
+/*
+ * Each shard keeps two Bloom filters, one per generation of 2 * window
+ * seconds. A key recorded at any moment is remembered for at least
+ * 2 * window seconds, which covers every ClientHello passing the freshness
+ * check twice.
+ *
+ * Everything below lives in a MAP_SHARED segment and is used by several
+ * processes, so no pointers are kept in it.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    /* Generation number each filter was cleared for */
+    uint64_t epoch[2];
+} QuicAntiReplayShard;
+
+typedef struct {
+    size_t map_len;
+    /* Allowed skew of the ticket age in seconds */
+    uint32_t window;
+    /* Bits of one filter, a multiple of 64 */
+    uint64_t filter_bits;
+    uint64_t salt[2];
+    QuicAntiReplayShard shards[QUIC_ANTI_REPLAY_SHARD_NUM];
+    /* filters of shard i are at (2 * i + generation) * filter_bits */
+    uint64_t filters[];
+} QuicAntiReplay;
+
+QuicAntiReplay *QuicAntiReplayNew(uint32_t, uint32_t);
+void QuicAntiReplayFree(QuicAntiReplay *);
+int QuicAntiReplayCheck(QuicAntiReplay *, const uint8_t *, size_t);
+#ifdef QUIC_TEST
+int QuicAntiReplayDoCheck(QuicAntiReplay *, const uint8_t *, size_t, time_t);
+#endif
+
+#endif
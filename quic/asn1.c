@@ -15,6 +15,8 @@ ASN1_SEQUENCE(QUIC_SESSION_ASN1) = {
     ASN1_EXP_OPT_EMBED(QUIC_SESSION_ASN1, tick_lifetime_hint, ZUINT64, 2),
     ASN1_EXP_OPT(QUIC_SESSION_ASN1, tlsext_tick, ASN1_OCTET_STRING, 3),
     ASN1_EXP_OPT_EMBED(QUIC_SESSION_ASN1, max_early_data, ZUINT32, 4),
+    ASN1_EXP_OPT_EMBED(QUIC_SESSION_ASN1, tick_time, ZUINT64, 5),
+    ASN1_EXP_OPT(QUIC_SESSION_ASN1, alpn_selected, ASN1_OCTET_STRING, 6),
 } static_ASN1_SEQUENCE_END(QUIC_SESSION_ASN1)
 
 IMPLEMENT_STATIC_ASN1_ENCODE_FUNCTIONS(QUIC_SESSION_ASN1)
@@ -51,6 +53,7 @@ int i2dQuicSession(QUIC_SESSION *in, uint8_t **pp)
     QUIC_DATA *tk = NULL;
     ASN1_OCTET_STRING tlsext_tick;
     ASN1_OCTET_STRING master_key;
+    ASN1_OCTET_STRING alpn_selected;
     QUIC_SESSION_ASN1 as = {};
 
     if (in->cipher == NULL) {
@@ -65,6 +68,7 @@ int i2dQuicSession(QUIC_SESSION *in, uint8_t **pp)
     as.cipher_id = in->cipher->id;
     as.tick_lifetime_hint = t->lifetime_hint;
     as.tick_age_add = t->age_add;
+    as.tick_time = t->time;
     as.max_early_data = in->max_early_data;
 
     tk = &t->ticket;
@@ -75,6 +79,11 @@ int i2dQuicSession(QUIC_SESSION *in, uint8_t **pp)
     QuicSessionOinit(&as.master_key, &master_key, t->master_key,
             t->master_key_length);
 
+    if (!QuicDataIsEmpty(&in->alpn_selected)) {
+        QuicSessionOinit(&as.alpn_selected, &alpn_selected,
+                in->alpn_selected.data, in->alpn_selected.len);
+    }
+
     return i2d_QUIC_SESSION_ASN1(&as, (unsigned char **)pp);
 }
 
@@ -104,11 +113,21 @@ QUIC_SESSION *d2iQuicSession(const uint8_t **pp, long length)
 
     sess->max_early_data = as->max_early_data;
 
+    if (as->alpn_selected != NULL && QuicDataCopy(&sess->alpn_selected,
+                as->alpn_selected->data, as->alpn_selected->length) < 0) {
+        goto err;
+    }
+
     t = QuicSessionTicketNew(as->tick_lifetime_hint, as->tick_age_add, NULL, 0);
     if (t == NULL) {
         goto err;
     }
 
+    /* Issue time, the server checks 0-RTT freshness against it */
+    if (as->tick_time != 0) {
+        t->time = as->tick_time;
+    }
+
     if (as->tlsext_tick != NULL) {
         t->ticket.data = as->tlsext_tick->data;
         t->ticket.len = as->tlsext_tick->length;
@@ -12,8 +12,10 @@ typedef struct {
     uint32_t tick_age_add;
     uint32_t max_early_data;
     uint64_t tick_lifetime_hint;
+    uint64_t tick_time;
     ASN1_OCTET_STRING *tlsext_tick;
     ASN1_OCTET_STRING *master_key;
+    ASN1_OCTET_STRING *alpn_selected;
 } QUIC_SESSION_ASN1;
 
 int i2dQuicSession(QUIC_SESSION *in, uint8_t **pp);
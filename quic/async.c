@@ -0,0 +1,265 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "async.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "tls_lib.h"
+#include "mem.h"
+#include "log.h"
+
+QUIC_ASYNC_JOB *QuicAsyncJobNew(EVP_PKEY *pkey, const EVP_MD *md, bool pss,
+                                    const uint8_t *tbs, size_t tbs_len)
+{
+    QUIC_ASYNC_JOB *job = NULL;
+
+    job = QuicMemCalloc(sizeof(*job));
+    if (job == NULL) {
+        return NULL;
+    }
+
+    INIT_LIST_HEAD(&job->node);
+    job->refcnt = 1;
+    job->status = QUIC_ASYNC_JOB_PENDING;
+    job->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (job->efd < 0) {
+        QUIC_LOG("Create eventfd failed: %s\n", strerror(errno));
+        goto err;
+    }
+
+    job->tbs = QuicMemDup(tbs, tbs_len);
+    if (job->tbs == NULL) {
+        goto err;
+    }
+    job->tbs_len = tbs_len;
+
+    job->sig_len = EVP_PKEY_size(pkey);
+    job->sig = QuicMemMalloc(job->sig_len);
+    if (job->sig == NULL) {
+        goto err;
+    }
+
+    EVP_PKEY_up_ref(pkey);
+    job->pkey = pkey;
+    job->md = md;
+    job->pss = pss;
+
+    return job;
+err:
+    QuicAsyncJobFree(job);
+    return NULL;
+}
+
+void QuicAsyncJobFree(QUIC_ASYNC_JOB *job)
+{
+    if (job == NULL) {
+        return;
+    }
+
+    if (__atomic_sub_fetch(&job->refcnt, 1, __ATOMIC_ACQ_REL) > 0) {
+        return;
+    }
+
+    if (job->efd >= 0) {
+        close(job->efd);
+    }
+    EVP_PKEY_free(job->pkey);
+    QuicMemFree(job->tbs);
+    QuicMemFree(job->sig);
+    QuicMemFree(job);
+}
+
+int QuicAsyncJobStatus(QUIC_ASYNC_JOB *job)
+{
+    return __atomic_load_n(&job->status, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Produce the signature of @job, may be called from any thread.
+ */
+int QuicAsyncJobSign(QUIC_ASYNC_JOB *job)
+{
+    if (TlsSign(job->pkey, job->md, job->pss, job->tbs, job->tbs_len,
+                job->sig, &job->sig_len) < 0) {
+        __atomic_store_n(&job->status, QUIC_ASYNC_JOB_FAILED,
+                            __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Deliver the result of @job to the connection and drop the reference of
+ * the executor. Must be called exactly once for each submitted job.
+ */
+void QuicAsyncJobDone(QUIC_ASYNC_JOB *job)
+{
+    uint64_t v = 1;
+
+    if (QuicAsyncJobStatus(job) == QUIC_ASYNC_JOB_PENDING) {
+        __atomic_store_n(&job->status, QUIC_ASYNC_JOB_DONE,
+                            __ATOMIC_RELEASE);
+    }
+
+    if (write(job->efd, &v, sizeof(v)) != sizeof(v)) {
+        QUIC_LOG("Write eventfd failed: %s\n", strerror(errno));
+    }
+
+    QuicAsyncJobFree(job);
+}
+
+static void *QuicAsyncWorker(void *arg)
+{
+    QuicAsyncPool *pool = arg;
+    QUIC_ASYNC_JOB *job = NULL;
+
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stop && list_empty(&pool->queue)) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+
+        if (pool->stop) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+
+        job = list_first_entry(&pool->queue, QUIC_ASYNC_JOB, node);
+        list_del_init(&job->node);
+        pthread_mutex_unlock(&pool->lock);
+
+        QuicAsyncJobSign(job);
+        QuicAsyncJobDone(job);
+    }
+
+    QuicThreadExit();
+    return NULL;
+}
+
+QuicAsyncPool *QuicAsyncPoolNew(int num)
+{
+    QuicAsyncPool *pool = NULL;
+
+    if (num <= 0 || num > QUIC_ASYNC_WORKER_MAX) {
+        return NULL;
+    }
+
+    pool = QuicMemCalloc(sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    INIT_LIST_HEAD(&pool->queue);
+
+    for (pool->num = 0; pool->num < num; pool->num++) {
+        if (pthread_create(&pool->workers[pool->num], NULL, QuicAsyncWorker,
+                    pool) != 0) {
+            QUIC_LOG("Create worker failed\n");
+            QuicAsyncPoolFree(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void QuicAsyncPoolFree(QuicAsyncPool *pool)
+{
+    QUIC_ASYNC_JOB *job = NULL;
+    QUIC_ASYNC_JOB *n = NULL;
+    int i = 0;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->num; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    list_for_each_entry_safe(job, n, &pool->queue, node) {
+        list_del_init(&job->node);
+        __atomic_store_n(&job->status, QUIC_ASYNC_JOB_FAILED,
+                            __ATOMIC_RELEASE);
+        QuicAsyncJobDone(job);
+    }
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    QuicMemFree(pool);
+}
+
+bool QuicAsyncEnabled(const QUIC_CTX *ctx)
+{
+    return ctx->async.submit != NULL || ctx->async.pool != NULL;
+}
+
+int QuicAsyncJobSubmit(const QUIC_CTX *ctx, QUIC_ASYNC_JOB *job)
+{
+    QuicAsyncPool *pool = ctx->async.pool;
+
+    __atomic_add_fetch(&job->refcnt, 1, __ATOMIC_RELAXED);
+    if (ctx->async.submit != NULL) {
+        if (ctx->async.submit(job, ctx->async.arg) < 0) {
+            QuicAsyncJobFree(job);
+            return -1;
+        }
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    list_add_tail(&job->node, &pool->queue);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+int QuicCtxSetAsyncWorkers(QUIC_CTX *ctx, int num)
+{
+    QuicAsyncPool *pool = NULL;
+
+    if (num > 0) {
+        pool = QuicAsyncPoolNew(num);
+        if (pool == NULL) {
+            return -1;
+        }
+    }
+
+    QuicAsyncPoolFree(ctx->async.pool);
+    ctx->async.pool = pool;
+    return 0;
+}
+
+void QuicCtxSetAsyncCallback(QUIC_CTX *ctx, QUIC_ASYNC_SUBMIT_CB cb,
+                                void *arg)
+{
+    ctx->async.submit = cb;
+    ctx->async.arg = arg;
+}
+
+int QUIC_get_async_fd(QUIC *quic)
+{
+    QUIC_ASYNC_JOB *job = quic->tls.async_job;
+
+    if (job == NULL) {
+        return -1;
+    }
+
+    return job->efd;
+}
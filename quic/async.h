@@ -0,0 +1,60 @@
+#ifndef TBQUIC_QUIC_ASYNC_H_
+#define TBQUIC_QUIC_ASYNC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+
+#include <tbquic/types.h>
+#include <tbquic/quic.h>
+
+#include "list.h"
+
+#define QUIC_ASYNC_WORKER_MAX   64
+
+enum {
+    QUIC_ASYNC_JOB_PENDING,
+    QUIC_ASYNC_JOB_DONE,
+    QUIC_ASYNC_JOB_FAILED,
+};
+
+/*
+ * A private key operation offloaded from the handshake. Referenced by the
+ * connection and by the executor(worker or user callback), the eventfd is
+ * closed with the last reference so the executor never writes to a fd
+ * reused by others.
+ */
+struct QuicAsyncJob {
+    struct list_head node;
+    int refcnt;
+    int status;
+    int efd;
+    EVP_PKEY *pkey;
+    const EVP_MD *md;
+    bool pss;
+    uint8_t *tbs;
+    size_t tbs_len;
+    uint8_t *sig;
+    size_t sig_len;
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct list_head queue;
+    pthread_t workers[QUIC_ASYNC_WORKER_MAX];
+    int num;
+    bool stop;
+} QuicAsyncPool;
+
+QUIC_ASYNC_JOB *QuicAsyncJobNew(EVP_PKEY *, const EVP_MD *, bool,
+                                    const uint8_t *, size_t);
+void QuicAsyncJobFree(QUIC_ASYNC_JOB *);
+int QuicAsyncJobStatus(QUIC_ASYNC_JOB *);
+int QuicAsyncJobSubmit(const QUIC_CTX *, QUIC_ASYNC_JOB *);
+bool QuicAsyncEnabled(const QUIC_CTX *);
+QuicAsyncPool *QuicAsyncPoolNew(int);
+void QuicAsyncPoolFree(QuicAsyncPool *);
+
+#endif
@@ -40,6 +40,39 @@ void QuicBufFree(QUIC_BUFFER *qbuf)
     BUF_MEM_free(qbuf->buf);
 }
 
+/*
+ * Reallocate the buffer with @len bytes, data in use is kept.
+ */
+int QuicBufShrink(QUIC_BUFFER *qbuf, size_t len)
+{
+    BUF_MEM *buf = NULL;
+    size_t used = qbuf->reserved + qbuf->data_len;
+
+    if (QUIC_LT(len, used)) {
+        len = used;
+    }
+
+    if (QUIC_GE(len, qbuf->buf->max)) {
+        return 0;
+    }
+
+    buf = BUF_MEM_new();
+    if (buf == NULL) {
+        return -1;
+    }
+
+    if (!BUF_MEM_grow(buf, len)) {
+        BUF_MEM_free(buf);
+        return -1;
+    }
+
+    QuicMemcpy(buf->data, qbuf->buf->data, used);
+    BUF_MEM_free(qbuf->buf);
+    qbuf->buf = buf;
+
+    return 0;
+}
+
 QuicStaticBuffer *QuicGetPlainTextBuffer(void)
 {
     return &QuicInternalBuf[QUIC_STATIC_BUF_TYPE_PLAINTEXT];
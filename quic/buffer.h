@@ -28,6 +28,7 @@ QuicStaticBuffer *QuicGetPlainTextBuffer(void);
 QuicStaticBuffer *QuicGetSendBuffer(void);
 int QuicBufInit(QUIC_BUFFER *, size_t);
 void QuicBufFree(QUIC_BUFFER *);
+int QuicBufShrink(QUIC_BUFFER *, size_t);
 void QuicBufClear(QUIC_BUFFER *);
 size_t QuicBufMemGrow(QUIC_BUFFER *, size_t);
 uint8_t *QuicBufData(QUIC_BUFFER *);
@@ -47,6 +47,118 @@ QuicCert *QuicCertNew(void)
     return cert;
 }
 
+static QuicCertChainCache *QuicCertChainCacheNew(void)
+{
+    QuicCertChainCache *cache = NULL;
+
+    cache = QuicMemCalloc(sizeof(*cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->refcnt = 1;
+    return cache;
+}
+
+void QuicCertChainCacheFree(QuicCertChainCache *cache)
+{
+    int i = 0;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    if (__atomic_sub_fetch(&cache->refcnt, 1, __ATOMIC_ACQ_REL) > 0) {
+        return;
+    }
+
+    for (i = 0; i < QUIC_CERT_COMP_ALG_NUM; i++) {
+        QuicMemFree(cache->comp[i].data);
+    }
+    QuicMemFree(cache->data);
+    QuicMemFree(cache);
+}
+
+static const uint8_t *QuicCertCacheLoad(uint8_t **slot, size_t *slot_len,
+                                        size_t *len)
+{
+    const uint8_t *data = NULL;
+
+    data = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (data != NULL) {
+        *len = *slot_len;
+    }
+
+    return data;
+}
+
+/*
+ * Connections of different threads may race to fill the cache, the
+ * content is the same so the first one wins.
+ */
+static void QuicCertCacheStore(uint8_t **slot, size_t *slot_len,
+                                const uint8_t *data, size_t len)
+{
+    uint8_t *copy = NULL;
+    uint8_t *expected = NULL;
+
+    if (len == 0) {
+        return;
+    }
+
+    copy = QuicMemDup(data, len);
+    if (copy == NULL) {
+        return;
+    }
+
+    *slot_len = len;
+    if (!__atomic_compare_exchange_n(slot, &expected, copy, false,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        QuicMemFree(copy);
+    }
+}
+
+const uint8_t *QuicCertChainCacheGet(QuicCertChainCache *cache, size_t *len)
+{
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    return QuicCertCacheLoad(&cache->data, &cache->len, len);
+}
+
+void QuicCertChainCacheSet(QuicCertChainCache *cache, const uint8_t *data,
+                            size_t len)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    QuicCertCacheStore(&cache->data, &cache->len, data, len);
+}
+
+const uint8_t *QuicCertChainCacheGetComp(QuicCertChainCache *cache,
+                                            uint16_t alg, size_t *len)
+{
+    if (cache == NULL || alg >= QUIC_CERT_COMP_ALG_NUM) {
+        return NULL;
+    }
+
+    return QuicCertCacheLoad(&cache->comp[alg].data, &cache->comp[alg].len,
+                                len);
+}
+
+void QuicCertChainCacheSetComp(QuicCertChainCache *cache, uint16_t alg,
+                                const uint8_t *data, size_t len)
+{
+    if (cache == NULL || alg >= QUIC_CERT_COMP_ALG_NUM) {
+        return;
+    }
+
+    QuicCertCacheStore(&cache->comp[alg].data, &cache->comp[alg].len,
+                        data, len);
+}
+
 QuicCert *QuicCertDup(QuicCert *cert)
 {
     QuicCert *dst = NULL;
@@ -81,6 +193,10 @@ QuicCert *QuicCertDup(QuicCert *cert)
                 goto out;
             }
         }
+        if (cpk->cache != NULL) {
+            __atomic_add_fetch(&cpk->cache->refcnt, 1, __ATOMIC_RELAXED);
+            dpk->cache = cpk->cache;
+        }
     }
 
     return dst;
@@ -106,6 +222,8 @@ static void QuicCertClearCerts(QuicCert *c)
         cp->privatekey = NULL;
         sk_X509_pop_free(cp->chain, X509_free);
         cp->chain = NULL;
+        QuicCertChainCacheFree(cp->cache);
+        cp->cache = NULL;
     }
 }
 
@@ -120,9 +238,83 @@ void QuicCertFree(QuicCert *cert)
     QuicMemFree(cert);
 }
 
+static int QuicVerifyCallback(int ok, X509_STORE_CTX *store_ctx)
+{
+    QUIC *quic = X509_STORE_CTX_get_app_data(store_ctx);
+
+    return quic->ctx->verify_callback(ok, store_ctx);
+}
+
+/*
+ * Verify the peer chain in @sk, the leaf first. With a verify cache on the
+ * context a chain that passed before skips the chain building, the
+ * CertificateVerify signature is checked by the caller either way. A
+ * verify callback sees every chain, so the cache is not used with one.
+ */
 int QuicVerifyCertChain(QUIC *quic, STACK_OF(X509) *sk)
 {
-    return 0;
+    const QUIC_CTX *ctx = quic->ctx;
+    QuicCertVerifyCache *cache = ctx->cert_verify_cache;
+    X509_STORE_CTX *store_ctx = NULL;
+    X509 *x = NULL;
+    uint8_t key[QUIC_CERT_VERIFY_KEY_LEN] = {};
+    int ret = -1;
+
+    if (quic->verify_mode == QUIC_TLS_VERIFY_NONE) {
+        return 0;
+    }
+
+    x = sk_X509_value(sk, 0);
+    if (x == NULL) {
+        return -1;
+    }
+
+    if (ctx->verify_callback != NULL) {
+        cache = NULL;
+    }
+
+    if (cache != NULL) {
+        if (QuicCertVerifyCacheKey(key, sk, quic->param) < 0) {
+            cache = NULL;
+        } else if (QuicCertVerifyCacheLookup(cache, key) == 0) {
+            return 0;
+        }
+    }
+
+    store_ctx = X509_STORE_CTX_new();
+    if (store_ctx == NULL) {
+        return -1;
+    }
+
+    if (!X509_STORE_CTX_init(store_ctx, ctx->cert_store, x, sk)) {
+        goto out;
+    }
+
+    if (!X509_VERIFY_PARAM_set1(X509_STORE_CTX_get0_param(store_ctx),
+                quic->param)) {
+        goto out;
+    }
+
+    X509_STORE_CTX_set_app_data(store_ctx, quic);
+    if (ctx->verify_callback != NULL) {
+        X509_STORE_CTX_set_verify_cb(store_ctx, QuicVerifyCallback);
+    }
+
+    if (X509_verify_cert(store_ctx) <= 0) {
+        QUIC_LOG("Verify cert failed(%s)\n", X509_verify_cert_error_string(
+                    X509_STORE_CTX_get_error(store_ctx)));
+        goto out;
+    }
+
+    if (cache != NULL) {
+        QuicCertVerifyCacheAdd(cache, key, X509_STORE_CTX_get0_chain(store_ctx),
+                                ctx->cert_store, quic->param);
+    }
+
+    ret = 0;
+out:
+    X509_STORE_CTX_free(store_ctx);
+    return ret;
 }
 
 const QuicCertLookup *QuicCertLookupByNid(int nid, size_t *index)
@@ -196,6 +388,7 @@ int QuicSetPkey(QuicCert *c, EVP_PKEY *pkey)
 int QuicSetCert(QuicCert *c, X509 *x)
 {
     const QuicCertLookup *lu = NULL;
+    QuicCertChainCache *cache = NULL;
     EVP_PKEY *pkey = NULL;
     RSA *rsa = NULL;
     size_t i = 0;
@@ -240,6 +433,15 @@ int QuicSetCert(QuicCert *c, X509 *x)
         }
     }
 
+    cache = QuicCertChainCacheNew();
+    if (cache == NULL) {
+        return -1;
+    }
+
+    /* The encoded chain of the old certificate is stale now */
+    QuicCertChainCacheFree(c->pkeys[i].cache);
+    c->pkeys[i].cache = cache;
+
     X509_free(c->pkeys[i].x509);
     X509_up_ref(x);
     c->pkeys[i].x509 = x;
@@ -4,13 +4,32 @@
 #include <openssl/x509_vfy.h>
 #include <openssl/x509.h>
 #include <tbquic/types.h>
+#include <tbquic/tls.h>
 #include "base.h"
 #include "cipher.h"
 
+#define QUIC_CERT_COMP_ALG_NUM  (TLSEXT_CERT_COMP_ZSTD + 1)
+
+/*
+ * Encoded certificate_list of the Certificate message, shared by all the
+ * connections of a context and filled on first use.
+ */
+typedef struct {
+    int refcnt;
+    uint8_t *data;
+    size_t len;
+    /* CompressedCertificate body of each algorithm, RFC 8879 */
+    struct {
+        uint8_t *data;
+        size_t len;
+    } comp[QUIC_CERT_COMP_ALG_NUM];
+} QuicCertChainCache;
+
 typedef struct {
     X509 *x509;
     EVP_PKEY *privatekey;
     STACK_OF(X509) *chain;
+    QuicCertChainCache *cache;
 } QuicCertPkey;
 
 typedef struct {
@@ -31,5 +50,12 @@ int QuicVerifyCertChain(QUIC *, STACK_OF(X509) *);
 int QuicSetPkey(QuicCert *, EVP_PKEY *);
 int QuicSetCert(QuicCert *, X509 *);
 const QuicCertLookup *QuicCertLookupByPkey(const EVP_PKEY *, size_t *);
+void QuicCertChainCacheFree(QuicCertChainCache *);
+const uint8_t *QuicCertChainCacheGet(QuicCertChainCache *, size_t *);
+void QuicCertChainCacheSet(QuicCertChainCache *, const uint8_t *, size_t);
+const uint8_t *QuicCertChainCacheGetComp(QuicCertChainCache *, uint16_t,
+                                            size_t *);
+void QuicCertChainCacheSetComp(QuicCertChainCache *, uint16_t,
+                                    const uint8_t *, size_t);
 
 #endif
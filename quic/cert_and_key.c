@@ -31,6 +31,7 @@ int QuicCtxUsePrivateKey(QUIC_CTX *ctx, EVP_PKEY *pkey)
         return -1;
     }
 
+    TlsConfigReset(ctx);
     return QuicSetPkey(ctx->cert, pkey);
 }
 
@@ -80,6 +81,7 @@ int QuicCtxUseCertificate(QUIC_CTX *ctx, X509 *x)
         return -1;
     }
 
+    TlsConfigReset(ctx);
     return QuicSetCert(ctx->cert, x);
 }
 
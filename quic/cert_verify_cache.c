@@ -0,0 +1,251 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "cert_verify_cache.h"
+
+#include <string.h>
+#include <openssl/evp.h>
+
+#include "evp.h"
+#include "cipher.h"
+#include "mem.h"
+#include "log.h"
+
+static QuicCertVerifyCacheEntry *
+QuicCertVerifyCacheSlot(QuicCertVerifyCache *cache, const uint8_t *key)
+{
+    uint64_t idx = 0;
+
+    memcpy(&idx, key, sizeof(idx));
+    return &cache->entries[idx & cache->mask];
+}
+
+/*
+ * Seconds from @now until @t, the result is clamped to @limit.
+ */
+static time_t QuicCertVerifyTimeLimit(const ASN1_TIME *t, time_t now,
+                                        time_t limit)
+{
+    int day = 0;
+    int sec = 0;
+    time_t left = 0;
+
+    if (t == NULL || !ASN1_TIME_diff(&day, &sec, NULL, t)) {
+        return 0;
+    }
+
+    left = (time_t)day * 86400 + sec;
+    if (left <= 0) {
+        return 0;
+    }
+
+    return now + left < limit ? now + left : limit;
+}
+
+/* Entries must not outlive the CRLs they were checked against */
+static time_t QuicCertVerifyCrlLimit(X509_STORE *store, time_t now,
+                                        time_t limit)
+{
+    STACK_OF(X509_OBJECT) *objs = NULL;
+    X509_OBJECT *obj = NULL;
+    X509_CRL *crl = NULL;
+    int i = 0;
+
+    if (!X509_STORE_lock(store)) {
+        return 0;
+    }
+
+    objs = X509_STORE_get0_objects(store);
+    for (i = 0; i < sk_X509_OBJECT_num(objs) && limit != 0; i++) {
+        obj = sk_X509_OBJECT_value(objs, i);
+        if (X509_OBJECT_get_type(obj) != X509_LU_CRL) {
+            continue;
+        }
+
+        crl = X509_OBJECT_get0_X509_CRL(obj);
+        limit = QuicCertVerifyTimeLimit(X509_CRL_get0_nextUpdate(crl), now,
+                                        limit);
+    }
+    X509_STORE_unlock(store);
+
+    return limit;
+}
+
+QuicCertVerifyCache *QuicCertVerifyCacheNew(size_t entries, uint32_t ttl)
+{
+    QuicCertVerifyCache *cache = NULL;
+    size_t num = 1;
+
+    if (entries == 0 || entries > QUIC_CERT_VERIFY_CACHE_ENTRY_MAX ||
+            ttl == 0) {
+        return NULL;
+    }
+
+    while (num < entries) {
+        num <<= 1;
+    }
+
+    cache = QuicMemCalloc(sizeof(*cache) + num * sizeof(cache->entries[0]));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->mask = num - 1;
+    cache->ttl = ttl;
+
+    return cache;
+}
+
+void QuicCertVerifyCacheFree(QuicCertVerifyCache *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    QuicMemFree(cache);
+}
+
+/*
+ * Must be called when the trust anchors or the verify callback change.
+ */
+void QuicCertVerifyCacheFlush(QuicCertVerifyCache *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    memset(cache->entries, 0, (cache->mask + 1) * sizeof(cache->entries[0]));
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int QuicCertVerifyCacheKey(uint8_t *key, STACK_OF(X509) *sk,
+                            const X509_VERIFY_PARAM *param)
+{
+    EVP_MD_CTX *mctx = NULL;
+    const EVP_MD *sha256 = QuicMd(QUIC_DIGEST_SHA256);
+    const char *host = NULL;
+    X509 *x = NULL;
+    uint8_t md[EVP_MAX_MD_SIZE] = {};
+    unsigned int len = 0;
+    unsigned long flags = 0;
+    unsigned int hostflags = 0;
+    int depth = 0;
+    int i = 0;
+    int ret = -1;
+
+    mctx = QuicEvpMdCtxNew();
+    if (mctx == NULL) {
+        return -1;
+    }
+
+    if (sha256 == NULL || !EVP_DigestInit_ex(mctx, sha256, NULL)) {
+        goto out;
+    }
+
+    for (i = 0; i < sk_X509_num(sk); i++) {
+        x = sk_X509_value(sk, i);
+        if (!X509_digest(x, sha256, md, &len) ||
+                !EVP_DigestUpdate(mctx, md, len)) {
+            goto out;
+        }
+    }
+
+    depth = X509_VERIFY_PARAM_get_depth(param);
+    flags = X509_VERIFY_PARAM_get_flags(param);
+    hostflags = X509_VERIFY_PARAM_get_hostflags(param);
+    if (!EVP_DigestUpdate(mctx, &depth, sizeof(depth)) ||
+            !EVP_DigestUpdate(mctx, &flags, sizeof(flags)) ||
+            !EVP_DigestUpdate(mctx, &hostflags, sizeof(hostflags))) {
+        goto out;
+    }
+
+    host = X509_VERIFY_PARAM_get0_host((X509_VERIFY_PARAM *)param, 0);
+    if (host != NULL && !EVP_DigestUpdate(mctx, host, strlen(host))) {
+        goto out;
+    }
+
+    if (!EVP_DigestFinal_ex(mctx, key, NULL)) {
+        goto out;
+    }
+
+    ret = 0;
+out:
+    QuicEvpMdCtxFree(mctx);
+    return ret;
+}
+
+#ifndef QUIC_TEST
+static
+#endif
+int QuicCertVerifyCacheDoLookup(QuicCertVerifyCache *cache, const uint8_t *key,
+                                    time_t now)
+{
+    QuicCertVerifyCacheEntry *e = NULL;
+    int ret = -1;
+
+    pthread_mutex_lock(&cache->lock);
+    e = QuicCertVerifyCacheSlot(cache, key);
+    if (e->expire != 0 && memcmp(e->key, key, sizeof(e->key)) == 0) {
+        if (now < e->expire) {
+            ret = 0;
+        } else {
+            e->expire = 0;
+        }
+    }
+
+    if (ret == 0) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return ret;
+}
+
+/*
+ * Return 0 if the chain behind @key passed verification before and the
+ * result is still good.
+ */
+int QuicCertVerifyCacheLookup(QuicCertVerifyCache *cache, const uint8_t *key)
+{
+    return QuicCertVerifyCacheDoLookup(cache, key, time(NULL));
+}
+
+/*
+ * Remember a successful verification, @chain is the verified one so the
+ * entry expires with the first certificate of it to do so.
+ */
+void QuicCertVerifyCacheAdd(QuicCertVerifyCache *cache, const uint8_t *key,
+                            STACK_OF(X509) *chain, X509_STORE *store,
+                            const X509_VERIFY_PARAM *param)
+{
+    QuicCertVerifyCacheEntry *e = NULL;
+    time_t now = time(NULL);
+    time_t expire = now + cache->ttl;
+    int i = 0;
+
+    for (i = 0; i < sk_X509_num(chain) && expire != 0; i++) {
+        expire = QuicCertVerifyTimeLimit(
+                    X509_get0_notAfter(sk_X509_value(chain, i)), now, expire);
+    }
+
+    if (expire != 0 && (X509_VERIFY_PARAM_get_flags(param) &
+                (X509_V_FLAG_CRL_CHECK | X509_V_FLAG_CRL_CHECK_ALL))) {
+        expire = QuicCertVerifyCrlLimit(store, now, expire);
+    }
+
+    if (expire == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    e = QuicCertVerifyCacheSlot(cache, key);
+    memcpy(e->key, key, sizeof(e->key));
+    e->expire = expire;
+    pthread_mutex_unlock(&cache->lock);
+}
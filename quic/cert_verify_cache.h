@@ -0,0 +1,48 @@
+#ifndef TBQUIC_QUIC_CERT_VERIFY_CACHE_H_
+#define TBQUIC_QUIC_CERT_VERIFY_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include <openssl/x509.h>
+#include <openssl/sha.h>
+
+#define QUIC_CERT_VERIFY_CACHE_ENTRY_MAX    (1 << 20)
+#define QUIC_CERT_VERIFY_KEY_LEN            SHA256_DIGEST_LENGTH
+
+typedef struct {
+    uint8_t key[QUIC_CERT_VERIFY_KEY_LEN];
+    /* 0 if empty */
+    time_t expire;
+} QuicCertVerifyCacheEntry;
+
+/*
+ * Chains that passed X509_verify_cert(), keyed by a hash of the chain and
+ * the verify params. Only successes are kept and never past the validity
+ * of the chain or the next update of a CRL in use. Direct mapped.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t mask;
+    uint32_t ttl;
+    uint64_t hits;
+    uint64_t misses;
+    QuicCertVerifyCacheEntry entries[];
+} QuicCertVerifyCache;
+
+QuicCertVerifyCache *QuicCertVerifyCacheNew(size_t, uint32_t);
+void QuicCertVerifyCacheFree(QuicCertVerifyCache *);
+void QuicCertVerifyCacheFlush(QuicCertVerifyCache *);
+int QuicCertVerifyCacheKey(uint8_t *, STACK_OF(X509) *,
+                            const X509_VERIFY_PARAM *);
+int QuicCertVerifyCacheLookup(QuicCertVerifyCache *, const uint8_t *);
+void QuicCertVerifyCacheAdd(QuicCertVerifyCache *, const uint8_t *,
+                            STACK_OF(X509) *, X509_STORE *,
+                            const X509_VERIFY_PARAM *);
+#ifdef QUIC_TEST
+int QuicCertVerifyCacheDoLookup(QuicCertVerifyCache *, const uint8_t *,
+                                    time_t);
+#endif
+
+#endif
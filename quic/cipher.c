@@ -8,6 +8,7 @@
 #include <assert.h>
 #include <openssl/evp.h>
 #include <openssl/obj_mac.h>
+#include <openssl/objects.h>
 #include <tbquic/cipher.h>
 
 #include "quic_local.h"
@@ -15,6 +16,7 @@
 #include "common.h"
 #include "mem.h"
 #include "tls_lib.h"
+#include "session.h"
 #include "evp.h"
 #include "log.h"
 
@@ -28,16 +30,18 @@ static size_t QuicAesEcbGetCipherLen(size_t, size_t);
 static size_t QuicAesGcmGetCipherLen(size_t, size_t);
 static size_t QuicAesCcmGetCipherLen(size_t, size_t);
 
+static const uint8_t quic_client_early_traffic[] = "c e traffic";
 static const uint8_t quic_client_handshake_traffic[] = "c hs traffic";
 static const uint8_t quic_server_handshake_traffic[] = "s hs traffic";
 static const uint8_t quic_client_application_traffic[] = "c ap traffic";
 static const uint8_t quic_server_application_traffic[] = "s ap traffic";
+static const char quic_client_early_label[] = CLIENT_EARLY_LABEL;
 static const char quic_client_handshake_label[] = CLIENT_HANDSHAKE_LABEL;
 static const char quic_server_handshake_label[] = SERVER_HANDSHAKE_LABEL;
 static const char quic_client_app_lable[] = CLIENT_APPLICATION_LABEL;
 static const char quic_server_app_label[] = SERVER_APPLICATION_LABEL;
 
-static const QuicCipherSuite cipher_suite[QUIC_ALG_MAX] = {
+static const QuicCipherSuite cipher_suite[QUIC_ALG_NUM] = {
     [QUIC_ALG_AES_128_ECB] = {
         .nid = NID_aes_128_ecb,
         .get_cipher_len = QuicAesEcbGetCipherLen,
@@ -58,11 +62,13 @@ static const QuicCipherSuite cipher_suite[QUIC_ALG_MAX] = {
     [QUIC_ALG_AES_192_GCM] = {
         .nid = NID_aes_192_gcm,
         .tag_len = EVP_GCM_TLS_TAG_LEN,
+        .hp_alg = QUIC_ALG_AES_192_ECB,
         .get_cipher_len = QuicAesGcmGetCipherLen,
     },
     [QUIC_ALG_AES_256_GCM] = {
         .nid = NID_aes_256_gcm,
         .tag_len = EVP_GCM_TLS_TAG_LEN,
+        .hp_alg = QUIC_ALG_AES_256_ECB,
         .get_cipher_len = QuicAesGcmGetCipherLen,
     },
     [QUIC_ALG_AES_128_CCM] = {
@@ -78,8 +84,17 @@ static const QuicCipherSuite cipher_suite[QUIC_ALG_MAX] = {
         .get_cipher_len = QuicAesCcmGetCipherLen,
     },
     [QUIC_ALG_CHACHA20] = {
-        .nid = NID_aes_256_ccm,
-        .get_cipher_len = QuicAesCcmGetCipherLen,
+        .nid = NID_chacha20,
+        .get_cipher_len = QuicAesEcbGetCipherLen,
+    },
+    [QUIC_ALG_CHACHA20POLY1305] = {
+        .nid = NID_chacha20_poly1305,
+        .tag_len = EVP_CHACHAPOLY_TLS_TAG_LEN,
+        .hp_alg = QUIC_ALG_CHACHA20,
+        .get_cipher_len = QuicAesGcmGetCipherLen,
+    },
+    [QUIC_ALG_AES_256_CBC] = {
+        .nid = NID_aes_256_cbc,
     },
 };
 
@@ -90,6 +105,11 @@ static int quic_digest_method_map[QUIC_DIGEST_NUM] = {
     [QUIC_DIGEST_SHA1] = NID_sha1,
 };
 
+/*
+ * Fetched once by QuicLoadCiphers(), so that EVP_*Init() never goes through
+ * the provider lookup(and its locks) of OpenSSL 3 implicit fetching.
+ */
+static const EVP_CIPHER *quic_cipher_methods[QUIC_ALG_NUM];
 static const EVP_MD *quic_digest_methods[QUIC_DIGEST_NUM];
 
 static const uint8_t handshake_salt_v1[] =
@@ -178,6 +198,21 @@ int QuicCipherGetTagLen(uint32_t alg)
     return suite->tag_len;
 }
 
+/*
+ * AES-128 based AEADs leave hp_alg 0, which is QUIC_ALG_AES_128_ECB.
+ */
+int QuicCipherGetHPAlg(uint32_t alg)
+{
+    const QuicCipherSuite *suite = NULL;
+
+    suite = QuicCipherSuiteFind(alg);
+    if (suite == NULL) {
+        return -1;
+    }
+
+    return suite->hp_alg;
+}
+
 /*
  * Compute the initial secrets given Connection ID "cid".
  */
@@ -219,9 +254,11 @@ static int QuicCipherDoPrepare(QUIC_CIPHER *cipher, const EVP_CIPHER *c,
                                 uint8_t *secret, const uint8_t *key,
                                 int enc)
 {
-    cipher->ctx = EVP_CIPHER_CTX_new();
     if (cipher->ctx == NULL) {
-        return -1;
+        cipher->ctx = QuicEvpCipherCtxNew();
+        if (cipher->ctx == NULL) {
+            return -1;
+        }
     }
 
     if (secret == NULL) {
@@ -232,16 +269,13 @@ static int QuicCipherDoPrepare(QUIC_CIPHER *cipher, const EVP_CIPHER *c,
     return QuicEvpCipherInit(cipher->ctx, c, key, NULL, enc);
 }
 
-static const EVP_CIPHER *QuicFindCipherByAlg(uint32_t alg)
+const EVP_CIPHER *QuicFindCipherByAlg(uint32_t alg)
 {
-    int nid = 0;
-
-    nid = QuicCipherNidFind(alg);
-    if (nid < 0) {
+    if (QUIC_GE(alg, QUIC_ALG_NUM)) {
         return NULL;
     }
 
-    return EVP_get_cipherbynid(nid);
+    return quic_cipher_methods[alg];
 }
 
 static int QuicHPCipherPrepare(QuicHPCipher *cipher, const EVP_MD *md,
@@ -313,6 +347,39 @@ static int QuicPPCipherPrepare(QuicPPCipher *cipher, const EVP_MD *md,
     return QuicCipherDoPrepare(&cipher->cipher, c, secret, key, enc);
 }
 
+/*
+ * RFC 9001 6.1. Initiating a Key Update
+ * secret_<n+1> = HKDF-Expand-Label(secret_<n>, "quic ku", "", Hash.length)
+ * @secret is replaced by the next generation secret, then the packet
+ * protection key and IV of @cipher are derived from it. The header
+ * protection key is not updated. The cipher context of @cipher is reused
+ * if it has been allocated.
+ */
+int QuicPPCipherKeyUpdate(QuicPPCipher *cipher, uint32_t alg,
+                            const EVP_MD *md, uint8_t *secret, int enc)
+{
+    uint8_t next_secret[EVP_MAX_MD_SIZE] = {};
+    static const uint8_t quic_ku_label[] = "quic ku";
+    int md_size = 0;
+
+    md_size = EVP_MD_size(md);
+    if (md_size <= 0) {
+        return -1;
+    }
+
+    if (QuicTLS13HkdfExpandLabel(md, secret, md_size, quic_ku_label,
+                sizeof(quic_ku_label) - 1, next_secret, md_size) < 0) {
+        QUIC_LOG("Gen next secret failed\n");
+        return -1;
+    }
+
+    QuicMemcpy(secret, next_secret, md_size);
+    OPENSSL_cleanse(next_secret, sizeof(next_secret));
+    cipher->cipher.alg = alg;
+
+    return QuicPPCipherPrepare(cipher, md, secret, enc);
+}
+
 int QuicCiphersPrepare(QUIC_CIPHERS *ciphers, const EVP_MD *md,
                         uint8_t *secret, int enc)
 {
@@ -350,6 +417,7 @@ int QuicCreateInitialDecoders(QUIC *quic, uint32_t version, QUIC_DATA *cid)
     uint8_t *encrypt_secret = NULL;
     uint8_t client_secret[HASH_SHA2_256_LENGTH];
     uint8_t server_secret[HASH_SHA2_256_LENGTH];
+    const EVP_MD *md = QuicMd(QUIC_DIGEST_SHA256);
     
     init = &quic->initial;
     if (init->decrypt.cipher_inited == true ||
@@ -369,12 +437,12 @@ int QuicCreateInitialDecoders(QUIC *quic, uint32_t version, QUIC_DATA *cid)
         encrypt_secret = client_secret;
     }
 
-    if (QuicDeriveInitialSecrets(cid, EVP_sha256(), client_secret,
+    if (QuicDeriveInitialSecrets(cid, md, client_secret,
                 server_secret, version) < 0) {
         return -1;
     }
 
-    return QuicPrepareEncoderDecoders(init, EVP_sha256(), decrypt_secret,
+    return QuicPrepareEncoderDecoders(init, md, decrypt_secret,
                             encrypt_secret);
 }
 
@@ -484,7 +552,8 @@ QuicCreateEncryptorDecryptor(TLS *s, QUIC_CRYPTO *c, uint8_t *in_secret,
         QuicMemcpy(hash, hashval, hlen);
     }
 
-    if (QUIC_set_hp_cipher_space_alg(cs, QUIC_ALG_AES_128_ECB) < 0) {
+    if (QUIC_set_hp_cipher_space_alg(cs,
+                QuicCipherGetHPAlg(cipher->algorithm_enc)) < 0) {
         QUIC_LOG("Set handshake HP cipher failed\n");
         return QUIC_FLOW_RET_ERROR;
     }
@@ -525,12 +594,12 @@ static int QuicCreateHandshakeClientEncryptorDecryptor(QUIC *quic, int enc)
     TLS *s = &quic->tls;
     
     return QuicCreateEncryptorDecryptor(s, &quic->handshake,
-                            s->handshake_secret, NULL,
-                            s->handshake_traffic_hash,
-                            sizeof(s->handshake_traffic_hash),
+                            s->hs->handshake_secret, NULL,
+                            s->hs->handshake_traffic_hash,
+                            sizeof(s->hs->handshake_traffic_hash),
                             quic_client_handshake_traffic,
                             sizeof(quic_client_handshake_traffic) - 1,
-                            s->client_finished_secret,
+                            s->hs->client_finished_secret,
                             quic_client_handshake_label, false, enc);
 }
 
@@ -540,12 +609,12 @@ QuicCreateHandshakeServerEncryptorDecryptor(QUIC *quic, int enc)
     TLS *s = &quic->tls;
     
     return QuicCreateEncryptorDecryptor(s, &quic->handshake,
-                            s->handshake_secret, NULL,
-                            s->handshake_traffic_hash,
-                            sizeof(s->handshake_traffic_hash),
+                            s->hs->handshake_secret, NULL,
+                            s->hs->handshake_traffic_hash,
+                            sizeof(s->hs->handshake_traffic_hash),
                             quic_server_handshake_traffic,
                             sizeof(quic_server_handshake_traffic) - 1,
-                            s->server_finished_secret,
+                            s->hs->server_finished_secret,
                             quic_server_handshake_label, true, enc);
 }
 
@@ -553,26 +622,91 @@ int QuicCreateAppDataClientEncryptorDecryptor(QUIC *quic, int enc)
 {
     TLS *s = &quic->tls;
     
-    return QuicCreateEncryptorDecryptor(s, &quic->application, s->master_secret,
+    if (QuicCreateEncryptorDecryptor(s, &quic->application,
+                            s->hs->master_secret,
                             s->client_app_traffic_secret,
-                            s->server_finished_hash,
-                            sizeof(s->server_finished_hash),
+                            s->hs->server_finished_hash,
+                            sizeof(s->hs->server_finished_hash),
                             quic_client_application_traffic,
                             sizeof(quic_client_application_traffic) - 1,
-                            NULL, quic_client_app_lable, false, enc);
+                            NULL, quic_client_app_lable, false, enc) < 0) {
+        return -1;
+    }
+
+    return QuicKeyUpdateInit(quic);
 }
 
 static int QuicCreateAppDataServerEncryptorDecryptor(QUIC *quic, int enc)
 {
     TLS *s = &quic->tls;
     
-    return QuicCreateEncryptorDecryptor(s, &quic->application, s->master_secret,
+    if (QuicCreateEncryptorDecryptor(s, &quic->application,
+                            s->hs->master_secret,
                             s->server_app_traffic_secret,
-                            s->server_finished_hash,
-                            sizeof(s->server_finished_hash),
+                            s->hs->server_finished_hash,
+                            sizeof(s->hs->server_finished_hash),
                             quic_server_application_traffic,
                             sizeof(quic_server_application_traffic) - 1,
-                            NULL, quic_server_app_label, true, enc);
+                            NULL, quic_server_app_label, true, enc) < 0) {
+        return -1;
+    }
+
+    return QuicKeyUpdateInit(quic);
+}
+
+/*
+ * RFC 9001 5.6. 0-RTT keys come from client_early_traffic_secret, derived
+ * from the resumed PSK and ClientHello. The cipher suite of the session is
+ * used since the handshake one is not known yet on client.
+ */
+static int QuicCreateZeroRttEncryptorDecryptor(QUIC *quic, int enc)
+{
+    TLS *s = &quic->tls;
+    QuicCipherSpace *cs = &quic->zero_rtt;
+    const TlsCipher *cipher = NULL;
+    const EVP_MD *md = NULL;
+
+    if (cs->cipher_inited == true) {
+        return 0;
+    }
+
+    if (quic->session == NULL || quic->session->cipher == NULL) {
+        QUIC_LOG("No session cipher\n");
+        return -1;
+    }
+
+    cipher = quic->session->cipher;
+    if (QUIC_set_hp_cipher_space_alg(cs,
+                QuicCipherGetHPAlg(cipher->algorithm_enc)) < 0) {
+        QUIC_LOG("Set 0-RTT HP cipher failed\n");
+        return -1;
+    }
+
+    if (QUIC_set_pp_cipher_space_alg(cs, cipher->algorithm_enc) < 0) {
+        QUIC_LOG("Set 0-RTT PP cipher failed\n");
+        return -1;
+    }
+
+    md = QuicMd(cipher->digest);
+    if (md == NULL) {
+        return -1;
+    }
+
+    return QuicInstallEncryptorDecryptor(s, md, s->hs->early_secret, NULL,
+                                    quic_client_early_traffic,
+                                    sizeof(quic_client_early_traffic) - 1,
+                                    s->hs->client_hello_hash, cs, NULL, 0,
+                                    quic_client_early_label, enc);
+}
+
+int QuicCreateZeroRttClientEncoders(QUIC *quic)
+{
+    return QuicCreateZeroRttEncryptorDecryptor(quic, QUIC_EVP_ENCRYPT);
+}
+
+int QuicCreateZeroRttClientDecoders(QUIC *quic)
+{
+    return QuicCreateZeroRttEncryptorDecryptor(quic, QUIC_EVP_DECRYPT);
 }
 
 int QuicCreateHandshakeClientEncoders(QUIC *quic)
@@ -650,29 +784,110 @@ const EVP_MD *QuicMd(uint32_t idx)
 
 static void QuicCipherFree(QUIC_CIPHER *cipher)
 {
-    EVP_CIPHER_CTX_free(cipher->ctx);
+    QuicEvpCipherCtxFree(cipher->ctx);
     cipher->ctx = NULL;
 }
 
+void QuicPPCipherCtxFree(QuicPPCipher *cipher)
+{
+    QuicCipherFree(&cipher->cipher);
+}
+
 void QuicCipherCtxFree(QUIC_CIPHERS *ciphers)
 {
     QuicCipherFree(&ciphers->hp_cipher.cipher);
     QuicCipherFree(&ciphers->pp_cipher.cipher);
 }
 
-int QuicLoadCiphers(void)
+static const EVP_CIPHER *
+QuicCipherFetch(QUIC_LIB_CTX *libctx, int nid, const char *propq)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_CIPHER_fetch(libctx, OBJ_nid2sn(nid), propq);
+#else
+    return EVP_get_cipherbynid(nid);
+#endif
+}
+
+static const EVP_MD *
+QuicMdFetch(QUIC_LIB_CTX *libctx, int nid, const char *propq)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_MD_fetch(libctx, OBJ_nid2sn(nid), propq);
+#else
+    return EVP_get_digestbynid(nid);
+#endif
+}
+
+int QuicLoadCiphers(QUIC_LIB_CTX *libctx, const char *propq)
 {
     const EVP_MD *md = NULL;
     uint32_t md_id = 0;
+    uint32_t alg = 0;
+    int nid = 0;
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+    if (libctx != NULL || propq != NULL) {
+        QUIC_LOG("Library context needs OpenSSL 3.0\n");
+        return -1;
+    }
+#endif
+
+    QuicUnloadCiphers();
+    if (QuicEvpLibCtxSet(libctx, propq) < 0) {
+        return -1;
+    }
 
     for (md_id = 0; md_id < QUIC_DIGEST_NUM; md_id++) {
-        md = EVP_get_digestbynid(quic_digest_method_map[md_id]);
+        md = QuicMdFetch(libctx, quic_digest_method_map[md_id], propq);
         if (md == NULL) {
-            return -1;
+            QUIC_LOG("Fetch digest %u failed\n", md_id);
+            goto err;
         }
         quic_digest_methods[md_id] = md;
     }
 
+    for (alg = 0; alg < QUIC_ALG_NUM; alg++) {
+        nid = cipher_suite[alg].nid;
+        if (nid == NID_undef) {
+            continue;
+        }
+        /*
+         * Not all ciphers are provided by a restricted provider(e.g. FIPS),
+         * a missing one fails only when it is negotiated.
+         */
+        quic_cipher_methods[alg] = QuicCipherFetch(libctx, nid, propq);
+    }
+
+    if (quic_cipher_methods[QUIC_ALG_AES_256_CBC] == NULL) {
+        QUIC_LOG("Fetch ticket cipher failed\n");
+        goto err;
+    }
+
     return 0;
+err:
+    QuicUnloadCiphers();
+    return -1;
 }
 
+void QuicUnloadCiphers(void)
+{
+    uint32_t md_id = 0;
+    uint32_t alg = 0;
+
+    for (md_id = 0; md_id < QUIC_DIGEST_NUM; md_id++) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_MD_free((EVP_MD *)quic_digest_methods[md_id]);
+#endif
+        quic_digest_methods[md_id] = NULL;
+    }
+
+    for (alg = 0; alg < QUIC_ALG_NUM; alg++) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_CIPHER_free((EVP_CIPHER *)quic_cipher_methods[alg]);
+#endif
+        quic_cipher_methods[alg] = NULL;
+    }
+
+    QuicEvpLibCtxClear();
+}
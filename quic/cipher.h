@@ -6,6 +6,7 @@
 #include <openssl/evp.h>
 
 #include <tbquic/types.h>
+#include <tbquic/cipher.h>
 #include "base.h"
 
 #define TLS13_AEAD_NONCE_LENGTH     12
@@ -20,6 +21,15 @@
 #define EARLY_EXPORTER_SECRET_LABEL "EARLY_EXPORTER_SECRET"
 #define EXPORTER_SECRET_LABEL "EXPORTER_SECRET"
 
+/*
+ * Library internal algorithms, numbered after the public QuicAlgId so that
+ * enum stays ABI stable.
+ */
+enum {
+    QUIC_ALG_AES_256_CBC = QUIC_ALG_MAX,
+    QUIC_ALG_NUM,
+};
+
 #define QUIC_A_ALG_MASK_RSA      0x0001U
 #define QUIC_A_ALG_MASK_ECDRSA   0x0002U
 
@@ -54,6 +64,8 @@ typedef struct {
 typedef struct {
     int nid;
     uint32_t tag_len;
+    /* Header protection of an AEAD, RFC 9001 5.4 */
+    uint32_t hp_alg;
     size_t (*get_cipher_len)(size_t, size_t);
 } QuicCipherSuite;
 
@@ -72,6 +84,8 @@ struct QuicCiphers {
 extern void (*QuicSecretTest)(uint8_t *secret);
 #endif
 int QuicCreateInitialDecoders(QUIC *, uint32_t, QUIC_DATA *);
+int QuicCreateZeroRttClientEncoders(QUIC *);
+int QuicCreateZeroRttClientDecoders(QUIC *);
 int QuicCreateHandshakeClientEncoders(QUIC *);
 int QuicCreateHandshakeClientDecoders(QUIC *);
 int QuicCreateHandshakeServerEncoders(QUIC *);
@@ -80,13 +94,20 @@ int QuicCreateAppDataClientEncoders(QUIC *);
 int QuicCreateAppDataClientDecoders(QUIC *);
 int QuicCreateAppDataServerEncoders(QUIC *);
 int QuicCreateAppDataServerDecoders(QUIC *);
+int QuicPPCipherKeyUpdate(QuicPPCipher *, uint32_t, const EVP_MD *,
+                            uint8_t *, int);
+int QuicCiphersPrepare(QUIC_CIPHERS *, const EVP_MD *, uint8_t *, int);
 void QuicCipherCtxFree(QUIC_CIPHERS *);
+void QuicPPCipherCtxFree(QuicPPCipher *);
 int QuicCipherNidFind(uint32_t);
 size_t QuicCipherLenGet(uint32_t, size_t);
 int QuicCipherGetTagLen(uint32_t);
+int QuicCipherGetHPAlg(uint32_t);
 int QuicDoCipher(QUIC_CIPHER *, uint8_t *, size_t *, size_t,
                     const uint8_t *, size_t);
 const EVP_MD *QuicMd(uint32_t);
-int QuicLoadCiphers(void);
+const EVP_CIPHER *QuicFindCipherByAlg(uint32_t);
+int QuicLoadCiphers(QUIC_LIB_CTX *, const char *);
+void QuicUnloadCiphers(void);
 
 #endif
@@ -0,0 +1,299 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "clnt_session_cache.h"
+
+#include <string.h>
+
+#include "mem.h"
+#include "log.h"
+
+#define QUIC_CLNT_SESSION_CACHE_FNV_OFFSET  0xcbf29ce484222325ULL
+#define QUIC_CLNT_SESSION_CACHE_FNV_PRIME   0x100000001b3ULL
+
+static uint64_t QuicClntSessionHashBytes(uint64_t hash, const uint8_t *data,
+                                            size_t len)
+{
+    size_t i = 0;
+
+    for (i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= QUIC_CLNT_SESSION_CACHE_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static uint64_t QuicClntSessionKeyHash(const QuicClntSessionKey *key)
+{
+    uint64_t hash = QUIC_CLNT_SESSION_CACHE_FNV_OFFSET;
+
+    /* The terminating NUL keeps hostname and ALPN apart */
+    hash = QuicClntSessionHashBytes(hash, (const uint8_t *)key->hostname,
+                                    strlen(key->hostname) + 1);
+    hash = QuicClntSessionHashBytes(hash, key->alpn->ptr_u8, key->alpn->len);
+    return QuicClntSessionHashBytes(hash, (const uint8_t *)&key->port,
+                                    sizeof(key->port));
+}
+
+static QuicClntSessionCacheEntry *
+QuicClntSessionCacheFind(QuicClntSessionCache *cache,
+                            const QuicClntSessionKey *key, uint64_t hash)
+{
+    QuicClntSessionCacheEntry *e = NULL;
+    struct list_head *bucket = &cache->buckets[hash & cache->bucket_mask];
+
+    list_for_each_entry(e, bucket, hash_node) {
+        if (e->hash == hash && e->port == key->port &&
+                strcmp(e->hostname, key->hostname) == 0 &&
+                QuicDataEq(&e->alpn, key->alpn)) {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+static void QuicClntSessionCacheEntryFree(QuicClntSessionCache *cache,
+                                            QuicClntSessionCacheEntry *e)
+{
+    list_del(&e->hash_node);
+    list_del(&e->lru_node);
+    cache->num--;
+
+    QuicSessionFree(e->sess);
+    QuicDataFree(&e->alpn);
+    QuicMemFree(e->hostname);
+    QuicMemFree(e);
+}
+
+static QuicClntSessionCacheEntry *
+QuicClntSessionCacheEntryNew(const QuicClntSessionKey *key, uint64_t hash)
+{
+    QuicClntSessionCacheEntry *e = NULL;
+
+    e = QuicMemCalloc(sizeof(*e));
+    if (e == NULL) {
+        return NULL;
+    }
+
+    e->hash = hash;
+    e->port = key->port;
+    e->hostname = QuicMemStrDup(key->hostname);
+    if (e->hostname == NULL) {
+        goto err;
+    }
+
+    if (QuicDataDup(&e->alpn, key->alpn) < 0) {
+        goto err;
+    }
+
+    e->sess = QuicSessionCreate();
+    if (e->sess == NULL) {
+        goto err;
+    }
+
+    return e;
+err:
+    QuicDataFree(&e->alpn);
+    if (e->hostname != NULL) {
+        QuicMemFree(e->hostname);
+    }
+    QuicMemFree(e);
+    return NULL;
+}
+
+static bool QuicClntSessionTicketExpired(QuicSessionTicket *t, time_t now)
+{
+    return (uint64_t)(now - t->time) >= t->lifetime_hint;
+}
+
+static void QuicClntSessionTicketDrop(QUIC_SESSION *sess, QuicSessionTicket *t)
+{
+    list_del(&t->node);
+    sess->tick_identity--;
+    QuicSessionTicketFree(t);
+}
+
+QuicClntSessionCache *QuicClntSessionCacheNew(size_t entries)
+{
+    QuicClntSessionCache *cache = NULL;
+    size_t bucket_num = 1;
+    size_t i = 0;
+
+    if (entries == 0 || entries > QUIC_CLNT_SESSION_CACHE_ENTRY_MAX) {
+        return NULL;
+    }
+
+    while (bucket_num < entries) {
+        bucket_num <<= 1;
+    }
+
+    cache = QuicMemCalloc(sizeof(*cache) +
+                            bucket_num * sizeof(cache->buckets[0]));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->max = entries;
+    cache->bucket_mask = bucket_num - 1;
+    INIT_LIST_HEAD(&cache->lru);
+    for (i = 0; i < bucket_num; i++) {
+        INIT_LIST_HEAD(&cache->buckets[i]);
+    }
+
+    return cache;
+}
+
+void QuicClntSessionCacheFree(QuicClntSessionCache *cache)
+{
+    QuicClntSessionCacheEntry *e = NULL;
+    QuicClntSessionCacheEntry *n = NULL;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    list_for_each_entry_safe(e, n, &cache->lru, lru_node) {
+        QuicClntSessionCacheEntryFree(cache, e);
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    QuicMemFree(cache);
+}
+
+/*
+ * Keep a copy of @t for the next connection to the same server. Expired
+ * tickets are dropped here, so the lookup only has to check the one it
+ * hands out.
+ */
+int QuicClntSessionCacheAdd(QuicClntSessionCache *cache,
+                            const QuicClntSessionKey *key,
+                            const TlsCipher *cipher, QUIC_SESSION *sess,
+                            QuicSessionTicket *t)
+{
+    QuicClntSessionCacheEntry *e = NULL;
+    QuicSessionTicket *dup = NULL;
+    QuicSessionTicket *old = NULL;
+    QuicSessionTicket *n = NULL;
+    time_t now = time(NULL);
+    uint64_t hash = 0;
+    int ret = -1;
+
+    if (cipher == NULL || key->hostname == NULL ||
+            QuicClntSessionTicketExpired(t, now)) {
+        return -1;
+    }
+
+    dup = QuicSessionTicketDup(t);
+    if (dup == NULL) {
+        return -1;
+    }
+
+    hash = QuicClntSessionKeyHash(key);
+    pthread_mutex_lock(&cache->lock);
+    e = QuicClntSessionCacheFind(cache, key, hash);
+    if (e == NULL) {
+        if (cache->num == cache->max) {
+            QuicClntSessionCacheEntryFree(cache, list_last_entry(&cache->lru,
+                        QuicClntSessionCacheEntry, lru_node));
+        }
+
+        e = QuicClntSessionCacheEntryNew(key, hash);
+        if (e == NULL) {
+            goto out;
+        }
+
+        list_add_tail(&e->hash_node,
+                        &cache->buckets[hash & cache->bucket_mask]);
+        list_add(&e->lru_node, &cache->lru);
+        cache->num++;
+    } else {
+        list_move(&e->lru_node, &cache->lru);
+    }
+
+    list_for_each_entry_safe(old, n, &e->sess->ticket_queue, node) {
+        /* Tickets of another cipher suite can not be offered together */
+        if (e->sess->cipher != cipher ||
+                QuicClntSessionTicketExpired(old, now) ||
+                e->sess->tick_identity >= QUIC_CLNT_SESSION_CACHE_TICKET_MAX) {
+            QuicClntSessionTicketDrop(e->sess, old);
+        }
+    }
+
+    e->sess->cipher = cipher;
+    e->sess->max_early_data = sess->max_early_data;
+    e->sess->peer_param = sess->peer_param;
+    QuicSessionTicketAdd(e->sess, dup);
+    dup = NULL;
+    ret = 0;
+out:
+    pthread_mutex_unlock(&cache->lock);
+    if (dup != NULL) {
+        QuicSessionTicketFree(dup);
+    }
+    return ret;
+}
+
+/*
+ * Take the newest ticket for the server out of the cache, a ticket is
+ * never offered twice (RFC 8446 C.4). Return a session holding just that
+ * ticket, NULL on a miss.
+ */
+QUIC_SESSION *QuicClntSessionCacheGet(QuicClntSessionCache *cache,
+                                        const QuicClntSessionKey *key)
+{
+    QuicClntSessionCacheEntry *e = NULL;
+    QUIC_SESSION *sess = NULL;
+    QuicSessionTicket *t = NULL;
+    time_t now = time(NULL);
+    uint64_t hash = 0;
+
+    if (key->hostname == NULL) {
+        return NULL;
+    }
+
+    sess = QuicSessionCreate();
+    if (sess == NULL) {
+        return NULL;
+    }
+
+    hash = QuicClntSessionKeyHash(key);
+    pthread_mutex_lock(&cache->lock);
+    e = QuicClntSessionCacheFind(cache, key, hash);
+    while (e != NULL && !list_empty(&e->sess->ticket_queue)) {
+        t = list_last_entry(&e->sess->ticket_queue, QuicSessionTicket, node);
+        list_del(&t->node);
+        e->sess->tick_identity--;
+        if (!QuicClntSessionTicketExpired(t, now)) {
+            break;
+        }
+        QuicSessionTicketFree(t);
+        t = NULL;
+    }
+
+    if (t != NULL) {
+        sess->cipher = e->sess->cipher;
+        sess->max_early_data = e->sess->max_early_data;
+        sess->peer_param = e->sess->peer_param;
+        QuicSessionTicketAdd(sess, t);
+    }
+
+    if (e != NULL) {
+        if (list_empty(&e->sess->ticket_queue)) {
+            QuicClntSessionCacheEntryFree(cache, e);
+        } else {
+            list_move(&e->lru_node, &cache->lru);
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (t == NULL) {
+        QuicSessionFree(sess);
+        return NULL;
+    }
+
+    return sess;
+}
@@ -0,0 +1,53 @@
+#ifndef TBQUIC_QUIC_CLNT_SESSION_CACHE_H_
+#define TBQUIC_QUIC_CLNT_SESSION_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <tbquic/types.h>
+
+#include "base.h"
+#include "list.h"
+#include "session.h"
+#include "tls_cipher.h"
+
+#define QUIC_CLNT_SESSION_CACHE_ENTRY_MAX   (1 << 20)
+/* Tickets kept per server, each one is used only once */
+#define QUIC_CLNT_SESSION_CACHE_TICKET_MAX  4
+
+typedef struct {
+    const char *hostname;
+    const QUIC_DATA *alpn;
+    uint16_t port;
+} QuicClntSessionKey;
+
+typedef struct {
+    struct list_head hash_node;
+    struct list_head lru_node;
+    uint64_t hash;
+    char *hostname;
+    QUIC_DATA alpn;
+    uint16_t port;
+    /* Tickets not used yet, the newest at the tail */
+    QUIC_SESSION *sess;
+} QuicClntSessionCacheEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t max;
+    size_t num;
+    size_t bucket_mask;
+    /* Most recently used first */
+    struct list_head lru;
+    struct list_head buckets[];
+} QuicClntSessionCache;
+
+QuicClntSessionCache *QuicClntSessionCacheNew(size_t);
+void QuicClntSessionCacheFree(QuicClntSessionCache *);
+int QuicClntSessionCacheAdd(QuicClntSessionCache *, const QuicClntSessionKey *,
+                            const TlsCipher *, QUIC_SESSION *,
+                            QuicSessionTicket *);
+QUIC_SESSION *QuicClntSessionCacheGet(QuicClntSessionCache *,
+                                        const QuicClntSessionKey *);
+
+#endif
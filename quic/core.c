@@ -10,6 +10,8 @@
 #include "stream.h"
 #include "log.h"
 
+static bool QuicTxQueueHasPkt(QUIC *, uint32_t);
+
 static int QuicCryptoOffset[QUIC_PKT_TYPE_MAX] = {
     [QUIC_PKT_TYPE_INITIAL] = offsetof(QUIC, initial),
     [QUIC_PKT_TYPE_0RTT] =  offsetof(QUIC, application),
@@ -56,6 +58,7 @@ int QuicWritePkt(QUIC *quic, QuicStaticBuffer *buffer)
     size_t total_len = 0;
     bool end = false;
     bool short_header = false;
+    bool handshake_sent = false;
     int ret = 0;
 
     WPacketStaticBufInit(&pkt, buffer->data, quic->mss);
@@ -77,9 +80,13 @@ int QuicWritePkt(QUIC *quic, QuicStaticBuffer *buffer)
             }
         }
 
-        if (QuicStreamSendFlowCtrl(quic, qb->stream_id, qb->stream_len,
-                    qb->pkt_type) < 0) {
-            return -1;
+        /* Early data sent again was counted when it was first sent */
+        if (!(qb->flags & QBUFF_FLAGS_FLOW_COUNTED)) {
+            if (QuicStreamSendFlowCtrl(quic, qb->stream_id, qb->stream_len,
+                        qb->pkt_type) < 0) {
+                return -1;
+            }
+            qb->flags |= QBUFF_FLAGS_FLOW_COUNTED;
         }
 
         //QUIC_LOG("last = %d, data len = %lu\n", end, QBuffGetDataLen(qb));
@@ -93,6 +100,9 @@ int QuicWritePkt(QUIC *quic, QuicStaticBuffer *buffer)
         assert(c != NULL);
 
         short_header = qb->pkt_type == QUIC_PKT_TYPE_1RTT;
+        if (qb->pkt_type == QUIC_PKT_TYPE_HANDSHAKE) {
+            handshake_sent = true;
+        }
         QBuffQueueUnlink(qb);
         QBuffQueueAdd(&c->sent_queue, qb);
         if (qb == tail) {
@@ -103,6 +113,24 @@ int QuicWritePkt(QUIC *quic, QuicStaticBuffer *buffer)
     buffer->len = WPacket_get_written(&pkt);
     WPacketCleanup(&pkt);
 
+    /*
+     * RFC 9001 4.9.1. A client MUST discard Initial keys when it first
+     * sends a Handshake packet.
+     */
+    if (!QUIC_IS_SERVER(quic) && handshake_sent) {
+        QuicCryptoDiscard(quic, QUIC_PKT_TYPE_INITIAL);
+    }
+
+    /*
+     * RFC 9001 4.9.2. The server confirms the handshake when it completes,
+     * Handshake keys are discarded after pending Handshake packets sent.
+     */
+    if (QUIC_IS_SERVER(quic) &&
+            quic->statem.state == QUIC_STATEM_HANDSHAKE_DONE &&
+            !QuicTxQueueHasPkt(quic, QUIC_PKT_TYPE_HANDSHAKE)) {
+        QuicHandshakeConfirmed(quic);
+    }
+
     return 0;
 }
 
@@ -123,3 +151,94 @@ void QuicCryptoFree(QUIC_CRYPTO *c)
     QuicCryptoKeyFree(c);
 }
 
+static bool QuicTxQueueHasPkt(QUIC *quic, uint32_t pkt_type)
+{
+    QBUFF *qb = NULL;
+
+    list_for_each_entry(qb, &quic->tx_queue.queue, node) {
+        if (qb->pkt_type == pkt_type) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * RFC 9001 4.9. Discarding Unused Keys
+ * Keys, sent and unsent packets of the packet number space are freed,
+ * packets of this space received later are dropped.
+ */
+void QuicCryptoDiscard(QUIC *quic, uint32_t pkt_type)
+{
+    QUIC_CRYPTO *c = QuicCryptoGet(quic, pkt_type);
+    QBUFF *qb = NULL;
+    QBUFF *n = NULL;
+
+    if (c == NULL || c->discarded) {
+        return;
+    }
+
+    list_for_each_entry_safe(qb, n, &quic->tx_queue.queue, node) {
+        if (qb->pkt_type == pkt_type) {
+            QBuffQueueUnlink(qb);
+            QBuffFree(qb);
+        }
+    }
+
+    QuicCryptoFree(c);
+    c->discarded = true;
+}
+
+/*
+ * RFC 9001 4.9.3. 0-RTT keys are discarded once 1-RTT keys are in use.
+ * Early data not sent yet goes out in 1-RTT packets. If the server rejected
+ * early data, the sent 0-RTT packets were dropped and are sent again too
+ * (RFC 9001 4.6.2). Both are moved behind the packets queued so far.
+ */
+void QuicZeroRttDiscard(QUIC *quic, bool rejected)
+{
+    QUIC_CRYPTO *c = QuicGetOneRttCrypto(quic);
+    QBUFF *qb = NULL;
+    QBUFF *n = NULL;
+    LIST_HEAD(replay);
+
+    list_for_each_entry_safe(qb, n, &quic->tx_queue.queue, node) {
+        if (qb->pkt_type == QUIC_PKT_TYPE_0RTT) {
+            QBuffQueueUnlink(qb);
+            QBuffSetPktType(qb, QUIC_PKT_TYPE_1RTT);
+            list_add_tail(&qb->node, &replay);
+        }
+    }
+
+    if (rejected) {
+        list_for_each_entry_safe(qb, n, &c->sent_queue.queue, node) {
+            if (qb->pkt_type == QUIC_PKT_TYPE_0RTT) {
+                QBuffQueueUnlink(qb);
+                QBuffSetPktType(qb, QUIC_PKT_TYPE_1RTT);
+                list_add_tail(&qb->node, &replay);
+            }
+        }
+    }
+
+    list_splice_tail(&replay, &quic->tx_queue.queue);
+
+    QuicCipherCtxFree(&quic->zero_rtt.ciphers);
+    quic->zero_rtt.cipher_inited = false;
+}
+
+/*
+ * RFC 9001 4.9.2. Handshake keys and the TLS handshake state are discarded
+ * once the handshake is confirmed.
+ */
+void QuicHandshakeConfirmed(QUIC *quic)
+{
+    if (quic->handshake.discarded) {
+        return;
+    }
+
+    QuicCryptoDiscard(quic, QUIC_PKT_TYPE_INITIAL);
+    QuicCryptoDiscard(quic, QUIC_PKT_TYPE_HANDSHAKE);
+    TlsHandshakeDiscard(&quic->tls);
+}
+
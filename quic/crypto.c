@@ -8,6 +8,7 @@
 #include <openssl/hmac.h>
 
 #include "packet_local.h"
+#include "evp.h"
 
 uint8_t *HkdfExtract(const EVP_MD *evp_md, const uint8_t *salt, size_t salt_len,
                         const uint8_t *key, size_t key_len, uint8_t *prk,
@@ -47,7 +48,7 @@ uint8_t *HkdfExpand(const EVP_MD *evp_md, const uint8_t *prk, size_t prk_len,
         return NULL;
     }
 
-    if ((hmac = HMAC_CTX_new()) == NULL) {
+    if ((hmac = QuicHmacCtxNew()) == NULL) {
         return NULL;
     }
 
@@ -93,7 +94,7 @@ uint8_t *HkdfExpand(const EVP_MD *evp_md, const uint8_t *prk, size_t prk_len,
 
  err:
     OPENSSL_cleanse(prev, sizeof(prev));
-    HMAC_CTX_free(hmac);
+    QuicHmacCtxFree(hmac);
     return ret;
 }
 
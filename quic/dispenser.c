@@ -68,6 +68,7 @@ int QuicDispenserReadBytes(QUIC *quic, RPacket *pkt)
     QUIC_DATA *buf = quic->read_buf;
 
     if (buf->len == 0) {
+        quic->statem.rwstate = QUIC_READING;
         return -1;
     }
 
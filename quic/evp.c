@@ -4,9 +4,219 @@
 
 #include "evp.h"
 
+#include <stdbool.h>
+#include <pthread.h>
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/objects.h>
+#include "mem.h"
 #include "log.h"
 
+enum {
+    QUIC_EVP_CTX_POOL_CIPHER,
+    QUIC_EVP_CTX_POOL_MD,
+    QUIC_EVP_CTX_POOL_HMAC,
+    QUIC_EVP_CTX_POOL_NUM,
+};
+
+typedef struct {
+    void *ctx[QUIC_EVP_CTX_POOL_SIZE];
+    int num;
+} QuicEvpCtxPool;
+
+/*
+ * Contexts are reset before returned to the free lists, only the allocation
+ * of the context itself is saved. Lists are per-thread so no lock needed,
+ * they are freed by the key destructor when the thread exits.
+ */
+/* Given to QuicInitEx(), used by every key operation */
+static QUIC_LIB_CTX *QuicEvpLibCtx;
+static char *QuicEvpPropq;
+
+static pthread_key_t QuicEvpCtxPoolKey;
+static pthread_once_t QuicEvpCtxPoolOnce = PTHREAD_ONCE_INIT;
+static int QuicEvpCtxPoolKeyErr;
+
+static void QuicEvpCtxPoolsFree(void *arg)
+{
+    QuicEvpCtxPool *pools = arg;
+    QuicEvpCtxPool *pool = NULL;
+
+    pool = &pools[QUIC_EVP_CTX_POOL_CIPHER];
+    while (pool->num > 0) {
+        EVP_CIPHER_CTX_free(pool->ctx[--pool->num]);
+    }
+
+    pool = &pools[QUIC_EVP_CTX_POOL_MD];
+    while (pool->num > 0) {
+        EVP_MD_CTX_free(pool->ctx[--pool->num]);
+    }
+
+    pool = &pools[QUIC_EVP_CTX_POOL_HMAC];
+    while (pool->num > 0) {
+        HMAC_CTX_free(pool->ctx[--pool->num]);
+    }
+
+    QuicMemFree(pools);
+}
+
+static void QuicEvpCtxPoolKeyCreate(void)
+{
+    QuicEvpCtxPoolKeyErr = pthread_key_create(&QuicEvpCtxPoolKey,
+                                                QuicEvpCtxPoolsFree);
+}
+
+static QuicEvpCtxPool *QuicEvpCtxPoolsGet(bool create)
+{
+    QuicEvpCtxPool *pools = NULL;
+
+    if (pthread_once(&QuicEvpCtxPoolOnce, QuicEvpCtxPoolKeyCreate) != 0 ||
+            QuicEvpCtxPoolKeyErr != 0) {
+        return NULL;
+    }
+
+    pools = pthread_getspecific(QuicEvpCtxPoolKey);
+    if (pools == NULL && create) {
+        pools = QuicMemCalloc(sizeof(*pools) * QUIC_EVP_CTX_POOL_NUM);
+        if (pools == NULL) {
+            return NULL;
+        }
+
+        if (pthread_setspecific(QuicEvpCtxPoolKey, pools) != 0) {
+            QuicMemFree(pools);
+            return NULL;
+        }
+    }
+
+    return pools;
+}
+
+static void *QuicEvpCtxPoolGet(int type)
+{
+    QuicEvpCtxPool *pools = NULL;
+    QuicEvpCtxPool *pool = NULL;
+
+    pools = QuicEvpCtxPoolsGet(false);
+    if (pools == NULL) {
+        return NULL;
+    }
+
+    pool = &pools[type];
+    if (pool->num == 0) {
+        return NULL;
+    }
+
+    return pool->ctx[--pool->num];
+}
+
+static int QuicEvpCtxPoolPut(int type, void *ctx)
+{
+    QuicEvpCtxPool *pools = NULL;
+    QuicEvpCtxPool *pool = NULL;
+
+    pools = QuicEvpCtxPoolsGet(true);
+    if (pools == NULL) {
+        return -1;
+    }
+
+    pool = &pools[type];
+    if (pool->num >= QUIC_EVP_CTX_POOL_SIZE) {
+        return -1;
+    }
+
+    pool->ctx[pool->num++] = ctx;
+    return 0;
+}
+
+EVP_CIPHER_CTX *QuicEvpCipherCtxNew(void)
+{
+    EVP_CIPHER_CTX *ctx = NULL;
+
+    ctx = QuicEvpCtxPoolGet(QUIC_EVP_CTX_POOL_CIPHER);
+    if (ctx != NULL) {
+        return ctx;
+    }
+
+    return EVP_CIPHER_CTX_new();
+}
+
+void QuicEvpCipherCtxFree(EVP_CIPHER_CTX *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    if (!EVP_CIPHER_CTX_reset(ctx) ||
+            QuicEvpCtxPoolPut(QUIC_EVP_CTX_POOL_CIPHER, ctx) < 0) {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+}
+
+EVP_MD_CTX *QuicEvpMdCtxNew(void)
+{
+    EVP_MD_CTX *ctx = NULL;
+
+    ctx = QuicEvpCtxPoolGet(QUIC_EVP_CTX_POOL_MD);
+    if (ctx != NULL) {
+        return ctx;
+    }
+
+    return EVP_MD_CTX_new();
+}
+
+void QuicEvpMdCtxFree(EVP_MD_CTX *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    if (!EVP_MD_CTX_reset(ctx) ||
+            QuicEvpCtxPoolPut(QUIC_EVP_CTX_POOL_MD, ctx) < 0) {
+        EVP_MD_CTX_free(ctx);
+    }
+}
+
+HMAC_CTX *QuicHmacCtxNew(void)
+{
+    HMAC_CTX *ctx = NULL;
+
+    ctx = QuicEvpCtxPoolGet(QUIC_EVP_CTX_POOL_HMAC);
+    if (ctx != NULL) {
+        return ctx;
+    }
+
+    return HMAC_CTX_new();
+}
+
+void QuicHmacCtxFree(HMAC_CTX *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    if (!HMAC_CTX_reset(ctx) ||
+            QuicEvpCtxPoolPut(QUIC_EVP_CTX_POOL_HMAC, ctx) < 0) {
+        HMAC_CTX_free(ctx);
+    }
+}
+
+/*
+ * Free the contexts cached by current thread now, instead of waiting for
+ * the thread to exit. The main thread never runs the key destructor.
+ */
+void QuicEvpCtxPoolFlush(void)
+{
+    QuicEvpCtxPool *pools = NULL;
+
+    pools = QuicEvpCtxPoolsGet(false);
+    if (pools == NULL) {
+        return;
+    }
+
+    pthread_setspecific(QuicEvpCtxPoolKey, NULL);
+    QuicEvpCtxPoolsFree(pools);
+}
+
 int QuicEvpCipherInit(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher,
                         const uint8_t *key, const uint8_t *iv,
                         int enc)
@@ -77,3 +287,54 @@ int QUIC_EVP_CIPHER_gcm_get_tag(EVP_CIPHER_CTX *ctx, size_t tag_len,
     return QuicEvpCipherCtxCtrl(ctx, EVP_CTRL_GCM_GET_TAG, (int)tag_len, data);
 }
 
+
+int QuicEvpLibCtxSet(QUIC_LIB_CTX *libctx, const char *propq)
+{
+    QuicEvpLibCtxClear();
+    if (propq != NULL) {
+        QuicEvpPropq = OPENSSL_strdup(propq);
+        if (QuicEvpPropq == NULL) {
+            return -1;
+        }
+    }
+
+    QuicEvpLibCtx = libctx;
+    return 0;
+}
+
+void QuicEvpLibCtxClear(void)
+{
+    OPENSSL_free(QuicEvpPropq);
+    QuicEvpPropq = NULL;
+    QuicEvpLibCtx = NULL;
+}
+
+/* @id is an EVP_PKEY_* type, which is the NID of the algorithm */
+EVP_PKEY_CTX *QuicEvpPkeyCtxNewId(int id)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_PKEY_CTX_new_from_name(QuicEvpLibCtx, OBJ_nid2sn(id),
+                                        QuicEvpPropq);
+#else
+    return EVP_PKEY_CTX_new_id(id, NULL);
+#endif
+}
+
+EVP_PKEY_CTX *QuicEvpPkeyCtxNew(EVP_PKEY *pkey)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_PKEY_CTX_new_from_pkey(QuicEvpLibCtx, pkey, QuicEvpPropq);
+#else
+    return EVP_PKEY_CTX_new(pkey, NULL);
+#endif
+}
+
+EVP_PKEY *QuicEvpHmacKeyNew(const uint8_t *key, size_t len)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_PKEY_new_raw_private_key_ex(QuicEvpLibCtx, "HMAC",
+                                        QuicEvpPropq, key, len);
+#else
+    return EVP_PKEY_new_raw_private_key(EVP_PKEY_HMAC, NULL, key, len);
+#endif
+}
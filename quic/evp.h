@@ -2,9 +2,13 @@
 #define TBQUIC_QUIC_EVP_H_
 
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <tbquic/types.h>
 
 #define QUIC_EVP_DECRYPT    0
 #define QUIC_EVP_ENCRYPT    1
+/* Per-thread, enough for the contexts of several connections */
+#define QUIC_EVP_CTX_POOL_SIZE  256
 
 int QuicEvpCipherInit(EVP_CIPHER_CTX *, const EVP_CIPHER *, const uint8_t *,
                         const uint8_t *, int);
@@ -15,5 +19,17 @@ int QuicEvpCipher(EVP_CIPHER_CTX *, uint8_t *, const uint8_t *, size_t);
 int QUIC_EVP_CIPHER_set_iv_len(EVP_CIPHER_CTX *, size_t);
 int QUIC_EVP_CIPHER_gcm_set_tag(EVP_CIPHER_CTX *, size_t, uint8_t *);
 int QUIC_EVP_CIPHER_gcm_get_tag(EVP_CIPHER_CTX *, size_t, uint8_t *);
+EVP_CIPHER_CTX *QuicEvpCipherCtxNew(void);
+void QuicEvpCipherCtxFree(EVP_CIPHER_CTX *);
+EVP_MD_CTX *QuicEvpMdCtxNew(void);
+void QuicEvpMdCtxFree(EVP_MD_CTX *);
+HMAC_CTX *QuicHmacCtxNew(void);
+void QuicHmacCtxFree(HMAC_CTX *);
+void QuicEvpCtxPoolFlush(void);
+int QuicEvpLibCtxSet(QUIC_LIB_CTX *, const char *);
+void QuicEvpLibCtxClear(void);
+EVP_PKEY_CTX *QuicEvpPkeyCtxNewId(int);
+EVP_PKEY_CTX *QuicEvpPkeyCtxNew(EVP_PKEY *);
+EVP_PKEY *QuicEvpHmacKeyNew(const uint8_t *, size_t);
 
 #endif
@@ -385,6 +385,7 @@ static int QuicHPMaskGen(QuicHPCipher *hp_cipher, uint8_t *mask_out,
                         size_t mask_out_len, const uint8_t *pkt_num_start,
                         size_t total_len)
 {
+    static const uint8_t zeros[QUIC_SAMPLE_LEN];
     const uint8_t *sample = NULL;
     uint8_t mask[QUIC_SAMPLE_LEN*2] = {};
     size_t mask_len = 0;
@@ -400,6 +401,18 @@ static int QuicHPMaskGen(QuicHPCipher *hp_cipher, uint8_t *mask_out,
     }
 
     sample = pkt_num_start + QUIC_PACKET_NUM_MAX_LEN;
+    /*
+     * RFC 9001 5.4.4, the sample is the block counter and nonce of
+     * ChaCha20, which is the layout of its EVP IV. The mask encrypts zeros.
+     */
+    if (hp_cipher->cipher.alg == QUIC_ALG_CHACHA20) {
+        if (QuicEvpCipherInit(hp_cipher->cipher.ctx, NULL, NULL, sample,
+                    QUIC_EVP_ENCRYPT) < 0) {
+            return -1;
+        }
+        sample = zeros;
+    }
+
     if (QuicHPDoCipher(hp_cipher, mask, &mask_len, sizeof(mask), sample,
                 QUIC_SAMPLE_LEN) < 0) {
         QUIC_LOG("Do HP cipher failed\n");
@@ -558,9 +571,11 @@ static int QuicDecryptMessage(QuicPPCipher *cipher, uint8_t *out, size_t *outl,
 static int QuicEncryptMessage(QuicPPCipher *cipher, uint8_t *out, size_t *outl,
                                 size_t out_buf_len, uint8_t *head, size_t hlen,
                                 uint64_t pkt_num, uint8_t pkt_num_len,
-                                uint8_t *in, size_t inlen)
+                                uint8_t *in, size_t inlen,
+                                const uint8_t *ext, size_t ext_len)
 {
     QUIC_CIPHER *c = NULL;
+    size_t len = 0;
     int tag_len = 0;
 
     c = &cipher->cipher;
@@ -576,11 +591,29 @@ static int QuicEncryptMessage(QuicPPCipher *cipher, uint8_t *out, size_t *outl,
 
     assert(QUIC_LT(*outl, out_buf_len));
 
+    /* Frames in the packet buffer, then stream data in place */
+    if (ext_len != 0) {
+        if (QuicEvpCipherUpdate(c->ctx, out, &len, in, inlen) < 0) {
+            QUIC_LOG("Cipher Update failed\n");
+            return -1;
+        }
+
+        assert(QUIC_LE(len, out_buf_len));
+        out += len;
+        out_buf_len -= len;
+        in = (uint8_t *)ext;
+        inlen = ext_len;
+    }
+
     if (QuicDoCipher(&cipher->cipher, out, outl, out_buf_len, in, inlen) < 0) {
         QUIC_LOG("Do cipher failed\n");
         return -1;
     }
 
+    out -= len;
+    out_buf_len += len;
+    *outl += len;
+
     tag_len = QuicCipherGetTagLen(c->alg);
     if (tag_len < 0) {
         QUIC_LOG("Get tag len failed\n");
@@ -651,12 +684,13 @@ static int QuicLengthParse(RPacket *msg, RPacket *pkt)
     return 0;
 }
  
-static int
-QuicDecryptPacket(QUIC_CRYPTO *c, RPacket *pkt, uint8_t *buf, size_t *len,
-                    size_t buf_size, uint8_t bit_mask)
+static int QuicDoDecryptPacket(QUIC *quic, QUIC_CRYPTO *c, QuicCipherSpace *cs,
+                    RPacket *pkt, uint8_t *buf, size_t *len, size_t buf_size,
+                    uint8_t bit_mask)
 {
-    QuicCipherSpace *cs = &c->decrypt;
     QUIC_CIPHERS *cipher = NULL;
+    QuicPPCipher *pp_cipher = NULL;
+    QuicPacketFlags flags;
     uint64_t pkt_num = 0;
     uint32_t h_pkt_num = 0;
     uint8_t pkt_num_len;
@@ -680,8 +714,25 @@ QuicDecryptPacket(QUIC_CRYPTO *c, RPacket *pkt, uint8_t *buf, size_t *len,
         //return -1;
     }
 
-    if (QuicDecryptMessage(&cipher->pp_cipher, buf, len, buf_size,
-                h_pkt_num, pkt_num_len, pkt) < 0) {
+    pp_cipher = &cipher->pp_cipher;
+    if (bit_mask == QUIC_SPACKET_TYPE_RESV_MASK) {
+        flags.value = *RPacketHead(pkt);
+        pp_cipher = QuicKeyUpdateGetDecryptor(quic, flags.sh.key_phase,
+                                                pkt_num);
+        if (pp_cipher == NULL) {
+            QUIC_LOG("No key for key phase %u\n", flags.sh.key_phase);
+            return -1;
+        }
+    }
+
+    if (QuicDecryptMessage(pp_cipher, buf, len, buf_size,
+                pkt_num, pkt_num_len, pkt) < 0) {
+        return -1;
+    }
+
+    if (bit_mask == QUIC_SPACKET_TYPE_RESV_MASK &&
+            QuicKeyUpdateOnDecrypted(quic, pp_cipher, pkt_num) < 0) {
+        QUIC_LOG("Key update failed!\n");
         return -1;
     }
 
@@ -695,6 +746,16 @@ QuicDecryptPacket(QUIC_CRYPTO *c, RPacket *pkt, uint8_t *buf, size_t *len,
     return 0;
 }
 
+#ifndef QUIC_TEST
+static
+#endif
+int QuicDecryptPacket(QUIC *quic, QUIC_CRYPTO *c, RPacket *pkt, uint8_t *buf,
+                    size_t *len, size_t buf_size, uint8_t bit_mask)
+{
+    return QuicDoDecryptPacket(quic, c, &c->decrypt, pkt, buf, len, buf_size,
+                                bit_mask);
+}
+
 static int QuicFrameParse(QUIC *quic, uint8_t *data, size_t len, QUIC_CRYPTO *c,
                             uint32_t pkt_type, void *buf)
 {
@@ -704,9 +765,58 @@ static int QuicFrameParse(QUIC *quic, uint8_t *data, size_t len, QUIC_CRYPTO *c,
     return QuicFrameDoParser(quic, &frame, c, pkt_type, buf);
 }
 
+/*
+ * RFC 9001 4.6.2. 0-RTT packets are dropped if early data was rejected or
+ * the keys were discarded after the handshake. @c is the application crypto,
+ * only the keys differ from 1-RTT.
+ */
 static int Quic0RttPacketParse(QUIC *quic, RPacket *pkt, QUIC_CRYPTO *c)
 {
-    return 0;
+    TLS *s = &quic->tls;
+    QuicStreamConf *scf = &quic->stream;
+    QUIC_DATA_BUF *buf = NULL;
+    RPacket msg = {};
+    uint64_t recvd = 0;
+    size_t len = 0;
+    int ret = -1;
+
+    if (QuicLengthParse(&msg, pkt) < 0) {
+        return -1;
+    }
+
+    if (!QUIC_IS_SERVER(quic) ||
+            s->early_data_state != TLS_EARLY_DATA_READING ||
+            !quic->zero_rtt.cipher_inited) {
+        return 0;
+    }
+
+    buf = QuicDataBufCreate(quic->mss);
+    if (buf == NULL) {
+        return -1;
+    }
+
+    if (QuicDoDecryptPacket(quic, c, &quic->zero_rtt, &msg, buf->buf.data,
+                &len, buf->buf.len, QUIC_LPACKET_TYPE_RESV_MASK) < 0) {
+        QUIC_LOG("Decrypt message failed!\n");
+        goto out;
+    }
+
+    recvd = scf->stat_all.recvd;
+    if (QuicFrameParse(quic, buf->buf.data, len, c, QUIC_PKT_TYPE_0RTT,
+                buf) < 0) {
+        goto out;
+    }
+
+    s->early_data_count += scf->stat_all.recvd - recvd;
+    if (s->early_data_count > s->max_early_data) {
+        QUIC_LOG("Too much early data(%lu)\n", s->early_data_count);
+        goto out;
+    }
+
+    ret = 0;
+out:
+    QuicDataBufFree(buf);
+    return ret;
 }
 
 int QuicInitPacketParse(QUIC *quic, RPacket *pkt, QUIC_CRYPTO *c)
@@ -731,7 +841,11 @@ int QuicInitPacketParse(QUIC *quic, RPacket *pkt, QUIC_CRYPTO *c)
         return -1;
     }
 
-    if (QuicDecryptPacket(c, &msg, buffer->data, &buffer->len,
+    if (c->discarded) {
+        return 0;
+    }
+
+    if (QuicDecryptPacket(quic, c, &msg, buffer->data, &buffer->len,
                 sizeof(buffer->data),
                 QUIC_LPACKET_TYPE_RESV_MASK) < 0) {
         QUIC_LOG("Decrypt message failed!\n");
@@ -751,13 +865,25 @@ static int QuicHandshakePacketParse(QUIC *quic, RPacket *pkt, QUIC_CRYPTO *c)
         return -1;
     }
 
-    if (QuicDecryptPacket(c, &msg, buffer->data, &buffer->len,
+    if (c->discarded) {
+        return 0;
+    }
+
+    if (QuicDecryptPacket(quic, c, &msg, buffer->data, &buffer->len,
                 sizeof(buffer->data),
                 QUIC_LPACKET_TYPE_RESV_MASK) < 0) {
         QUIC_LOG("Decrypt message failed!\n");
         return -1;
     }
 
+    /*
+     * RFC 9001 4.9.1. A server MUST discard Initial keys when it first
+     * successfully processes a Handshake packet.
+     */
+    if (QUIC_IS_SERVER(quic)) {
+        QuicCryptoDiscard(quic, QUIC_PKT_TYPE_INITIAL);
+    }
+
     return QuicFrameParse(quic, buffer->data, buffer->len, c,
                             QUIC_PKT_TYPE_HANDSHAKE, NULL);
 }
@@ -775,7 +901,7 @@ static int QuicOneRttParse(QUIC *quic, RPacket *pkt, QUIC_CRYPTO *c)
     }
 
     data = buf->buf.data;
-    if (QuicDecryptPacket(c, pkt, data, &len, buf->buf.len,
+    if (QuicDecryptPacket(quic, c, pkt, data, &len, buf->buf.len,
                 QUIC_SPACKET_TYPE_RESV_MASK) < 0) {
         QUIC_LOG("Decrypt message failed!\n");
         QuicDataBufFree(buf);
@@ -946,7 +1072,7 @@ static int QuicLHeaderGen(QUIC *quic, uint8_t **first_byte, WPacket *pkt,
 }
 
 static int QuicSHeaderGen(QUIC *quic, uint8_t **first_byte, WPacket *pkt,
-                            uint8_t pkt_num_len)
+                            uint8_t pkt_num_len, uint8_t key_phase)
 {
     QUIC_DATA *dcid = NULL;
     QuicPacketFlags flags;
@@ -954,7 +1080,7 @@ static int QuicSHeaderGen(QUIC *quic, uint8_t **first_byte, WPacket *pkt,
     flags.sh.fixed = 1;
     flags.sh.header_form = 0;
     flags.sh.packet_num_len = (pkt_num_len & 0x3) - 1;
-    flags.sh.key_phase = 0;
+    flags.sh.key_phase = key_phase;
     flags.sh.reserved = 0;
     flags.sh.spin = 0;
 
@@ -990,13 +1116,13 @@ static int QuicFrameBufferAddPadding(QUIC *quic, size_t padding_len, QBUFF *qb)
 
 int QuicEncryptPayload(QUIC *quic, QuicPPCipher *pp_cipher, uint8_t *head,
                         size_t hlen, uint8_t *out, size_t out_len,
-                        uint32_t pkt_num, uint8_t pkt_num_len, QBUFF *qb)
+                        uint64_t pkt_num, uint8_t pkt_num_len, QBUFF *qb)
 {
     size_t outl = 0;
 
     if (QuicEncryptMessage(pp_cipher, out, &outl, out_len, head, hlen, pkt_num,
-                            pkt_num_len, QBuffHead(qb),
-                            QBuffGetDataLen(qb)) < 0) {
+                            pkt_num_len, QBuffHead(qb), qb->data_len,
+                            qb->ext, qb->ext_len) < 0) {
         return -1;
     }
 
@@ -1049,8 +1175,8 @@ static size_t QuicSPacketGetHeaderLen(QUIC *quic)
     return 1 + QuicCidWriteLen(&quic->dcid);
 }
 
-static size_t QuicLPacketGetTotalLen(QUIC *quic, QUIC_CRYPTO *c, uint8_t type,
-                                size_t data_len)
+static size_t QuicLPacketGetTotalLen(QUIC *quic, QuicCipherSpace *cs,
+                                uint8_t type, size_t data_len)
 {
     size_t hlen = 0;
     size_t total_len = 0;
@@ -1063,8 +1189,7 @@ static size_t QuicLPacketGetTotalLen(QUIC *quic, QUIC_CRYPTO *c, uint8_t type,
     hlen = QuicLPacketGetHeaderLen(quic, type);
 
     total_len += hlen;
-    cipher_len = QuicGetEncryptedPayloadLen(&c->encrypt.ciphers.pp_cipher,
-                                            data_len);
+    cipher_len = QuicGetEncryptedPayloadLen(&cs->ciphers.pp_cipher, data_len);
     len = cipher_len + pkt_num_len;
     wlen = QuicVariableLengthEncode((uint8_t *)&var_len, sizeof(var_len), len);
     if (wlen < 0) {
@@ -1087,11 +1212,10 @@ static size_t QuicSPacketGetTotalLen(QUIC *quic, QUIC_CRYPTO *c, size_t data_len
     return total_len + cipher_len + pkt_num_len;
 }
 
-int QuicPacketBuild(QUIC *quic, QUIC_CRYPTO *c, uint8_t *first_byte,
-                    uint8_t pkt_num_len, WPacket *pkt, QBUFF *qb,
-                    uint8_t mask)
+int QuicPacketBuild(QUIC *quic, QUIC_CRYPTO *c, QuicCipherSpace *cs,
+                    uint8_t *first_byte, uint8_t pkt_num_len, WPacket *pkt,
+                    QBUFF *qb, uint8_t mask)
 {
-    QuicCipherSpace *cs = &c->encrypt;
     QuicPPCipher *pp_cipher = NULL;
     uint8_t *pkt_num_start = NULL;
     uint8_t *dest = NULL;
@@ -1139,8 +1263,9 @@ int QuicPacketBuild(QUIC *quic, QUIC_CRYPTO *c, uint8_t *first_byte,
     offset = dest - first_byte;
     assert(offset > 0);
 
+    /* RFC 9001 5.3, the nonce takes the full packet number */
     if (QuicEncryptPayload(quic, pp_cipher, first_byte, offset, dest, cipher_len,
-                            pkt_num, pkt_num_len, qb) < 0) {
+                            c->pkt_num, pkt_num_len, qb) < 0) {
         QUIC_LOG("Encrypt Payload failed\n");
         return -1;
     }
@@ -1150,8 +1275,8 @@ int QuicPacketBuild(QUIC *quic, QUIC_CRYPTO *c, uint8_t *first_byte,
                             mask);
 }
 
-int QuicLPacketBuild(QUIC *quic, QUIC_CRYPTO *c, uint8_t type, WPacket *pkt,
-                        QBUFF *qb, bool end)
+int QuicLPacketBuild(QUIC *quic, QUIC_CRYPTO *c, QuicCipherSpace *cs,
+                        uint8_t type, WPacket *pkt, QBUFF *qb, bool end)
 {
     uint8_t *first_byte = 0;
     size_t total_len = 0;
@@ -1163,7 +1288,7 @@ int QuicLPacketBuild(QUIC *quic, QUIC_CRYPTO *c, uint8_t type, WPacket *pkt,
         QuicEncryptPayloadHook(qb);
     }
 #endif
-    total_len = QuicLPacketGetTotalLen(quic, c, type, QBuffGetDataLen(qb));
+    total_len = QuicLPacketGetTotalLen(quic, cs, type, QBuffGetDataLen(qb));
     total_len += WPacket_get_written(pkt);
     if (QuicLHeaderGen(quic, &first_byte, pkt, type, pkt_num_len) < 0) {
         QUIC_LOG("Long header generate failed\n");
@@ -1185,7 +1310,7 @@ int QuicLPacketBuild(QUIC *quic, QUIC_CRYPTO *c, uint8_t type, WPacket *pkt,
         }
     }
 
-    return QuicPacketBuild(quic, c, first_byte, pkt_num_len, pkt, qb,
+    return QuicPacketBuild(quic, c, cs, first_byte, pkt_num_len, pkt, qb,
                             QUIC_LPACKET_TYPE_RESV_MASK);
 }
 
@@ -1195,24 +1320,31 @@ QuicSPacketBuild(QUIC *quic, QUIC_CRYPTO *c, WPacket *pkt, QBUFF *qb, bool end)
     uint8_t *first_byte = NULL;
     uint8_t pkt_num_len = quic->pkt_num_len + 1;
 
-    if (QuicSHeaderGen(quic, &first_byte, pkt, pkt_num_len) < 0) {
+    if (QuicSHeaderGen(quic, &first_byte, pkt, pkt_num_len,
+                QuicKeyUpdateTxPhase(quic)) < 0) {
         QUIC_LOG("Long header generate failed\n");
         return -1;
     }
 
-    return QuicPacketBuild(quic, c, first_byte, pkt_num_len, pkt, qb,
-                            QUIC_SPACKET_TYPE_RESV_MASK);
+    return QuicPacketBuild(quic, c, &c->encrypt, first_byte, pkt_num_len,
+                            pkt, qb, QUIC_SPACKET_TYPE_RESV_MASK);
 }
 
 size_t QuicInitialPacketGetTotalLen(QUIC *quic, size_t data_len)
 {
-    return QuicLPacketGetTotalLen(quic, QuicGetInitialCrypto(quic),
+    return QuicLPacketGetTotalLen(quic, &QuicGetInitialCrypto(quic)->encrypt,
                             QUIC_LPACKET_TYPE_INITIAL, data_len);
 }
 
+size_t QuicZeroRttPacketGetTotalLen(QUIC *quic, size_t data_len)
+{
+    return QuicLPacketGetTotalLen(quic, &quic->zero_rtt,
+                            QUIC_LPACKET_TYPE_0RTT, data_len);
+}
+
 size_t QuicHandshakePacketGetTotalLen(QUIC *quic, size_t data_len)
 {
-    return QuicLPacketGetTotalLen(quic, QuicGetHandshakeCrypto(quic),
+    return QuicLPacketGetTotalLen(quic, &QuicGetHandshakeCrypto(quic)->encrypt,
                             QUIC_LPACKET_TYPE_HANDSHAKE, data_len);
 }
 
@@ -1223,14 +1355,28 @@ size_t QuicAppDataPacketGetTotalLen(QUIC *quic, size_t data_len)
 
 int QuicInitialPacketBuild(QUIC *quic, WPacket *pkt, QBUFF *qb, bool end)
 {
-    return QuicLPacketBuild(quic, QuicGetInitialCrypto(quic),
-                    QUIC_LPACKET_TYPE_INITIAL, pkt, qb, end);
+    QUIC_CRYPTO *c = QuicGetInitialCrypto(quic);
+
+    return QuicLPacketBuild(quic, c, &c->encrypt, QUIC_LPACKET_TYPE_INITIAL,
+                            pkt, qb, end);
+}
+
+/*
+ * 0-RTT packets are numbered in the application data space, 1-RTT packets
+ * go on with the numbers after them.
+ */
+int QuicZeroRttPacketBuild(QUIC *quic, WPacket *pkt, QBUFF *qb, bool end)
+{
+    return QuicLPacketBuild(quic, QuicGetOneRttCrypto(quic), &quic->zero_rtt,
+                            QUIC_LPACKET_TYPE_0RTT, pkt, qb, end);
 }
 
 int QuicHandshakePacketBuild(QUIC *quic, WPacket *pkt, QBUFF *qb, bool end)
 {
-    return QuicLPacketBuild(quic, QuicGetHandshakeCrypto(quic),
-                    QUIC_LPACKET_TYPE_HANDSHAKE, pkt, qb, end);
+    QUIC_CRYPTO *c = QuicGetHandshakeCrypto(quic);
+
+    return QuicLPacketBuild(quic, c, &c->encrypt, QUIC_LPACKET_TYPE_HANDSHAKE,
+                            pkt, qb, end);
 }
 
 int QuicAppDataPacketBuild(QUIC *quic, WPacket *pkt, QBUFF *qb, bool end)
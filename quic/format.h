@@ -9,6 +9,7 @@
 #include "packet_local.h"
 #include "base.h"
 #include "q_buff.h"
+#include "cipher.h"
 
 #define QUIC_PKT_NUM_MAX (0x3FFFFFFFFFFFFFFF) //2^62 - 1
 #define QUIC_INITIAL_PKT_DATAGRAM_SIZE_MIN      1200
@@ -91,9 +92,11 @@ int QuicPktHeaderParse(QUIC *, RPacket *, QuicPacketFlags, uint32_t *,
 int QuicPktBodyParse(QUIC *, RPacket *, uint32_t);
 int QuicInitPacketParse(QUIC *, RPacket *, QUIC_CRYPTO *);
 size_t QuicInitialPacketGetTotalLen(QUIC *, size_t);
+size_t QuicZeroRttPacketGetTotalLen(QUIC *, size_t);
 size_t QuicHandshakePacketGetTotalLen(QUIC *, size_t);
 size_t QuicAppDataPacketGetTotalLen(QUIC *, size_t);
 int QuicInitialPacketBuild(QUIC *, WPacket *, QBUFF *, bool);
+int QuicZeroRttPacketBuild(QUIC *, WPacket *, QBUFF *, bool);
 int QuicHandshakePacketBuild(QUIC *, WPacket *, QBUFF *, bool);
 int QuicAppDataPacketBuild(QUIC *, WPacket *, QBUFF *, bool);
 void QuicAddQueue(QUIC *quic, QBUFF *qb);
@@ -104,9 +107,13 @@ int QuicSrvrParseScid(QUIC *quic, RPacket *pkt, size_t);
 int QuicSrvrParseDcid(QUIC *quic, RPacket *pkt, size_t);
 int QuicGetPktFlags(QuicPacketFlags *, RPacket *);
 int QuicGetDcidFromPkt(QUIC_DATA *, const uint8_t *, size_t);
+int QuicDecryptHeader(QuicHPCipher *, uint32_t *, uint8_t *, RPacket *,
+                        uint8_t);
 
 #ifdef QUIC_TEST
 extern void (*QuicEncryptPayloadHook)(QBUFF *qb);
+int QuicDecryptPacket(QUIC *, QUIC_CRYPTO *, RPacket *, uint8_t *, size_t *,
+                        size_t, uint8_t);
 #endif
 
 #endif
@@ -74,6 +74,7 @@ static QuicFrameProcess frame_handler[QUIC_FRAME_TYPE_MAX] = {
         .parser = QuicFramePingParser,
     },
     [QUIC_FRAME_TYPE_ACK] = {
+        .flags = QUIC_FRAME_FLAGS_NO_0RTT,
         .parser = QuicFrameAckParser,
         .builder = QuicFrameAckBuild,
     },
@@ -85,9 +86,11 @@ static QuicFrameProcess frame_handler[QUIC_FRAME_TYPE_MAX] = {
         .parser = QuicFrameStopSendingParser,
     },
     [QUIC_FRAME_TYPE_CRYPTO] = {
+        .flags = QUIC_FRAME_FLAGS_NO_0RTT,
         .parser = QuicFrameCryptoParser,
     },
     [QUIC_FRAME_TYPE_NEW_TOKEN] = {
+        .flags = QUIC_FRAME_FLAGS_NO_0RTT,
         .parser = QuicFrameNewTokenParser,
         .builder = QuicFrameNewTokenBuild,
     },
@@ -139,6 +142,7 @@ static QuicFrameProcess frame_handler[QUIC_FRAME_TYPE_MAX] = {
         .parser = QuicFrameNewConnIdParser,
     },
     [QUIC_FRAME_TYPE_RETIRE_CONNECTION_ID] = {
+        .flags = QUIC_FRAME_FLAGS_NO_0RTT,
         .parser = QuicFrameRetireConnIdParser,
     },
     [QUIC_FRAME_TYPE_CONNECTION_CLOSE] = {
@@ -148,7 +152,7 @@ static QuicFrameProcess frame_handler[QUIC_FRAME_TYPE_MAX] = {
         .parser = QuicFrameConnCloseParser,
     },
     [QUIC_FRAME_TYPE_HANDSHAKE_DONE] = {
-        .flags = QUIC_FRAME_FLAGS_NO_BODY,
+        .flags = QUIC_FRAME_FLAGS_NO_BODY|QUIC_FRAME_FLAGS_NO_0RTT,
         .parser = QuicFrameHandshakeDoneParser,
     },
 };
@@ -173,6 +177,12 @@ int QuicFrameDoParser(QUIC *quic, RPacket *pkt, QUIC_CRYPTO *c,
             continue;
         }
 
+        if (pkt_type == QUIC_PKT_TYPE_0RTT &&
+                (flags & QUIC_FRAME_FLAGS_NO_0RTT)) {
+            QUIC_LOG("Type(%lx) not allowed in 0-RTT\n", type);
+            return -1;
+        }
+
         parser = frame_handler[type].parser;
         if (parser == NULL) {
             QUIC_LOG("No parser for type(%lx)\n", type);
@@ -194,6 +204,10 @@ int QuicFrameDoParser(QUIC *quic, RPacket *pkt, QUIC_CRYPTO *c,
     }
 
     if (ack_eliciting) {
+        /* RFC 9000 12.3, 0-RTT packets are acknowledged in 1-RTT packets */
+        if (pkt_type == QUIC_PKT_TYPE_0RTT) {
+            pkt_type = QUIC_PKT_TYPE_1RTT;
+        }
         QuicAckFrameBuild(quic, pkt_type);
     }
 
@@ -313,6 +327,9 @@ static int QuicFrameResetStreamParser(QUIC *quic, RPacket *pkt, uint64_t type,
 
     si = QuicStreamGetInstance(quic, stream_id);
     if (si == NULL) {
+        if (QuicStreamIdClosed(quic, stream_id)) {
+            return 0;
+        }
         QUIC_LOG("Instance not found for ID %lu\n", stream_id);
         return -1;
     }
@@ -340,9 +357,17 @@ static int QuicFrameStopSendingParser(QUIC *quic, RPacket *pkt,
         return -1;
     }
 
+    if (QuicVariableLengthDecode(pkt, &err_code) < 0) {
+        QUIC_LOG("Application error code decode failed!\n");
+        return -1;
+    }
+
     QUIC_LOG("Stream %lu\n", id);
     si = QuicStreamGetInstance(quic, id);
     if (si == NULL) {
+        if (QuicStreamIdClosed(quic, id)) {
+            return 0;
+        }
         QUIC_LOG("Instance not found for ID %lu\n", id);
         return -1;
     }
@@ -356,15 +381,11 @@ static int QuicFrameStopSendingParser(QUIC *quic, RPacket *pkt,
 
     si->send_state = QUIC_STREAM_STATE_DISABLE;
 
-    if (QuicVariableLengthDecode(pkt, &err_code) < 0) {
-        QUIC_LOG("Max Stream Data decode failed!\n");
-        return -1;
-    }
-
     if (si->recv_state == QUIC_STREAM_STATE_START) {
         si->recv_state = QUIC_STREAM_STATE_RECV;
     }
 
+    QuicStreamTryReclaim(quic, si);
     return 0;
 }
 
@@ -473,8 +494,17 @@ QuicFrameStreamParser(QUIC *quic, RPacket *pkt, uint64_t type, QUIC_CRYPTO *c,
         len = RPacketRemaining(pkt);
     }
 
+    if (RPacketGetBytes(pkt, &data, len) < 0) {
+        QUIC_LOG("Peek stream data failed!\n");
+        return -1;
+    }
+
     si = QuicStreamGetInstance(quic, id);
     if (si == NULL) {
+        /* Retransmitted after the stream was done, ACK and drop it */
+        if (QuicStreamIdClosed(quic, id)) {
+            return 0;
+        }
         QUIC_LOG("Instance not found for ID %lu\n", id);
         return -1;
     }
@@ -488,22 +518,22 @@ QuicFrameStreamParser(QUIC *quic, RPacket *pkt, uint64_t type, QUIC_CRYPTO *c,
         si->send_state = QUIC_STREAM_STATE_READY;
     }
 
+    if (si->recv_state == QUIC_STREAM_STATE_START) {
+        si->recv_state = QUIC_STREAM_STATE_RECV;
+    }
+
     if (type & QUIC_FRAME_STREAM_BIT_FIN) {
         QUIC_LOG("Stream FIN\n");
         if (si->recv_state == QUIC_STREAM_STATE_RECV) {
+            si->final_size = offset + len;
             si->recv_state = QUIC_STREAM_STATE_SIZE_KNOWN;
+        } else if (si->recv_state == QUIC_STREAM_STATE_SIZE_KNOWN &&
+                si->final_size != offset + len) {
+            QUIC_LOG("Final size changed\n");
+            return -1;
         }
     }
 
-    if (RPacketGetBytes(pkt, &data, len) < 0) {
-        QUIC_LOG("Peek stream data failed!\n");
-        return -1;
-    }
-
-    if (si->recv_state == QUIC_STREAM_STATE_START) {
-        si->recv_state = QUIC_STREAM_STATE_RECV;
-    }
-
     if (si->recv_state != QUIC_STREAM_STATE_RECV &&
             si->recv_state != QUIC_STREAM_STATE_SIZE_KNOWN) {
         return 0;
@@ -555,9 +585,17 @@ static int QuicFrameStreamDataBlockedParser(QUIC *quic, RPacket *pkt,
         return -1;
     }
 
+    if (QuicVariableLengthDecode(pkt, &max_stream_data) < 0) {
+        QUIC_LOG("Max Stream Data decode failed!\n");
+        return -1;
+    }
+
     QUIC_LOG("Stream %lu\n", id);
     si = QuicStreamGetInstance(quic, id);
     if (si == NULL) {
+        if (QuicStreamIdClosed(quic, id)) {
+            return 0;
+        }
         QUIC_LOG("Instance not found for ID %lu\n", id);
         return -1;
     }
@@ -567,11 +605,6 @@ static int QuicFrameStreamDataBlockedParser(QUIC *quic, RPacket *pkt,
         return -1;
     }
 
-    if (QuicVariableLengthDecode(pkt, &max_stream_data) < 0) {
-        QUIC_LOG("Max Stream Data decode failed!\n");
-        return -1;
-    }
-
     if (si->recv_state == QUIC_STREAM_STATE_START) {
         si->recv_state = QUIC_STREAM_STATE_RECV;
     }
@@ -623,9 +656,17 @@ static int QuicFrameMaxStreamDataParser(QUIC *quic, RPacket *pkt,
         return -1;
     }
 
+    if (QuicVariableLengthDecode(pkt, &max_stream_data) < 0) {
+        QUIC_LOG("Max Stream Data decode failed!\n");
+        return -1;
+    }
+
     QUIC_LOG("Stream %lu\n", id);
     si = QuicStreamGetInstance(quic, id);
     if (si == NULL) {
+        if (QuicStreamIdClosed(quic, id)) {
+            return 0;
+        }
         QUIC_LOG("Instance not found for ID %lu\n", id);
         return -1;
     }
@@ -637,11 +678,6 @@ static int QuicFrameMaxStreamDataParser(QUIC *quic, RPacket *pkt,
         return -1;
     }
 
-    if (QuicVariableLengthDecode(pkt, &max_stream_data) < 0) {
-        QUIC_LOG("Max Stream Data decode failed!\n");
-        return -1;
-    }
-
     if (QUIC_LT(si->max_stream_data, max_stream_data)) {
         si->max_stream_data = max_stream_data;
     }
@@ -790,7 +826,7 @@ static int QuicFrameHandshakeDoneParser(QUIC *quic, RPacket *pkt, uint64_t type,
     QUIC_LOG("handshake done\n");
     if (!quic->quic_server) {
         quic->statem.state = QUIC_STATEM_HANDSHAKE_DONE;
-        QuicCryptoFree(&quic->handshake);
+        QuicHandshakeConfirmed(quic);
     }
 
     return 0;
@@ -985,7 +1021,7 @@ static int QuicFrameStreamBuild(QUIC *quic, WPacket *pkt, uint64_t id,
         si->send_state = QUIC_STREAM_STATE_SEND;
     }
 
-    offset = si->stat_bytes.sent;
+    offset = si->send_offset;
     if (offset) {
         type |= QUIC_FRAME_STREAM_BIT_OFF;
     }
@@ -1016,13 +1052,17 @@ static int QuicFrameStreamBuild(QUIC *quic, WPacket *pkt, uint64_t id,
     }
 
     if (type & QUIC_FRAME_STREAM_BIT_LEN) {
-        return QuicWPacketSubMemcpyVar(pkt, data, len);
+        data_len = QuicWPacketSubMemcpyVar(pkt, data, len);
+    } else {
+        space = WPacket_get_space(pkt);
+        data_len = QUIC_MIN(space, len);
+        if (WPacketMemcpy(pkt, data, data_len) < 0) {
+            return -1;
+        }
     }
 
-    space = WPacket_get_space(pkt);
-    data_len = QUIC_MIN(space, len);
-    if (WPacketMemcpy(pkt, data, data_len) < 0) {
-        return -1;
+    if (data_len > 0) {
+        si->send_offset += data_len;
     }
 
     return data_len;
@@ -1230,7 +1270,8 @@ static int QuicFrameStreamWrite(QUIC *quic, uint32_t pkt_type, WPacket *pkt,
     return 0;
 }
 
-int QuicStreamFrameBuild(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t num)
+int QuicStreamFrameBuild(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t num,
+                            uint32_t pkt_type)
 {
     QUIC_STREAM_IOVEC *v = NULL;
     QUIC_CRYPTO *c = NULL;
@@ -1239,7 +1280,6 @@ int QuicStreamFrameBuild(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t num)
     size_t i = 0;
     size_t buf_len = 0;
     uint64_t flags = 0;
-    uint32_t pkt_type = QUIC_PKT_TYPE_1RTT;
     int ret = -1;
 
     buf_len = QuicFrameGetBuffLen(quic, pkt_type);
@@ -1249,7 +1289,7 @@ int QuicStreamFrameBuild(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t num)
     }
 
     c = QuicCryptoGet(quic, pkt_type);
-    if (QuicFrameAckSendCheck(c) == 0) {
+    if (pkt_type != QUIC_PKT_TYPE_0RTT && QuicFrameAckSendCheck(c) == 0) {
         if (QuicVariableLengthWrite(&pkt, QUIC_FRAME_TYPE_ACK) < 0) {
             return -1;
         }
@@ -1284,6 +1324,109 @@ out:
     return ret;
 }
 
+/*
+ * Only the STREAM frame header is written to the QBUFF, the data stays in
+ * the application buffer and is encrypted from there. One frame per packet,
+ * so the data always ends the plaintext. Returns the length queued, -1 if
+ * none.
+ */
+int QuicStreamFrameBuildZc(QUIC *quic, QuicStreamSendBuf *sb,
+                            uint32_t pkt_type)
+{
+    QuicStreamInstance *si = NULL;
+    QUIC_CRYPTO *c = NULL;
+    QBUFF *qb = NULL;
+    uint8_t *data = sb->data;
+    WPacket pkt = {};
+    uint64_t type = 0;
+    size_t buf_len = 0;
+    size_t offset = 0;
+    size_t space = 0;
+    size_t len = 0;
+    int ret = -1;
+
+    si = QuicStreamGetInstance(quic, sb->id);
+    if (si == NULL) {
+        return -1;
+    }
+
+    if (si->send_state != QUIC_STREAM_STATE_READY &&
+            si->send_state != QUIC_STREAM_STATE_SEND) {
+        return -1;
+    }
+
+    if (si->send_state == QUIC_STREAM_STATE_READY) {
+        si->send_state = QUIC_STREAM_STATE_SEND;
+    }
+
+    buf_len = QuicFrameGetBuffLen(quic, pkt_type);
+    c = QuicCryptoGet(quic, pkt_type);
+    while (QUIC_LT(offset, sb->len)) {
+        qb = QuicFrameBufferNew(pkt_type, buf_len, &pkt);
+        if (qb == NULL) {
+            goto out;
+        }
+
+        if (offset == 0 && pkt_type != QUIC_PKT_TYPE_0RTT &&
+                QuicFrameAckSendCheck(c) == 0) {
+            if (QuicVariableLengthWrite(&pkt, QUIC_FRAME_TYPE_ACK) < 0 ||
+                    QuicFrameAckGen(quic, &pkt, c) < 0) {
+                goto out;
+            }
+        }
+
+        type = QUIC_FRAME_TYPE_STREAM | QUIC_FRAME_STREAM_BIT_LEN;
+        if (si->send_offset) {
+            type |= QUIC_FRAME_STREAM_BIT_OFF;
+        }
+
+        if (QuicVariableLengthWrite(&pkt, type) < 0 ||
+                QuicVariableLengthWrite(&pkt, sb->id) < 0) {
+            goto out;
+        }
+
+        if ((type & QUIC_FRAME_STREAM_BIT_OFF) &&
+                QuicVariableLengthWrite(&pkt, si->send_offset) < 0) {
+            goto out;
+        }
+
+        /* Room for the longest length a packet needs */
+        space = WPacket_get_space(&pkt);
+        if (QUIC_LE(space, sizeof(uint32_t))) {
+            goto out;
+        }
+
+        len = QUIC_MIN(sb->len - offset, space - sizeof(uint32_t));
+        if (QuicVariableLengthWrite(&pkt, len) < 0) {
+            goto out;
+        }
+
+        qb->stream_id = sb->id;
+        qb->stream_len = len;
+        qb->ext = &data[offset];
+        qb->ext_len = len;
+        qb->zc = sb;
+        sb->ref++;
+
+        if (QuicFrameAddQueue(quic, &pkt, qb) < 0) {
+            QUIC_LOG("Add frame queue failed\n");
+            goto out;
+        }
+
+        qb = NULL;
+        si->send_offset += len;
+        offset += len;
+    }
+
+out:
+    WPacketCleanup(&pkt);
+    QBuffFree(qb);
+    if (offset != 0) {
+        ret = offset;
+    }
+    return ret;
+}
+
 int QuicCryptoFrameBuild(QUIC *quic, uint32_t pkt_type)
 {
     QUIC_BUFFER *buf = QUIC_TLS_BUFFER(quic);
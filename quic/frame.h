@@ -6,6 +6,7 @@
 
 #include "base.h"
 #include "packet_local.h"
+#include "stream.h"
     
 #define QUIC_FRAME_STREAM_BIT_FIN       0x01
 #define QUIC_FRAME_STREAM_BIT_LEN       0x02
@@ -57,6 +58,8 @@ typedef enum {
 typedef struct {
 #define QUIC_FRAME_FLAGS_NO_BODY        0x0001
 #define QUIC_FRAME_FLAGS_SKIP           0x0002
+/* RFC 9000 12.5, not allowed in 0-RTT packets */
+#define QUIC_FRAME_FLAGS_NO_0RTT        0x0004
     uint64_t flags;
     QuicFrameParser parser;
     QuicFrameBuilder builder;
@@ -78,7 +81,8 @@ int QuicFramePaddingBuild(WPacket *, size_t);
 int QuicFramePingBuild(QUIC *, WPacket *, uint8_t *, uint64_t, size_t);
 int QuicFrameAckSendCheck(QUIC_CRYPTO *c);
 int QuicCryptoFrameBuild(QUIC *, uint32_t);
-int QuicStreamFrameBuild(QUIC *, QUIC_STREAM_IOVEC *, size_t);
+int QuicStreamFrameBuild(QUIC *, QUIC_STREAM_IOVEC *, size_t, uint32_t);
+int QuicStreamFrameBuildZc(QUIC *, QuicStreamSendBuf *, uint32_t);
 int QuicAckFrameBuild(QUIC *, uint32_t);
 int QuicDataBlockedFrameBuild(QUIC *, int64_t, uint32_t);
 int QuicStreamDataBlockedFrameBuild(QUIC *, int64_t, uint32_t);
@@ -0,0 +1,308 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "key_update.h"
+
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "common.h"
+#include "evp.h"
+#include "mem.h"
+#include "tls_lib.h"
+#include "log.h"
+
+static void QuicKeyUpdateSecrets(QUIC *quic, uint8_t **rx_secret,
+                                    uint8_t **tx_secret)
+{
+    TLS *s = &quic->tls;
+
+    if (QUIC_IS_SERVER(quic)) {
+        *rx_secret = s->client_app_traffic_secret;
+        *tx_secret = s->server_app_traffic_secret;
+    } else {
+        *rx_secret = s->server_app_traffic_secret;
+        *tx_secret = s->client_app_traffic_secret;
+    }
+}
+
+static int QuicKeyUpdatePrepare(QUIC *quic)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+    QUIC_CRYPTO *c = &quic->application;
+    const EVP_MD *md = NULL;
+    uint8_t *rx_secret = NULL;
+    uint8_t *tx_secret = NULL;
+    uint32_t alg = 0;
+
+    md = TlsHandshakeMd(&quic->tls);
+    if (md == NULL) {
+        return -1;
+    }
+
+    QuicKeyUpdateSecrets(quic, &rx_secret, &tx_secret);
+    if (!ku->next_rx_ready) {
+        ku->next_rx_tentative = 0;
+        alg = c->decrypt.ciphers.pp_cipher.cipher.alg;
+        if (QuicPPCipherKeyUpdate(&ku->next_decrypt, alg, md, rx_secret,
+                    QUIC_EVP_DECRYPT) < 0) {
+            QUIC_LOG("Prepare next decrypt key failed\n");
+            return -1;
+        }
+        ku->next_rx_ready = 1;
+    }
+
+    if (!ku->next_tx_ready) {
+        alg = c->encrypt.ciphers.pp_cipher.cipher.alg;
+        if (QuicPPCipherKeyUpdate(&ku->next_encrypt, alg, md, tx_secret,
+                    QUIC_EVP_ENCRYPT) < 0) {
+            QUIC_LOG("Prepare next encrypt key failed\n");
+            return -1;
+        }
+        ku->next_tx_ready = 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Called after each 1-RTT key installed, derive the keys of next phase once
+ * both directions are ready.
+ */
+int QuicKeyUpdateInit(QUIC *quic)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+    QUIC_CRYPTO *c = &quic->application;
+
+    if (ku->inited) {
+        return 0;
+    }
+
+    if (!c->decrypt.cipher_inited || !c->encrypt.cipher_inited) {
+        return 0;
+    }
+
+    if (QuicKeyUpdatePrepare(quic) < 0) {
+        return -1;
+    }
+
+    ku->inited = 1;
+    return 0;
+}
+
+/*
+ * RFC 9001 6.5. Discard the old read keys after 3 * PTO, the context is
+ * reused by the keys of next phase.
+ */
+static void QuicKeyUpdateCheck(QUIC *quic, uint64_t now)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+    QuicPPCipher tmp = {};
+
+    if (!ku->prev_valid || QUIC_LT(now, ku->prev_expire)) {
+        return;
+    }
+
+    ku->prev_valid = 0;
+    if (!ku->next_rx_ready) {
+        ku->next_rx_tentative = 0;
+        tmp = ku->next_decrypt;
+        ku->next_decrypt = ku->prev_decrypt;
+        ku->prev_decrypt = tmp;
+    }
+    QuicPPCipherCtxFree(&ku->prev_decrypt);
+
+    if (QuicKeyUpdatePrepare(quic) < 0) {
+        QUIC_LOG("Prepare next phase keys failed\n");
+    }
+}
+
+static int QuicKeyUpdateTxFlip(QUIC *quic)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+    QUIC_CRYPTO *c = &quic->application;
+    QuicPPCipher *cur = &c->encrypt.ciphers.pp_cipher;
+    QuicPPCipher tmp = {};
+
+    if (!ku->next_tx_ready && QuicKeyUpdatePrepare(quic) < 0) {
+        return -1;
+    }
+
+    tmp = *cur;
+    *cur = ku->next_encrypt;
+    ku->next_encrypt = tmp;
+    ku->next_tx_ready = 0;
+    ku->tx_phase ^= 1;
+    ku->tx_first_pn = c->pkt_num + 1;
+    ku->tx_pkt_count = 0;
+
+    return 0;
+}
+
+/*
+ * The peer updated again before the old read keys were discarded. Derive
+ * the next keys to try on the packet, but keep the old keys and the secret
+ * until it is authenticated, a forged packet must not change them.
+ */
+static QuicPPCipher *QuicKeyUpdateTentative(QUIC *quic)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+    QUIC_CRYPTO *c = &quic->application;
+    const EVP_MD *md = NULL;
+    uint8_t *rx_secret = NULL;
+    uint8_t *tx_secret = NULL;
+    uint32_t alg = 0;
+
+    if (ku->next_rx_tentative) {
+        return &ku->next_decrypt;
+    }
+
+    md = TlsHandshakeMd(&quic->tls);
+    if (md == NULL) {
+        return NULL;
+    }
+
+    QuicKeyUpdateSecrets(quic, &rx_secret, &tx_secret);
+    QuicMemcpy(ku->next_rx_secret, rx_secret, EVP_MD_size(md));
+    alg = c->decrypt.ciphers.pp_cipher.cipher.alg;
+    if (QuicPPCipherKeyUpdate(&ku->next_decrypt, alg, md, ku->next_rx_secret,
+                QUIC_EVP_DECRYPT) < 0) {
+        QUIC_LOG("Prepare tentative decrypt key failed\n");
+        return NULL;
+    }
+
+    ku->next_rx_tentative = 1;
+    return &ku->next_decrypt;
+}
+
+/*
+ * RFC 9001 6.3. Receiving Key Updates
+ */
+QuicPPCipher *QuicKeyUpdateGetDecryptor(QUIC *quic, uint8_t key_phase,
+                                        uint64_t pkt_num)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+    QUIC_CRYPTO *c = &quic->application;
+
+    if (!ku->inited) {
+        return &c->decrypt.ciphers.pp_cipher;
+    }
+
+    QuicKeyUpdateCheck(quic, c->arriv_time);
+    if (key_phase == ku->rx_phase) {
+        return &c->decrypt.ciphers.pp_cipher;
+    }
+
+    if (ku->prev_valid && QUIC_LT(pkt_num, ku->rx_first_pn)) {
+        return &ku->prev_decrypt;
+    }
+
+    if (!ku->next_rx_ready) {
+        /* Peer updated again before old keys expired */
+        return QuicKeyUpdateTentative(quic);
+    }
+
+    return &ku->next_decrypt;
+}
+
+/*
+ * Packet protected by @cipher has been authenticated, if it is the key of
+ * next phase, install it and respond by updating write keys.
+ */
+int QuicKeyUpdateOnDecrypted(QUIC *quic, QuicPPCipher *cipher,
+                                uint64_t pkt_num)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+    QUIC_CRYPTO *c = &quic->application;
+    QuicPPCipher *cur = &c->decrypt.ciphers.pp_cipher;
+    QuicPPCipher tmp = {};
+    uint8_t *rx_secret = NULL;
+    uint8_t *tx_secret = NULL;
+
+    if (cipher != &ku->next_decrypt) {
+        if (cipher == cur && QUIC_LT(pkt_num, ku->rx_first_pn)) {
+            ku->rx_first_pn = pkt_num;
+        }
+        return 0;
+    }
+
+    if (ku->next_rx_tentative) {
+        QuicKeyUpdateSecrets(quic, &rx_secret, &tx_secret);
+        QuicMemcpy(rx_secret, ku->next_rx_secret,
+                EVP_MD_size(TlsHandshakeMd(&quic->tls)));
+        ku->next_rx_tentative = 0;
+    }
+
+    tmp = ku->prev_decrypt;
+    ku->prev_decrypt = *cur;
+    *cur = ku->next_decrypt;
+    ku->next_decrypt = tmp;
+    ku->next_rx_ready = 0;
+    ku->prev_valid = 1;
+    ku->prev_expire = c->arriv_time + QUIC_KEY_UPDATE_OLD_KEY_TIMEOUT;
+    ku->rx_first_pn = pkt_num;
+    ku->rx_phase ^= 1;
+
+    if (ku->tx_phase == ku->rx_phase) {
+        /* Update initiated by us has been confirmed */
+        return 0;
+    }
+
+    return QuicKeyUpdateTxFlip(quic);
+}
+
+/*
+ * RFC 9001 6.1. Initiating a Key Update
+ */
+int QuicKeyUpdate(QUIC *quic)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+    QUIC_CRYPTO *c = &quic->application;
+
+    if (!ku->inited || quic->statem.state != QUIC_STATEM_HANDSHAKE_DONE) {
+        return -1;
+    }
+
+    if (ku->tx_phase != ku->rx_phase) {
+        QUIC_LOG("Key update in progress\n");
+        return -1;
+    }
+
+    /*
+     * The next keys are ready only after old keys discarded, this also
+     * makes us wait 3 * PTO before initiating the next update.
+     */
+    if (!ku->next_rx_ready || !ku->next_tx_ready) {
+        return -1;
+    }
+
+    /* Current keys must be acknowledged by peer */
+    if (QUIC_LT(c->largest_acked, ku->tx_first_pn)) {
+        return -1;
+    }
+
+    return QuicKeyUpdateTxFlip(quic);
+}
+
+uint8_t QuicKeyUpdateTxPhase(QUIC *quic)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+
+    if (QUIC_GE(ku->tx_pkt_count, QUIC_KEY_UPDATE_PKT_LIMIT)) {
+        (void)QuicKeyUpdate(quic);
+    }
+
+    ku->tx_pkt_count++;
+    return ku->tx_phase;
+}
+
+void QuicKeyUpdateFree(QUIC *quic)
+{
+    QuicKeyUpdateState *ku = &quic->key_update;
+
+    QuicPPCipherCtxFree(&ku->next_decrypt);
+    QuicPPCipherCtxFree(&ku->next_encrypt);
+    QuicPPCipherCtxFree(&ku->prev_decrypt);
+    OPENSSL_cleanse(ku->next_rx_secret, sizeof(ku->next_rx_secret));
+}
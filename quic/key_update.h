@@ -0,0 +1,60 @@
+#ifndef TBQUIC_QUIC_KEY_UPDATE_H_
+#define TBQUIC_QUIC_KEY_UPDATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <tbquic/types.h>
+
+#include "cipher.h"
+
+/*
+ * RFC 9002 6.2.2. Without RTT sample:
+ * PTO = kInitialRtt + 4 * (kInitialRtt / 2) + max_ack_delay
+ */
+#define QUIC_KEY_UPDATE_PTO_US      (333000 + 4 * 166500 + 25000)
+/* RFC 9001 6.5. Retain old read keys for no more than 3 * PTO */
+#define QUIC_KEY_UPDATE_OLD_KEY_TIMEOUT     (3 * QUIC_KEY_UPDATE_PTO_US)
+/*
+ * RFC 9001 6.6. Limits on AEAD Usage. AEAD_AES_128_CCM has the lowest
+ * confidentiality limit(2^21.5), update keys before any AEAD reach it.
+ */
+#define QUIC_KEY_UPDATE_PKT_LIMIT   (1ULL << 21)
+
+/*
+ * Keys for the next key phase are derived in advance, so the flip of phase
+ * is only a swap of cipher contexts. Secrets of struct Tls keep the
+ * generation of next_decrypt/next_encrypt once they are ready, or the
+ * generation of current keys otherwise. If the peer updates again before
+ * that, next_decrypt is derived from a copy of the secret and only tried,
+ * the copy replaces the secret once a packet is authenticated with it.
+ */
+typedef struct {
+    uint8_t inited:1;
+    /* Key phase of application decrypt/encrypt keys */
+    uint8_t rx_phase:1;
+    uint8_t tx_phase:1;
+    uint8_t next_rx_ready:1;
+    uint8_t next_tx_ready:1;
+    uint8_t prev_valid:1;
+    uint8_t next_rx_tentative:1;
+    /* The smallest packet number received with current read keys */
+    uint64_t rx_first_pn;
+    /* The smallest packet number sent with current write keys */
+    uint64_t tx_first_pn;
+    /* Packets protected by current write keys */
+    uint64_t tx_pkt_count;
+    uint64_t prev_expire;
+    QuicPPCipher next_decrypt;
+    QuicPPCipher next_encrypt;
+    QuicPPCipher prev_decrypt;
+    uint8_t next_rx_secret[EVP_MAX_MD_SIZE];
+} QuicKeyUpdateState;
+
+int QuicKeyUpdateInit(QUIC *);
+QuicPPCipher *QuicKeyUpdateGetDecryptor(QUIC *, uint8_t, uint64_t);
+int QuicKeyUpdateOnDecrypted(QUIC *, QuicPPCipher *, uint64_t);
+uint8_t QuicKeyUpdateTxPhase(QUIC *);
+void QuicKeyUpdateFree(QUIC *);
+
+#endif
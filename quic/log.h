@@ -8,7 +8,7 @@
 
 #define QUIC_LOG(format, ...) \
     do { \
-        fprintf(stdout, "[%s, %d]: "format, __FUNCTION__, \
+        fprintf(stderr, "[%s, %d]: "format, __FUNCTION__, \
                 __LINE__, ##__VA_ARGS__); \
     } while (0)
 
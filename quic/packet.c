@@ -650,6 +650,25 @@ int WPacketForceClose(WPacket *pkt)
     return ret;
 }
 
+/*
+ * Drop the innermost sub packet and rewind to @written, used when a
+ * message can't be finished now and will be rebuilt later.
+ */
+void WPacketAbort(WPacket *pkt, size_t written)
+{
+    WPACKET_SUB *sub = NULL;
+
+    sub = pkt->subs;
+    if (sub != NULL) {
+        pkt->subs = sub->parent;
+        QuicMemFree(sub);
+    }
+
+    assert(QUIC_LE(written, pkt->written));
+    pkt->curr -= pkt->written - written;
+    pkt->written = written;
+}
+
 int WPacketSubMemcpyBytes(WPacket *pkt, const void *src, size_t len,
                          size_t lenbytes)
 {
@@ -95,6 +95,7 @@ int WPacketSubMemcpyU32(WPacket *, const void *, size_t);
 int WPacketSubAllocBytesU8(WPacket *, size_t, uint8_t **);
 int WPacketSubAllocBytesU24(WPacket *, size_t, uint8_t **);
 int WPacketForceClose(WPacket *pkt);
+void WPacketAbort(WPacket *, size_t);
 
 int WPacketClose(WPacket *);
 void WPacketCleanup(WPacket *);
@@ -17,6 +17,11 @@ static const QuicPktMethod QuicBuffPktMethod[QUIC_PKT_TYPE_MAX] = {
         .get_crypto = QuicGetInitialCrypto,
         .compute_totallen = QuicInitialPacketGetTotalLen,
     },
+    [QUIC_PKT_TYPE_0RTT] = {
+        .build_pkt = QuicZeroRttPacketBuild,
+        .get_crypto = QuicGetOneRttCrypto,
+        .compute_totallen = QuicZeroRttPacketGetTotalLen,
+    },
     [QUIC_PKT_TYPE_HANDSHAKE] = {
         .build_pkt = QuicHandshakePacketBuild,
         .get_crypto = QuicGetHandshakeCrypto,
@@ -72,12 +77,34 @@ QBUFF *QBuffNew(uint32_t pkt_type, size_t len)
     return qb;
 }
 
+/*
+ * Data of a packet is sent again with another type, e.g. rejected 0-RTT
+ * data is replayed in 1-RTT packets.
+ */
+int QBuffSetPktType(QBUFF *qb, uint32_t pkt_type)
+{
+    const QuicPktMethod *method = NULL;
+
+    method = QBuffPktMethodFind(pkt_type);
+    if (method == NULL) {
+        return -1;
+    }
+
+    qb->pkt_type = pkt_type;
+    qb->method = method;
+    return 0;
+}
+
 void QBuffFree(QBUFF *qb)
 {
     if (qb == NULL) {
         return;
     }
 
+    if (qb->zc != NULL) {
+        QuicStreamSendBufPut(qb->zc);
+    }
+
     QuicMemFree(qb->buff);
     QuicMemFree(qb);
 }
@@ -97,9 +124,10 @@ size_t QBuffLen(QBUFF *qb)
     return qb->buff_len;
 }
 
+/* Plaintext length of the packet, referenced stream data included */
 size_t QBuffGetDataLen(QBUFF *qb)
 {
-    return qb->data_len;
+    return qb->data_len + qb->ext_len;
 }
 
 size_t QBuffSpace(QBUFF *qb)
@@ -200,6 +228,8 @@ static void QBufStreamFlagsProc(QUIC *quic, int64_t id, uint64_t flags)
             si->send_state = QUIC_STREAM_STATE_RESET_RECVD;
         }
     }
+
+    QuicStreamTryReclaim(quic, si);
 }
 
 QBUFF *QBufAckSentPkt(QUIC *quic, QBuffQueueHead *h, uint64_t smallest,
@@ -222,6 +252,9 @@ QBUFF *QBufAckSentPkt(QUIC *quic, QBuffQueueHead *h, uint64_t smallest,
         }
 
         QBufStreamFlagsProc(quic, qb->stream_id, qb->flags);
+        if (qb->zc != NULL) {
+            QuicStreamSendBufAck(qb->zc, qb->ext_len);
+        }
 
         QBuffQueueUnlink(qb);
         QBuffFree(qb);
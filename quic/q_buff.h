@@ -28,6 +28,7 @@
      })
 
 typedef struct QBuff QBUFF;
+struct QuicStreamSendBuf;
 typedef int (*QBuffPktBuilder)(QUIC *, WPacket *, QBUFF *, bool);
 typedef QUIC_CRYPTO *(*QBufPktGetCrypto)(QUIC *quic);
 typedef size_t (*QBuffPktGetTotalLen)(QUIC *, size_t);
@@ -47,6 +48,8 @@ struct QBuff {
     uint64_t pkt_num;
 #define QBUFF_FLAGS_STREAM_FIN      0x01
 #define QBUFF_FLAGS_STREAM_RESET    0x02
+/* Stream data charged to flow control, not again when sent again */
+#define QBUFF_FLAGS_FLOW_COUNTED    0x04
     uint64_t flags;
     int64_t stream_id;
     uint32_t pkt_type;
@@ -55,10 +58,15 @@ struct QBuff {
     size_t buff_len;
     size_t data_len;
     size_t stream_len;
+    /* Stream data left in the application buffer, follows @buff */
+    struct QuicStreamSendBuf *zc;
+    const uint8_t *ext;
+    size_t ext_len;
 };
 
 void QBuffQueueHeadInit(QBuffQueueHead *);
 QBUFF *QBuffNew(uint32_t, size_t);
+int QBuffSetPktType(QBUFF *, uint32_t);
 void QBuffFree(QBUFF *);
 void *QBuffHead(QBUFF *);
 void *QBuffTail(QBUFF *);
@@ -20,11 +20,12 @@
 #include "common.h"
 #include "format.h"
 #include "session.h"
+#include "evp.h"
+#include "cert_comp.h"
 
 QUIC_CTX *QuicCtxNew(const QUIC_METHOD *meth)
 {
     QUIC_CTX *ctx = NULL;
-    TlsTicketKey *tk = NULL;
 
     ctx = QuicMemCalloc(sizeof(*ctx));
     if (ctx == NULL) {
@@ -35,6 +36,7 @@ QUIC_CTX *QuicCtxNew(const QUIC_METHOD *meth)
     ctx->mss = QUIC_DATAGRAM_SIZE_MAX_DEF;
     ctx->verify_mode = QUIC_TLS_VERIFY_NONE;
     ctx->cid_len = QUIC_MIN_CID_LENGTH;
+    pthread_mutex_init(&ctx->tls_config_lock, NULL);
 
     ctx->cert = QuicCertNew();
     if (ctx->cert == NULL) {
@@ -59,16 +61,8 @@ QUIC_CTX *QuicCtxNew(const QUIC_METHOD *meth)
         goto out;
     }
 
-    tk = &ctx->ext.ticket_key;
-    if (RAND_bytes(tk->tick_key_name, sizeof(tk->tick_key_name)) <= 0) {
-        goto out;
-    }
-
-    if (RAND_priv_bytes(tk->tick_hmac_key, sizeof(tk->tick_hmac_key)) <= 0) {
-        goto out;
-    }
-
-    if (RAND_priv_bytes(tk->tick_aes_key, sizeof(tk->tick_aes_key)) <= 0) {
+    ctx->ext.ticket_keys = TlsTicketKeyRingNew();
+    if (ctx->ext.ticket_keys == NULL) {
         goto out;
     }
 
@@ -80,12 +74,24 @@ out:
 
 void QuicCtxFree(QUIC_CTX *ctx)
 {
+    QuicAsyncPoolFree(ctx->async.pool);
+    TlsKeySharePoolFree(ctx->key_share_pool);
+    TlsGroupCacheFree(ctx->group_cache);
+    QuicCertVerifyCacheFree(ctx->cert_verify_cache);
+    QuicVhostTableFree(ctx->vhost_table);
+    QuicSessionCacheFree(ctx->session_cache);
+    QuicAntiReplayFree(ctx->anti_replay);
+    QuicClntSessionCacheFree(ctx->clnt_session_cache);
+    TlsTicketKeyRingFree(ctx->ext.ticket_keys);
     QuicDataFree(&ctx->ext.alpn);
     QuicDataFree(&ctx->ext.supported_groups);
+    QuicDataFree(&ctx->ext.cert_comp_algs);
     sk_X509_NAME_pop_free(ctx->client_ca_names, X509_NAME_free);
     sk_X509_NAME_pop_free(ctx->ca_names, X509_NAME_free);
     X509_VERIFY_PARAM_free(ctx->param);
     X509_STORE_free(ctx->cert_store);
+    TlsConfigReset(ctx);
+    pthread_mutex_destroy(&ctx->tls_config_lock);
     QuicCertFree(ctx->cert);
 
     QuicMemFree(ctx);
@@ -95,11 +101,15 @@ int QuicCtxCtrl(QUIC_CTX *ctx, uint32_t cmd, void *parg, long larg)
 {
     switch (cmd) {
         case QUIC_CTRL_SET_GROUPS:
+            TlsConfigReset(ctx);
             return TlsSetSupportedGroups(&ctx->ext.supported_groups.ptr_u16,
                     &ctx->ext.supported_groups.len,
                     parg, larg);
         case QUIC_CTRL_SET_SIGALGS:
+            TlsConfigReset(ctx);
             return TlsSetSigalgs(ctx->cert, parg, larg);
+        case QUIC_CTRL_SET_CERT_COMPRESSION:
+            return TlsSetCertCompression(&ctx->ext.cert_comp_algs, parg, larg);
         case QUIC_CTRL_SET_MSS:
             uint32_t mss = *((uint32_t *)(parg));
             if (QUIC_GT(mss, QUIC_DATAGRAM_SIZE_MAX)) {
@@ -118,12 +128,14 @@ int QuicCtxCtrl(QUIC_CTX *ctx, uint32_t cmd, void *parg, long larg)
 int QUIC_CTX_set_transport_parameter(QUIC_CTX *ctx, uint64_t type, void *value,
                                         size_t len)
 {
+    TlsConfigReset(ctx);
     return QuicTransParamSet(&ctx->ext.trans_param, type, value, len);
 }
 
 int QUIC_set_transport_parameter(QUIC *quic, uint64_t type,
                                     void *value, size_t len)
 {
+    quic->tls.ext.trans_param_set = true;
     return QuicTransParamSet(&quic->tls.ext.trans_param, type, value, len);
 }
 
@@ -135,6 +147,7 @@ int QUIC_set_transport_parameter(QUIC *quic, uint64_t type,
 int QUIC_CTX_set_alpn_protos(QUIC_CTX *ctx, const uint8_t *protos,
                                 size_t protos_len)
 {
+    TlsConfigReset(ctx);
     return QuicDataCopy(&ctx->ext.alpn, protos, protos_len);
 }
 
@@ -155,6 +168,7 @@ void QUIC_CTX_set_verify(QUIC_CTX *ctx, uint32_t mode,
 {
     ctx->verify_mode = mode;
     ctx->verify_callback = cb;
+    QuicCertVerifyCacheFlush(ctx->cert_verify_cache);
 }
 
 void QUIC_CTX_set_verify_depth(QUIC_CTX *ctx, int depth)
@@ -162,9 +176,273 @@ void QUIC_CTX_set_verify_depth(QUIC_CTX *ctx, int depth)
     X509_VERIFY_PARAM_set_depth(ctx->param, depth);
 }
 
+/*
+ * Keep @depth pre-generated ephemeral keys for each key share group in use,
+ * refilled by a background thread or by QuicCtxKeySharePoolRefill().
+ * Depth 0 disables the pool.
+ */
+int QuicCtxSetKeySharePool(QUIC_CTX *ctx, size_t depth, bool background)
+{
+    TlsKeySharePool *pool = NULL;
+    uint16_t id = EC_NAMED_CURVE_X25519;
+
+    if (depth > 0) {
+        pool = TlsKeySharePoolNew(depth, background);
+        if (pool == NULL) {
+            return -1;
+        }
+
+        if (!QuicDataIsEmpty(&ctx->ext.supported_groups)) {
+            id = ctx->ext.supported_groups.ptr_u16[0];
+        }
+        TlsKeySharePoolWant(pool, id);
+    }
+
+    TlsKeySharePoolFree(ctx->key_share_pool);
+    ctx->key_share_pool = pool;
+    return 0;
+}
+
+size_t QuicCtxKeySharePoolRefill(QUIC_CTX *ctx, size_t budget)
+{
+    if (ctx->key_share_pool == NULL) {
+        return 0;
+    }
+
+    return TlsKeySharePoolRefill(ctx->key_share_pool, budget);
+}
+
+/*
+ * Remember the key share group each server selects, up to @entries
+ * servers, and offer only that share next time. Needs a hostname on the
+ * connection. @entries of 0 removes the cache.
+ */
+int QuicCtxSetKeySharePredict(QUIC_CTX *ctx, size_t entries)
+{
+    TlsGroupCache *cache = NULL;
+
+    if (entries > 0) {
+        cache = TlsGroupCacheNew(entries);
+        if (cache == NULL) {
+            return -1;
+        }
+    }
+
+    TlsGroupCacheFree(ctx->group_cache);
+    ctx->group_cache = cache;
+    return 0;
+}
+
+void QuicCtxKeySharePredictStats(QUIC_CTX *ctx, uint64_t *hits,
+                                    uint64_t *misses)
+{
+    TlsGroupCache *cache = ctx->group_cache;
+
+    *hits = 0;
+    *misses = 0;
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    *hits = cache->hits;
+    *misses = cache->misses;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+bool QuicKeySharePredicted(QUIC *quic)
+{
+    return quic->tls.ext.key_share_predict_hit;
+}
+
+/*
+ * Remember the peer chains that verified for at most @ttl seconds, so a
+ * client reconnecting to the same server does not build the chain again.
+ * @entries of 0 turns it off. Not used while a verify callback is set.
+ */
+int QuicCtxSetCertVerifyCache(QUIC_CTX *ctx, size_t entries, uint32_t ttl)
+{
+    QuicCertVerifyCache *cache = NULL;
+
+    if (entries > 0) {
+        cache = QuicCertVerifyCacheNew(entries, ttl);
+        if (cache == NULL) {
+            return -1;
+        }
+    }
+
+    QuicCertVerifyCacheFree(ctx->cert_verify_cache);
+    ctx->cert_verify_cache = cache;
+    return 0;
+}
+
+/*
+ * Set up the virtual host table of a server context sized for @hosts
+ * names, 0 removes it. Must not be called with connections running.
+ */
+int QuicCtxSetVhostTable(QUIC_CTX *ctx, size_t hosts)
+{
+    QuicVhostTable *table = NULL;
+
+    if (hosts > 0) {
+        table = QuicVhostTableNew(hosts);
+        if (table == NULL) {
+            return -1;
+        }
+    }
+
+    QuicVhostTableFree(ctx->vhost_table);
+    ctx->vhost_table = table;
+    return 0;
+}
+
+/*
+ * Serve @hostname ("*.example.com" for a wildcard) with the certificates,
+ * ALPN and transport parameters of @host_ctx as they are now. Safe to call
+ * while other threads accept connections.
+ */
+int QuicCtxAddVhost(QUIC_CTX *ctx, const char *hostname, QUIC_CTX *host_ctx)
+{
+    TlsConfig *conf = NULL;
+    int ret = 0;
+
+    if (ctx->vhost_table == NULL) {
+        return -1;
+    }
+
+    conf = TlsConfigGet(host_ctx);
+    if (conf == NULL) {
+        return -1;
+    }
+
+    ret = QuicVhostTableAdd(ctx->vhost_table, hostname, conf);
+    TlsConfigFree(conf);
+    return ret;
+}
+
+void QuicCtxCertVerifyCacheStats(QUIC_CTX *ctx, uint64_t *hits,
+                                    uint64_t *misses)
+{
+    QuicCertVerifyCache *cache = ctx->cert_verify_cache;
+
+    *hits = 0;
+    *misses = 0;
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    *hits = cache->hits;
+    *misses = cache->misses;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/*
+ * Keep resumption secrets in a segment shared by the processes forked
+ * after this call, the tickets only carry the cache ID. @entries of 0
+ * goes back to stateless tickets.
+ */
+int QuicCtxSetSessionCache(QUIC_CTX *ctx, size_t entries, uint32_t ttl)
+{
+    QuicSessionCache *cache = NULL;
+
+    if (entries > 0) {
+        cache = QuicSessionCacheNew(entries, ttl);
+        if (cache == NULL) {
+            return -1;
+        }
+    }
+
+    QuicSessionCacheFree(ctx->session_cache);
+    ctx->session_cache = cache;
+    return 0;
+}
+
+/*
+ * 0-RTT is only accepted with an anti-replay filter. @rate is the expected
+ * number of resumptions with early data per second and sizes the filter,
+ * @window is the allowed skew of the ticket age in seconds. Like the session
+ * cache, the filter is shared by the processes forked after this call.
+ * @rate of 0 removes the filter.
+ */
+int QuicCtxSetAntiReplay(QUIC_CTX *ctx, uint32_t rate, uint32_t window)
+{
+    QuicAntiReplay *ar = NULL;
+
+    if (rate > 0) {
+        ar = QuicAntiReplayNew(rate, window);
+        if (ar == NULL) {
+            return -1;
+        }
+    }
+
+    QuicAntiReplayFree(ctx->anti_replay);
+    ctx->anti_replay = ar;
+    return 0;
+}
+
+/*
+ * Keep the tickets of up to @entries servers, keyed by SNI, ALPN and port.
+ * Connections with a hostname resume from it without QUIC_set_session().
+ * @entries of 0 removes the cache.
+ */
+int QuicCtxSetClientSessionCache(QUIC_CTX *ctx, size_t entries)
+{
+    QuicClntSessionCache *cache = NULL;
+
+    if (entries > 0) {
+        cache = QuicClntSessionCacheNew(entries);
+        if (cache == NULL) {
+            return -1;
+        }
+    }
+
+    QuicClntSessionCacheFree(ctx->clnt_session_cache);
+    ctx->clnt_session_cache = cache;
+    return 0;
+}
+
+/*
+ * Encrypt new tickets with @key, or a random key if @key is NULL. Tickets
+ * of the previous keys are still accepted until they fall off the ring,
+ * so all the servers sharing tickets can rotate at their own pace.
+ */
+int QuicCtxRotateTicketKey(QUIC_CTX *ctx, const uint8_t *key, size_t len)
+{
+    TlsTicketKey tk = {};
+    int ret = 0;
+
+    if (key == NULL) {
+        return TlsTicketKeyRingRotate(ctx->ext.ticket_keys, NULL);
+    }
+
+    if (len != QUIC_TICKET_KEY_LEN) {
+        return -1;
+    }
+
+    QuicMemcpy(tk.tick_key_name, key, sizeof(tk.tick_key_name));
+    key += sizeof(tk.tick_key_name);
+    QuicMemcpy(tk.tick_hmac_key, key, sizeof(tk.tick_hmac_key));
+    key += sizeof(tk.tick_hmac_key);
+    QuicMemcpy(tk.tick_aes_key, key, sizeof(tk.tick_aes_key));
+
+    ret = TlsTicketKeyRingRotate(ctx->ext.ticket_keys, &tk);
+    OPENSSL_cleanse(&tk, sizeof(tk));
+    return ret;
+}
+
+/*
+ * Number of ticket keys kept, the encryption key included.
+ */
+int QuicCtxSetTicketKeyNum(QUIC_CTX *ctx, size_t num)
+{
+    return TlsTicketKeyRingSetMax(ctx->ext.ticket_keys, num);
+}
+
 int QuicCtxLoadVerifyLocations(QUIC_CTX *ctx, const char *CAfile,
         const char *CApath)
 {
+    QuicCertVerifyCacheFlush(ctx->cert_verify_cache);
     return X509_STORE_load_locations(ctx->cert_store, CAfile, CApath);
 }
 
@@ -192,7 +470,16 @@ void QUIC_CTX_set_client_CA_list(QUIC_CTX *ctx, STACK_OF(X509_NAME) *name_list)
  */
 int QUIC_set_alpn_protos(QUIC *quic, const uint8_t *protos, size_t protos_len)
 {
-    return QuicDataCopy(&quic->tls.ext.alpn, protos, protos_len);
+    TLS *tls = &quic->tls;
+    QUIC_DATA alpn = {};
+
+    if (QuicDataCopy(&alpn, protos, protos_len) < 0) {
+        return -1;
+    }
+
+    TlsConfigDataFree(&tls->ext.alpn, &tls->config->alpn);
+    tls->ext.alpn = alpn;
+    return 0;
 }
 
 static int QUIC_set_cipher_alg(QUIC_CIPHER *cipher, uint32_t alg)
@@ -285,7 +572,6 @@ QUIC *QuicNew(QUIC_CTX *ctx)
     quic->options = ctx->options;
     quic->version = ctx->method->version;
     quic->send_fd = -1;
-    quic->tls.ext.trans_param = ctx->ext.trans_param;
     quic->ctx = ctx;
     quic->param = X509_VERIFY_PARAM_new();
     if (quic->param == NULL) {
@@ -347,6 +633,8 @@ void QUIC_set_connect_state(QUIC *quic)
 int QuicCtrl(QUIC *quic, uint32_t cmd, void *parg, long larg)
 {
     TLS *tls = &quic->tls;
+    QuicCert *cert = NULL;
+    QUIC_DATA groups = {};
     size_t len = 0;
 
     switch (cmd) {
@@ -358,10 +646,23 @@ int QuicCtrl(QUIC *quic, uint32_t cmd, void *parg, long larg)
             quic->pkt_num_len = len - 1;
             break;
         case QUIC_CTRL_SET_GROUPS:
-            return TlsSetSupportedGroups(&tls->ext.supported_groups.ptr_u16,
-                    &tls->ext.supported_groups.len,
-                    parg, larg);
+            if (TlsSetSupportedGroups(&groups.ptr_u16, &groups.len,
+                        parg, larg) < 0) {
+                return -1;
+            }
+            TlsConfigDataFree(&tls->ext.supported_groups,
+                                &tls->config->supported_groups);
+            tls->ext.supported_groups = groups;
+            break;
         case QUIC_CTRL_SET_SIGALGS:
+            /* Copy on write, the config one is shared */
+            if (tls->cert == tls->config->cert) {
+                cert = QuicCertDup(tls->cert);
+                if (cert == NULL) {
+                    return -1;
+                }
+                tls->cert = cert;
+            }
             return TlsSetSigalgs(tls->cert, parg, larg);
         case QUIC_CTRL_SET_TLSEXT_HOSTNAME:
             QuicMemFree(tls->ext.hostname);
@@ -414,6 +715,8 @@ void QuicFree(QUIC *quic)
     QBuffQueueDestroy(&quic->tx_queue);
     QBuffQueueDestroy(&quic->rx_queue);
 
+    QuicKeyUpdateFree(quic);
+    QuicCipherCtxFree(&quic->zero_rtt.ciphers);
     QuicCryptoFree(&quic->application);
     QuicCryptoFree(&quic->handshake);
     QuicCryptoFree(&quic->initial);
@@ -515,7 +818,7 @@ QUIC_SESSION *QUIC_get1_session(QUIC *quic)
 
 int QUIC_set_session(QUIC *quic, QUIC_SESSION *sess)
 {
-    if (sess == NULL) {
+    if (sess != NULL) {
         QuicSessionUpRef(sess);
     }
 
@@ -548,6 +851,10 @@ int QUIC_get_error(QUIC *quic, int ret)
         return QUIC_ERROR_WANT_WRITE;
     }
 
+    if (quic->statem.rwstate == QUIC_ASYNC_PAUSED) {
+        return QUIC_ERROR_WANT_ASYNC;
+    }
+
     return QUIC_ERROR_QUIC;
 }
 
@@ -583,16 +890,28 @@ int QuicSendPacket(QUIC *quic)
     return 0;
 }
 
-int QuicInit(void)
+int QuicInitEx(QUIC_LIB_CTX *libctx, const char *propq)
 {
-    if (QuicLoadCiphers() < 0) {
+    if (QuicLoadCiphers(libctx, propq) < 0) {
         return -1;
     }
 
 	return 0;
 }
 
+int QuicInit(void)
+{
+    return QuicInitEx(NULL, NULL);
+}
+
+void QuicThreadExit(void)
+{
+    QuicEvpCtxPoolFlush();
+}
+
 void QuicExit(void)
 {
+    QuicThreadExit();
+    QuicUnloadCiphers();
 }
 
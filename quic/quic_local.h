@@ -13,6 +13,15 @@
 #include "stream.h"
 #include "cipher.h"
 #include "buffer.h"
+#include "async.h"
+#include "key_share.h"
+#include "group_cache.h"
+#include "cert_verify_cache.h"
+#include "vhost.h"
+#include "session_cache.h"
+#include "anti_replay.h"
+#include "clnt_session_cache.h"
+#include "ticket_key.h"
 #include "tls.h"
 #include "cert.h"
 #include "list.h"
@@ -21,6 +30,7 @@
 #include "packet_local.h"
 #include "connection.h"
 #include "timer.h"
+#include "key_update.h"
 
 #define QUIC_VERSION_1      0x01
 
@@ -65,8 +75,25 @@ struct QuicCtx {
         QUIC_DATA alpn;
         QuicTransParams trans_param;
         QUIC_DATA supported_groups;
-        TlsTicketKey ticket_key;
+        TlsTicketKeyRing *ticket_keys;
+        /* Certificate compression algorithms in preference order */
+        QUIC_DATA cert_comp_algs;
     } ext;
+    TlsKeySharePool *key_share_pool;
+    TlsGroupCache *group_cache;
+    TlsConfig *tls_config;
+    pthread_mutex_t tls_config_lock;
+    QuicSessionCache *session_cache;
+    QuicAntiReplay *anti_replay;
+    QuicClntSessionCache *clnt_session_cache;
+    QuicCertVerifyCache *cert_verify_cache;
+    /* Read without a lock, only replaced with no connection running */
+    QuicVhostTable *vhost_table;
+    struct {
+        QuicAsyncPool *pool;
+        QUIC_ASYNC_SUBMIT_CB submit;
+        void *arg;
+    } async;
 };
 
 typedef struct {
@@ -85,12 +112,15 @@ struct QuicCrypto {
     QBuffQueueHead sent_queue; 
     QuicCipherSpace decrypt;
     QuicCipherSpace encrypt;
+    bool discarded;
 };
 
 typedef struct {
     QuicStatem state;
     QuicReadState read_state;
     QuicReadWriteState rwstate;
+    /* Bit per state whose pre_work has run, it must not run again */
+    uint32_t pre_worked;
 } QUIC_STATEM;
 
 struct Quic {
@@ -127,6 +157,9 @@ struct Quic {
     QUIC_CRYPTO initial;
     QUIC_CRYPTO handshake;
     QUIC_CRYPTO application;
+    /* 0-RTT keys, the packets share packet number space of application */
+    QuicCipherSpace zero_rtt;
+    QuicKeyUpdateState key_update;
     QuicTransParams peer_param;
     QBUFF *send_head;
     Timer delay_ack;
@@ -153,6 +186,9 @@ QUIC_CRYPTO *QuicGetHandshakeCrypto(QUIC *);
 QUIC_CRYPTO *QuicGetOneRttCrypto(QUIC *);
 int QuicWritePkt(QUIC *, QuicStaticBuffer *);
 void QuicCryptoFree(QUIC_CRYPTO *);
+void QuicCryptoDiscard(QUIC *, uint32_t);
+void QuicZeroRttDiscard(QUIC *, bool);
+void QuicHandshakeConfirmed(QUIC *);
 
 
 
@@ -34,6 +34,23 @@ QuicSessionTicketNew(uint32_t lifetime_hint, uint32_t age_add,
     return t;
 }
 
+QuicSessionTicket *QuicSessionTicketDup(const QuicSessionTicket *t)
+{
+    QuicSessionTicket *dup = NULL;
+
+    dup = QuicSessionTicketNew(t->lifetime_hint, t->age_add, t->ticket.data,
+                                t->ticket.len);
+    if (dup == NULL) {
+        return NULL;
+    }
+
+    dup->time = t->time;
+    QuicMemcpy(dup->master_key, t->master_key, t->master_key_length);
+    dup->master_key_length = t->master_key_length;
+
+    return dup;
+}
+
 void QuicSessionTicketAdd(QUIC_SESSION *sess, QuicSessionTicket *t)
 {
     list_add_tail(&t->node, &sess->ticket_queue);
@@ -145,6 +162,7 @@ void QuicSessionDestroy(QUIC_SESSION *sess)
         QuicSessionTicketFree(t);
     }
 
+    QuicDataFree(&sess->alpn_selected);
     QuicMemFree(sess);
 }
 
@@ -9,6 +9,7 @@
 #include "base.h"
 #include "list.h"
 #include "tls.h"
+#include "transport.h"
 #include "packet_local.h"
 
 #define QUIC_SESSION_TICKET_LIFETIME_HINT_DEF   172800
@@ -30,6 +31,10 @@ struct QuicSession {
     uint32_t tick_identity;
     uint32_t max_early_data;
     int references;
+    /* RFC 8446 4.2.10. 0-RTT needs the same ALPN as the original session */
+    QUIC_DATA alpn_selected;
+    /* RFC 9000 7.4.1. Remembered for 0-RTT */
+    QuicTransParams peer_param;
     struct list_head ticket_queue;
 };
 
@@ -39,6 +44,7 @@ void QuicSessionFree(QUIC_SESSION *);
 int QuicGetSession(QUIC *);
 QuicSessionTicket *QuicSessionTicketNew(uint32_t, uint32_t, const uint8_t *,
                                         size_t);
+QuicSessionTicket *QuicSessionTicketDup(const QuicSessionTicket *);
 QuicSessionTicket *QuicSessionTicketGet(QUIC_SESSION *, uint32_t *);
 QuicSessionTicket *QuicSessionTicketPickTail(QUIC_SESSION *);
 void QuicSessionTicketAdd(QUIC_SESSION *, QuicSessionTicket *);
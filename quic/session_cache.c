@@ -0,0 +1,255 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "session_cache.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "tls_cipher.h"
+#include "mem.h"
+#include "log.h"
+
+static void QuicSessionCacheLock(QuicSessionCacheStripe *stripe)
+{
+    /* The owner died with the lock held, the entries are still usable */
+    if (pthread_mutex_lock(&stripe->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&stripe->lock);
+    }
+}
+
+static void QuicSessionCacheUnlock(QuicSessionCacheStripe *stripe)
+{
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+static QuicSessionCacheStripe *
+QuicSessionCacheStripeGet(QuicSessionCache *cache, const uint8_t *id)
+{
+    uint64_t hash = 0;
+
+    /* IDs are random, their leading bytes are hash enough */
+    QuicMemcpy(&hash, id, sizeof(hash));
+    return &cache->stripes[hash % cache->stripe_num];
+}
+
+static QuicSessionCacheEntry *
+QuicSessionCacheFind(QuicSessionCacheStripe *stripe, const uint8_t *id)
+{
+    QuicSessionCacheEntry *e = NULL;
+    int i = 0;
+
+    for (i = 0; i < QUIC_SESSION_CACHE_WAYS; i++) {
+        e = &stripe->entries[i];
+        if (e->used && QuicMemCmp(e->id, id, sizeof(e->id)) == 0) {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Must be called before the worker processes are forked, the segment is
+ * inherited by all of them.
+ */
+QuicSessionCache *QuicSessionCacheNew(size_t entries, uint32_t ttl)
+{
+    QuicSessionCache *cache = NULL;
+    pthread_mutexattr_t attr;
+    size_t stripe_num = 0;
+    size_t map_len = 0;
+    size_t i = 0;
+
+    if (entries == 0 || entries > QUIC_SESSION_CACHE_ENTRY_MAX || ttl == 0) {
+        return NULL;
+    }
+
+    stripe_num = (entries + QUIC_SESSION_CACHE_WAYS - 1) /
+                    QUIC_SESSION_CACHE_WAYS;
+    map_len = sizeof(*cache) + stripe_num * sizeof(cache->stripes[0]);
+    cache = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (cache == MAP_FAILED) {
+        QUIC_LOG("mmap session cache failed\n");
+        return NULL;
+    }
+
+    cache->map_len = map_len;
+    cache->stripe_num = stripe_num;
+    cache->ttl = ttl;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    for (i = 0; i < stripe_num; i++) {
+        pthread_mutex_init(&cache->stripes[i].lock, &attr);
+    }
+    pthread_mutexattr_destroy(&attr);
+
+    return cache;
+}
+
+/*
+ * Only unmap it from this process, the others may still be using it.
+ */
+void QuicSessionCacheFree(QuicSessionCache *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    munmap(cache, cache->map_len);
+}
+
+int QuicSessionCacheAdd(QuicSessionCache *cache, const uint8_t *id,
+                        QUIC_SESSION *sess)
+{
+    QuicSessionCacheStripe *stripe = NULL;
+    QuicSessionCacheEntry *e = NULL;
+    QuicSessionCacheEntry *victim = NULL;
+    QuicSessionTicket *t = NULL;
+    time_t now = time(NULL);
+    uint64_t lifetime = cache->ttl;
+    int i = 0;
+
+    t = QuicSessionTicketPickTail(sess);
+    if (t == NULL || sess->cipher == NULL) {
+        return -1;
+    }
+
+    if (t->master_key_length > sizeof(e->master_key)) {
+        return -1;
+    }
+
+    if (t->lifetime_hint < lifetime) {
+        lifetime = t->lifetime_hint;
+    }
+
+    stripe = QuicSessionCacheStripeGet(cache, id);
+    QuicSessionCacheLock(stripe);
+    victim = QuicSessionCacheFind(stripe, id);
+    for (i = 0; victim == NULL && i < QUIC_SESSION_CACHE_WAYS; i++) {
+        e = &stripe->entries[i];
+        if (!e->used || e->expire <= now) {
+            victim = e;
+        }
+    }
+
+    /* Evict the least recently used one */
+    if (victim == NULL) {
+        victim = &stripe->entries[0];
+        for (i = 1; i < QUIC_SESSION_CACHE_WAYS; i++) {
+            e = &stripe->entries[i];
+            if (e->last_used < victim->last_used) {
+                victim = e;
+            }
+        }
+    }
+
+    QuicMemcpy(victim->id, id, sizeof(victim->id));
+    victim->cipher_id = sess->cipher->id;
+    victim->max_early_data = sess->max_early_data;
+    victim->alpn_len = 0;
+    if (sess->alpn_selected.len <= sizeof(victim->alpn)) {
+        QuicMemcpy(victim->alpn, sess->alpn_selected.data,
+                sess->alpn_selected.len);
+        victim->alpn_len = sess->alpn_selected.len;
+    } else {
+        victim->max_early_data = 0;
+    }
+    victim->age_add = t->age_add;
+    victim->lifetime_hint = t->lifetime_hint;
+    victim->master_key_length = t->master_key_length;
+    QuicMemcpy(victim->master_key, t->master_key, t->master_key_length);
+    victim->expire = now + lifetime;
+    victim->issued = t->time;
+    victim->last_used = ++stripe->clock;
+    victim->used = true;
+    QuicSessionCacheUnlock(stripe);
+
+    return 0;
+}
+
+/*
+ * Return a new session built from the cached secrets, NULL if @id is
+ * unknown or expired.
+ */
+QUIC_SESSION *QuicSessionCacheLookup(QuicSessionCache *cache,
+                                        const uint8_t *id, size_t len)
+{
+    QuicSessionCacheStripe *stripe = NULL;
+    QuicSessionCacheEntry *e = NULL;
+    QuicSessionCacheEntry copy = {};
+    QUIC_SESSION *sess = NULL;
+    QuicSessionTicket *t = NULL;
+
+    if (len != QUIC_SESSION_CACHE_ID_LEN) {
+        return NULL;
+    }
+
+    stripe = QuicSessionCacheStripeGet(cache, id);
+    QuicSessionCacheLock(stripe);
+    e = QuicSessionCacheFind(stripe, id);
+    if (e != NULL) {
+        if (e->expire <= time(NULL)) {
+            e->used = false;
+            e = NULL;
+        } else {
+            e->last_used = ++stripe->clock;
+            copy = *e;
+        }
+    }
+    QuicSessionCacheUnlock(stripe);
+
+    if (e == NULL) {
+        return NULL;
+    }
+
+    sess = QuicSessionCreate();
+    if (sess == NULL) {
+        return NULL;
+    }
+
+    sess->cipher = QuicGetTlsCipherById(copy.cipher_id);
+    if (sess->cipher == NULL) {
+        goto err;
+    }
+
+    sess->max_early_data = copy.max_early_data;
+    if (copy.alpn_len != 0 && QuicDataCopy(&sess->alpn_selected, copy.alpn,
+                copy.alpn_len) < 0) {
+        goto err;
+    }
+
+    t = QuicSessionTicketNew(copy.lifetime_hint, copy.age_add, id, len);
+    if (t == NULL) {
+        goto err;
+    }
+
+    QuicMemcpy(t->master_key, copy.master_key, copy.master_key_length);
+    t->master_key_length = copy.master_key_length;
+    t->time = copy.issued;
+    QuicSessionTicketAdd(sess, t);
+
+    return sess;
+err:
+    QuicSessionFree(sess);
+    return NULL;
+}
+
+void QuicSessionCacheRemove(QuicSessionCache *cache, const uint8_t *id)
+{
+    QuicSessionCacheStripe *stripe = NULL;
+    QuicSessionCacheEntry *e = NULL;
+
+    stripe = QuicSessionCacheStripeGet(cache, id);
+    QuicSessionCacheLock(stripe);
+    e = QuicSessionCacheFind(stripe, id);
+    if (e != NULL) {
+        e->used = false;
+    }
+    QuicSessionCacheUnlock(stripe);
+}
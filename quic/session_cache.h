@@ -0,0 +1,62 @@
+#ifndef TBQUIC_QUIC_SESSION_CACHE_H_
+#define TBQUIC_QUIC_SESSION_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+#include <tbquic/types.h>
+
+#include "session.h"
+
+#define QUIC_SESSION_CACHE_ID_LEN       16
+/* Entries sharing one lock and one LRU clock */
+#define QUIC_SESSION_CACHE_WAYS         8
+#define QUIC_SESSION_CACHE_ENTRY_MAX    (1 << 22)
+/* A longer ALPN is not stored and the session loses 0-RTT */
+#define QUIC_SESSION_CACHE_ALPN_MAX_LEN 32
+
+/*
+ * Everything below lives in a MAP_SHARED segment and is used by several
+ * processes, so no pointers are kept in it.
+ */
+typedef struct {
+    uint8_t id[QUIC_SESSION_CACHE_ID_LEN];
+    bool used;
+    uint8_t master_key_length;
+    uint8_t alpn_len;
+    uint32_t cipher_id;
+    uint32_t age_add;
+    uint32_t max_early_data;
+    uint64_t lifetime_hint;
+    uint64_t last_used;
+    time_t expire;
+    time_t issued;
+    uint8_t master_key[EVP_MAX_MD_SIZE];
+    uint8_t alpn[QUIC_SESSION_CACHE_ALPN_MAX_LEN];
+} QuicSessionCacheEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t clock;
+    QuicSessionCacheEntry entries[QUIC_SESSION_CACHE_WAYS];
+} QuicSessionCacheStripe;
+
+typedef struct {
+    size_t map_len;
+    uint32_t stripe_num;
+    /* Upper bound of an entry lifetime in seconds */
+    uint32_t ttl;
+    QuicSessionCacheStripe stripes[];
+} QuicSessionCache;
+
+QuicSessionCache *QuicSessionCacheNew(size_t, uint32_t);
+void QuicSessionCacheFree(QuicSessionCache *);
+int QuicSessionCacheAdd(QuicSessionCache *, const uint8_t *, QUIC_SESSION *);
+QUIC_SESSION *QuicSessionCacheLookup(QuicSessionCache *, const uint8_t *,
+                                        size_t);
+void QuicSessionCacheRemove(QuicSessionCache *, const uint8_t *);
+
+#endif
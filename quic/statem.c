@@ -12,6 +12,7 @@
 #include "rand.h"
 #include "datagram.h"
 #include "q_buff.h"
+#include "async.h"
 #include "mem.h"
 #include "common.h"
 #include "log.h"
@@ -76,6 +77,47 @@ QuicReadStateMachine(QUIC *quic, const QuicStatemFlow *statem, size_t num)
     return 0;
 }
 
+static bool QuicAsyncPaused(QUIC *quic)
+{
+    QUIC_ASYNC_JOB *job = quic->tls.async_job;
+
+    if (job == NULL || QuicAsyncJobStatus(job) != QUIC_ASYNC_JOB_PENDING) {
+        return false;
+    }
+
+    quic->statem.rwstate = QUIC_ASYNC_PAUSED;
+    return true;
+}
+
+/*
+ * Continue the TLS flight stopped by a private key operation, the
+ * messages before it have already been framed.
+ */
+static int QuicAsyncResume(QUIC *quic)
+{
+    if (QuicAsyncPaused(quic)) {
+        return -1;
+    }
+
+    quic->statem.rwstate = QUIC_NOTHING;
+    QuicBufClear(QUIC_TLS_BUFFER(quic));
+    if (TlsDoHandshake(&quic->tls) == QUIC_FLOW_RET_ERROR) {
+        QUIC_LOG("TLS handshake failed\n");
+        return -1;
+    }
+    QuicBufClear(QUIC_TLS_BUFFER(quic));
+
+    if (QuicSendPacket(quic) < 0) {
+        return -1;
+    }
+
+    if (QuicWantWrite(quic)) {
+        return -1;
+    }
+
+    return 0;
+}
+
 int
 QuicStateMachineAct(QUIC *quic, const QuicStatemFlow *statem, size_t num)
 {
@@ -83,9 +125,18 @@ QuicStateMachineAct(QUIC *quic, const QuicStatemFlow *statem, size_t num)
     QUIC_STATEM *st = &quic->statem;
     int ret = 0;
 
+    if (st->rwstate == QUIC_ASYNC_PAUSED && QuicAsyncResume(quic) < 0) {
+        return -1;
+    }
+
     do {
         sm = &statem[st->state];
-        if (sm->pre_work != NULL) {
+        /*
+         * A non-blocking caller comes back here after WANT_READ, the flight
+         * of this state has already been sent then.
+         */
+        if (sm->pre_work != NULL && !(st->pre_worked & (1U << st->state))) {
+            st->pre_worked |= 1U << st->state;
             ret = sm->pre_work(quic);
         }
 
@@ -93,7 +144,7 @@ QuicStateMachineAct(QUIC *quic, const QuicStatemFlow *statem, size_t num)
             return -1;
         }
 
-        if (QuicWantWrite(quic)) {
+        if (QuicWantWrite(quic) || QuicAsyncPaused(quic)) {
             return -1;
         }
 
@@ -106,7 +157,7 @@ QuicStateMachineAct(QUIC *quic, const QuicStatemFlow *statem, size_t num)
             return -1;
         }
 
-        if (QuicWantWrite(quic)) {
+        if (QuicWantWrite(quic) || QuicAsyncPaused(quic)) {
             return -1;
         }
 
@@ -20,6 +20,7 @@ typedef enum {
     QUIC_FLOW_RET_NEXT,
     QUIC_FLOW_RET_WANT_READ,
     QUIC_FLOW_RET_WANT_WRITE,
+    QUIC_FLOW_RET_WANT_ASYNC,
     QUIC_FLOW_RET_CONTINUE,
     QUIC_FLOW_RET_FINISH,
     QUIC_FLOW_RET_DROP,
@@ -107,6 +108,7 @@ typedef enum {
     TLS_MT_CERTIFICATE_STATUS = 22,
     TLS_MT_SUPPLEMENTAL_DATA = 23,
     TLS_MT_KEY_UPDATE = 24,
+    TLS_MT_COMPRESSED_CERTIFICATE = 25,
     TLS_MT_MESSAGE_HASH = 254,
     TLS_MT_MESSAGE_TYPE_MAX,
 } TlsMessageType;
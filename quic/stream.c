@@ -12,6 +12,7 @@
 #include "packet_local.h"
 #include "frame.h"
 #include "mem.h"
+#include "rand.h"
 #include "common.h"
 #include "log.h"
 
@@ -40,6 +41,7 @@ static bool QuicStreamPeerOpened(int64_t id, bool server)
 static void
 QuicStreamInstanceInit(QuicStreamInstance *si, int64_t id, bool server)
 {
+    si->id = id;
     si->recv_state = QUIC_STREAM_STATE_START;
     si->send_state = QUIC_STREAM_STATE_START;
 
@@ -80,30 +82,42 @@ static void QuicStreamInstanceRecvOpen(QuicStreamInstance *si)
     }
 }
 
-static int QuicStreamConfInit(QuicStreamConf *scf, uint64_t max_stream_bidi,
-                        uint64_t max_stream_uni, bool server)
+static void QuicStreamConfMaxIdSet(QuicStreamConf *scf,
+                        uint64_t max_stream_bidi, uint64_t max_stream_uni,
+                        bool server)
 {
     uint64_t max_bidi_stream_id = 0;
     uint64_t max_uni_stream_id = 0;
-    int64_t id = 0;
 
-    if (scf->stream != NULL) {
+    max_bidi_stream_id = QuicStreamComputeMaxId(max_stream_bidi, false, server);
+    max_uni_stream_id = QuicStreamComputeMaxId(max_stream_uni, true, server);
+    scf->max_id_value = QUIC_MAX(max_bidi_stream_id, max_uni_stream_id);
+}
+
+static int QuicStreamConfInit(QuicStreamConf *scf, uint64_t max_stream_bidi,
+                        uint64_t max_stream_uni, bool server)
+{
+    if (scf->bucket != NULL) {
         QUIC_LOG("Stream initialized\n");
         return -1;
     }
 
-    max_bidi_stream_id = QuicStreamComputeMaxId(max_stream_bidi, false, server);
-    max_uni_stream_id = QuicStreamComputeMaxId(max_stream_uni, true, server);
-    scf->max_id_value = QUIC_MAX(max_bidi_stream_id, max_uni_stream_id);
-    scf->stream = QuicMemCalloc(sizeof(*scf->stream)*scf->max_id_value);
-    if (scf->stream == NULL) {
+    QuicStreamConfMaxIdSet(scf, max_stream_bidi, max_stream_uni, server);
+
+    /* Instances come from the slabs on first use */
+    scf->bucket = QuicMemCalloc(sizeof(*scf->bucket)*QUIC_STREAM_HASH_SIZE);
+    if (scf->bucket == NULL) {
         return -1;
     }
 
-    for (id = 0; id < scf->max_id_value; id++) {
-        QuicStreamInstanceInit(&scf->stream[id], id, server);
+    /* Peers must not guess the levels and build a degenerate list */
+    if (QuicRandBytes((uint8_t *)&scf->reasm_rand,
+                sizeof(scf->reasm_rand)) < 0 || scf->reasm_rand == 0) {
+        scf->reasm_rand = (uintptr_t)scf | 1;
     }
 
+    scf->bucket_mask = QUIC_STREAM_HASH_SIZE - 1;
+    INIT_LIST_HEAD(&scf->slab);
     INIT_LIST_HEAD(&scf->msg_queue);
     return 0;
 }
@@ -112,14 +126,24 @@ void QuicStreamConfDeInit(QuicStreamConf *scf)
 {
     QuicStreamMsg *msg = NULL;
     QuicStreamMsg *n = NULL;
-    int64_t id = 0;
+    QuicStreamSlab *slab = NULL;
+    QuicStreamSlab *ns = NULL;
+    QuicStreamInstance *si = NULL;
+    uint64_t i = 0;
 
-    if (scf->stream == NULL) {
+    if (scf->bucket == NULL) {
         return;
     }
 
-    for (id = 0; id < scf->max_id_value; id++) {
-        QuicStreamInstanceDeInit(&scf->stream[id]);
+    for (i = 0; i <= scf->bucket_mask; i++) {
+        for (si = scf->bucket[i]; si != NULL; si = si->next) {
+            QuicStreamInstanceDeInit(si);
+        }
+    }
+
+    list_for_each_entry_safe(slab, ns, &scf->slab, node) {
+        list_del(&slab->node);
+        QuicMemFree(slab);
     }
 
     list_for_each_entry_safe(msg, n, &scf->msg_queue, node) {
@@ -127,7 +151,263 @@ void QuicStreamConfDeInit(QuicStreamConf *scf)
         QuicStreamMsgFree(msg);
     }
 
-    QuicMemFree(scf->stream);
+    for (i = 0; i < QUIC_NELEM(scf->closed); i++) {
+        QuicMemFree(scf->closed[i].range);
+        QuicMemset(&scf->closed[i], 0, sizeof(scf->closed[i]));
+    }
+
+    QuicMemFree(scf->bucket);
+    scf->bucket = NULL;
+}
+
+static QuicStreamInstance **QuicStreamBucket(QuicStreamConf *scf, int64_t id)
+{
+    /* IDs of one type are consecutive once the type bits are dropped */
+    uint64_t key = ((uint64_t)id >> QUIC_STREAM_ID_MASK_BITS) ^
+                    ((uint64_t)id << (QUIC_STREAM_ID_MASK_BITS + 3));
+
+    return &scf->bucket[key & scf->bucket_mask];
+}
+
+static QuicStreamInstance *QuicStreamFind(QuicStreamConf *scf, int64_t id)
+{
+    QuicStreamInstance *si = NULL;
+
+    for (si = *QuicStreamBucket(scf, id); si != NULL; si = si->next) {
+        if (si->id == id) {
+            return si;
+        }
+    }
+
+    return NULL;
+}
+
+static void QuicStreamGrow(QuicStreamConf *scf)
+{
+    QuicStreamInstance **old = scf->bucket;
+    QuicStreamInstance **b = NULL;
+    QuicStreamInstance *si = NULL;
+    QuicStreamInstance *n = NULL;
+    uint64_t old_mask = scf->bucket_mask;
+    uint64_t i = 0;
+
+    scf->bucket = QuicMemCalloc(sizeof(*scf->bucket)*(old_mask + 1)*2);
+    if (scf->bucket == NULL) {
+        /* Keep the old table, chains get longer */
+        scf->bucket = old;
+        return;
+    }
+
+    scf->bucket_mask = (old_mask << 1) | 1;
+    for (i = 0; i <= old_mask; i++) {
+        for (si = old[i]; si != NULL; si = n) {
+            n = si->next;
+            b = QuicStreamBucket(scf, si->id);
+            si->next = *b;
+            *b = si;
+        }
+    }
+
+    QuicMemFree(old);
+}
+
+static QuicStreamInstance *
+QuicStreamCreate(QuicStreamConf *scf, int64_t id, bool server)
+{
+    QuicStreamInstance **b = NULL;
+    QuicStreamInstance *si = NULL;
+    QuicStreamSlab *slab = NULL;
+    int i = 0;
+
+    if (scf->free == NULL) {
+        slab = QuicMemCalloc(sizeof(*slab));
+        if (slab == NULL) {
+            return NULL;
+        }
+
+        for (i = QUIC_STREAM_SLAB_SIZE - 1; i >= 0; i--) {
+            slab->inst[i].next = scf->free;
+            scf->free = &slab->inst[i];
+        }
+        list_add_tail(&slab->node, &scf->slab);
+    }
+
+    if (scf->num > scf->bucket_mask) {
+        QuicStreamGrow(scf);
+    }
+
+    si = scf->free;
+    scf->free = si->next;
+    QuicMemset(si, 0, sizeof(*si));
+    QuicStreamInstanceInit(si, id, server);
+
+    b = QuicStreamBucket(scf, id);
+    si->next = *b;
+    *b = si;
+    scf->num++;
+
+    return si;
+}
+
+static QuicStreamClosed *QuicStreamClosedSet(QuicStreamConf *scf, int64_t id)
+{
+    return &scf->closed[!!QUIC_STREAM_IS_UNI(id)];
+}
+
+/* Number of ranges starting at or below @index */
+static uint32_t QuicStreamClosedFind(QuicStreamClosed *c, uint64_t index)
+{
+    uint32_t lo = 0;
+    uint32_t hi = c->num;
+    uint32_t mid = 0;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo)/2;
+        if (c->range[mid].start <= index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static bool QuicStreamIsClosed(QuicStreamConf *scf, int64_t id)
+{
+    QuicStreamClosed *c = QuicStreamClosedSet(scf, id);
+    uint64_t index = (uint64_t)id >> QUIC_STREAM_ID_MASK_BITS;
+    uint32_t i = 0;
+
+    i = QuicStreamClosedFind(c, index);
+
+    return i != 0 && index < c->range[i - 1].end;
+}
+
+static int QuicStreamClosedGrow(QuicStreamClosed *c)
+{
+    QuicStreamRange *range = NULL;
+    uint32_t size = 0;
+
+    size = c->size ? c->size*2 : QUIC_STREAM_CLOSED_RANGES;
+    range = QuicMemMalloc(sizeof(*range)*size);
+    if (range == NULL) {
+        return -1;
+    }
+
+    if (c->num != 0) {
+        QuicMemcpy(range, c->range, sizeof(*range)*c->num);
+    }
+    QuicMemFree(c->range);
+    c->range = range;
+    c->size = size;
+
+    return 0;
+}
+
+static int QuicStreamSetClosed(QuicStreamConf *scf, int64_t id)
+{
+    QuicStreamClosed *c = QuicStreamClosedSet(scf, id);
+    QuicStreamRange *prev = NULL;
+    QuicStreamRange *next = NULL;
+    uint64_t index = (uint64_t)id >> QUIC_STREAM_ID_MASK_BITS;
+    uint32_t i = 0;
+
+    /* Range @i is the first one above @index */
+    i = QuicStreamClosedFind(c, index);
+    if (i != 0) {
+        prev = &c->range[i - 1];
+        if (index < prev->end) {
+            return 0;
+        }
+        if (prev->end != index) {
+            prev = NULL;
+        }
+    }
+
+    if (i < c->num && c->range[i].start == index + 1) {
+        next = &c->range[i];
+    }
+
+    if (prev != NULL && next != NULL) {
+        prev->end = next->end;
+        QuicMemmove(next, next + 1, sizeof(*next)*(c->num - i - 1));
+        c->num--;
+        return 0;
+    }
+
+    if (prev != NULL) {
+        prev->end++;
+        return 0;
+    }
+
+    if (next != NULL) {
+        next->start--;
+        return 0;
+    }
+
+    if (c->num == c->size && QuicStreamClosedGrow(c) < 0) {
+        return -1;
+    }
+
+    QuicMemmove(&c->range[i + 1], &c->range[i],
+            sizeof(*c->range)*(c->num - i));
+    c->range[i].start = index;
+    c->range[i].end = index + 1;
+    c->num++;
+
+    return 0;
+}
+
+static bool QuicStreamFinished(QuicStreamInstance *si)
+{
+    if (!list_empty(&si->queue) || si->lent_bytes != 0) {
+        return false;
+    }
+
+    if (si->recv_state != QUIC_STREAM_STATE_DISABLE &&
+            si->recv_state != QUIC_STREAM_STATE_DATA_READ &&
+            si->recv_state != QUIC_STREAM_STATE_RESET_READ) {
+        return false;
+    }
+
+    return si->send_state == QUIC_STREAM_STATE_DISABLE ||
+            si->send_state == QUIC_STREAM_STATE_DATA_RECVD ||
+            si->send_state == QUIC_STREAM_STATE_RESET_RECVD;
+}
+
+/*
+ * Give the instance of a stream in a terminal state back to the slab.
+ * A peer stream is only reclaimed if it can be remembered as closed, so
+ * a late frame does not open it again.
+ */
+bool QuicStreamTryReclaim(QUIC *quic, QuicStreamInstance *si)
+{
+    QuicStreamConf *scf = &quic->stream;
+    QuicStreamInstance **b = NULL;
+
+    if (!QuicStreamFinished(si)) {
+        return false;
+    }
+
+    if (QuicStreamPeerOpened(si->id, quic->quic_server) &&
+            QuicStreamSetClosed(scf, si->id) < 0) {
+        return false;
+    }
+
+    for (b = QuicStreamBucket(scf, si->id); *b != NULL; b = &(*b)->next) {
+        if (*b == si) {
+            *b = si->next;
+            break;
+        }
+    }
+
+    QuicStreamInstanceDeInit(si);
+    si->next = scf->free;
+    scf->free = si;
+    scf->num--;
+
+    return true;
 }
 
 QuicStreamMsg *QuicStreamMsgCreate(int64_t id, uint32_t type)
@@ -240,7 +520,7 @@ QUIC_STREAM_HANDLE QuicStreamOpen(QUIC *quic, bool uni)
     QuicStreamInstance *si = NULL;
     int64_t id = -1;
 
-    if (scf->stream == NULL) {
+    if (scf->bucket == NULL) {
         QUIC_LOG("Stream not initialized\n");
         return -1;
     }
@@ -250,7 +530,10 @@ QUIC_STREAM_HANDLE QuicStreamOpen(QUIC *quic, bool uni)
         return -1;
     }
 
-    si = &scf->stream[id];
+    si = QuicStreamCreate(scf, id, quic->quic_server);
+    if (si == NULL) {
+        return -1;
+    }
 
     assert(si->send_state == QUIC_STREAM_STATE_START);
 
@@ -274,9 +557,8 @@ QuicStreamInstance *QuicStreamGetInstance(QUIC *quic, QUIC_STREAM_HANDLE h)
     QuicStreamConf *scf = &quic->stream;
     QuicStreamInstance *si = NULL;
     int64_t id = h;
-    int64_t i = 0;
 
-    if (scf->stream == NULL) {
+    if (scf->bucket == NULL) {
         QUIC_LOG("Stream not initialized\n");
         return NULL;
     }
@@ -285,24 +567,104 @@ QuicStreamInstance *QuicStreamGetInstance(QUIC *quic, QUIC_STREAM_HANDLE h)
         return NULL;
     }
 
-    si = &scf->stream[id];
+    si = QuicStreamFind(scf, id);
+    if (si != NULL) {
+        return si;
+    }
 
-    if (!QuicStreamPeerOpened(id, quic->quic_server) &&
-            si->send_state == QUIC_STREAM_STATE_START) {
+    /* Local streams exist from QuicStreamOpen() until reclaimed */
+    if (!QuicStreamPeerOpened(id, quic->quic_server) ||
+            QuicStreamIsClosed(scf, id)) {
         return NULL;
     }
 
-    if (id > scf->max_id_opened) {
-        for (i = scf->max_id_opened + 1; i <= id; i++) {
-            QuicStreamInstanceRecvOpen(&scf->stream[i]);
-        }
-
-        scf->max_id_opened = id;
+    /* Opened by the peer, implicitly or by this frame */
+    si = QuicStreamCreate(scf, id, quic->quic_server);
+    if (si == NULL) {
+        return NULL;
     }
 
+    QuicStreamInstanceRecvOpen(si);
     return si;
 }
 
+/*
+ * A stream that existed once and was reclaimed, so a frame for it is late
+ * rather than invalid.
+ */
+bool QuicStreamIdClosed(QUIC *quic, int64_t id)
+{
+    QuicStreamConf *scf = &quic->stream;
+    uint64_t index = (uint64_t)id >> QUIC_STREAM_ID_MASK_BITS;
+    uint64_t alloced = 0;
+
+    if (scf->bucket == NULL || QuicStreamIdCheck(quic, scf, id) < 0) {
+        return false;
+    }
+
+    if (QuicStreamFind(scf, id) != NULL) {
+        return false;
+    }
+
+    if (QuicStreamPeerOpened(id, quic->quic_server)) {
+        return QuicStreamIsClosed(scf, id);
+    }
+
+    if (id & QUIC_STREAM_UNIDIRECTIONAL) {
+        alloced = scf->uni_id_alloced;
+    } else {
+        alloced = scf->bidi_id_alloced;
+    }
+
+    return index < alloced;
+}
+
+static int QuicStreamOpenAndSend(QUIC *quic, QUIC_STREAM_HANDLE *h, bool uni,
+                                QUIC_STREAM_IOVEC *iov, uint32_t pkt_type)
+{
+    int64_t id = 0;
+
+    id = QuicStreamOpen(quic, uni);
+    if (id < 0) {
+        QUIC_LOG("Open Stream failed\n");
+        return -1;
+    }
+
+    *h = id;
+    iov->handle = id;
+    if (QuicStreamFrameBuild(quic, iov, 1, pkt_type) < 0) {
+        QUIC_LOG("Build Stream frame failed\n");
+        return -1;
+    }
+
+    if (QuicSendPacket(quic) < 0) {
+        return -1;
+    }
+
+    return iov->data_len;
+}
+
+/*
+ * RFC 9001 4.6.1. A client resuming a session may send data in 0-RTT
+ * packets before the handshake completes, up to max_early_data of the
+ * ticket.
+ */
+static bool QuicStreamEarlyDataAllowed(QUIC *quic, size_t len)
+{
+    TLS *s = &quic->tls;
+
+    if (QUIC_IS_SERVER(quic) || quic->session == NULL) {
+        return false;
+    }
+
+    if (s->early_data_state != TLS_EARLY_DATA_WRITING ||
+            s->ext.early_data == TLS_EARLY_DATA_REJECTED) {
+        return false;
+    }
+
+    return s->early_data_count + len <= quic->session->max_early_data;
+}
+
 int QuicStreamSendEarlyData(QUIC *quic, QUIC_STREAM_HANDLE *h, bool uni,
                                 void *data, size_t len)
 {
@@ -312,34 +674,25 @@ int QuicStreamSendEarlyData(QUIC *quic, QUIC_STREAM_HANDLE *h, bool uni,
         .data_len = len,
     };
     TlsState handshake_state;
-    int64_t id = 0;
     int ret = 0;
 
     ret = QuicDoHandshake(quic);
     handshake_state = quic->tls.handshake_state; 
     if (handshake_state == TLS_ST_SR_FINISHED ||
             handshake_state == TLS_ST_HANDSHAKE_DONE) {
-            QUIC_LOG("Build Stream frame\n");
-        id = QuicStreamOpen(quic, uni);
-        if (id < 0) {
-            QUIC_LOG("Open Stream failed\n");
-            return -1;
-        }
-
-        *h = id;
-        iov.handle = id;
-        if (QuicStreamFrameBuild(quic, &iov, 1) < 0) {
-            QUIC_LOG("Build Stream frame failed\n");
-            return -1;
-        }
+        return QuicStreamOpenAndSend(quic, h, uni, &iov, QUIC_PKT_TYPE_1RTT);
+    }
 
-        if (QuicSendPacket(quic) < 0) {
-            return -1;
-        }
+    if (!QuicStreamEarlyDataAllowed(quic, len)) {
+        return ret;
+    }
 
-        return len;
+    ret = QuicStreamOpenAndSend(quic, h, uni, &iov, QUIC_PKT_TYPE_0RTT);
+    if (ret < 0) {
+        return -1;
     }
 
+    quic->tls.early_data_count += len;
     return ret;
 }
 
@@ -363,7 +716,7 @@ int QuicStreamSend(QUIC *quic, QUIC_STREAM_HANDLE h, void *data, size_t len)
         return -1;
     }
 
-    if (QuicStreamFrameBuild(quic, &iov, 1) < 0) {
+    if (QuicStreamFrameBuild(quic, &iov, 1, QUIC_PKT_TYPE_1RTT) < 0) {
         QUIC_LOG("Build Stream frame failed\n");
         return -1;
     }
@@ -375,6 +728,102 @@ int QuicStreamSend(QUIC *quic, QUIC_STREAM_HANDLE h, void *data, size_t len)
     return len;
 }
 
+int QuicStreamSendZeroCopy(QUIC *quic, QUIC_STREAM_HANDLE h, void *data,
+                    size_t len, QUIC_STREAM_SEND_CB cb, void *arg)
+{
+    QuicStreamInstance *si = NULL;
+    QuicStreamSendBuf *sb = NULL;
+    int queued = 0;
+    int ret = -1;
+
+    if (len == 0) {
+        return -1;
+    }
+
+    si = QuicStreamGetInstance(quic, h);
+    if (si == NULL) {
+        return -1;
+    }
+
+    if (si->send_state != QUIC_STREAM_STATE_READY &&
+            si->send_state != QUIC_STREAM_STATE_SEND) {
+        return -1;
+    }
+
+    sb = QuicMemCalloc(sizeof(*sb));
+    if (sb == NULL) {
+        return -1;
+    }
+
+    /* The reference of this call, the QBUFFs take one each */
+    sb->ref = 1;
+    sb->id = h;
+    sb->data = data;
+    sb->len = len;
+    sb->unacked = len;
+    sb->cb = cb;
+    sb->arg = arg;
+
+    queued = QuicStreamFrameBuildZc(quic, sb, QUIC_PKT_TYPE_1RTT);
+    if (queued < 0) {
+        QUIC_LOG("Build Stream frame failed\n");
+        goto out;
+    }
+
+    /* The tail not queued is never sent, @cb reports the queued part */
+    sb->len = queued;
+    sb->unacked = queued;
+
+    if (QuicSendPacket(quic) < 0) {
+        QUIC_LOG("Send packet failed\n");
+    }
+
+    /* Frames still queued or in flight are sent or retransmitted later */
+    if (sb->ref > 1) {
+        ret = queued;
+    }
+out:
+    if (ret < 0) {
+        /* Nothing references @data, the caller still owns it */
+        sb->cb = NULL;
+    }
+    QuicStreamSendBufPut(sb);
+    return ret;
+}
+
+static void QuicStreamSendBufDone(QuicStreamSendBuf *sb, bool acked)
+{
+    if (sb->done) {
+        return;
+    }
+
+    sb->done = 1;
+    if (sb->cb != NULL) {
+        sb->cb(sb->id, sb->data, sb->len, acked, sb->arg);
+    }
+}
+
+void QuicStreamSendBufAck(QuicStreamSendBuf *sb, size_t len)
+{
+    assert(QUIC_GE(sb->unacked, len));
+
+    sb->unacked -= len;
+    if (sb->unacked == 0) {
+        QuicStreamSendBufDone(sb, true);
+    }
+}
+
+void QuicStreamSendBufPut(QuicStreamSendBuf *sb)
+{
+    if (--sb->ref != 0) {
+        return;
+    }
+
+    /* Data not all acked, it is never sent again */
+    QuicStreamSendBufDone(sb, false);
+    QuicMemFree(sb);
+}
+
 #if 0
 int QuicStreamWriteV(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t iovcnt)
 {
@@ -383,6 +832,137 @@ int QuicStreamWriteV(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t iovcnt)
 }
 #endif
  
+static QuicStreamData *
+QuicStreamReasmNext(QuicStreamInstance *si, QuicStreamData *prev, int l)
+{
+    struct list_head *n = NULL;
+
+    if (l > 0) {
+        return prev != NULL ? prev->skip[l - 1] : si->skip[l - 1];
+    }
+
+    n = prev != NULL ? prev->node.next : si->queue.next;
+    if (n == &si->queue) {
+        return NULL;
+    }
+
+    return list_entry(n, QuicStreamData, node);
+}
+
+static void QuicStreamReasmSetNext(QuicStreamInstance *si, QuicStreamData *prev,
+                                    int l, QuicStreamData *next)
+{
+    if (prev != NULL) {
+        prev->skip[l - 1] = next;
+    } else {
+        si->skip[l - 1] = next;
+    }
+}
+
+/*
+ * Return the last segment starting at or before @offset, NULL if there is
+ * none. @update gets the last such segment of each level.
+ */
+static QuicStreamData *QuicStreamReasmFind(QuicStreamInstance *si,
+                                int64_t offset, QuicStreamData **update)
+{
+    QuicStreamData *prev = NULL;
+    QuicStreamData *next = NULL;
+    int l = 0;
+
+    for (l = QUIC_STREAM_REASM_LEVEL - 1; l >= 0; l--) {
+        while ((next = QuicStreamReasmNext(si, prev, l)) != NULL &&
+                next->offset <= offset) {
+            prev = next;
+        }
+        update[l] = prev;
+    }
+
+    return prev;
+}
+
+/* @sd must directly follow @update on each of its levels */
+static void QuicStreamReasmUnlink(QuicStreamInstance *si,
+                            QuicStreamData **update, QuicStreamData *sd)
+{
+    int l = 0;
+
+    for (l = 1; l < sd->level; l++) {
+        QuicStreamReasmSetNext(si, update[l], l, sd->skip[l - 1]);
+    }
+
+    list_del(&sd->node);
+    si->reasm_bytes -= sd->len;
+    si->reasm_segs--;
+}
+
+/* Geometric with p = 1/2: one level more for each trailing zero bit */
+static uint8_t QuicStreamReasmLevel(QuicStreamConf *scf)
+{
+    uint64_t x = scf->reasm_rand;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    scf->reasm_rand = x;
+
+    return 1 + __builtin_ctzll(x | (1ULL << (QUIC_STREAM_REASM_LEVEL - 1)));
+}
+
+static void QuicStreamReasmInsert(QuicStreamInstance *si,
+                            QuicStreamData **update, QuicStreamData *sd)
+{
+    QuicStreamData *prev = update[0];
+    int l = 0;
+
+    list_add(&sd->node, prev != NULL ? &prev->node : &si->queue);
+    for (l = 1; l < sd->level; l++) {
+        sd->skip[l - 1] = QuicStreamReasmNext(si, update[l], l);
+        QuicStreamReasmSetNext(si, update[l], l, sd);
+    }
+
+    si->reasm_bytes += sd->len;
+    si->reasm_segs++;
+}
+
+static void QuicStreamReasmConsume(QuicStreamInstance *si, QuicStreamData *sd,
+                                    size_t len)
+{
+    QuicStreamData *update[QUIC_STREAM_REASM_LEVEL] = {};
+
+    if (len < sd->len) {
+        sd->data += len;
+        sd->len -= len;
+        sd->offset += len;
+        si->reasm_bytes -= len;
+        return;
+    }
+
+    /* Always the first segment, no predecessor on any level */
+    QuicStreamReasmUnlink(si, update, sd);
+    QuicStreamDataFree(sd);
+}
+
+static void QuicStreamReadDone(QuicStreamInstance *si, uint32_t *flags)
+{
+    if (list_empty(&si->queue)) {
+        if (si->recv_state == QUIC_STREAM_STATE_DATA_RECVD) {
+            si->recv_state = QUIC_STREAM_STATE_DATA_READ;
+            if (flags != NULL) {
+                *flags |= QUIC_STREAM_DATA_FLAGS_FIN;
+            }
+        }
+    }
+
+    if (si->recv_state == QUIC_STREAM_STATE_RESET_RECVD) {
+        if (flags != NULL) {
+            *flags |= QUIC_STREAM_DATA_FLAGS_RESET;
+        }
+    }
+
+    si->notified = 0;
+}
+
 static int QuicStreamReadData(QuicStreamInstance *si, uint32_t *flags,
                             uint8_t *data, size_t len)
 {
@@ -405,13 +985,7 @@ static int QuicStreamReadData(QuicStreamInstance *si, uint32_t *flags,
         }
 
         QuicMemcpy(&data[rlen], sd->data, copy_bytes);
-        if (copy_bytes == sd->len) {
-            list_del(&sd->node);
-            QuicStreamDataFree(sd);
-        } else {
-            sd->data += copy_bytes;
-            sd->len -= copy_bytes;
-        }
+        QuicStreamReasmConsume(si, sd, copy_bytes);
 
         si->offset += copy_bytes;
         rlen += copy_bytes;
@@ -420,22 +994,7 @@ static int QuicStreamReadData(QuicStreamInstance *si, uint32_t *flags,
         }
     }
 
-    if (list_empty(&si->queue)) {
-        if (si->recv_state == QUIC_STREAM_STATE_DATA_RECVD) {
-            si->recv_state = QUIC_STREAM_STATE_DATA_READ;
-            if (flags != NULL) {
-                *flags |= QUIC_STREAM_DATA_FLAGS_FIN;
-            }
-        }
-    }
-
-    if (si->recv_state == QUIC_STREAM_STATE_RESET_RECVD) {
-        if (flags != NULL) {
-            *flags |= QUIC_STREAM_DATA_FLAGS_RESET;
-        }
-    }
-
-    si->notified = 0;
+    QuicStreamReadDone(si, flags);
     return rlen;
 }
 
@@ -481,7 +1040,7 @@ int QuicStreamRecv(QUIC *quic, QUIC_STREAM_HANDLE h, uint32_t *flags,
     }
 
     rlen = QuicStreamReadData(si, flags, data, len);
-    if (rlen > 0) {
+    if (QuicStreamTryReclaim(quic, si) || rlen > 0) {
         return rlen;
     }
 
@@ -489,7 +1048,126 @@ int QuicStreamRecv(QUIC *quic, QUIC_STREAM_HANDLE h, uint32_t *flags,
         return -1;
     }
 
-    return QuicStreamReadData(si, flags, data, len);
+    /* May have been reclaimed by the ACKs just read */
+    si = QuicStreamGetInstance(quic, h);
+    if (si == NULL) {
+        return 0;
+    }
+
+    rlen = QuicStreamReadData(si, flags, data, len);
+    QuicStreamTryReclaim(quic, si);
+    return rlen;
+}
+
+/* Move whole in order segments to @loan instead of copying them */
+static int QuicStreamLendData(QuicStreamInstance *si, uint32_t *flags,
+                        QUIC_STREAM_IOVEC *iov, size_t iovcnt,
+                        QUIC_STREAM_LOAN *loan)
+{
+    QuicStreamData *update[QUIC_STREAM_REASM_LEVEL] = {};
+    QuicStreamData *sd = NULL;
+    QuicStreamData *n = NULL;
+    int cnt = 0;
+
+    list_for_each_entry_safe(sd, n, &si->queue, node) {
+        if (cnt >= iovcnt || si->offset != sd->offset) {
+            break;
+        }
+
+        QuicStreamReasmUnlink(si, update, sd);
+        list_add_tail(&sd->node, &loan->queue);
+
+        iov[cnt].handle = si->id;
+        iov[cnt].iov_base = (void *)sd->data;
+        iov[cnt].iov_len = sd->len;
+        iov[cnt].data_len = sd->len;
+        iov[cnt].flags = 0;
+
+        si->offset += sd->len;
+        si->lent_bytes += sd->len;
+        loan->bytes += sd->len;
+        cnt++;
+    }
+
+    QuicStreamReadDone(si, flags);
+    if (cnt > 0 && flags != NULL) {
+        iov[cnt - 1].flags = *flags;
+    }
+
+    return cnt;
+}
+
+int QuicStreamRecvBorrow(QUIC *quic, QUIC_STREAM_HANDLE h, uint32_t *flags,
+                            QUIC_STREAM_IOVEC *iov, size_t iovcnt,
+                            QUIC_STREAM_LOAN **loan)
+{
+    QuicStreamInstance *si = NULL;
+    QUIC_STREAM_LOAN *l = NULL;
+    int cnt = 0;
+
+    *loan = NULL;
+    si = QuicStreamGetInstance(quic, h);
+    if (si == NULL) {
+        return -1;
+    }
+
+    l = QuicMemCalloc(sizeof(*l));
+    if (l == NULL) {
+        return -1;
+    }
+
+    l->id = h;
+    INIT_LIST_HEAD(&l->queue);
+
+    cnt = QuicStreamLendData(si, flags, iov, iovcnt, l);
+    if (cnt == 0 && !QuicStreamTryReclaim(quic, si)) {
+        if (QuicStreamRecvNew(quic) < 0) {
+            QuicMemFree(l);
+            return -1;
+        }
+
+        si = QuicStreamGetInstance(quic, h);
+        if (si != NULL) {
+            cnt = QuicStreamLendData(si, flags, iov, iovcnt, l);
+            QuicStreamTryReclaim(quic, si);
+        }
+    }
+
+    if (cnt == 0) {
+        QuicMemFree(l);
+        return 0;
+    }
+
+    *loan = l;
+    return cnt;
+}
+
+void QuicStreamRecvRelease(QUIC *quic, QUIC_STREAM_LOAN *loan)
+{
+    QuicStreamInstance *si = NULL;
+    QuicStreamData *sd = NULL;
+    QuicStreamData *n = NULL;
+
+    if (loan == NULL) {
+        return;
+    }
+
+    list_for_each_entry_safe(sd, n, &loan->queue, node) {
+        list_del(&sd->node);
+        QuicStreamDataFree(sd);
+    }
+
+    /* Not reclaimed while lent, the budget goes back to it */
+    if (quic->stream.bucket != NULL) {
+        si = QuicStreamFind(&quic->stream, loan->id);
+    }
+
+    if (si != NULL) {
+        si->lent_bytes -= loan->bytes;
+        QuicStreamTryReclaim(quic, si);
+    }
+
+    QuicMemFree(loan);
 }
 
 int QuicStreamReadV(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t iovcnt)
@@ -504,7 +1182,7 @@ int QuicStreamReadV(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t iovcnt)
     int cnt = 0;
     int rlen = 0;
 
-    if (scf->stream == NULL) {
+    if (scf->bucket == NULL) {
         return -1;
     }
 
@@ -542,7 +1220,7 @@ int QuicStreamReadV(QUIC *quic, QUIC_STREAM_IOVEC *iov, size_t iovcnt)
                 cnt++;
             }
 
-            if (rlen < iov_cur->iov_len) {
+            if (QuicStreamTryReclaim(quic, si) || rlen < iov_cur->iov_len) {
                 break;
             }
         }
@@ -568,6 +1246,23 @@ int QuicStreamInit(QUIC *quic)
                                 quic->quic_server);
 }
 
+/*
+ * The streams were opened for 0-RTT with the remembered parameters, take
+ * the limits from the ones the peer has just sent.
+ */
+void QuicStreamLimitUpdate(QUIC *quic)
+{
+    QuicTransParams *local = &quic->tls.ext.trans_param;
+    QuicTransParams *peer = &quic->peer_param;
+
+    QuicStreamConfMaxIdSet(&quic->stream,
+            QUIC_MAX(local->initial_max_stream_bidi,
+                    peer->initial_max_stream_bidi),
+            QUIC_MAX(local->initial_max_stream_uni,
+                    peer->initial_max_stream_uni),
+            quic->quic_server);
+}
+
 QuicStreamData *QuicStreamDataCreate(void *origin_buf, int64_t offset,
                                         const void *data, size_t len)
 {
@@ -667,78 +1362,174 @@ int QuicStreamSendFlowCtrl(QUIC *quic, int64_t id, size_t len,
     return 0;
 }
 
-static void QuicStreamDataAddOfo(QUIC *quic, QuicStreamData *sd,
-                            QuicStreamInstance *si)
+static void QuicStreamDataTrimFront(QuicStreamData *sd, int64_t offset)
 {
-    if (QuicStreamRecvFlowCtrl(quic, si, sd->len) < 0) {
-        QUIC_LOG("Drop because of flow control\n");
-        QuicStreamDataFree(sd);
-        return;
+    int64_t trim = offset - sd->offset;
+
+    sd->data += trim;
+    sd->len -= trim;
+    sd->offset = offset;
+}
+
+/* Bytes of [@start, @end) not covered by the segments from @next on */
+static uint64_t QuicStreamReasmNewBytes(QuicStreamInstance *si,
+                            QuicStreamData *next, int64_t start, int64_t end)
+{
+    uint64_t covered = 0;
+
+    for (; next != NULL && next->offset < end;
+            next = QuicStreamReasmNext(si, next, 0)) {
+        covered += QUIC_MIN(end, next->offset + (int64_t)next->len) -
+                    next->offset;
     }
 
-    list_add_tail(&sd->node, &si->queue);
+    return end - start - covered;
 }
 
-static bool QuicStreamOrdered(QuicStreamInstance *si)
+static void QuicStreamRecvAdvance(QuicStreamInstance *si, QuicStreamData *sd)
 {
-    QuicStreamData *sd = NULL;
-    bool ordered = true;
-    int64_t start = si->offset;
+    if (si->contig < si->offset) {
+        si->contig = si->offset;
+    }
 
-    list_for_each_entry(sd, &si->queue, node) {
-        if (start != sd->offset) {
-            ordered = false;
-            break;
+    for (; sd != NULL && sd->offset == si->contig;
+            sd = QuicStreamReasmNext(si, sd, 0)) {
+        si->contig = sd->offset + sd->len;
+    }
+}
+
+static void QuicStreamRecvComplete(QuicStreamInstance *si)
+{
+    QuicStreamData *last = NULL;
+
+    if (si->recv_state == QUIC_STREAM_STATE_SIZE_KNOWN) {
+        if (si->contig == si->final_size) {
+            si->recv_state = QUIC_STREAM_STATE_DATA_RECVD;
         }
+        return;
+    }
 
-        start = sd->offset + sd->len;
+    if (si->recv_state != QUIC_STREAM_STATE_RESET_RECVD) {
+        return;
+    }
+
+    if (!list_empty(&si->queue)) {
+        last = list_last_entry(&si->queue, QuicStreamData, node);
+        if (si->contig != last->offset + last->len) {
+            return;
+        }
     }
 
-    return ordered;
+    si->recv_state = QUIC_STREAM_STATE_DATA_RECVD;
 }
 
+/*
+ * A small out of order segment would keep its whole datagram alive while
+ * it waits for the gap, so it gets a buffer of its own. If that fails the
+ * datagram is kept.
+ */
+static void QuicStreamDataCompact(QuicStreamData *sd)
+{
+    QUIC_DATA_BUF *origin = sd->origin_buf;
+    QUIC_DATA_BUF *buf = NULL;
+
+    if (sd->len*2 >= origin->buf.len) {
+        return;
+    }
+
+    buf = QuicDataBufCreate(sd->len);
+    if (buf == NULL) {
+        return;
+    }
+
+    QuicMemcpy(buf->buf.data, sd->data, sd->len);
+    QuicDataBufFree(origin);
+    sd->origin_buf = buf;
+    sd->data = buf->buf.data;
+}
+
+/*
+ * Segments are kept sorted and disjoint: the part of @sd already queued
+ * is trimmed, queued segments inside @sd are replaced by it and one
+ * overlapping its end loses its front.
+ */
 void QuicStreamDataAdd(QUIC *quic, QuicStreamData *sd,
                     QuicStreamInstance *si)
 {
+    QuicStreamData *update[QUIC_STREAM_REASM_LEVEL] = {};
+    QuicStreamData *prev = NULL;
+    QuicStreamData *next = NULL;
     int64_t start = sd->offset;
     int64_t end = sd->offset + sd->len;
-    int64_t offset = 0;
+    int64_t prev_end = 0;
+    uint64_t new_bytes = 0;
 
     if (si->offset >= end){
         //Retransmitted
         QUIC_LOG("Retransmitted\n");
-        QuicStreamDataFree(sd);
-        return;
-    }
-
-    if (si->offset < start) {
-        //Out of Order
-        QuicStreamDataAddOfo(quic, sd, si);
-        return;
+        goto drop;
     }
 
     if (si->offset > start) {
         //Overlap
-        offset = si->offset - start;
-        sd->data += offset;
-        sd->len -= offset;
-        sd->offset = si->offset;
+        QuicStreamDataTrimFront(sd, si->offset);
+        start = si->offset;
     }
 
-    if (QuicStreamRecvFlowCtrl(quic, si, sd->len) < 0) {
-        QUIC_LOG("Drop because of flow control\n");
-        QuicStreamDataFree(sd);
-        return;
+    prev = QuicStreamReasmFind(si, start, update);
+    if (prev != NULL) {
+        prev_end = prev->offset + prev->len;
+        if (prev_end >= end) {
+            QUIC_LOG("Retransmitted\n");
+            goto drop;
+        }
+
+        if (prev_end > start) {
+            QuicStreamDataTrimFront(sd, prev_end);
+            start = prev_end;
+        }
     }
 
-    list_add_tail(&sd->node, &si->queue);
+    next = QuicStreamReasmNext(si, prev, 0);
+    new_bytes = QuicStreamReasmNewBytes(si, next, start, end);
+    if (new_bytes == 0) {
+        QUIC_LOG("Retransmitted\n");
+        goto drop;
+    }
 
-    if (si->recv_state == QUIC_STREAM_STATE_SIZE_KNOWN ||
-            si->recv_state == QUIC_STREAM_STATE_RESET_RECVD) {
-        if (QuicStreamOrdered(si)) {
-            si->recv_state = QUIC_STREAM_STATE_DATA_RECVD;
+    /*
+     * The stream window bounds the data queued here, anything inside it
+     * has to be kept since it will be acknowledged.
+     */
+    if (QuicStreamRecvFlowCtrl(quic, si, new_bytes) < 0) {
+        QUIC_LOG("Drop because of flow control\n");
+        goto drop;
+    }
+
+    while (next != NULL && next->offset < end) {
+        if (next->offset + next->len > end) {
+            si->reasm_bytes -= end - next->offset;
+            QuicStreamDataTrimFront(next, end);
+            break;
         }
+
+        QuicStreamReasmUnlink(si, update, next);
+        QuicStreamDataFree(next);
+        next = QuicStreamReasmNext(si, prev, 0);
+    }
+
+    if (start != si->contig) {
+        QuicStreamDataCompact(sd);
     }
+    sd->level = QuicStreamReasmLevel(&quic->stream);
+    QuicStreamReasmInsert(si, update, sd);
+    QuicStreamRecvAdvance(si, sd);
+    QuicStreamRecvComplete(si);
+    return;
+
+drop:
+    QuicStreamDataFree(sd);
+    QuicStreamRecvComplete(si);
 }
 
 void QuicStreamDataFree(QuicStreamData *sd)
@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include <tbquic/types.h>
+#include <tbquic/stream.h>
 #include "base.h"
 #include "list.h"
 
@@ -14,6 +15,12 @@
 
 #define QUIC_STREAM_IS_UNI(id) (id & QUIC_STREAM_UNIDIRECTIONAL)
 
+#define QUIC_STREAM_HASH_SIZE               16
+#define QUIC_STREAM_SLAB_SIZE               16
+#define QUIC_STREAM_CLOSED_RANGES           4
+/* Skip list levels of the reassembly queue, level 0 is the queue itself */
+#define QUIC_STREAM_REASM_LEVEL             8
+
 enum {
 	QUIC_STREAM_STATE_DISABLE = 0,
 	QUIC_STREAM_STATE_START,
@@ -35,25 +42,74 @@ enum {
     QUIC_STREAM_MSG_TYPE_MAX,
 };
 
-typedef struct {
+typedef struct QuicStreamInstance QuicStreamInstance;
+typedef struct QuicStreamData QuicStreamData;
+
+struct QuicStreamInstance {
+    /* Hash chain while in use, free list after reclaimed */
+    QuicStreamInstance *next;
+    int64_t id;
     uint64_t recv_state:4;
     uint64_t send_state:4;
     uint64_t notified:1;
     uint64_t local_opened:1;
     uint64_t uni:1;
     uint64_t max_stream_data;
+    /* Offset of the next byte put in a STREAM frame */
+    uint64_t send_offset;
     QuicDataStat stat_bytes;
     int64_t offset;
+    /* End of the data contiguous from @offset */
+    int64_t contig;
+    /* Offset and length of the FIN frame, valid once SIZE_KNOWN */
+    int64_t final_size;
+    uint64_t reasm_bytes;
+    uint32_t reasm_segs;
+    /*
+     * Lent to the application, the stream is kept until it is given back.
+     * Never charged against incoming data, the window already bounds it.
+     */
+    uint64_t lent_bytes;
+    /* Segments sorted by offset, never overlapping */
     struct list_head queue;
-} QuicStreamInstance;
+    QuicStreamData *skip[QUIC_STREAM_REASM_LEVEL - 1];
+};
+
+typedef struct {
+    struct list_head node;
+    QuicStreamInstance inst[QUIC_STREAM_SLAB_SIZE];
+} QuicStreamSlab;
+
+/* Stream indexes [@start, @end) */
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+} QuicStreamRange;
+
+/*
+ * Peer streams that were reclaimed, as sorted ranges that neither overlap
+ * nor touch. There is one range more than the gaps of still open streams.
+ */
+typedef struct {
+    QuicStreamRange *range;
+    uint32_t num;
+    uint32_t size;
+} QuicStreamClosed;
 
 typedef struct {
     QuicDataStat stat_all;
     uint64_t bidi_id_alloced;
     uint64_t uni_id_alloced;
-    uint64_t max_id_opened;
     uint64_t max_id_value;
-    QuicStreamInstance *stream;
+    /* Instances in use, indexed by stream ID */
+    QuicStreamInstance **bucket;
+    uint64_t bucket_mask;
+    uint64_t num;
+    QuicStreamInstance *free;
+    struct list_head slab;
+    QuicStreamClosed closed[2];
+    /* xorshift state for the reassembly skip list levels */
+    uint64_t reasm_rand;
     struct list_head msg_queue;
 } QuicStreamConf;
 
@@ -63,17 +119,40 @@ typedef struct {
     int64_t id;
 } QuicStreamMsg;
 
-typedef struct {
+struct QuicStreamLoan {
+    int64_t id;
+    uint64_t bytes;
+    struct list_head queue;
+};
+
+/* Application buffer sent without copy, referenced by the QBUFFs */
+typedef struct QuicStreamSendBuf {
+    uint32_t ref;
+    uint32_t done:1;
+    int64_t id;
+    void *data;
+    size_t len;
+    uint64_t unacked;
+    QUIC_STREAM_SEND_CB cb;
+    void *arg;
+} QuicStreamSendBuf;
+
+struct QuicStreamData {
     struct list_head node;
+    QuicStreamData *skip[QUIC_STREAM_REASM_LEVEL - 1];
+    uint8_t level;
     int64_t offset;
     const void *data;
     size_t len;
     void *origin_buf;
-} QuicStreamData;
+};
 
 int QuicStreamInit(QUIC *);
+void QuicStreamLimitUpdate(QUIC *);
 void QuicStreamConfDeInit(QuicStreamConf *);
 QuicStreamInstance *QuicStreamGetInstance(QUIC *, QUIC_STREAM_HANDLE);
+bool QuicStreamTryReclaim(QUIC *, QuicStreamInstance *);
+bool QuicStreamIdClosed(QUIC *, int64_t);
 QuicStreamData *QuicStreamDataCreate(void *, int64_t, const void *, size_t);
 void QuicStreamDataAdd(QUIC *, QuicStreamData *, QuicStreamInstance *);
 void QuicStreamDataFree(QuicStreamData *);
@@ -82,5 +161,7 @@ void QuicStreamMsgAdd(QuicStreamConf *, QuicStreamMsg *);
 void QuicStreamMsgFree(QuicStreamMsg *);
 void QuicStreamDataCount(QuicStreamConf *, uint64_t, bool, bool);
 int QuicStreamSendFlowCtrl(QUIC *, int64_t, size_t, uint32_t);
+void QuicStreamSendBufAck(QuicStreamSendBuf *, size_t);
+void QuicStreamSendBufPut(QuicStreamSendBuf *);
 
 #endif
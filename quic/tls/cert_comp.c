@@ -0,0 +1,260 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ * RFC 8879 TLS Certificate Compression
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cert_comp.h"
+
+#include <tbquic/tls.h>
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#define TLS_CERT_COMP_USE_ZLIB
+#endif
+#if defined(HAVE_LIBBROTLIENC) && defined(HAVE_LIBBROTLIDEC) && \
+    defined(HAVE_BROTLI_ENCODE_H) && defined(HAVE_BROTLI_DECODE_H)
+#include <brotli/encode.h>
+#include <brotli/decode.h>
+#define TLS_CERT_COMP_USE_BROTLI
+#endif
+#if defined(HAVE_LIBZSTD) && defined(HAVE_ZSTD_H)
+#include <zstd.h>
+#define TLS_CERT_COMP_USE_ZSTD
+#endif
+
+#include "quic_local.h"
+#include "base.h"
+#include "mem.h"
+#include "log.h"
+
+bool TlsCertCompSupported(uint16_t alg)
+{
+    switch (alg) {
+#ifdef TLS_CERT_COMP_USE_ZLIB
+        case TLSEXT_CERT_COMP_ZLIB:
+            return true;
+#endif
+#ifdef TLS_CERT_COMP_USE_BROTLI
+        case TLSEXT_CERT_COMP_BROTLI:
+            return true;
+#endif
+#ifdef TLS_CERT_COMP_USE_ZSTD
+        case TLSEXT_CERT_COMP_ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+int TlsCertCompress(uint16_t alg, const uint8_t *in, size_t len,
+                        uint8_t **out, size_t *outlen)
+{
+    uint8_t *buf = NULL;
+    size_t blen = 0;
+
+    switch (alg) {
+#ifdef TLS_CERT_COMP_USE_ZLIB
+        case TLSEXT_CERT_COMP_ZLIB: {
+            uLongf zlen = compressBound(len);
+
+            buf = QuicMemMalloc(zlen);
+            if (buf == NULL) {
+                return -1;
+            }
+
+            if (compress2(buf, &zlen, in, len, Z_BEST_COMPRESSION) != Z_OK) {
+                QuicMemFree(buf);
+                return -1;
+            }
+            blen = zlen;
+            break;
+        }
+#endif
+#ifdef TLS_CERT_COMP_USE_BROTLI
+        case TLSEXT_CERT_COMP_BROTLI:
+            blen = BrotliEncoderMaxCompressedSize(len);
+            if (blen == 0) {
+                return -1;
+            }
+
+            buf = QuicMemMalloc(blen);
+            if (buf == NULL) {
+                return -1;
+            }
+
+            if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY,
+                        BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, len, in,
+                        &blen, buf)) {
+                QuicMemFree(buf);
+                return -1;
+            }
+            break;
+#endif
+#ifdef TLS_CERT_COMP_USE_ZSTD
+        case TLSEXT_CERT_COMP_ZSTD:
+            blen = ZSTD_compressBound(len);
+            buf = QuicMemMalloc(blen);
+            if (buf == NULL) {
+                return -1;
+            }
+
+            blen = ZSTD_compress(buf, blen, in, len, ZSTD_maxCLevel());
+            if (ZSTD_isError(blen)) {
+                QuicMemFree(buf);
+                return -1;
+            }
+            break;
+#endif
+        default:
+            QUIC_LOG("Unsupported compression algorithm %u\n", alg);
+            return -1;
+    }
+
+    *out = buf;
+    *outlen = blen;
+    return 0;
+}
+
+/*
+ * The output must be exactly @outlen bytes, never write beyond it.
+ */
+int TlsCertDecompress(uint16_t alg, const uint8_t *in, size_t len,
+                        uint8_t *out, size_t outlen)
+{
+    switch (alg) {
+#ifdef TLS_CERT_COMP_USE_ZLIB
+        case TLSEXT_CERT_COMP_ZLIB: {
+            uLongf zlen = outlen;
+
+            if (uncompress(out, &zlen, in, len) != Z_OK || zlen != outlen) {
+                return -1;
+            }
+            return 0;
+        }
+#endif
+#ifdef TLS_CERT_COMP_USE_BROTLI
+        case TLSEXT_CERT_COMP_BROTLI: {
+            size_t blen = outlen;
+
+            if (BrotliDecoderDecompress(len, in, &blen, out) !=
+                    BROTLI_DECODER_RESULT_SUCCESS || blen != outlen) {
+                return -1;
+            }
+            return 0;
+        }
+#endif
+#ifdef TLS_CERT_COMP_USE_ZSTD
+        case TLSEXT_CERT_COMP_ZSTD: {
+            size_t zslen = ZSTD_decompress(out, outlen, in, len);
+
+            if (ZSTD_isError(zslen) || zslen != outlen) {
+                return -1;
+            }
+            return 0;
+        }
+#endif
+        default:
+            return -1;
+    }
+}
+
+static bool TlsCertCompOffered(TLS *s, uint16_t alg)
+{
+    const QUIC_DATA *algs = &QuicTlsTrans(s)->ctx->ext.cert_comp_algs;
+    size_t i = 0;
+
+    for (i = 0; i < algs->len; i++) {
+        if (algs->ptr_u16[i] == alg) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Parse a CompressedCertificate message and return the Certificate message
+ * body in @out, which must be freed by the caller.
+ */
+int TlsCertDecompressMsg(TLS *s, RPacket *pkt, uint8_t **out, size_t *outlen)
+{
+    const uint8_t *data = NULL;
+    uint8_t *buf = NULL;
+    uint32_t alg = 0;
+    uint32_t uncompressed_len = 0;
+    uint32_t len = 0;
+
+    if (RPacketGet2(pkt, &alg) < 0) {
+        return -1;
+    }
+
+    if (!TlsCertCompOffered(s, alg)) {
+        QUIC_LOG("Compression algorithm %u not offered\n", alg);
+        return -1;
+    }
+
+    if (RPacketGet3(pkt, &uncompressed_len) < 0) {
+        return -1;
+    }
+
+    if (uncompressed_len == 0 || uncompressed_len > TLS_CERT_COMP_MAX_LEN) {
+        QUIC_LOG("Bad uncompressed length %u\n", uncompressed_len);
+        return -1;
+    }
+
+    if (RPacketGet3(pkt, &len) < 0) {
+        return -1;
+    }
+
+    if (len == 0 || RPacketRemaining(pkt) != len) {
+        return -1;
+    }
+
+    if (RPacketGetBytes(pkt, &data, len) < 0) {
+        return -1;
+    }
+
+    buf = QuicMemMalloc(uncompressed_len);
+    if (buf == NULL) {
+        return -1;
+    }
+
+    if (TlsCertDecompress(alg, data, len, buf, uncompressed_len) < 0) {
+        QUIC_LOG("Decompress certificate failed\n");
+        QuicMemFree(buf);
+        return -1;
+    }
+
+    *out = buf;
+    *outlen = uncompressed_len;
+    return 0;
+}
+
+int TlsSetCertCompression(QUIC_DATA *algs, const uint16_t *list, size_t num)
+{
+    uint16_t *dup = NULL;
+    size_t i = 0;
+
+    for (i = 0; i < num; i++) {
+        if (!TlsCertCompSupported(list[i])) {
+            return -1;
+        }
+    }
+
+    if (num != 0) {
+        dup = QuicMemDup(list, num * sizeof(*list));
+        if (dup == NULL) {
+            return -1;
+        }
+    }
+
+    QuicDataFree(algs);
+    algs->ptr_u16 = dup;
+    algs->len = num;
+    return 0;
+}
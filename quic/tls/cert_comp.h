@@ -0,0 +1,20 @@
+#ifndef TBQUIC_QUIC_TLS_CERT_COMP_H_
+#define TBQUIC_QUIC_TLS_CERT_COMP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "tls.h"
+#include "packet_local.h"
+
+/* Largest Certificate message accepted after decompression */
+#define TLS_CERT_COMP_MAX_LEN   (1 << 17)
+
+bool TlsCertCompSupported(uint16_t);
+int TlsCertCompress(uint16_t, const uint8_t *, size_t, uint8_t **, size_t *);
+int TlsCertDecompress(uint16_t, const uint8_t *, size_t, uint8_t *, size_t);
+int TlsCertDecompressMsg(TLS *, RPacket *, uint8_t **, size_t *);
+int TlsSetCertCompression(QUIC_DATA *, const uint16_t *, size_t);
+
+#endif
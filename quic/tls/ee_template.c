@@ -0,0 +1,151 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "ee_template.h"
+
+#include <string.h>
+
+#include "mem.h"
+#include "log.h"
+
+static bool TlsEeTemplateMatch(const TlsEeTemplate *tmpl,
+                                const QUIC_DATA *alpn, bool early_data,
+                                uint8_t cid_len)
+{
+    return tmpl->early_data == early_data && tmpl->cid_len == cid_len &&
+            QuicDataEq(&tmpl->alpn, alpn);
+}
+
+void TlsEeTemplateCacheInit(TlsEeTemplateCache *cache)
+{
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->num = 0;
+}
+
+void TlsEeTemplateCacheFree(TlsEeTemplateCache *cache)
+{
+    size_t i = 0;
+
+    for (i = 0; i < cache->num; i++) {
+        TlsEeTemplateFree(cache->tmpl[i]);
+    }
+
+    cache->num = 0;
+    pthread_mutex_destroy(&cache->lock);
+}
+
+TlsEeTemplate *TlsEeTemplateNew(const QUIC_DATA *alpn, bool early_data,
+                                uint8_t cid_len)
+{
+    TlsEeTemplate *tmpl = NULL;
+
+    tmpl = QuicMemCalloc(sizeof(*tmpl));
+    if (tmpl == NULL) {
+        return NULL;
+    }
+
+    if (!QuicDataIsEmpty(alpn) && QuicDataDup(&tmpl->alpn, alpn) < 0) {
+        QuicMemFree(tmpl);
+        return NULL;
+    }
+
+    tmpl->early_data = early_data;
+    tmpl->cid_len = cid_len;
+
+    return tmpl;
+}
+
+void TlsEeTemplateFree(TlsEeTemplate *tmpl)
+{
+    if (tmpl == NULL) {
+        return;
+    }
+
+    QuicDataFree(&tmpl->alpn);
+    QuicMemFree(tmpl);
+}
+
+TlsEeTemplate *TlsEeTemplateFind(TlsEeTemplateCache *cache,
+                                    const QUIC_DATA *alpn, bool early_data,
+                                    uint8_t cid_len)
+{
+    TlsEeTemplate *tmpl = NULL;
+    size_t i = 0;
+
+    pthread_mutex_lock(&cache->lock);
+    for (i = 0; i < cache->num; i++) {
+        if (TlsEeTemplateMatch(cache->tmpl[i], alpn, early_data, cid_len)) {
+            tmpl = cache->tmpl[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return tmpl;
+}
+
+/*
+ * Templates are never removed before the cache is freed, so the ones
+ * found can be used without holding the lock. Return -1 if @tmpl was not
+ * taken (full or raced with another connection), the caller still owns it
+ * then.
+ */
+int TlsEeTemplateAdd(TlsEeTemplateCache *cache, TlsEeTemplate *tmpl)
+{
+    size_t i = 0;
+    int ret = -1;
+
+    pthread_mutex_lock(&cache->lock);
+    for (i = 0; i < cache->num; i++) {
+        if (TlsEeTemplateMatch(cache->tmpl[i], &tmpl->alpn, tmpl->early_data,
+                    tmpl->cid_len)) {
+            goto out;
+        }
+    }
+
+    if (cache->num < TLS_EE_TEMPLATE_MAX) {
+        cache->tmpl[cache->num++] = tmpl;
+        ret = 0;
+    }
+out:
+    pthread_mutex_unlock(&cache->lock);
+    return ret;
+}
+
+int TlsEeTemplatePatchAdd(TlsEeTemplate *tmpl, size_t offset)
+{
+    if (tmpl->patch_num >= TLS_EE_TEMPLATE_PATCH_MAX ||
+            offset + tmpl->cid_len > sizeof(tmpl->data)) {
+        return -1;
+    }
+
+    tmpl->patch[tmpl->patch_num++] = offset;
+    return 0;
+}
+
+int TlsEeTemplateWrite(const TlsEeTemplate *tmpl, WPacket *pkt,
+                        const QUIC_DATA *cid)
+{
+    uint8_t *dest = NULL;
+    size_t i = 0;
+
+    if (cid->len != tmpl->cid_len) {
+        return -1;
+    }
+
+    if (WPacketAllocateBytes(pkt, tmpl->len, &dest) < 0) {
+        return -1;
+    }
+
+    memcpy(dest, tmpl->data, tmpl->len);
+    if (cid->len == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < tmpl->patch_num; i++) {
+        memcpy(&dest[tmpl->patch[i]], cid->data, cid->len);
+    }
+
+    return 0;
+}
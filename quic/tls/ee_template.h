@@ -0,0 +1,48 @@
+#ifndef TBQUIC_QUIC_TLS_EE_TEMPLATE_H_
+#define TBQUIC_QUIC_TLS_EE_TEMPLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <tbquic/types.h>
+
+#include "base.h"
+#include "packet_local.h"
+
+#define TLS_EE_TEMPLATE_MAX         8
+#define TLS_EE_TEMPLATE_LEN_MAX     512
+/* original_destination_connection_id and initial_source_connection_id */
+#define TLS_EE_TEMPLATE_PATCH_MAX   2
+
+/*
+ * EncryptedExtensions block serialised once per ALPN choice, only the
+ * server CID differs between connections and is patched in at @patch.
+ */
+typedef struct {
+    QUIC_DATA alpn;
+    bool early_data;
+    uint8_t cid_len;
+    uint8_t patch_num;
+    uint16_t patch[TLS_EE_TEMPLATE_PATCH_MAX];
+    size_t len;
+    uint8_t data[TLS_EE_TEMPLATE_LEN_MAX];
+} TlsEeTemplate;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t num;
+    TlsEeTemplate *tmpl[TLS_EE_TEMPLATE_MAX];
+} TlsEeTemplateCache;
+
+void TlsEeTemplateCacheInit(TlsEeTemplateCache *);
+void TlsEeTemplateCacheFree(TlsEeTemplateCache *);
+TlsEeTemplate *TlsEeTemplateNew(const QUIC_DATA *, bool, uint8_t);
+void TlsEeTemplateFree(TlsEeTemplate *);
+TlsEeTemplate *TlsEeTemplateFind(TlsEeTemplateCache *, const QUIC_DATA *,
+                                    bool, uint8_t);
+int TlsEeTemplateAdd(TlsEeTemplateCache *, TlsEeTemplate *);
+int TlsEeTemplatePatchAdd(TlsEeTemplate *, size_t);
+int TlsEeTemplateWrite(const TlsEeTemplate *, WPacket *, const QUIC_DATA *);
+
+#endif
@@ -5,6 +5,7 @@
 #include "extension.h"
 
 #include "format.h"
+#include "mem.h"
 #include "quic_local.h"
 #include "common.h"
 #include "log.h"
@@ -137,62 +138,166 @@ TlsFindExtParser(uint32_t type, const TlsExtParse *ext, size_t num)
 }
 #endif
  
+/*
+ * A block of @len bytes holds at most @len / @min_len types not indexed,
+ * keep the table at most half full.
+ */
+static int TlsExtSeenInit(TlsExtSeen *seen, size_t len, size_t min_len)
+{
+    size_t num = len / min_len;
+    uint32_t bits = TLSEXT_SEEN_INLINE_BITS;
+
+    while ((1ULL << bits) < 2 * num) {
+        bits++;
+    }
+
+    seen->low = 0;
+    seen->high_bits = bits;
+    if (bits == TLSEXT_SEEN_INLINE_BITS) {
+        seen->high = seen->high_inline;
+        QuicMemset(seen->high, 0, sizeof(seen->high_inline));
+        return 0;
+    }
+
+    seen->high = QuicMemCalloc(sizeof(*seen->high) << bits);
+    if (seen->high == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void TlsExtSeenFree(TlsExtSeen *seen)
+{
+    if (seen->high != seen->high_inline) {
+        QuicMemFree(seen->high);
+    }
+    seen->high = NULL;
+}
+
+/*
+ * Mark @type met, -1 if it was already. RFC 8446 4.2 and RFC 9000 7.4
+ * allow each one only once.
+ */
+static int TlsExtSeenAdd(TlsExtSeen *seen, uint64_t type, uint64_t index_max)
+{
+    uint64_t mask = (1ULL << seen->high_bits) - 1;
+    uint64_t i = 0;
+
+    if (type < index_max) {
+        if (seen->low & (1ULL << type)) {
+            return -1;
+        }
+        seen->low |= 1ULL << type;
+        return 0;
+    }
+
+    /* GREASE values differ in the high bits, hash them down */
+    i = (type * 0x9E3779B97F4A7C15ULL) >> (64 - seen->high_bits);
+    while (seen->high[i] != 0) {
+        if (seen->high[i] == type) {
+            return -1;
+        }
+        i = (i + 1) & mask;
+    }
+
+    seen->high[i] = type;
+    return 0;
+}
+
+static bool TlsExtSeenLow(TlsExtSeen *seen, uint64_t type)
+{
+    return !!(seen->low & (1ULL << type));
+}
+
+/*
+ * Walk the extension block once and remember where each extension is,
+ * then call the parsers in table order since some of them depend on the
+ * ones before (e.g. early_data is checked by the pre_shared_key parser).
+ * An empty body is passed on like any other: early_data and the server's
+ * server_name have nothing else, parsers of the rest fail on it.
+ */
 int TlsParseExtensions(TLS *s, RPacket *pkt, uint32_t context, X509 *x,
                         size_t chainidx, const TlsExtParse *ext,
                         size_t num)
 {
     const TlsExtParse *thisexd = NULL;
-    RPacket tmp = {};
+    RPacket found[TLSEXT_TYPE_INDEX_MAX];
     RPacket ext_data = {};
+    TlsExtSeen seen = {};
     size_t i = 0;
     uint32_t type = 0;
+    uint32_t last = 0;
     uint32_t len = 0;
-    int ret = 0;
+    int ret = -1;
 
     if (TlsExtLenParse(pkt) < 0) {
         return -1;
     }
 
+    if (TlsExtSeenInit(&seen, RPacketRemaining(pkt),
+                TLSEXT_SEEN_EXT_MIN_LEN) < 0) {
+        return -1;
+    }
+
+    while (RPacketRemaining(pkt)) {
+        if (RPacketGet2(pkt, &type) < 0) {
+            goto out;
+        }
+
+        if (RPacketGet2(pkt, &len) < 0) {
+            goto out;
+        }
+
+        if (RPacketRemaining(pkt) < len) {
+            goto out;
+        }
+
+        last = type;
+        if (TlsExtSeenAdd(&seen, type, TLSEXT_TYPE_INDEX_MAX) < 0) {
+            QUIC_LOG("Duplicate extension %u\n", type);
+            goto out;
+        }
+
+        if (type < TLSEXT_TYPE_INDEX_MAX) {
+            RPacketBufInit(&found[type], RPacketData(pkt), len);
+            RPacketHeadSet(&found[type], RPacketHead(pkt));
+        }
+
+        RPacketPull(pkt, len);
+    }
+
+    /* RFC 8446 4.2.11, pre_shared_key must be the last one */
+    if ((context & TLSEXT_CLIENT_HELLO) &&
+            TlsExtSeenLow(&seen, EXT_TYPE_PRE_SHARED_KEY) &&
+            last != EXT_TYPE_PRE_SHARED_KEY) {
+        QUIC_LOG("PSK extension is not the last one\n");
+        goto out;
+    }
+
     for (i = 0; i < num; i++) {
-        tmp = *pkt;
         thisexd = ext + i;
         /* Skip if not relevant for our context */
         if (!TlsShouldParseExtension(s, thisexd->context, context)) {
             continue;
         }
 
-        while (RPacketRemaining(&tmp)) {
-            if (RPacketGet2(&tmp, &type) < 0) {
-                return -1;
-            }
-
-            if (RPacketGet2(&tmp, &len) < 0) {
-                return -1;
-            }
-
-            if (len == 0) {
-                continue;
-            }
-
-            if (type != thisexd->type) {
-                RPacketPull(&tmp, len);
-                continue;
-            }
-
-            RPacketBufInit(&ext_data, RPacketData(&tmp), len);
-            RPacketHeadSet(&ext_data, RPacketHead(&tmp));
-            ret = thisexd->parse(s, &ext_data, context, x, chainidx);
-            if (ret < 0) {
-                QUIC_LOG("Parse %u failed\n", type);
-                return -1;
-            }
+        type = thisexd->type;
+        if (type >= TLSEXT_TYPE_INDEX_MAX || !TlsExtSeenLow(&seen, type)) {
+            continue;
+        }
 
-            break;
+        ext_data = found[type];
+        if (thisexd->parse(s, &ext_data, context, x, chainidx) < 0) {
+            QUIC_LOG("Parse %u failed\n", type);
+            goto out;
         }
     }
 
-    RPacketPull(pkt, RPacketRemaining(pkt));
-    return 0;
+    ret = 0;
+out:
+    TlsExtSeenFree(&seen);
+    return ret;
 }
 
 #ifdef QUIC_TEST
@@ -258,57 +363,96 @@ TlsExtQtpConstructSourceConnId(TLS *s, QuicTransParams *param, size_t offset,
     QUIC *quic = NULL;
 
     quic = QuicTlsTrans(s);
+    if (s->ext.ee_template == NULL) {
+        return TlsExtQtpConstructCid(&quic->scid, pkt);
+    }
 
-    return TlsExtQtpConstructCid(&quic->scid, pkt);
+    if (QuicVariableLengthWrite(pkt, quic->scid.len) < 0) {
+        return -1;
+    }
+
+    /* Remember where the CID goes, each connection patches in its own */
+    if (TlsEeTemplatePatchAdd(s->ext.ee_template,
+                WPacket_get_written(pkt)) < 0) {
+        return -1;
+    }
+
+    if (quic->scid.len == 0) {
+        return 0;
+    }
+
+    return WPacketMemcpy(pkt, quic->scid.data, quic->scid.len);
 }
 
 int TlsParseQtpExtension(TLS *s,  RPacket *pkt, const TlsExtQtpDefinition *tp,
                             size_t num)
 {
+    const TlsExtQtpDefinition *index[TLSEXT_QTP_TYPE_INDEX_MAX] = {};
     const TlsExtQtpDefinition *p = NULL;
     QUIC *quic = QuicTlsTrans(s);
     QuicTransParams *param = NULL;
+    TlsExtSeen seen = {};
     uint64_t type = 0;
     uint64_t len = 0;
     size_t offset = 0;
     size_t i = 0;
+    int ret = -1;
+
+    for (i = 0; i < num; i++) {
+        p = tp + i;
+        if (p->type < TLSEXT_QTP_TYPE_INDEX_MAX && p->parse != NULL &&
+                QuicTransParamGetOffset(p->type, &offset) == 0) {
+            index[p->type] = p;
+        }
+    }
+
+    /* Values remembered for 0-RTT must not survive an absent parameter */
+    if (TlsExtSeenInit(&seen, RPacketRemaining(pkt),
+                TLSEXT_SEEN_QTP_MIN_LEN) < 0) {
+        return -1;
+    }
 
     param = &quic->peer_param;
+    QuicTransParamInit(param);
     while (RPacketRemaining(pkt)) {
         if (QuicVariableLengthDecode(pkt, &type) < 0) {
-            return -1;
+            goto out;
         }
         if (QuicVariableLengthDecode(pkt, &len) < 0) {
-            return -1;
+            goto out;
         }
 
-        for (i = 0; i < num; i++) {
-            p = tp + i;
-            if (p->type == type) {
-                break;
-            }
+        if (TlsExtSeenAdd(&seen, type, TLSEXT_QTP_TYPE_INDEX_MAX) < 0) {
+            QUIC_LOG("Duplicate transport parameter %lu\n", type);
+            goto out;
         }
 
-        if (i == num || QuicTransParamGetOffset(type, &offset) < 0) {
+        if (type >= TLSEXT_QTP_TYPE_INDEX_MAX) {
+            /* Unknown or reserved (GREASE) one */
             if (RPacketPull(pkt, len) < 0) {
-                return -1;
+                goto out;
             }
             continue;
         }
 
-        if (p->parse == NULL) {
+        p = index[type];
+        if (p == NULL) {
             if (RPacketPull(pkt, len) < 0) {
-                return -1;
+                goto out;
             }
             continue;
         }
 
+        QuicTransParamGetOffset(type, &offset);
         if (p->parse(s, param, offset, pkt, len) < 0) {
-            return -1;
+            goto out;
         }
     }
 
-    return 0;
+    ret = 0;
+out:
+    TlsExtSeenFree(&seen);
+    return ret;
 }
 
 int TlsExtQtpCheckInteger(TLS *tls, QuicTransParams *param,
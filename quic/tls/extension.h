@@ -14,9 +14,35 @@
 
 #define TLSEXT_KEX_MODE_KE_DHE     0x01
 
+/*
+ * Extensions and transport parameters below these types are looked up
+ * directly by type, anything else is not known to us and skipped
+ */
+#define TLSEXT_TYPE_INDEX_MAX       64
+#define TLSEXT_QTP_TYPE_INDEX_MAX   64
+/*
+ * Other types in one block are only remembered to catch duplicates, in a
+ * table sized from the block length. Blocks with no more types than half
+ * the inline slots do not allocate.
+ */
+#define TLSEXT_SEEN_INLINE_BITS     6
+/* Shortest extension and transport parameter with a type not indexed */
+#define TLSEXT_SEEN_EXT_MIN_LEN     4
+#define TLSEXT_SEEN_QTP_MIN_LEN     3
+
 #define TLSEXT_NAMETYPE_HOST_NAME   0
 #define TLSEXT_MAXLEN_HOST_NAME     255
 
+/* Types met in one extension block or transport parameter list */
+typedef struct {
+    /* Bit per type below the index limit */
+    uint64_t low;
+    /* Open addressing set of the others, no type there is 0 */
+    uint64_t *high;
+    uint32_t high_bits;
+    uint64_t high_inline[1 << TLSEXT_SEEN_INLINE_BITS];
+} TlsExtSeen;
+
 typedef enum {
     EXT_TYPE_SERVER_NAME = 0,                             /* RFC 6066 */
     EXT_TYPE_MAX_FRAGMENT_LENGTH = 1,                     /* RFC 6066 */
@@ -30,6 +56,7 @@ typedef enum {
     EXT_TYPE_CLIENT_CERTIFICATE_TYPE = 19,                /* RFC 7250 */
     EXT_TYPE_SERVER_CERTIFICATE_TYPE = 20,                /* RFC 7250 */
     EXT_TYPE_PADDING = 21,                                /* RFC 7685 */
+    EXT_TYPE_COMPRESS_CERTIFICATE = 27,                   /* RFC 8879 */
     EXT_TYPE_PRE_SHARED_KEY = 41,                         /* RFC 8446 */
     EXT_TYPE_EARLY_DATA = 42,                             /* RFC 8446 */
     EXT_TYPE_SUPPORTED_VERSIONS = 43,                     /* RFC 8446 */
@@ -109,6 +136,7 @@ int TlsExtConstructAlpn(QUIC_DATA *, WPacket *);
 int TlsParseQtpExtension(TLS *, RPacket *, const TlsExtQtpDefinition *, size_t);
 int TlsClntConstructExtensions(TLS *, WPacket *, uint32_t, X509 *, size_t);
 int TlsSrvrConstructExtensions(TLS *, WPacket *, uint32_t, X509 *, size_t);
+int TlsSrvrConstructEncryptedExt(TLS *, WPacket *);
 int TlsExtQtpConstructSourceConnId(TLS *, QuicTransParams *, size_t, WPacket *);
 int TlsClntParseExtensions(TLS *, RPacket *, uint32_t, X509 *, size_t);
 int TlsSrvrParseExtensions(TLS *, RPacket *, uint32_t, X509 *, size_t);
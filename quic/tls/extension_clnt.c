@@ -21,6 +21,8 @@
 static int TlsExtClntCheckServerName(TLS *);
 static int TlsExtClntCheckAlpn(TLS *);
 static int TlsExtClntCheckPreSharedKey(TLS *);
+static int TlsExtClntCheckEarlyData(TLS *);
+static int TlsExtClntCheckCompressCert(TLS *);
 static int TlsExtClntCheckUnknown(TLS *);
 static ExtReturn TlsExtClntConstructServerName(TLS *, WPacket *, uint32_t,
                                             X509 *, size_t);
@@ -40,6 +42,10 @@ static ExtReturn TlsExtClntConstructAlpn(TLS *, WPacket *, uint32_t, X509 *,
                                         size_t);
 static ExtReturn TlsExtClntConstructPreSharedKey(TLS *, WPacket *, uint32_t,
                                         X509 *, size_t);
+static ExtReturn TlsExtClntConstructCompressCert(TLS *, WPacket *, uint32_t,
+                                        X509 *, size_t);
+static ExtReturn TlsExtClntConstructEarlyData(TLS *, WPacket *, uint32_t,
+                                        X509 *, size_t);
 static ExtReturn TlsExtClntConstructUnknown(TLS *, WPacket *, uint32_t, X509 *,
                                         size_t);
 static int TlsExtClntParseServerName(TLS *, RPacket *, uint32_t, X509 *,
@@ -99,12 +105,24 @@ static const TlsExtConstruct client_ext_construct[] = {
         .context = TLSEXT_CLIENT_HELLO,
         .construct = TlsExtClntConstructTlsExtQtp,
     },
+    {
+        .type = EXT_TYPE_COMPRESS_CERTIFICATE,
+        .context = TLSEXT_CLIENT_HELLO,
+        .check = TlsExtClntCheckCompressCert,
+        .construct = TlsExtClntConstructCompressCert,
+    },
     {
         .type = 0x4469,
         .context = TLSEXT_CLIENT_HELLO,
         .check = TlsExtClntCheckUnknown,
         .construct = TlsExtClntConstructUnknown,
     },
+    {
+        .type = EXT_TYPE_EARLY_DATA,
+        .context = TLSEXT_CLIENT_HELLO,
+        .check = TlsExtClntCheckEarlyData,
+        .construct = TlsExtClntConstructEarlyData,
+    },
     {
         .type = EXT_TYPE_PRE_SHARED_KEY,
         .context = TLSEXT_CLIENT_HELLO,
@@ -146,7 +164,7 @@ static const TlsExtParse client_ext_parse[] = {
     },
     {
         .type = EXT_TYPE_EARLY_DATA, 
-        .context = TLSEXT_NEW_SESSION_TICKET,
+        .context = TLSEXT_SERVER_HELLO|TLSEXT_NEW_SESSION_TICKET,
         .parse = TlsExtClntParseEarlyData,
     },
     {
@@ -380,6 +398,28 @@ static int TlsExtClntCheckPreSharedKey(TLS *s)
     return 0;
 }
 
+static int TlsExtClntCheckEarlyData(TLS *s)
+{
+    QUIC_SESSION *sess = TlsGetSession(s);
+
+    if (sess == NULL || sess->max_early_data == 0 ||
+            list_empty(&sess->ticket_queue)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static ExtReturn TlsExtClntConstructEarlyData(TLS *s, WPacket *pkt,
+                                    uint32_t context, X509 *x,
+                                    size_t chainidx)
+{
+    s->early_data_state = TLS_EARLY_DATA_CONNECTING;
+    s->early_data_count = 0;
+
+    return EXT_RETURN_SENT;
+}
+
 static ExtReturn TlsExtClntConstructPreSharedKey(TLS *s, WPacket *pkt,
                                     uint32_t context, X509 *x,
                                     size_t chainidx)
@@ -450,6 +490,11 @@ static ExtReturn TlsExtClntConstructPreSharedKey(TLS *s, WPacket *pkt,
         return EXT_RETURN_FAIL;
     }
 
+    if (s->early_data_state == TLS_EARLY_DATA_CONNECTING &&
+            TlsClientHelloHash(s, md, msgstart, WPacket_get_written(pkt)) < 0) {
+        return EXT_RETURN_FAIL;
+    }
+
     QUIC_LOG("Sent\n");
     return EXT_RETURN_SENT;
 }
@@ -494,6 +539,40 @@ static ExtReturn TlsExtClntConstructKeyExchModes(TLS *tls, WPacket *pkt,
     return EXT_RETURN_SENT;
 }
 
+static int TlsExtClntCheckCompressCert(TLS *s)
+{
+    if (QuicDataIsEmpty(&QuicTlsTrans(s)->ctx->ext.cert_comp_algs)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static ExtReturn TlsExtClntConstructCompressCert(TLS *s, WPacket *pkt,
+                                        uint32_t context, X509 *x,
+                                        size_t chainidx)
+{
+    const QUIC_DATA *algs = &QuicTlsTrans(s)->ctx->ext.cert_comp_algs;
+    size_t i = 0;
+
+    if (WPacketStartSubU8(pkt) < 0) {
+        return EXT_RETURN_FAIL;
+    }
+
+    for (i = 0; i < algs->len; i++) {
+        if (WPacketPut2(pkt, algs->ptr_u16[i]) < 0) {
+            return EXT_RETURN_FAIL;
+        }
+    }
+
+    if (WPacketClose(pkt) < 0) {
+        QUIC_LOG("Close packet failed\n");
+        return EXT_RETURN_FAIL;
+    }
+
+    return EXT_RETURN_SENT;
+}
+
 #ifdef QUIC_TEST
 size_t (*QuicTestEncodedpointHook)(unsigned char **point);
 #endif
@@ -503,13 +582,9 @@ static int TlsExtClntAddKeyShare(TLS *tls, WPacket *pkt, uint16_t id)
     unsigned char *encoded_point = NULL;
     size_t encodedlen = 0;
 
-    if (tls->kexch_key == NULL) {
-        key_share_key = TlsGeneratePkeyGroup(tls, id);
-        if (key_share_key == NULL) {
-            return -1;
-        }
-    } else {
-        key_share_key = tls->kexch_key;
+    key_share_key = TlsKeyShareGet(tls, id);
+    if (key_share_key == NULL) {
+        return -1;
     }
 
     /* Encode the public key. */
@@ -531,16 +606,9 @@ static int TlsExtClntAddKeyShare(TLS *tls, WPacket *pkt, uint16_t id)
         goto out;
     }
 
-    tls->kexch_key = key_share_key;
-    tls->group_id = id;
-
     OPENSSL_free(encoded_point);
     return 0;
 out:
-    if (tls->kexch_key == NULL) {
-        EVP_PKEY_free(key_share_key);
-    }
-
     OPENSSL_free(encoded_point);
     return -1;
 }
@@ -549,9 +617,10 @@ static ExtReturn TlsExtClntConstructKeyShare(TLS *tls, WPacket *pkt,
                                         uint32_t context, X509 *x,
                                         size_t chainidx)
 {
+    QUIC *quic = QuicTlsTrans(tls);
     const uint16_t *pgroups = NULL;
     size_t pgroupslen = 0;
-    size_t max_idx = 0;
+    size_t num = 1;
     size_t i = 0;
 
     if (WPacketStartSubU16(pkt) < 0) { 
@@ -559,18 +628,33 @@ static ExtReturn TlsExtClntConstructKeyShare(TLS *tls, WPacket *pkt,
     }
 
     TlsGetSupportedGroups(tls, &pgroups, &pgroupslen);
-    max_idx = tls->ext.key_share_max_group_idx;
     assert(pgroupslen != 0);
-    if (max_idx >= pgroupslen) {
-        max_idx = pgroupslen - 1;
+
+    /* Only the share the server is known to select */
+    for (i = 0; tls->ext.key_share_predicted != 0 && i < pgroupslen; i++) {
+        if (pgroups[i] == tls->ext.key_share_predicted) {
+            if (TlsExtClntAddKeyShare(tls, pkt, pgroups[i]) < 0) {
+                return EXT_RETURN_FAIL;
+            }
+            goto out;
+        }
+    }
+
+    /*
+     * Nothing known about the server yet, offer every group so that the
+     * one it selects can be learnt from ServerHello.
+     */
+    if (quic->ctx->group_cache != NULL) {
+        num = pgroupslen;
     }
 
-    for (i = 0; i <= max_idx; i++) {
+    for (i = 0; i < num; i++) {
         if (TlsExtClntAddKeyShare(tls, pkt, pgroups[i]) < 0) {
             return EXT_RETURN_FAIL;
         }
     }
 
+out:
     if (WPacketClose(pkt) < 0) {
         QUIC_LOG("Close packet failed\n");
         return EXT_RETURN_FAIL;
@@ -744,6 +828,12 @@ static int TlsExtClntParseEarlyData(TLS *s, RPacket *pkt, uint32_t context,
         return 0;
     }
 
+    if (s->early_data_state != TLS_EARLY_DATA_WRITING ||
+            RPacketRemaining(pkt) != 0) {
+        return -1;
+    }
+
+    s->ext.early_data = TLS_EARLY_DATA_ACCEPTED;
     return 0;
 }
 
@@ -751,47 +841,29 @@ static int TlsExtClntParseKeyShare(TLS *tls, RPacket *pkt,
                                 uint32_t context, X509 *x,
                                 size_t chainidx)
 {
-    EVP_PKEY *ckey = tls->kexch_key;
+    EVP_PKEY *ckey = NULL;
     EVP_PKEY *skey = NULL;
-    const uint16_t *pgroups = NULL;
     const uint8_t *key_ex_data = NULL;
-    size_t pgroupslen = 0;
-    size_t max_idx = 0;
-    size_t i = 0;
     uint32_t group_id = 0;
     uint32_t key_ex_len = 0;
 
-    if (ckey == NULL) {
-        QUIC_LOG("Ckey is NULL\n");
-        return -1;
-    }
-
     if (RPacketGet2(pkt, &group_id) < 0) {
         return -1;
     }
 
-    TlsGetSupportedGroups(tls, &pgroups, &pgroupslen);
-    max_idx = tls->ext.key_share_max_group_idx;
-    assert(pgroupslen != 0);
-    if (max_idx >= pgroupslen) {
-        max_idx = pgroupslen - 1;
-    }
-
-    for (i = 0; i <= max_idx; i++) {
-        if (pgroups[i] == group_id) {
-            break;
-        }
-    }
-
-    if (i > max_idx) {
-        QUIC_LOG("Group ID %u not found\n",  group_id);
+    ckey = TlsKeyShareTake(tls, group_id);
+    if (ckey == NULL) {
+        QUIC_LOG("Group ID %u not offered\n",  group_id);
+        /* The server moved off the group it was known to select */
+        TlsClntGroupForget(tls);
         return -1;
     }
 
-    if (group_id != tls->group_id) {
-        QUIC_LOG("Group ID %u not same[%d]\n",  group_id, tls->group_id);
-        return -1;
-    }
+    /* Shares of the other groups are of no use any more */
+    TlsKeySharesFree(tls);
+    EVP_PKEY_free(tls->kexch_key);
+    tls->kexch_key = ckey;
+    tls->group_id = group_id;
 
     if (RPacketGet2(pkt, &key_ex_len) < 0) {
         return -1;
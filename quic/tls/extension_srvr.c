@@ -13,6 +13,7 @@
 #include "common.h"
 #include "mem.h"
 #include "log.h"
+#include "cert_comp.h"
 
 static int TlsExtSrvrCheckAlpn(TLS *);
 static int TlsExtSrvrCheckKeyShare(TLS *);
@@ -50,6 +51,8 @@ static int TlsExtSrvrParseAlpn(TLS *, RPacket *, uint32_t, X509 *,
                                         size_t);
 static int TlsExtsrvrParsePsk(TLS *, RPacket *, uint32_t, X509 *,
                                         size_t);
+static int TlsExtSrvrParseCompressCert(TLS *, RPacket *, uint32_t, X509 *,
+                                        size_t);
 
 static const TlsExtConstruct server_ext_construct[] = {
     {
@@ -81,7 +84,7 @@ static const TlsExtConstruct server_ext_construct[] = {
     },
     {
         .type = EXT_TYPE_EARLY_DATA, 
-        .context = TLSEXT_NEW_SESSION_TICKET,
+        .context = TLSEXT_ENCRYPTED_EXT|TLSEXT_NEW_SESSION_TICKET,
         .construct = TlsExtSrvrConstructEarlyData,
     },
     {
@@ -138,6 +141,11 @@ static const TlsExtParse server_ext_parse[] = {
         .context = TLSEXT_CLIENT_HELLO,
         .parse = TlsExtSrvrParseEarlyData,
     },
+    {
+        .type = EXT_TYPE_COMPRESS_CERTIFICATE,
+        .context = TLSEXT_CLIENT_HELLO,
+        .parse = TlsExtSrvrParseCompressCert,
+    },
     {
         .type = EXT_TYPE_PRE_SHARED_KEY,
         .context = TLSEXT_CLIENT_HELLO,
@@ -275,7 +283,11 @@ TlsExtSrvrConstructKeyShare(TLS *s, WPacket *pkt, uint32_t context,
         return EXT_RETURN_FAIL;
     }
 
-    skey = TlsGeneratePkey(ckey);
+    skey = TlsGeneratePkeyGroup(s, s->group_id);
+    if (skey == NULL) {
+        skey = TlsGeneratePkey(ckey);
+    }
+
     if (skey == NULL) {
         return EXT_RETURN_FAIL;
     }
@@ -360,9 +372,34 @@ static ExtReturn TlsExtSrvrConstructEarlyData(TLS *s, WPacket *pkt, uint32_t con
         return EXT_RETURN_SENT;
     }
 
+    if (s->ext.early_data != TLS_EARLY_DATA_ACCEPTED) {
+        return EXT_RETURN_NOT_SENT;
+    }
+
     return EXT_RETURN_SENT;
 }
 
+/*
+ * Certificates and ALPN of the virtual host come into play before the
+ * ALPN and key share extensions are parsed.
+ */
+static int TlsExtSrvrVhostSelect(TLS *s)
+{
+    QuicVhostTable *table = QuicTlsTrans(s)->ctx->vhost_table;
+    TlsConfig *conf = NULL;
+
+    if (table == NULL) {
+        return 0;
+    }
+
+    conf = QuicVhostTableLookup(table, s->ext.hostname);
+    if (conf != NULL) {
+        TlsConfigSwitch(s, conf);
+    }
+
+    return 0;
+}
+
 static int TlsExtSrvrParseServerName(TLS *s, RPacket *pkt, uint32_t context,
                                 X509 *x, size_t chainidx)
 {
@@ -418,7 +455,7 @@ static int TlsExtSrvrParseServerName(TLS *s, RPacket *pkt, uint32_t context,
         return -1;
     }
 
-    return 0;
+    return TlsExtSrvrVhostSelect(s);
 }
 
 static int TlsExtSrvrParseSigAlgs(TLS *s, RPacket *pkt, uint32_t context,
@@ -449,6 +486,8 @@ static int TlsExtSrvrParseEarlyData(TLS *s, RPacket *pkt, uint32_t context,
         return -1;
     }
 
+    /* Offered, accepted later if the PSK allows */
+    s->ext.early_data = TLS_EARLY_DATA_REJECTED;
     return 0;
 }
 
@@ -630,6 +669,88 @@ static int TlsExtSrvrParseAlpn(TLS *s, RPacket *pkt, uint32_t context, X509 *x,
     return 0;
 }
 
+static int TlsExtSrvrParseCompressCert(TLS *s, RPacket *pkt, uint32_t context,
+                                        X509 *x, size_t chainidx)
+{
+    const QUIC_DATA *algs = &QuicTlsTrans(s)->ctx->ext.cert_comp_algs;
+    RPacket alg_list = {};
+    RPacket offered = {};
+    uint32_t alg = 0;
+    size_t i = 0;
+
+    if (RPacketGetLengthPrefixed1(pkt, &alg_list) < 0) {
+        return -1;
+    }
+
+    if (RPacketRemaining(&alg_list) < 2 ||
+            (RPacketRemaining(&alg_list) & 1) != 0) {
+        QUIC_LOG("Bad algorithm list length\n");
+        return -1;
+    }
+
+    /* Follow the server preference */
+    for (i = 0; i < algs->len; i++) {
+        offered = alg_list;
+        while (RPacketGet2(&offered, &alg) == 0) {
+            if (alg == algs->ptr_u16[i] && TlsCertCompSupported(alg)) {
+                s->ext.cert_comp_alg = alg;
+                return 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int TlsExtSrvrTicketSession(TLS *s, const uint8_t *tick, size_t len,
+                                    QUIC_SESSION **sess)
+{
+    QuicSessionCache *cache = QuicTlsTrans(s)->ctx->session_cache;
+
+    /* Stateless tickets are always longer than a cache ID */
+    if (cache != NULL && len == QUIC_SESSION_CACHE_ID_LEN) {
+        *sess = QuicSessionCacheLookup(cache, tick, len);
+        return *sess != NULL ? 0 : -1;
+    }
+
+    return TlsDecryptTicket(s, tick, len, sess);
+}
+
+/*
+ * RFC 8446 8.2 and 8.3, the ticket age the client reports must match the
+ * time since the ticket was issued, and the binder must not have been seen
+ * inside that window. Otherwise the early data is rejected, the handshake
+ * still goes on.
+ */
+static bool TlsExtSrvrEarlyDataFresh(TLS *s, QuicSessionTicket *t,
+                                        uint32_t ticket_agel, RPacket *binder)
+{
+    QuicAntiReplay *ar = QuicTlsTrans(s)->ctx->anti_replay;
+    int64_t client_age = 0;
+    int64_t server_age = 0;
+    int64_t skew = 0;
+
+    if (ar == NULL) {
+        return false;
+    }
+
+    client_age = (uint32_t)(ticket_agel - t->age_add) / 1000;
+    server_age = time(NULL) - t->time;
+    skew = client_age - server_age;
+    if (skew > ar->window || skew < -(int64_t)ar->window) {
+        QUIC_LOG("Ticket age skew %ld too large\n", (long)skew);
+        return false;
+    }
+
+    if (QuicAntiReplayCheck(ar, RPacketData(binder),
+                RPacketRemaining(binder)) < 0) {
+        QUIC_LOG("Replayed ClientHello\n");
+        return false;
+    }
+
+    return true;
+}
+
 static int TlsExtsrvrParsePsk(TLS *s, RPacket *pkt, uint32_t context,
                                     X509 *x, size_t chainidx)
 {
@@ -660,7 +781,7 @@ static int TlsExtsrvrParsePsk(TLS *s, RPacket *pkt, uint32_t context,
             return -1;
         }
 
-        if (TlsDecryptTicket(s, RPacketData(&identity),
+        if (TlsExtSrvrTicketSession(s, RPacketData(&identity),
                     RPacketRemaining(&identity), &sess) < 0) {
             QUIC_LOG("Decrypt Ticket failed\n");
             continue;
@@ -709,6 +830,19 @@ static int TlsExtsrvrParsePsk(TLS *s, RPacket *pkt, uint32_t context,
         goto err;
     }
 
+    /* Only the first identity can carry early data */
+    if (s->ext.early_data == TLS_EARLY_DATA_REJECTED && id == 0) {
+        s->ext.early_data_fresh = TlsExtSrvrEarlyDataFresh(s, t, ticket_agel,
+                                        &binder);
+    }
+
+    /* The PSK extension is the last one, ClientHello ends here */
+    if (s->ext.early_data == TLS_EARLY_DATA_REJECTED &&
+            TlsClientHelloHash(s, md, RPacketHead(pkt),
+                RPacketReadLen(pkt)) < 0) {
+        goto err;
+    }
+
     QUIC_LOG("Parse PSK\n");
     QuicSessionFree(quic->session);
     quic->session = sess;
@@ -765,4 +899,68 @@ int TlsSrvrConstructExtensions(TLS *s, WPacket *pkt, uint32_t context, X509 *x,
                                     QUIC_NELEM(server_ext_construct));
 }
 
+static bool TlsSrvrEeTemplateUsable(TLS *s)
+{
+#ifdef QUIC_TEST
+    if (QuicTestExtensionHook != NULL || QuicTestTransParamHook != NULL) {
+        return false;
+    }
+#endif
+    /* The template is built from the transport parameters of the config */
+    return !s->ext.trans_param_set && s->config != NULL;
+}
+
+/*
+ * Everything in EncryptedExtensions but the server CID only depends on the
+ * config, the ALPN selected and whether early data was accepted. Serialise
+ * it once for each of those and copy it out for the next connections.
+ */
+int TlsSrvrConstructEncryptedExt(TLS *s, WPacket *pkt)
+{
+    QUIC *quic = QuicTlsTrans(s);
+    TlsEeTemplateCache *cache = NULL;
+    TlsEeTemplate *tmpl = NULL;
+    WPacket tpkt = {};
+    bool early_data = false;
+    int ret = -1;
+
+    if (!TlsSrvrEeTemplateUsable(s)) {
+        return TlsSrvrConstructExtensions(s, pkt, TLSEXT_ENCRYPTED_EXT,
+                                            NULL, 0);
+    }
+
+    cache = &s->config->ee_template;
+    early_data = (s->ext.early_data == TLS_EARLY_DATA_ACCEPTED);
+    tmpl = TlsEeTemplateFind(cache, &s->alpn_selected, early_data,
+                                quic->scid.len);
+    if (tmpl != NULL) {
+        return TlsEeTemplateWrite(tmpl, pkt, &quic->scid);
+    }
+
+    tmpl = TlsEeTemplateNew(&s->alpn_selected, early_data, quic->scid.len);
+    if (tmpl == NULL) {
+        return -1;
+    }
+
+    WPacketStaticBufInit(&tpkt, tmpl->data, sizeof(tmpl->data));
+    s->ext.ee_template = tmpl;
+    ret = TlsSrvrConstructExtensions(s, &tpkt, TLSEXT_ENCRYPTED_EXT, NULL, 0);
+    s->ext.ee_template = NULL;
+    tmpl->len = WPacket_get_written(&tpkt);
+    WPacketCleanup(&tpkt);
+    if (ret < 0) {
+        /* Too long for a template */
+        TlsEeTemplateFree(tmpl);
+        return TlsSrvrConstructExtensions(s, pkt, TLSEXT_ENCRYPTED_EXT,
+                                            NULL, 0);
+    }
+
+    ret = TlsEeTemplateWrite(tmpl, pkt, &quic->scid);
+    if (TlsEeTemplateAdd(cache, tmpl) < 0) {
+        TlsEeTemplateFree(tmpl);
+    }
+
+    return ret;
+}
+
 
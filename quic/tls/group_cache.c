@@ -0,0 +1,121 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "group_cache.h"
+
+#include "mem.h"
+
+static uint64_t TlsGroupCacheOrigin(const char *hostname, uint16_t port)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint8_t *p = (const uint8_t *)hostname;
+
+    for (; *p != 0; p++) {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+
+    hash ^= port;
+    hash *= 0x100000001b3ULL;
+
+    /* 0 marks an empty slot */
+    return hash != 0 ? hash : 1;
+}
+
+TlsGroupCache *TlsGroupCacheNew(size_t entries)
+{
+    TlsGroupCache *cache = NULL;
+    size_t num = 1;
+
+    if (entries == 0 || entries > TLS_GROUP_CACHE_ENTRY_MAX) {
+        return NULL;
+    }
+
+    while (num < entries) {
+        num <<= 1;
+    }
+
+    cache = QuicMemCalloc(sizeof(*cache) + num * sizeof(cache->entries[0]));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->mask = num - 1;
+
+    return cache;
+}
+
+void TlsGroupCacheFree(TlsGroupCache *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    QuicMemFree(cache);
+}
+
+/*
+ * Return the group the server selected last time, 0 if unknown.
+ */
+uint16_t TlsGroupCacheGet(TlsGroupCache *cache, const char *hostname,
+                            uint16_t port)
+{
+    TlsGroupCacheEntry *e = NULL;
+    uint64_t origin = TlsGroupCacheOrigin(hostname, port);
+    uint16_t group_id = 0;
+
+    pthread_mutex_lock(&cache->lock);
+    e = &cache->entries[origin & cache->mask];
+    if (e->origin == origin) {
+        group_id = e->group_id;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return group_id;
+}
+
+/*
+ * @predicted is what TlsGroupCacheGet() returned for this handshake,
+ * @selected the group of the ServerHello.
+ */
+void TlsGroupCacheUpdate(TlsGroupCache *cache, const char *hostname,
+                            uint16_t port, uint16_t predicted,
+                            uint16_t selected)
+{
+    TlsGroupCacheEntry *e = NULL;
+    uint64_t origin = TlsGroupCacheOrigin(hostname, port);
+
+    pthread_mutex_lock(&cache->lock);
+    if (predicted != 0 && predicted == selected) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+
+    e = &cache->entries[origin & cache->mask];
+    e->origin = origin;
+    e->group_id = selected;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/*
+ * Forget the group of an origin whose handshake failed or whose server no
+ * longer selects it, so the next ClientHello offers all the shares again.
+ */
+void TlsGroupCacheDrop(TlsGroupCache *cache, const char *hostname,
+                        uint16_t port)
+{
+    TlsGroupCacheEntry *e = NULL;
+    uint64_t origin = TlsGroupCacheOrigin(hostname, port);
+
+    pthread_mutex_lock(&cache->lock);
+    e = &cache->entries[origin & cache->mask];
+    if (e->origin == origin) {
+        e->origin = 0;
+        e->group_id = 0;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,36 @@
+#ifndef TBQUIC_QUIC_TLS_GROUP_CACHE_H_
+#define TBQUIC_QUIC_TLS_GROUP_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define TLS_GROUP_CACHE_ENTRY_MAX   (1 << 20)
+
+typedef struct {
+    /* Hash of hostname and port, 0 if empty */
+    uint64_t origin;
+    uint16_t group_id;
+} TlsGroupCacheEntry;
+
+/*
+ * Key share group selected by each server, so the next ClientHello only
+ * carries the share the server wants. Direct mapped, a colliding origin
+ * just takes the slot over.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t mask;
+    uint64_t hits;
+    uint64_t misses;
+    TlsGroupCacheEntry entries[];
+} TlsGroupCache;
+
+TlsGroupCache *TlsGroupCacheNew(size_t);
+void TlsGroupCacheFree(TlsGroupCache *);
+uint16_t TlsGroupCacheGet(TlsGroupCache *, const char *, uint16_t);
+void TlsGroupCacheUpdate(TlsGroupCache *, const char *, uint16_t, uint16_t,
+                            uint16_t);
+void TlsGroupCacheDrop(TlsGroupCache *, const char *, uint16_t);
+
+#endif
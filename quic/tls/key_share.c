@@ -0,0 +1,224 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "key_share.h"
+
+#include <tbquic/quic.h>
+
+#include "tls_lib.h"
+#include "mem.h"
+#include "log.h"
+
+/* Must hold the lock */
+static TlsKeyShareSlot *TlsKeySharePoolEmptySlot(TlsKeySharePool *pool,
+                                                    uint16_t *id)
+{
+    TlsKeyShareSlot *slot = NULL;
+    uint16_t i = 0;
+
+    for (i = 0; i < TLS_KEY_SHARE_GROUP_NUM; i++) {
+        slot = &pool->slots[i];
+        if (slot->wanted && slot->num < pool->depth) {
+            *id = i;
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static void *TlsKeySharePoolRefillThread(void *arg)
+{
+    TlsKeySharePool *pool = arg;
+    uint16_t id = 0;
+    bool stop = false;
+
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stop && TlsKeySharePoolEmptySlot(pool, &id) == NULL) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        stop = pool->stop;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stop) {
+            break;
+        }
+
+        TlsKeySharePoolRefill(pool, 1);
+    }
+
+    QuicThreadExit();
+    return NULL;
+}
+
+TlsKeySharePool *TlsKeySharePoolNew(size_t depth, bool background)
+{
+    TlsKeySharePool *pool = NULL;
+
+    if (depth == 0 || depth > TLS_KEY_SHARE_POOL_DEPTH_MAX) {
+        return NULL;
+    }
+
+    pool = QuicMemCalloc(sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->depth = depth;
+
+    if (background) {
+        if (pthread_create(&pool->refill, NULL, TlsKeySharePoolRefillThread,
+                    pool) != 0) {
+            QUIC_LOG("Create refill thread failed\n");
+            TlsKeySharePoolFree(pool);
+            return NULL;
+        }
+        pool->background = true;
+    }
+
+    return pool;
+}
+
+void TlsKeySharePoolFree(TlsKeySharePool *pool)
+{
+    TlsKeyShareSlot *slot = NULL;
+    size_t i = 0;
+    size_t j = 0;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    if (pool->background) {
+        pthread_mutex_lock(&pool->lock);
+        pool->stop = true;
+        pthread_cond_signal(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+        pthread_join(pool->refill, NULL);
+    }
+
+    for (i = 0; i < TLS_KEY_SHARE_GROUP_NUM; i++) {
+        slot = &pool->slots[i];
+        for (j = 0; j < slot->num; j++) {
+            EVP_PKEY_free(slot->keys[j]);
+        }
+        QuicMemFree(slot->keys);
+    }
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    QuicMemFree(pool);
+}
+
+void TlsKeySharePoolWant(TlsKeySharePool *pool, uint16_t id)
+{
+    if (id >= TLS_KEY_SHARE_GROUP_NUM) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->slots[id].wanted = true;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Take a key of group @id out of the pool, NULL if the pool is empty and
+ * the caller should generate one inline.
+ */
+EVP_PKEY *TlsKeySharePoolGet(TlsKeySharePool *pool, uint16_t id)
+{
+    TlsKeyShareSlot *slot = NULL;
+    EVP_PKEY *pkey = NULL;
+
+    if (id >= TLS_KEY_SHARE_GROUP_NUM) {
+        return NULL;
+    }
+
+    slot = &pool->slots[id];
+
+    pthread_mutex_lock(&pool->lock);
+    slot->wanted = true;
+    if (slot->num > 0) {
+        pkey = slot->keys[--slot->num];
+        slot->keys[slot->num] = NULL;
+    }
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return pkey;
+}
+
+/*
+ * Generate at most @budget keys for the groups in use, for callers
+ * refilling the pool in idle loop slices. Return the number of keys added.
+ */
+size_t TlsKeySharePoolRefill(TlsKeySharePool *pool, size_t budget)
+{
+    TlsKeyShareSlot *slot = NULL;
+    EVP_PKEY *pkey = NULL;
+    EVP_PKEY **keys = NULL;
+    size_t added = 0;
+    uint16_t id = 0;
+
+    while (added < budget) {
+        pthread_mutex_lock(&pool->lock);
+        slot = TlsKeySharePoolEmptySlot(pool, &id);
+        pthread_mutex_unlock(&pool->lock);
+        if (slot == NULL) {
+            break;
+        }
+
+        /* Keygen is slow, do it without the lock */
+        pkey = TlsGenerateKeyGroup(id);
+        if (pkey == NULL) {
+            pthread_mutex_lock(&pool->lock);
+            slot->wanted = false;
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (slot->keys == NULL) {
+            keys = QuicMemCalloc(pool->depth * sizeof(*keys));
+            if (keys == NULL) {
+                slot->wanted = false;
+            }
+            slot->keys = keys;
+        }
+
+        if (slot->keys != NULL && slot->num < pool->depth) {
+            slot->keys[slot->num++] = pkey;
+            pkey = NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if (pkey != NULL) {
+            /* Filled by someone else meanwhile */
+            EVP_PKEY_free(pkey);
+            continue;
+        }
+        added++;
+    }
+
+    return added;
+}
+
+size_t TlsKeySharePoolNum(TlsKeySharePool *pool, uint16_t id)
+{
+    size_t num = 0;
+
+    if (id >= TLS_KEY_SHARE_GROUP_NUM) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    num = pool->slots[id].num;
+    pthread_mutex_unlock(&pool->lock);
+
+    return num;
+}
@@ -0,0 +1,42 @@
+#ifndef TBQUIC_QUIC_TLS_KEY_SHARE_H_
+#define TBQUIC_QUIC_TLS_KEY_SHARE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+#include <tbquic/ec.h>
+
+#define TLS_KEY_SHARE_GROUP_NUM     (EC_NAMED_CURVE_X448 + 1)
+#define TLS_KEY_SHARE_POOL_DEPTH_MAX    1024
+
+typedef struct {
+    EVP_PKEY **keys;
+    size_t num;
+    /* Group used by handshake, keep it filled */
+    bool wanted;
+} TlsKeyShareSlot;
+
+/*
+ * Ephemeral keys generated ahead of the handshake. A key is removed from
+ * the pool when taken, so it is never used twice.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t refill;
+    size_t depth;
+    bool background;
+    bool stop;
+    TlsKeyShareSlot slots[TLS_KEY_SHARE_GROUP_NUM];
+} TlsKeySharePool;
+
+TlsKeySharePool *TlsKeySharePoolNew(size_t, bool);
+void TlsKeySharePoolFree(TlsKeySharePool *);
+void TlsKeySharePoolWant(TlsKeySharePool *, uint16_t);
+EVP_PKEY *TlsKeySharePoolGet(TlsKeySharePool *, uint16_t);
+size_t TlsKeySharePoolRefill(TlsKeySharePool *, size_t);
+size_t TlsKeySharePoolNum(TlsKeySharePool *, uint16_t);
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "ticket_key.h"
+
+#include <string.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+
+#include "mem.h"
+#include "log.h"
+
+static int TlsTicketKeyGenerate(TlsTicketKey *tk)
+{
+    if (RAND_bytes(tk->tick_key_name, sizeof(tk->tick_key_name)) <= 0) {
+        return -1;
+    }
+
+    if (RAND_priv_bytes(tk->tick_hmac_key, sizeof(tk->tick_hmac_key)) <= 0) {
+        return -1;
+    }
+
+    if (RAND_priv_bytes(tk->tick_aes_key, sizeof(tk->tick_aes_key)) <= 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+TlsTicketKeyRing *TlsTicketKeyRingNew(void)
+{
+    TlsTicketKeyRing *ring = NULL;
+
+    ring = QuicMemCalloc(sizeof(*ring));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    if (TlsTicketKeyGenerate(&ring->keys[0]) < 0) {
+        QuicMemFree(ring);
+        return NULL;
+    }
+
+    pthread_rwlock_init(&ring->lock, NULL);
+    ring->num = 1;
+    ring->max = TLS_TICKET_KEY_RING_DEF;
+    return ring;
+}
+
+void TlsTicketKeyRingFree(TlsTicketKeyRing *ring)
+{
+    if (ring == NULL) {
+        return;
+    }
+
+    pthread_rwlock_destroy(&ring->lock);
+    OPENSSL_cleanse(ring->keys, sizeof(ring->keys));
+    QuicMemFree(ring);
+}
+
+/*
+ * Make @tk the encryption key, a random one if @tk is NULL. The previous
+ * keys move down and only decrypt from now on, the oldest one beyond the
+ * ring size is dropped.
+ */
+int TlsTicketKeyRingRotate(TlsTicketKeyRing *ring, const TlsTicketKey *tk)
+{
+    TlsTicketKey key = {};
+
+    if (tk == NULL) {
+        if (TlsTicketKeyGenerate(&key) < 0) {
+            return -1;
+        }
+    } else {
+        key = *tk;
+    }
+
+    pthread_rwlock_wrlock(&ring->lock);
+    if (ring->num < ring->max) {
+        ring->num++;
+    }
+    memmove(&ring->keys[1], &ring->keys[0],
+            (ring->num - 1) * sizeof(ring->keys[0]));
+    ring->keys[0] = key;
+    OPENSSL_cleanse(&ring->keys[ring->num], (TLS_TICKET_KEY_RING_MAX -
+                ring->num) * sizeof(ring->keys[0]));
+    pthread_rwlock_unlock(&ring->lock);
+
+    OPENSSL_cleanse(&key, sizeof(key));
+    return 0;
+}
+
+int TlsTicketKeyRingSetMax(TlsTicketKeyRing *ring, size_t max)
+{
+    if (max == 0 || max > TLS_TICKET_KEY_RING_MAX) {
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&ring->lock);
+    ring->max = max;
+    if (ring->num > max) {
+        OPENSSL_cleanse(&ring->keys[max], (ring->num - max) *
+                sizeof(ring->keys[0]));
+        ring->num = max;
+    }
+    pthread_rwlock_unlock(&ring->lock);
+
+    return 0;
+}
+
+void TlsTicketKeyRingCurrent(TlsTicketKeyRing *ring, TlsTicketKey *tk)
+{
+    pthread_rwlock_rdlock(&ring->lock);
+    *tk = ring->keys[0];
+    pthread_rwlock_unlock(&ring->lock);
+}
+
+/*
+ * Copy the key named @name to @tk. @renew is set if it is no longer the
+ * encryption key, the ticket should then be replaced.
+ */
+int TlsTicketKeyRingFind(TlsTicketKeyRing *ring, const uint8_t *name,
+                            TlsTicketKey *tk, bool *renew)
+{
+    size_t i = 0;
+    int ret = -1;
+
+    pthread_rwlock_rdlock(&ring->lock);
+    for (i = 0; i < ring->num; i++) {
+        if (QuicMemCmp(ring->keys[i].tick_key_name, name,
+                    TLSEXT_KEYNAME_LENGTH) == 0) {
+            *tk = ring->keys[i];
+            *renew = (i != 0);
+            ret = 0;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&ring->lock);
+
+    return ret;
+}
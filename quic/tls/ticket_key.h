@@ -0,0 +1,33 @@
+#ifndef TBQUIC_QUIC_TLS_TICKET_KEY_H_
+#define TBQUIC_QUIC_TLS_TICKET_KEY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "tls.h"
+
+#define TLS_TICKET_KEY_RING_MAX     8
+#define TLS_TICKET_KEY_RING_DEF     4
+
+/*
+ * keys[0] encrypts new tickets, the older ones are only kept to decrypt
+ * tickets issued before the last rotations.
+ */
+struct TlsTicketKeyRing {
+    pthread_rwlock_t lock;
+    size_t num;
+    size_t max;
+    TlsTicketKey keys[TLS_TICKET_KEY_RING_MAX];
+};
+
+TlsTicketKeyRing *TlsTicketKeyRingNew(void);
+void TlsTicketKeyRingFree(TlsTicketKeyRing *);
+int TlsTicketKeyRingRotate(TlsTicketKeyRing *, const TlsTicketKey *);
+int TlsTicketKeyRingSetMax(TlsTicketKeyRing *, size_t);
+void TlsTicketKeyRingCurrent(TlsTicketKeyRing *, TlsTicketKey *);
+int TlsTicketKeyRingFind(TlsTicketKeyRing *, const uint8_t *, TlsTicketKey *,
+                            bool *);
+
+#endif
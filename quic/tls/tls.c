@@ -15,6 +15,9 @@
 #include "mem.h"
 #include "extension.h"
 #include "frame.h"
+#include "evp.h"
+#include "async.h"
+#include "cert_comp.h"
 #include "common.h"
 #include "log.h"
 
@@ -61,6 +64,8 @@ TlsHandshakeRead(TLS *s, const TlsProcess *p, RPacket *pkt,
     RPacket msg = {};
     TlsState state = 0;
     QuicFlowReturn ret = QUIC_FLOW_RET_FINISH;
+    uint8_t *cert_msg = NULL;
+    size_t cert_len = 0;
     size_t remain = 0;
     uint32_t type = 0;
     uint32_t len = 0;
@@ -82,7 +87,8 @@ TlsHandshakeRead(TLS *s, const TlsProcess *p, RPacket *pkt,
     }
 
     state = s->handshake_state;
-    while (type != p->msg_type) {
+    while (type != p->msg_type && !(type == TLS_MT_COMPRESSED_CERTIFICATE &&
+                p->msg_type == TLS_MT_CERTIFICATE)) {
         if (p->skip_check != NULL && p->skip_check(s) == 0) {
             s->handshake_state = p->next_state;
             state = s->handshake_state;
@@ -132,11 +138,23 @@ TlsHandshakeRead(TLS *s, const TlsProcess *p, RPacket *pkt,
         return QUIC_FLOW_RET_ERROR;
     }
 
+    if (type == TLS_MT_COMPRESSED_CERTIFICATE) {
+        if (TlsCertDecompressMsg(s, &msg, &cert_msg, &cert_len) < 0) {
+            return QUIC_FLOW_RET_ERROR;
+        }
+        RPacketBufInit(&msg, cert_msg, cert_len);
+    }
+
     ret = p->handler(s, &msg);
+    QuicMemFree(cert_msg);
     if (ret == QUIC_FLOW_RET_ERROR) {
         return QUIC_FLOW_RET_ERROR;
     }
 
+    if (type == TLS_MT_FINISHED) {
+        s->buffer_release = 1;
+    }
+
     TlsFlowFinish(s, state, p->next_state);
     return ret;
 }
@@ -155,7 +173,6 @@ TlsHandshakeWrite(TLS *s, const TlsProcess *p, WPacket *pkt)
         return QUIC_FLOW_RET_ERROR;
     }
 
-    msg = WPacket_get_curr(pkt);
     wlen = WPacket_get_written(pkt);
     if (WPacketPut1(pkt, p->msg_type) < 0) {
         QUIC_LOG("Put Message type failed\n");
@@ -173,6 +190,12 @@ TlsHandshakeWrite(TLS *s, const TlsProcess *p, WPacket *pkt)
         return QUIC_FLOW_RET_ERROR;
     }
 
+    if (ret == QUIC_FLOW_RET_WANT_ASYNC) {
+        /* Message will be rebuilt when the job is done */
+        WPacketAbort(pkt, wlen);
+        return ret;
+    }
+
     if (WPacketClose(pkt) < 0) {
         QUIC_LOG("Close packet failed\n");
         return QUIC_FLOW_RET_ERROR;
@@ -180,6 +203,13 @@ TlsHandshakeWrite(TLS *s, const TlsProcess *p, WPacket *pkt)
 
     msg_len = WPacket_get_written(pkt) - wlen;
     assert(QUIC_GT(msg_len, 0));
+    /* Buffer may be reallocated by handler */
+    msg = WPacket_get_curr(pkt) - msg_len;
+    if (s->tmp.msg_type != 0) {
+        msg[0] = s->tmp.msg_type;
+        s->tmp.msg_type = 0;
+    }
+
     if (TlsFinishMac(s, msg, msg_len) < 0) {
         return QUIC_FLOW_RET_ERROR;
     }
@@ -228,7 +258,8 @@ TlsHandshakeStatem(TLS *s, RPacket *rpkt, WPacket *wpkt,
             return ret;
         }
 
-        if (ret == QUIC_FLOW_RET_WANT_READ || ret == QUIC_FLOW_RET_WANT_WRITE) {
+        if (ret == QUIC_FLOW_RET_WANT_READ || ret == QUIC_FLOW_RET_WANT_WRITE ||
+                ret == QUIC_FLOW_RET_WANT_ASYNC) {
             return ret;
         }
 
@@ -306,6 +337,24 @@ TlsHandshake(TLS *s, const TlsProcess *proc, size_t num)
         }
     }
 
+    /*
+     * The peer flight, certificates included, is hashed and framed replies
+     * are queued, do not hold on to a buffer that big until the handshake
+     * is confirmed.
+     */
+    if (s->buffer_release && QuicBufGetOffset(buffer) == 0) {
+        s->buffer_release = 0;
+        if (QuicBufShrink(buffer, TLS_POST_HANDSHAKE_BUF_LEN) < 0) {
+            QUIC_LOG("Shrink TLS buffer failed\n");
+        }
+    }
+
+    if (s->early_data_state == TLS_EARLY_DATA_WRITE_FLUSH) {
+        QuicZeroRttDiscard(quic,
+                s->ext.early_data == TLS_EARLY_DATA_REJECTED);
+        s->early_data_state = TLS_EARLY_DATA_FINISHED_WRITING;
+    }
+
     if (s->handshake_state == TLS_ST_SW_HANDSHAKE_DONE) {
         QuicDataHandshakeDoneFrameBuild(quic, 0, pkt_type);
         QUIC_LOG("hhhhhhhhhhhhhhhhhhhhhhhhhhandshake done\n");
@@ -412,14 +461,34 @@ int TlsAddCertChain(TLS *s, WPacket *pkt, QuicCertPkey *cpk,
 QuicFlowReturn TlsCertChainBuild(TLS *s, WPacket *pkt, QuicCertPkey *cpk,
                                     TlsExtConstructor ext)
 {
+    const uint8_t *data = NULL;
+    size_t len = 0;
+    size_t wlen = 0;
+
+    if (cpk == NULL) {
+        return QUIC_FLOW_RET_ERROR;
+    }
+
+    data = QuicCertChainCacheGet(cpk->cache, &len);
+    if (data != NULL) {
+        if (WPacketSubMemcpyU24(pkt, data, len) < 0) {
+            return QUIC_FLOW_RET_ERROR;
+        }
+        return QUIC_FLOW_RET_FINISH;
+    }
+
     if (WPacketStartSubU24(pkt) < 0) {
         return QUIC_FLOW_RET_ERROR;
     }
 
+    wlen = WPacket_get_written(pkt);
     if (TlsAddCertChain(s, pkt, cpk, ext) < 0) {
         return QUIC_FLOW_RET_ERROR;
     }
 
+    len = WPacket_get_written(pkt) - wlen;
+    QuicCertChainCacheSet(cpk->cache, WPacket_get_curr(pkt) - len, len);
+
     if (WPacketClose(pkt) < 0) {
         return QUIC_FLOW_RET_ERROR;
     }
@@ -427,12 +496,90 @@ QuicFlowReturn TlsCertChainBuild(TLS *s, WPacket *pkt, QuicCertPkey *cpk,
     return QUIC_FLOW_RET_FINISH;
 }
 
+/*
+ * Compress the Certificate message once per certificate and algorithm, the
+ * following handshakes copy the cached CompressedCertificate body.
+ */
+QuicFlowReturn TlsCompressedCertBuild(TLS *s, WPacket *pkt,
+                                QuicCertPkey *cpk, TlsExtConstructor ext)
+{
+    uint16_t alg = s->ext.cert_comp_alg;
+    const uint8_t *data = NULL;
+    uint8_t *comp = NULL;
+    uint8_t *buf = NULL;
+    WPacket tmp = {};
+    size_t comp_len = 0;
+    size_t wlen = 0;
+    size_t len = 0;
+    QuicFlowReturn ret = QUIC_FLOW_RET_ERROR;
+
+    if (cpk == NULL) {
+        return QUIC_FLOW_RET_ERROR;
+    }
+
+    s->tmp.msg_type = TLS_MT_COMPRESSED_CERTIFICATE;
+    data = QuicCertChainCacheGetComp(cpk->cache, alg, &len);
+    if (data != NULL) {
+        if (WPacketMemcpy(pkt, data, len) < 0) {
+            return QUIC_FLOW_RET_ERROR;
+        }
+        return QUIC_FLOW_RET_FINISH;
+    }
+
+    /*
+     * Fixed size buffer, the length of a sub packet is written through a
+     * pointer which must not move while the chain is appended.
+     */
+    buf = QuicMemMalloc(TLS_CERT_COMP_MAX_LEN);
+    if (buf == NULL) {
+        return QUIC_FLOW_RET_ERROR;
+    }
+
+    WPacketStaticBufInit(&tmp, buf, TLS_CERT_COMP_MAX_LEN);
+    if (WPacketPut1(&tmp, 0) < 0) {
+        goto out;
+    }
+
+    if (TlsCertChainBuild(s, &tmp, cpk, ext) == QUIC_FLOW_RET_ERROR) {
+        goto out;
+    }
+
+    if (TlsCertCompress(alg, buf, WPacket_get_written(&tmp), &comp,
+                &comp_len) < 0) {
+        goto out;
+    }
+
+    wlen = WPacket_get_written(pkt);
+    if (WPacketPut2(pkt, alg) < 0 ||
+            WPacketPut3(pkt, WPacket_get_written(&tmp)) < 0 ||
+            WPacketSubMemcpyU24(pkt, comp, comp_len) < 0) {
+        goto out;
+    }
+
+    len = WPacket_get_written(pkt) - wlen;
+    QuicCertChainCacheSetComp(cpk->cache, alg, WPacket_get_curr(pkt) - len,
+                                len);
+    ret = QUIC_FLOW_RET_FINISH;
+out:
+    QuicMemFree(comp);
+    WPacketCleanup(&tmp);
+    QuicMemFree(buf);
+    return ret;
+}
+
 QuicFlowReturn TlsCertVerifyBuild(TLS *s, WPacket *pkt)
 {
-    if (TlsConstructCertVerify(s, pkt) < 0) {
+    int ret = 0;
+
+    ret = TlsConstructCertVerify(s, pkt);
+    if (ret < 0) {
         return QUIC_FLOW_RET_ERROR;
     }
 
+    if (ret > 0) {
+        return QUIC_FLOW_RET_WANT_ASYNC;
+    }
+
     return QUIC_FLOW_RET_FINISH;
 }
 
@@ -451,14 +598,14 @@ QuicFlowReturn TlsFinishedBuild(TLS *s, void *packet)
         slen = TLS_MD_CLIENT_FINISH_LABEL_LEN;
     }
 
-    finish_md_len = TlsFinalFinishMac(s, sender, slen, s->finish_md);
+    finish_md_len = TlsFinalFinishMac(s, sender, slen, s->hs->finish_md);
     if (finish_md_len == 0) {
         return QUIC_FLOW_RET_ERROR;
     }
 
-    s->finish_md_len = finish_md_len;
+    s->hs->finish_md_len = finish_md_len;
 
-    if (WPacketMemcpy(pkt, s->finish_md, finish_md_len) < 0) {
+    if (WPacketMemcpy(pkt, s->hs->finish_md, finish_md_len) < 0) {
         return QUIC_FLOW_RET_ERROR;
     }
 
@@ -469,12 +616,12 @@ int TlsFinishedCheck(TLS *s, RPacket *pkt)
 {
     size_t len = 0;
 
-    len = s->peer_finish_md_len;
+    len = s->hs->peer_finish_md_len;
     if (RPacketRemaining(pkt) != len) {
         return -1;
     }
 
-    if (QuicMemCmp(RPacketData(pkt), s->peer_finish_md, len) != 0) {
+    if (QuicMemCmp(RPacketData(pkt), s->hs->peer_finish_md, len) != 0) {
         return -1;
     }
 
@@ -492,37 +639,107 @@ int TlsInit(TLS *s, QUIC_CTX *ctx)
         return -1;
     }
 
-    s->cert = QuicCertDup(ctx->cert);
-    if (s->cert == NULL) {
+    s->hs = QuicMemCalloc(sizeof(*s->hs));
+    if (s->hs == NULL) {
         return -1;
     }
 
-    if (QuicDataDup(&s->ext.alpn, &ctx->ext.alpn) < 0) {
+    s->config = TlsConfigGet(ctx);
+    if (s->config == NULL) {
         return -1;
     }
 
-    if (!QuicDataIsEmpty(&ctx->ext.supported_groups)) {
-        if (QuicDataDupU16(&s->ext.supported_groups,
-                    &ctx->ext.supported_groups) < 0) {
-            return -1;
-        }
+    s->cert = s->config->cert;
+    s->ext.alpn = s->config->alpn;
+    s->ext.supported_groups = s->config->supported_groups;
+    s->ext.trans_param = s->config->trans_param;
+    s->ext.ticket_ring = ctx->ext.ticket_keys;
+
+    return 0;
+}
+
+/*
+ * Move @s over to @conf, e.g. the one of the virtual host named in SNI.
+ * Settings changed on the connection itself are kept.
+ */
+void TlsConfigSwitch(TLS *s, TlsConfig *conf)
+{
+    TlsConfig *old = s->config;
+
+    if (conf == old) {
+        return;
     }
 
-    s->ext.ticket_key = ctx->ext.ticket_key;
+    TlsConfigUpRef(conf);
+    if (s->cert == old->cert) {
+        s->cert = conf->cert;
+    }
 
-    INIT_HLIST_HEAD(&s->cipher_list);
+    if (s->ext.alpn.data == old->alpn.data) {
+        s->ext.alpn = conf->alpn;
+    }
 
-    if (TlsCreateCipherList(&s->cipher_list, TLS_CIPHERS_DEF,
-                                sizeof(TLS_CIPHERS_DEF) - 1) < 0) {
-        QUIC_LOG("Create cipher list failed\n");
-        return -1;
+    if (s->ext.supported_groups.data == old->supported_groups.data) {
+        s->ext.supported_groups = conf->supported_groups;
     }
 
-    return 0;
+    if (!s->ext.trans_param_set) {
+        s->ext.trans_param = conf->trans_param;
+    }
+
+    s->config = conf;
+    TlsConfigFree(old);
+}
+
+static void TlsHandshakeSecretFree(TLS *s)
+{
+    if (s->hs == NULL) {
+        return;
+    }
+
+    OPENSSL_cleanse(s->hs, sizeof(*s->hs));
+    QuicMemFree(s->hs);
+    s->hs = NULL;
+}
+
+/*
+ * Release the state only used by handshake once it is confirmed. Secrets
+ * needed after handshake (application traffic secrets for key update and
+ * resumption master secret for NewSessionTicket) are kept.
+ */
+void TlsHandshakeDiscard(TLS *s)
+{
+    TlsHandshakeSecretFree(s);
+
+    QuicEvpMdCtxFree(s->handshake_dgst);
+    s->handshake_dgst = NULL;
+    QuicEvpMdCtxFree(s->handshake_dgst_copy);
+    s->handshake_dgst_copy = NULL;
+    EVP_PKEY_free(s->peer_kexch_key);
+    s->peer_kexch_key = NULL;
+    EVP_PKEY_free(s->kexch_key);
+    s->kexch_key = NULL;
+    TlsKeySharesFree(s);
+
+    QuicMemFree((void *)s->shared_sigalgs);
+    s->shared_sigalgs = NULL;
+    s->shared_sigalgs_len = 0;
+    s->tmp.sigalg = NULL;
+    QuicDataFree(&s->tmp.peer_cert_sigalgs);
+    QuicDataFree(&s->ext.peer_supported_groups);
+    QuicDataFree(&s->ext.peer_sigalgs);
+    QuicDataFree(&s->alpn_proposed);
+
+    if (QuicBufShrink(&s->buffer, TLS_POST_HANDSHAKE_BUF_LEN) < 0) {
+        QUIC_LOG("Shrink TLS buffer failed\n");
+    }
 }
 
 void TlsFree(TLS *s)
 {
+    TlsHandshakeSecretFree(s);
+    QuicAsyncJobFree(s->async_job);
+
     QuicDataFree(&s->alpn_selected);
     QuicDataFree(&s->alpn_proposed);
 
@@ -531,18 +748,26 @@ void TlsFree(TLS *s)
     }
 
     X509_free(s->peer_cert);
-    EVP_MD_CTX_free(s->handshake_dgst);
+    QuicEvpMdCtxFree(s->handshake_dgst);
+    QuicEvpMdCtxFree(s->handshake_dgst_copy);
     EVP_PKEY_free(s->peer_kexch_key);
     EVP_PKEY_free(s->kexch_key);
+    TlsKeySharesFree(s);
     QuicMemFree((void *)s->shared_sigalgs);
     QuicDataFree(&s->tmp.peer_cert_sigalgs);
-    QuicDataFree(&s->ext.supported_groups);
     QuicDataFree(&s->ext.peer_supported_groups);
     QuicDataFree(&s->ext.peer_sigalgs);
-    QuicDataFree(&s->ext.alpn);
 
-    TlsDestroyCipherList(&s->cipher_list);
-    QuicCertFree(s->cert);
+    if (s->config != NULL) {
+        TlsConfigDataFree(&s->ext.supported_groups,
+                            &s->config->supported_groups);
+        TlsConfigDataFree(&s->ext.alpn, &s->config->alpn);
+        if (s->cert != s->config->cert) {
+            QuicCertFree(s->cert);
+        }
+        TlsConfigFree(s->config);
+    }
+
     QuicBufFree(&s->buffer);
 }
 
@@ -15,6 +15,7 @@
 #include "base.h"
 #include "cert.h"
 #include "tls_cipher.h"
+#include "tls_config.h"
 #include "types.h"
 #include "sig_alg.h"
 #include "q_buff.h"
@@ -24,6 +25,8 @@
 #define TLS_CIPHESUITE_LEN_SIZE sizeof(uint16_t)
 
 #define TLS_MESSAGE_MAX_LEN     16384
+/* Only NewSessionTicket is expected after handshake */
+#define TLS_POST_HANDSHAKE_BUF_LEN  512
 #define TLS_VERSION_1_2         0x0303
 #define TLS_VERSION_1_3         0x0304
 
@@ -88,16 +91,49 @@ typedef enum {
     TLS_EARLY_DATA_FINISHED_READING
 } TlsEarlyDataState;
 
+/* Values of s->ext.early_data */
+#define TLS_EARLY_DATA_NOT_SENT     0
+#define TLS_EARLY_DATA_REJECTED     1
+#define TLS_EARLY_DATA_ACCEPTED     2
+
 typedef struct {
     uint8_t tick_hmac_key[TLSEXT_TICK_KEY_LENGTH];
     uint8_t tick_aes_key[TLSEXT_TICK_KEY_LENGTH];
     uint8_t tick_key_name[TLSEXT_KEYNAME_LENGTH];
 } TlsTicketKey;
 
+typedef struct TlsTicketKeyRing TlsTicketKeyRing;
+
 typedef struct {
     QuicFlowReturn (*handshake)(TLS *);
 } TlsMethod;
 
+typedef struct {
+    uint16_t group_id;
+    EVP_PKEY *pkey;
+} TlsKeyShare;
+
+/*
+ * Secrets and transcript hashes only used during handshake.
+ */
+typedef struct {
+    uint8_t early_secret[EVP_MAX_MD_SIZE];
+    /* Transcript hash of ClientHello, for client_early_traffic_secret */
+    uint8_t client_hello_hash[EVP_MAX_MD_SIZE];
+    uint8_t handshake_secret[EVP_MAX_MD_SIZE];
+    uint8_t master_secret[EVP_MAX_MD_SIZE];
+    uint8_t client_finished_secret[EVP_MAX_MD_SIZE];
+    uint8_t server_finished_secret[EVP_MAX_MD_SIZE];
+    uint8_t handshake_traffic_hash[EVP_MAX_MD_SIZE];
+    uint8_t server_finished_hash[EVP_MAX_MD_SIZE];
+    uint8_t cert_verify_hash[EVP_MAX_MD_SIZE];
+    size_t cert_verify_hash_len;
+    uint8_t finish_md[EVP_MAX_MD_SIZE];
+    size_t finish_md_len;
+    uint8_t peer_finish_md[EVP_MAX_MD_SIZE];
+    size_t peer_finish_md_len;
+} TlsHandshakeSecret;
+
 struct Tls {
     TlsState handshake_state;
     TlsEarlyDataState early_data_state;
@@ -105,39 +141,42 @@ struct Tls {
     uint64_t server:1;
     uint64_t alpn_sent:1;
     uint64_t hit:1; //reusing a session
+    /* Peer Finished read, the big read buffer is not needed any more */
+    uint64_t buffer_release:1;
     uint8_t client_random[TLS_RANDOM_BYTE_LEN];
     uint8_t server_random[TLS_RANDOM_BYTE_LEN];
-    struct hlist_head cipher_list;
+    /* Shared with the other connections of the context */
+    TlsConfig *config;
     size_t handshake_msg_len;
     QUIC_BUFFER buffer;
+    /* Points to config->cert unless changed on this connection */
     QuicCert *cert;
     const TlsCipher *handshake_cipher;
     EVP_PKEY *kexch_key;
     EVP_PKEY *peer_kexch_key;
+    /* Keys of the shares offered in ClientHello, one per group */
+    TlsKeyShare *key_shares;
+    size_t key_shares_num;
+    size_t key_shares_cap;
     EVP_MD_CTX *handshake_dgst;
+    /* Finalised in place of handshake_dgst for intermediate hashes */
+    EVP_MD_CTX *handshake_dgst_copy;
     X509 *peer_cert;
     const SigAlgLookup *peer_sigalg;
     uint16_t group_id;
     uint16_t psk_kex_mode;
     uint32_t lifetime_hint;
     uint32_t max_early_data;
+    /* Early data sent by client or received by server */
+    uint64_t early_data_count;
     uint64_t next_ticket_nonce;
-    uint8_t early_secret[EVP_MAX_MD_SIZE];
-    uint8_t handshake_secret[EVP_MAX_MD_SIZE];
-    uint8_t master_secret[EVP_MAX_MD_SIZE];
     uint8_t resumption_master_secret[EVP_MAX_MD_SIZE];
-    uint8_t client_finished_secret[EVP_MAX_MD_SIZE];
-    uint8_t server_finished_secret[EVP_MAX_MD_SIZE];
     uint8_t client_app_traffic_secret[EVP_MAX_MD_SIZE];
     uint8_t server_app_traffic_secret[EVP_MAX_MD_SIZE];
-    uint8_t handshake_traffic_hash[EVP_MAX_MD_SIZE];
-    uint8_t server_finished_hash[EVP_MAX_MD_SIZE];
-    uint8_t cert_verify_hash[EVP_MAX_MD_SIZE];
-    size_t cert_verify_hash_len;
-    uint8_t finish_md[EVP_MAX_MD_SIZE];
-    size_t finish_md_len;
-    uint8_t peer_finish_md[EVP_MAX_MD_SIZE];
-    size_t peer_finish_md_len;
+    /* Freed when handshake confirmed */
+    TlsHandshakeSecret *hs;
+    /* Pending private key operation */
+    QUIC_ASYNC_JOB *async_job;
     QUIC_DATA alpn_selected;
     QUIC_DATA alpn_proposed;
     const SigAlgLookup **shared_sigalgs;
@@ -146,19 +185,33 @@ struct Tls {
         QuicCertPkey *cert;
         const SigAlgLookup *sigalg;
         QUIC_DATA peer_cert_sigalgs;
+        /* Message type written instead of the default one */
+        TlsMessageType msg_type;
     } tmp;
     /* TLS extensions. */
     struct {
         char *hostname;
         QuicTransParams trans_param;
+        /* trans_param set on the connection, differs from the config */
+        bool trans_param_set;
+        /* EncryptedExtensions template being recorded */
+        TlsEeTemplate *ee_template;
         QUIC_DATA alpn;
         QUIC_DATA supported_groups;
         QUIC_DATA peer_supported_groups;
         QUIC_DATA peer_sigalgs;
-        size_t key_share_max_group_idx;
-        TlsTicketKey ticket_key;
+        /* Group the server selected last time, 0 if unknown */
+        uint16_t key_share_predicted;
+        bool key_share_predict_hit;
+        TlsTicketKeyRing *ticket_ring;
+        /* Resumed with a ticket of a rotated out key */
+        bool ticket_renew;
         uint16_t tick_identity;
-//        uint16_t early_data;
+        /* Certificate compression algorithm chosen by server */
+        uint16_t cert_comp_alg;
+        uint8_t early_data;
+        /* ClientHello passed the freshness and anti-replay checks */
+        bool early_data_fresh;
     } ext;
 };
 
@@ -177,8 +230,11 @@ extern uint8_t *quic_random_test;
 #endif
 
 int TlsInit(TLS *, QUIC_CTX *);
+void TlsConfigSwitch(TLS *, TlsConfig *);
 void TlsFree(TLS *);
+void TlsHandshakeDiscard(TLS *);
 QuicFlowReturn TlsConnect(TLS *tls);
+void TlsClntGroupForget(TLS *);
 QuicFlowReturn TlsAccept(TLS *tls);
 QuicFlowReturn TlsDoHandshake(TLS *);
 int TlsDoProcess(TLS *, RPacket *, WPacket *, const TlsProcess *,
@@ -194,6 +250,8 @@ int TlsConstructCertVerify(TLS *, WPacket *);
 int TlsFinishedCheck(TLS *, RPacket *);
 QuicFlowReturn TlsCertChainBuild(TLS *s, WPacket *, QuicCertPkey *,
                                 TlsExtConstructor);
+QuicFlowReturn TlsCompressedCertBuild(TLS *, WPacket *, QuicCertPkey *,
+                                TlsExtConstructor);
 QuicFlowReturn TlsCertVerifyBuild(TLS *s, WPacket *pkt);
 QuicFlowReturn TlsFinishedBuild(TLS *, void *);
 
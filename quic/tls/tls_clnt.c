@@ -5,6 +5,7 @@
 #include "tls.h"
 
 #include <assert.h>
+#include <arpa/inet.h>
 #include <tbquic/types.h>
 #include <tbquic/quic.h>
 #include <tbquic/cipher.h>
@@ -18,6 +19,7 @@
 #include "tls_lib.h"
 #include "mem.h"
 #include "session.h"
+#include "clnt_session_cache.h"
 #include "log.h"
 
 static QuicFlowReturn TlsClientHelloBuild(TLS *, void *);
@@ -31,6 +33,7 @@ static QuicFlowReturn TlsServerCertProc(TLS *, void *);
 static QuicFlowReturn TlsCertVerifyProc(TLS *, void *);
 static QuicFlowReturn TlsClientFinishedProc(TLS *, void *);
 static QuicFlowReturn TlsClntNewSessionTicketProc(TLS *, void *);
+static int TlsClientHelloPostWork(TLS *);
 static int TlsClientEncExtPostWork(TLS *);
 static int TlsClientFinishedPostWork(TLS *);
 static int TlsClientSkipCheckCertRequest(TLS *);
@@ -48,6 +51,7 @@ static const TlsProcess client_proc[TLS_MT_MESSAGE_TYPE_MAX] = {
         .msg_type = TLS_MT_CLIENT_HELLO,
         .handler = TlsClientHelloBuild,
         .pkt_type = QUIC_PKT_TYPE_INITIAL,
+        .post_work = TlsClientHelloPostWork,
     },
     [TLS_ST_CR_SERVER_HELLO] = {
         .flow_state = QUIC_FLOW_READING,
@@ -132,13 +136,112 @@ static const TlsProcess client_proc[TLS_MT_MESSAGE_TYPE_MAX] = {
 
 QuicFlowReturn TlsConnect(TLS *tls)
 {
-    return TlsHandshake(tls, client_proc, QUIC_NELEM(client_proc));
+    QuicFlowReturn ret;
+
+    ret = TlsHandshake(tls, client_proc, QUIC_NELEM(client_proc));
+    if (ret == QUIC_FLOW_RET_ERROR) {
+        TlsClntGroupForget(tls);
+    }
+
+    return ret;
+}
+
+static uint16_t TlsClntPeerPort(QUIC *quic)
+{
+    Address addr = quic->dest;
+    int fd = -1;
+
+    /* Connected socket given by QUIC_set_fd() */
+    if (addr.addrlen == 0 && quic->wbio != NULL) {
+        fd = BIO_get_fd(quic->wbio, NULL);
+        addr.addrlen = sizeof(addr.addr);
+        if (fd < 0 || getpeername(fd, &addr.addr.in, &addr.addrlen) != 0) {
+            return 0;
+        }
+    }
+
+    switch (addr.addr.in.sa_family) {
+        case AF_INET:
+            return ntohs(addr.addr.in4.sin_port);
+        case AF_INET6:
+            return ntohs(addr.addr.in6.sin6_port);
+        default:
+            return 0;
+    }
+}
+
+static void TlsClntSessionKey(TLS *s, QuicClntSessionKey *key)
+{
+    key->hostname = s->ext.hostname;
+    key->alpn = &s->ext.alpn;
+    key->port = TlsClntPeerPort(QuicTlsTrans(s));
+}
+
+/*
+ * Resume from the context cache unless the application has set a session
+ * by itself.
+ */
+static void TlsClntSessionCacheGet(TLS *s)
+{
+    QUIC *quic = QuicTlsTrans(s);
+    QuicClntSessionCache *cache = quic->ctx->clnt_session_cache;
+    QuicClntSessionKey key = {};
+
+    if (cache == NULL || quic->session != NULL) {
+        return;
+    }
+
+    TlsClntSessionKey(s, &key);
+    quic->session = QuicClntSessionCacheGet(cache, &key);
+}
+
+static void TlsClntGroupPredict(TLS *s)
+{
+    QUIC *quic = QuicTlsTrans(s);
+    TlsGroupCache *cache = quic->ctx->group_cache;
+
+    if (cache == NULL || s->ext.hostname == NULL ||
+            s->key_shares != NULL) {
+        return;
+    }
+
+    s->ext.key_share_predicted = TlsGroupCacheGet(cache, s->ext.hostname,
+                                        TlsClntPeerPort(quic));
+}
+
+void TlsClntGroupForget(TLS *s)
+{
+    QUIC *quic = QuicTlsTrans(s);
+    TlsGroupCache *cache = quic->ctx->group_cache;
+
+    if (cache == NULL || s->ext.hostname == NULL) {
+        return;
+    }
+
+    TlsGroupCacheDrop(cache, s->ext.hostname, TlsClntPeerPort(quic));
+}
+
+static void TlsClntGroupLearn(TLS *s)
+{
+    QUIC *quic = QuicTlsTrans(s);
+    TlsGroupCache *cache = quic->ctx->group_cache;
+
+    if (cache == NULL || s->ext.hostname == NULL) {
+        return;
+    }
+
+    s->ext.key_share_predict_hit = (s->ext.key_share_predicted == s->group_id);
+    TlsGroupCacheUpdate(cache, s->ext.hostname, TlsClntPeerPort(quic),
+                        s->ext.key_share_predicted, s->group_id);
 }
 
 static QuicFlowReturn TlsClientHelloBuild(TLS *s, void *packet)
 {
     WPacket *pkt = packet;
 
+    TlsClntSessionCacheGet(s);
+    TlsClntGroupPredict(s);
+
     if (WPacketPut2(pkt, TLS_VERSION_1_2) < 0) {
         QUIC_LOG("Put leagacy version failed\n");
         return QUIC_FLOW_RET_ERROR;
@@ -233,7 +336,7 @@ static QuicFlowReturn TlsServerHelloProc(TLS *tls, void *packet)
         return QUIC_FLOW_RET_ERROR;
     }
 
-    cipher = TlsCipherMatchListById(&tls->cipher_list, id);
+    cipher = TlsCipherMatchListById(&tls->config->cipher_list, id);
     if (cipher == NULL) {
         QUIC_LOG("Get shared cipher failed\n");
         return QUIC_FLOW_RET_ERROR;
@@ -250,6 +353,8 @@ static QuicFlowReturn TlsServerHelloProc(TLS *tls, void *packet)
         return QUIC_FLOW_RET_ERROR;
     }
 
+    TlsClntGroupLearn(tls);
+
     tls->handshake_msg_len = RPacketTotalLen(pkt);
     //change cipher state
     if (QuicCreateHandshakeServerDecoders(quic) < 0) {
@@ -295,7 +400,7 @@ static QuicFlowReturn TlsServerCertProc(TLS *s, void *packet)
     uint32_t cert_list_len = 0;
     uint32_t cert_len = 0;
     int v = 0;
-    QuicFlowReturn ret = QUIC_FLOW_RET_FINISH;
+    QuicFlowReturn ret = QUIC_FLOW_RET_ERROR;
 
     if (RPacketGet1(pkt, &context) < 0) {
         return QUIC_FLOW_RET_ERROR;
@@ -368,8 +473,9 @@ static QuicFlowReturn TlsServerCertProc(TLS *s, void *packet)
     s->peer_cert = x;
     x = NULL;
 
-    if (TlsHandshakeHash(s, s->cert_verify_hash, sizeof(s->cert_verify_hash),
-                &s->cert_verify_hash_len) < 0) {
+    if (TlsHandshakeHash(s, s->hs->cert_verify_hash,
+                sizeof(s->hs->cert_verify_hash),
+                &s->hs->cert_verify_hash_len) < 0) {
         goto out;
     }
 
@@ -443,7 +549,8 @@ static QuicFlowReturn TlsClientFinishedProc(TLS *s, void *packet)
         return QUIC_FLOW_RET_ERROR;
     }
 
-    if (TlsGenerateMasterSecret(s, s->master_secret, s->handshake_secret,
+    if (TlsGenerateMasterSecret(s, s->hs->master_secret,
+                                    s->hs->handshake_secret,
                                     &secret_size) < 0) {
         return QUIC_FLOW_RET_ERROR;
     }
@@ -464,6 +571,7 @@ static QuicFlowReturn TlsClntNewSessionTicketProc(TLS *s, void *packet)
     QUIC *quic = QuicTlsTrans(s);
     RPacket *pkt = packet;
     QuicSessionTicket *t = NULL;
+    QuicClntSessionKey key = {};
     RPacket nonce = {};
     const uint8_t *ticket = NULL;
     uint32_t ticket_lifetime_hint = 0;
@@ -506,6 +614,7 @@ static QuicFlowReturn TlsClntNewSessionTicketProc(TLS *s, void *packet)
     }
 
     QuicSessionTicketAdd(quic->session, t);
+    quic->session->peer_param = quic->peer_param;
 
     if (TlsClntParseExtensions(s, pkt, TLSEXT_NEW_SESSION_TICKET, NULL,
                 0) < 0) {
@@ -517,24 +626,89 @@ static QuicFlowReturn TlsClntNewSessionTicketProc(TLS *s, void *packet)
         return QUIC_FLOW_RET_ERROR;
     }
 
+    if (quic->ctx->clnt_session_cache != NULL) {
+        TlsClntSessionKey(s, &key);
+        if (QuicClntSessionCacheAdd(quic->ctx->clnt_session_cache, &key,
+                    s->handshake_cipher, quic->session, t) < 0) {
+            QUIC_LOG("Cache session failed\n");
+        }
+    }
+
     QUIC_LOG("innn\n");
     return QUIC_FLOW_RET_FINISH;
 }
 
-static int TlsClientEncExtPostWork(TLS *s)
+/*
+ * RFC 9001 4.6.1. Streams may be opened already for 0-RTT with the
+ * remembered transport parameters.
+ */
+static int TlsClientHelloPostWork(TLS *s)
 {
     QUIC *quic = QuicTlsTrans(s);
 
+    if (s->early_data_state != TLS_EARLY_DATA_CONNECTING) {
+        return 0;
+    }
+
+    quic->peer_param = quic->session->peer_param;
     if (QuicStreamInit(quic) < 0) {
         return -1;
     }
 
+    if (QuicCreateZeroRttClientEncoders(quic) < 0) {
+        return -1;
+    }
+
+    s->early_data_state = TLS_EARLY_DATA_WRITING;
+    return 0;
+}
+
+static int TlsClientEncExtPostWork(TLS *s)
+{
+    QUIC *quic = QuicTlsTrans(s);
+
+    if (s->early_data_state == TLS_EARLY_DATA_WRITING &&
+            s->ext.early_data != TLS_EARLY_DATA_ACCEPTED) {
+        s->ext.early_data = TLS_EARLY_DATA_REJECTED;
+    }
+
+    if (quic->stream.bucket == NULL) {
+        return QuicStreamInit(quic);
+    }
+
+    /* RFC 9000 7.4.1. Accepted 0-RTT must not see the limits reduced */
+    if (s->ext.early_data == TLS_EARLY_DATA_ACCEPTED &&
+            (quic->peer_param.initial_max_stream_bidi <
+             quic->session->peer_param.initial_max_stream_bidi ||
+             quic->peer_param.initial_max_stream_uni <
+             quic->session->peer_param.initial_max_stream_uni ||
+             quic->peer_param.initial_max_data <
+             quic->session->peer_param.initial_max_data)) {
+        QUIC_LOG("Transport parameters reduced for 0-RTT\n");
+        return -1;
+    }
+
+    QuicStreamLimitUpdate(quic);
     return 0;
 }
 
 static int TlsClientFinishedPostWork(TLS *s)
 {
-    return QuicCreateAppDataClientEncoders(QuicTlsTrans(s));
+    QUIC *quic = QuicTlsTrans(s);
+
+    if (QuicCreateAppDataClientEncoders(quic) < 0) {
+        return -1;
+    }
+
+    /*
+     * Early data still unsent or rejected goes out with 1-RTT keys, once
+     * Finished is queued, the server can not decrypt it before that.
+     */
+    if (s->early_data_state == TLS_EARLY_DATA_WRITING) {
+        s->early_data_state = TLS_EARLY_DATA_WRITE_FLUSH;
+    }
+
+    return 0;
 }
 
 static int TlsClientSkipCheckCertRequest(TLS *s)
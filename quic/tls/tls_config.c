@@ -0,0 +1,126 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "tls_config.h"
+
+#include "quic_local.h"
+#include "tls_cipher.h"
+#include "mem.h"
+#include "log.h"
+
+static TlsConfig *TlsConfigNew(QUIC_CTX *ctx)
+{
+    TlsConfig *conf = NULL;
+
+    conf = QuicMemCalloc(sizeof(*conf));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    conf->refcnt = 1;
+    INIT_HLIST_HEAD(&conf->cipher_list);
+    TlsEeTemplateCacheInit(&conf->ee_template);
+    if (TlsCreateCipherList(&conf->cipher_list, TLS_CIPHERS_DEF,
+                                sizeof(TLS_CIPHERS_DEF) - 1) < 0) {
+        QUIC_LOG("Create cipher list failed\n");
+        goto err;
+    }
+
+    conf->cert = QuicCertDup(ctx->cert);
+    if (conf->cert == NULL) {
+        goto err;
+    }
+
+    if (QuicDataDup(&conf->alpn, &ctx->ext.alpn) < 0) {
+        goto err;
+    }
+
+    if (!QuicDataIsEmpty(&ctx->ext.supported_groups)) {
+        if (QuicDataDupU16(&conf->supported_groups,
+                    &ctx->ext.supported_groups) < 0) {
+            goto err;
+        }
+    }
+
+    conf->trans_param = ctx->ext.trans_param;
+
+    return conf;
+err:
+    TlsConfigFree(conf);
+    return NULL;
+}
+
+/*
+ * Return the config of @ctx with a reference taken, built on first use
+ * after a change.
+ */
+TlsConfig *TlsConfigGet(QUIC_CTX *ctx)
+{
+    TlsConfig *conf = NULL;
+
+    pthread_mutex_lock(&ctx->tls_config_lock);
+    if (ctx->tls_config == NULL) {
+        ctx->tls_config = TlsConfigNew(ctx);
+    }
+
+    conf = ctx->tls_config;
+    if (conf != NULL) {
+        TlsConfigUpRef(conf);
+    }
+    pthread_mutex_unlock(&ctx->tls_config_lock);
+
+    return conf;
+}
+
+void TlsConfigUpRef(TlsConfig *conf)
+{
+    __atomic_add_fetch(&conf->refcnt, 1, __ATOMIC_RELAXED);
+}
+
+void TlsConfigFree(TlsConfig *conf)
+{
+    if (conf == NULL) {
+        return;
+    }
+
+    if (__atomic_sub_fetch(&conf->refcnt, 1, __ATOMIC_ACQ_REL) > 0) {
+        return;
+    }
+
+    TlsEeTemplateCacheFree(&conf->ee_template);
+    TlsDestroyCipherList(&conf->cipher_list);
+    QuicCertFree(conf->cert);
+    QuicDataFree(&conf->alpn);
+    QuicDataFree(&conf->supported_groups);
+    QuicMemFree(conf);
+}
+
+/*
+ * Must be called whenever a setting copied into the config changes on
+ * @ctx.
+ */
+void TlsConfigReset(QUIC_CTX *ctx)
+{
+    TlsConfig *conf = NULL;
+
+    pthread_mutex_lock(&ctx->tls_config_lock);
+    conf = ctx->tls_config;
+    ctx->tls_config = NULL;
+    pthread_mutex_unlock(&ctx->tls_config_lock);
+
+    TlsConfigFree(conf);
+}
+
+/*
+ * Connection settings point into the config until they are set on the
+ * connection itself, only free what is owned.
+ */
+void TlsConfigDataFree(QUIC_DATA *data, const QUIC_DATA *shared)
+{
+    if (data->data != shared->data) {
+        QuicDataFree(data);
+    }
+
+    QuicDataSet(data, NULL, 0);
+}
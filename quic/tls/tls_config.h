@@ -0,0 +1,36 @@
+#ifndef TBQUIC_QUIC_TLS_TLS_CONFIG_H_
+#define TBQUIC_QUIC_TLS_TLS_CONFIG_H_
+
+#include <tbquic/types.h>
+
+#include "base.h"
+#include "list.h"
+#include "cert.h"
+#include "transport.h"
+#include "ee_template.h"
+
+/*
+ * TLS settings of a context compiled once and shared read-only by all the
+ * connections created from it. Changing the context drops it, connections
+ * keep the one they were created with.
+ */
+typedef struct {
+    int refcnt;
+    /* Cipher suites in preference order */
+    struct hlist_head cipher_list;
+    /* Certificates, keys and signature algorithms */
+    QuicCert *cert;
+    QUIC_DATA alpn;
+    QUIC_DATA supported_groups;
+    QuicTransParams trans_param;
+    /* Server EncryptedExtensions built from the settings above */
+    TlsEeTemplateCache ee_template;
+} TlsConfig;
+
+TlsConfig *TlsConfigGet(QUIC_CTX *);
+void TlsConfigUpRef(TlsConfig *);
+void TlsConfigFree(TlsConfig *);
+void TlsConfigReset(QUIC_CTX *);
+void TlsConfigDataFree(QUIC_DATA *, const QUIC_DATA *);
+
+#endif
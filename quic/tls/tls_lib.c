@@ -11,6 +11,7 @@
 #include <openssl/hmac.h>
 #include <tbquic/ec.h>
 #include <tbquic/tls.h>
+#include <tbquic/cipher.h>
 
 #include "tls.h"
 #include "base.h"
@@ -20,6 +21,10 @@
 #include "quic_local.h"
 #include "common.h"
 #include "cipher.h"
+#include "evp.h"
+#include "async.h"
+#include "key_share.h"
+#include "ticket_key.h"
 #include "mem.h"
 #include "log.h"
 
@@ -305,7 +310,7 @@ EVP_PKEY *TlsGeneratePkey(EVP_PKEY *pm)
         return NULL;
     }
 
-    pctx = EVP_PKEY_CTX_new(pm, NULL);
+    pctx = QuicEvpPkeyCtxNew(pm);
     if (pctx == NULL) {
         goto err;
     }
@@ -324,7 +329,8 @@ err:
     return pkey;
 }
 
-EVP_PKEY *TlsGeneratePkeyGroup(TLS *tls, uint16_t id)
+/* Generate a private key of group @id */
+EVP_PKEY *TlsGenerateKeyGroup(uint16_t id)
 {
     EVP_PKEY *pkey = NULL;
     EVP_PKEY_CTX *pctx = NULL;
@@ -338,9 +344,9 @@ EVP_PKEY *TlsGeneratePkeyGroup(TLS *tls, uint16_t id)
  
     gtype = g_info->flags & TLS_CURVE_TYPE;
     if (gtype == TLS_CURVE_CUSTOM) {
-        pctx = EVP_PKEY_CTX_new_id(g_info->nid, NULL);
+        pctx = QuicEvpPkeyCtxNewId(g_info->nid);
     } else {
-        pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+        pctx = QuicEvpPkeyCtxNewId(EVP_PKEY_EC);
     }
 
     if (pctx == NULL) {
@@ -366,6 +372,111 @@ out:
     return pkey;
 }
 
+EVP_PKEY *TlsGeneratePkeyGroup(TLS *tls, uint16_t id)
+{
+    TlsKeySharePool *pool = QuicTlsTrans(tls)->ctx->key_share_pool;
+    EVP_PKEY *pkey = NULL;
+
+    if (pool != NULL) {
+        pkey = TlsKeySharePoolGet(pool, id);
+        if (pkey != NULL) {
+            return pkey;
+        }
+    }
+
+    return TlsGenerateKeyGroup(id);
+}
+
+static TlsKeyShare *TlsKeyShareFind(TLS *tls, uint16_t id)
+{
+    size_t i = 0;
+
+    for (i = 0; i < tls->key_shares_num; i++) {
+        if (tls->key_shares[i].group_id == id) {
+            return &tls->key_shares[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Key of the share offered for group id, generated on first use so a
+ * ClientHello built again offers the same keys.
+ */
+EVP_PKEY *TlsKeyShareGet(TLS *tls, uint16_t id)
+{
+    TlsKeyShare *share = NULL;
+    EVP_PKEY *pkey = NULL;
+    const uint16_t *pgroups = NULL;
+    size_t pgroupslen = 0;
+
+    share = TlsKeyShareFind(tls, id);
+    if (share != NULL) {
+        return share->pkey;
+    }
+
+    if (tls->key_shares == NULL) {
+        TlsGetSupportedGroups(tls, &pgroups, &pgroupslen);
+        if (pgroupslen == 0) {
+            return NULL;
+        }
+        tls->key_shares = QuicMemCalloc(sizeof(*tls->key_shares) *
+                                        pgroupslen);
+        if (tls->key_shares == NULL) {
+            return NULL;
+        }
+        tls->key_shares_cap = pgroupslen;
+    }
+
+    if (tls->key_shares_num == tls->key_shares_cap) {
+        return NULL;
+    }
+
+    pkey = TlsGeneratePkeyGroup(tls, id);
+    if (pkey == NULL) {
+        return NULL;
+    }
+
+    share = &tls->key_shares[tls->key_shares_num++];
+    share->group_id = id;
+    share->pkey = pkey;
+    return pkey;
+}
+
+/*
+ * Hand the key of the group the server selected over to the caller, NULL
+ * if no share of that group was offered.
+ */
+EVP_PKEY *TlsKeyShareTake(TLS *tls, uint16_t id)
+{
+    TlsKeyShare *share = NULL;
+    EVP_PKEY *pkey = NULL;
+
+    share = TlsKeyShareFind(tls, id);
+    if (share == NULL) {
+        return NULL;
+    }
+
+    pkey = share->pkey;
+    share->pkey = NULL;
+    return pkey;
+}
+
+void TlsKeySharesFree(TLS *tls)
+{
+    size_t i = 0;
+
+    for (i = 0; i < tls->key_shares_num; i++) {
+        EVP_PKEY_free(tls->key_shares[i].pkey);
+    }
+
+    QuicMemFree(tls->key_shares);
+    tls->key_shares = NULL;
+    tls->key_shares_num = 0;
+    tls->key_shares_cap = 0;
+}
+
 /*
  * Generate parameters from a group ID
  */
@@ -391,7 +502,7 @@ EVP_PKEY *TlsGenerateParamGroup(uint16_t id)
         return NULL;
     }
 
-    pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    pctx = QuicEvpPkeyCtxNewId(EVP_PKEY_EC);
     if (pctx == NULL) {
         goto err;
     }
@@ -442,7 +553,7 @@ int TlsDigestCachedRecords(TLS *tls)
 
     hdata = QuicBufHead(buffer);
     //QuicPrint(hdata, hdatalen);
-    tls->handshake_dgst = EVP_MD_CTX_new();
+    tls->handshake_dgst = QuicEvpMdCtxNew();
     if (tls->handshake_dgst == NULL) {
         return -1;
     }
@@ -476,12 +587,15 @@ int TlsFinishMac(TLS *tls, const uint8_t *buf, size_t len)
     return 0;
 }
 
+/*
+ * Hash of the transcript so far, the running digest is copied into a
+ * context kept for the whole handshake so nothing is allocated per call.
+ */
 int TlsHandshakeHash(TLS *tls, uint8_t *hash, size_t outlen, size_t *hash_size)
 {
     EVP_MD_CTX *ctx = NULL;
     EVP_MD_CTX *hdgst = tls->handshake_dgst;
     int hashlen = 0;
-    int ret = -1;
 
     if (hdgst == NULL) {
         QUIC_LOG("Hdgst is NULL\n");
@@ -494,27 +608,42 @@ int TlsHandshakeHash(TLS *tls, uint8_t *hash, size_t outlen, size_t *hash_size)
         return -1;
     }
 
-    ctx = EVP_MD_CTX_new();
+    ctx = tls->handshake_dgst_copy;
     if (ctx == NULL) {
-        return -1;
+        ctx = QuicEvpMdCtxNew();
+        if (ctx == NULL) {
+            return -1;
+        }
+        tls->handshake_dgst_copy = ctx;
     }
 
     if (!EVP_MD_CTX_copy_ex(ctx, hdgst)) {
-        goto err;
+        return -1;
     }
     
     if (EVP_DigestFinal_ex(ctx, hash, NULL) <= 0) {
-        goto err;
+        return -1;
     }
 
     if (hash_size != NULL) {
         *hash_size = hashlen;
     }
-    ret = 0;
 
- err:
-    EVP_MD_CTX_free(ctx);
-    return ret;
+    return 0;
+}
+
+/*
+ * RFC 8446 7.1. client_early_traffic_secret only covers ClientHello, it is
+ * needed before the handshake digest is set up by the cipher suite.
+ */
+int TlsClientHelloHash(TLS *s, const EVP_MD *md, const uint8_t *msg,
+                        size_t len)
+{
+    if (EVP_Digest(msg, len, s->hs->client_hello_hash, NULL, md, NULL) <= 0) {
+        return -1;
+    }
+
+    return 0;
 }
 
 int TlsDeriveSecrets(TLS *tls, const EVP_MD *md, const uint8_t *in_secret,
@@ -551,7 +680,7 @@ int TlsGenerateSecret(const EVP_MD *md, const uint8_t *prevsecret,
         return -1;
     }
 
-    pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+    pctx = QuicEvpPkeyCtxNewId(EVP_PKEY_HKDF);
     if (pctx == NULL) {
         return -1;
     }
@@ -571,19 +700,19 @@ int TlsGenerateSecret(const EVP_MD *md, const uint8_t *prevsecret,
         prevsecret = default_zeros;
         prevsecretlen = 0;
     } else {
-        mctx = EVP_MD_CTX_new();
+        mctx = QuicEvpMdCtxNew();
         /* The pre-extract derive step uses a hash of no messages */
         if (mctx == NULL) {
             goto out;
         }
         
         if (EVP_DigestInit_ex(mctx, md, NULL) <= 0) {
-            EVP_MD_CTX_free(mctx);
+            QuicEvpMdCtxFree(mctx);
             goto out;
         }
         
         retval = EVP_DigestFinal_ex(mctx, hash, NULL);
-        EVP_MD_CTX_free(mctx);
+        QuicEvpMdCtxFree(mctx);
         if (retval <= 0) {
             goto out;
         }
@@ -646,7 +775,7 @@ int TlsKeyDerive(TLS *s, EVP_PKEY *privkey, EVP_PKEY *pubkey)
         return -1;
     }
 
-    pctx = EVP_PKEY_CTX_new(privkey, NULL);
+    pctx = QuicEvpPkeyCtxNew(privkey);
     if (EVP_PKEY_derive_init(pctx) <= 0) {
         goto out;
     }
@@ -670,17 +799,17 @@ int TlsKeyDerive(TLS *s, EVP_PKEY *privkey, EVP_PKEY *pubkey)
 
     md = TlsHandshakeMd(s);
     if (!s->hit) {
-        ret = TlsGenerateSecret(md, NULL, NULL, 0, s->early_secret);
+        ret = TlsGenerateSecret(md, NULL, NULL, 0, s->hs->early_secret);
         if (ret < 0) {
             goto out;
         }
     }
 
-    ret = TlsGenerateSecret(md, s->early_secret, pms, pmslen,
-                            s->handshake_secret);
+    ret = TlsGenerateSecret(md, s->hs->early_secret, pms, pmslen,
+                            s->hs->handshake_secret);
 #ifdef QUIC_TEST
     if (QuicHandshakeSecretHook) {
-        QuicHandshakeSecretHook(s->handshake_secret);
+        QuicHandshakeSecretHook(s->hs->handshake_secret);
     }
 #endif
 out:
@@ -959,7 +1088,6 @@ int TlsChooseSigalg(TLS *s)
     }
 
     s->tmp.cert = &s->cert->pkeys[lu->sig_idx];
-    s->cert->key = s->tmp.cert;
     s->tmp.sigalg = lu;
 
     return 0;
@@ -993,9 +1121,9 @@ int TlsGetCertVerifyData(TLS *s, uint8_t *tbs, void **hdata, size_t *hdatalen)
      */
     if (s->handshake_state == TLS_ST_CR_CERT_VERIFY
             || s->handshake_state  == TLS_ST_SR_CERT_VERIFY) {
-        memcpy(tbs + TLS_TBS_PREAMBLE_SIZE, s->cert_verify_hash,
-                s->cert_verify_hash_len);
-        hashlen = s->cert_verify_hash_len;
+        memcpy(tbs + TLS_TBS_PREAMBLE_SIZE, s->hs->cert_verify_hash,
+                s->hs->cert_verify_hash_len);
+        hashlen = s->hs->cert_verify_hash_len;
     } else if (TlsHandshakeHash(s, tbs + TLS_TBS_PREAMBLE_SIZE, EVP_MAX_MD_SIZE,
                 &hashlen) < 0) {
         return -1;
@@ -1017,7 +1145,7 @@ int TlsDoCertVerify(TLS *s, const uint8_t *data, size_t len, EVP_PKEY *pkey,
     size_t hdatalen = 0;
     int ret = -1;
 
-    mctx = EVP_MD_CTX_new();
+    mctx = QuicEvpMdCtxNew();
     if (mctx == NULL) {
         return -1;
     }
@@ -1045,28 +1173,109 @@ int TlsDoCertVerify(TLS *s, const uint8_t *data, size_t len, EVP_PKEY *pkey,
 
     ret = 0;
 err:
-    EVP_MD_CTX_free(mctx);
+    QuicEvpMdCtxFree(mctx);
+    return ret;
+}
+
+int TlsSign(EVP_PKEY *pkey, const EVP_MD *md, bool pss, const uint8_t *tbs,
+                size_t tbs_len, uint8_t *sig, size_t *siglen)
+{
+    EVP_MD_CTX *mctx = NULL;
+    EVP_PKEY_CTX *pctx = NULL;
+    int ret = -1;
+
+    mctx = QuicEvpMdCtxNew();
+    if (mctx == NULL) {
+        return -1;
+    }
+
+    if (EVP_DigestSignInit(mctx, &pctx, md, NULL, pkey) <= 0) {
+        goto err;
+    }
+
+    if (pss) {
+        if (EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PSS_PADDING) <= 0) {
+            goto err;
+        }
+
+        if (EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx,
+                    RSA_PSS_SALTLEN_DIGEST) <= 0) {
+            goto err;
+        }
+    }
+
+    if (EVP_DigestSign(mctx, sig, siglen, tbs, tbs_len) <= 0) {
+        goto err;
+    }
+
+    ret = 0;
+err:
+    QuicEvpMdCtxFree(mctx);
+    return ret;
+}
+
+static int TlsPutCertVerify(WPacket *pkt, const SigAlgLookup *lu,
+                                const uint8_t *sig, size_t siglen)
+{
+    if (WPacketPut2(pkt, lu->sigalg) < 0) {
+        return -1;
+    }
+
+    return WPacketSubMemcpyU16(pkt, sig, siglen);
+}
+
+/*
+ * Take the result of the private key operation started by a previous call.
+ * Return 1 if it's still running.
+ */
+static int TlsAsyncCertVerify(TLS *s, WPacket *pkt, const SigAlgLookup *lu)
+{
+    QUIC_ASYNC_JOB *job = s->async_job;
+    int ret = -1;
+
+    switch (QuicAsyncJobStatus(job)) {
+        case QUIC_ASYNC_JOB_PENDING:
+            return 1;
+        case QUIC_ASYNC_JOB_DONE:
+            ret = TlsPutCertVerify(pkt, lu, job->sig, job->sig_len);
+            break;
+        default:
+            QUIC_LOG("Async sign failed\n");
+            break;
+    }
+
+    s->async_job = NULL;
+    QuicAsyncJobFree(job);
     return ret;
 }
 
+/*
+ * Return 1 if the signature is offloaded to the async executor, the
+ * message must be built again when the job is done.
+ */
 int TlsConstructCertVerify(TLS *s, WPacket *pkt)
 {
+    const QUIC_CTX *ctx = QuicTlsTrans(s)->ctx;
     const SigAlgLookup *lu = s->tmp.sigalg;
+    QUIC_ASYNC_JOB *job = NULL;
     EVP_PKEY *pkey = NULL;
     const EVP_MD *md = NULL;
-    EVP_MD_CTX *mctx = NULL;
-    EVP_PKEY_CTX *pctx = NULL;
     void *hdata = NULL;
     uint8_t *sig = NULL;
     uint8_t tbs[TLS_TBS_PREAMBLE_SIZE + EVP_MAX_MD_SIZE] = {};
     size_t hdatalen = 0;
     size_t siglen = 0;
-    QuicFlowReturn ret = QUIC_FLOW_RET_ERROR;
+    bool pss = false;
+    int ret = -1;
 
     if (lu == NULL || s->tmp.cert == NULL) {
         return -1;
     }
 
+    if (s->async_job != NULL) {
+        return TlsAsyncCertVerify(s, pkt, lu);
+    }
+
     pkey = s->tmp.cert->privatekey;
     if (pkey == NULL) {
         return -1;
@@ -1077,52 +1286,43 @@ int TlsConstructCertVerify(TLS *s, WPacket *pkt)
         return -1;
     }
 
-    mctx = EVP_MD_CTX_new();
-    if (mctx == NULL) {
+    if (TlsGetCertVerifyData(s, tbs, &hdata, &hdatalen) < 0) {
         return -1;
     }
 
-    if (TlsGetCertVerifyData(s, tbs, &hdata, &hdatalen) < 0) {
-        goto err;
-    }
+    pss = (lu->sig == EVP_PKEY_RSA_PSS);
+    if (QuicAsyncEnabled(ctx)) {
+        job = QuicAsyncJobNew(pkey, md, pss, hdata, hdatalen);
+        if (job == NULL) {
+            return -1;
+        }
 
-    if (WPacketPut2(pkt, lu->sigalg) < 0) {
-        goto err;
+        if (QuicAsyncJobSubmit(ctx, job) < 0) {
+            QuicAsyncJobFree(job);
+            return -1;
+        }
+
+        s->async_job = job;
+        return 1;
     }
 
     siglen = EVP_PKEY_size(pkey);
     sig = QuicMemMalloc(siglen);
     if (sig == NULL) {
-        goto err;
-    }
-
-    if (EVP_DigestSignInit(mctx, &pctx, md, NULL, pkey) <= 0) {
-        goto err;
-    }
-
-    if (lu->sig == EVP_PKEY_RSA_PSS) {
-        if (EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PSS_PADDING) <= 0) {
-            goto err;
-        }
-
-        if (EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx,
-                    RSA_PSS_SALTLEN_DIGEST) <= 0) {
-            goto err;
-        }
+        return -1;
     }
 
-    if (EVP_DigestSign(mctx, sig, &siglen, hdata, hdatalen) <= 0) {
+    if (TlsSign(pkey, md, pss, hdata, hdatalen, sig, &siglen) < 0) {
         goto err;
     }
 
-    if (WPacketSubMemcpyU16(pkt, sig, siglen) < 0) {
+    if (TlsPutCertVerify(pkt, lu, sig, siglen) < 0) {
         goto err;
     }
 
     ret = 0;
 err:
     QuicMemFree(sig);
-    EVP_MD_CTX_free(mctx);
     return ret;
 }
 
@@ -1134,7 +1334,7 @@ size_t TlsFinalFinishMac(TLS *s, const char *str, size_t slen, uint8_t *out)
 {
     const EVP_MD *md = TlsHandshakeMd(s);
     EVP_PKEY *key = NULL;
-    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    EVP_MD_CTX *ctx = QuicEvpMdCtxNew();
     uint8_t hash[EVP_MAX_MD_SIZE];
     size_t hashlen = 0;
     size_t ret = 0;
@@ -1150,11 +1350,9 @@ size_t TlsFinalFinishMac(TLS *s, const char *str, size_t slen, uint8_t *out)
     }
 #endif
     if (str == tls_md_server_finish_label) {
-        key = EVP_PKEY_new_raw_private_key(EVP_PKEY_HMAC, NULL,
-                                           s->server_finished_secret, hashlen);
+        key = QuicEvpHmacKeyNew(s->hs->server_finished_secret, hashlen);
     } else if (str == tls_md_client_finish_label) {
-        key = EVP_PKEY_new_raw_private_key(EVP_PKEY_HMAC, NULL,
-                                           s->client_finished_secret, hashlen);
+        key = QuicEvpHmacKeyNew(s->hs->client_finished_secret, hashlen);
     } else {
         QUIC_LOG("Unknown label!\n");
         goto err;
@@ -1172,7 +1370,7 @@ size_t TlsFinalFinishMac(TLS *s, const char *str, size_t slen, uint8_t *out)
     ret = hashlen;
  err:
     EVP_PKEY_free(key);
-    EVP_MD_CTX_free(ctx);
+    QuicEvpMdCtxFree(ctx);
     return ret;
 }
 
@@ -1189,9 +1387,9 @@ int TlsTakeMac(TLS *s)
         slen = TLS_MD_CLIENT_FINISH_LABEL_LEN;
     }
 
-    s->peer_finish_md_len = TlsFinalFinishMac(s, sender, slen,
-                                s->peer_finish_md);
-    if (s->peer_finish_md_len == 0) {
+    s->hs->peer_finish_md_len = TlsFinalFinishMac(s, sender, slen,
+                                s->hs->peer_finish_md);
+    if (s->hs->peer_finish_md_len == 0) {
         return -1;
     }
 
@@ -1214,12 +1412,12 @@ int TlsPskDoBinder(TLS *s, const EVP_MD *md, uint8_t *msgstart,
     int ret = -1;
     
     if (TlsGenerateSecret(md, NULL, t->master_key, t->master_key_length,
-                            s->early_secret) < 0) {
+                            s->hs->early_secret) < 0) {
         QUIC_LOG("Generate Secret failed\n");
         return -1;
     }
 
-    mctx = EVP_MD_CTX_new();
+    mctx = QuicEvpMdCtxNew();
     if (mctx == NULL) {
         return -1;
     }
@@ -1234,9 +1432,9 @@ int TlsPskDoBinder(TLS *s, const EVP_MD *md, uint8_t *msgstart,
         goto err;
     }
 
-    if (TLS13HkdfExpandLabel(md, s->early_secret, hashsize, resumption_label,
-                        sizeof(resumption_label) - 1, hash, hashsize, binderkey,
-                        hashsize) < 0) {
+    if (TLS13HkdfExpandLabel(md, s->hs->early_secret, hashsize,
+                        resumption_label, sizeof(resumption_label) - 1,
+                        hash, hashsize, binderkey, hashsize) < 0) {
         QUIC_LOG("TLS HKDF Expand Label failed\n");
         goto err;
     }
@@ -1261,8 +1459,7 @@ int TlsPskDoBinder(TLS *s, const EVP_MD *md, uint8_t *msgstart,
         goto err;
     }
 
-    mackey = EVP_PKEY_new_raw_private_key(EVP_PKEY_HMAC, NULL, finishedkey,
-                                            hashsize);
+    mackey = QuicEvpHmacKeyNew(finishedkey, hashsize);
     if (mackey == NULL) {
         QUIC_LOG("New PKEY failed\n");
         goto err;
@@ -1300,14 +1497,14 @@ int TlsPskDoBinder(TLS *s, const EVP_MD *md, uint8_t *msgstart,
 
 err:
     EVP_PKEY_free(mackey);
-    EVP_MD_CTX_free(mctx);
+    QuicEvpMdCtxFree(mctx);
     return ret;
 }
 
 int TlsDecryptTicket(TLS *s, const uint8_t *etick, size_t eticklen,
                         QUIC_SESSION **sess)
 {
-    TlsTicketKey *tk = &s->ext.ticket_key;
+    TlsTicketKey key = {};
     HMAC_CTX *hctx = NULL;
     EVP_CIPHER_CTX *ctx = NULL;
     const uint8_t *p = NULL;
@@ -1318,33 +1515,34 @@ int TlsDecryptTicket(TLS *s, const uint8_t *etick, size_t eticklen,
     int declen = 0;
     int slen = 0;
     int ret = -1;
+    bool renew = false;
 
     if (eticklen < TLSEXT_KEYNAME_LENGTH + EVP_MAX_IV_LENGTH) {
         return -1;
     }
 
-    hctx = HMAC_CTX_new();
+    hctx = QuicHmacCtxNew();
     if (hctx == NULL) {
         goto end;
     }
 
-    ctx = EVP_CIPHER_CTX_new();
+    ctx = QuicEvpCipherCtxNew();
     if (ctx == NULL) {
         goto end;
     }
 
-    if (QuicMemCmp(etick, tk->tick_key_name, TLSEXT_KEYNAME_LENGTH) != 0) {
-        QUIC_LOG("Tick Key Name invalid\n");
+    if (TlsTicketKeyRingFind(s->ext.ticket_ring, etick, &key, &renew) < 0) {
+        QUIC_LOG("Tick Key Name unknown\n");
         goto end;
     }
 
-    if (!HMAC_Init_ex(hctx, tk->tick_hmac_key, sizeof(tk->tick_hmac_key),
-                EVP_sha256(), NULL)) {
+    if (!HMAC_Init_ex(hctx, key.tick_hmac_key, sizeof(key.tick_hmac_key),
+                QuicMd(QUIC_DIGEST_SHA256), NULL)) {
         goto end;
     }
 
-    if (!EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, tk->tick_aes_key,
-                etick + TLSEXT_KEYNAME_LENGTH)) {
+    if (!EVP_DecryptInit_ex(ctx, QuicFindCipherByAlg(QUIC_ALG_AES_256_CBC),
+                NULL, key.tick_aes_key, etick + TLSEXT_KEYNAME_LENGTH)) {
         goto end;
     }
 
@@ -1404,10 +1602,12 @@ int TlsDecryptTicket(TLS *s, const uint8_t *etick, size_t eticklen,
 
     QuicMemFree(sdec);
 
+    s->ext.ticket_renew = renew;
     ret = 0;
 end:
-    EVP_CIPHER_CTX_free(ctx);
-    HMAC_CTX_free(hctx);
+    OPENSSL_cleanse(&key, sizeof(key));
+    QuicEvpCipherCtxFree(ctx);
+    QuicHmacCtxFree(hctx);
 
     return ret;
 }
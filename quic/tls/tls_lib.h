@@ -35,11 +35,16 @@ int TlsCheckFfdhGroup(uint16_t);
 int TlsCheckInList(TLS *, uint16_t, const uint16_t *, size_t);
 const EVP_MD *TlsHandshakeMd(TLS *);
 EVP_PKEY *TlsGeneratePkey(EVP_PKEY *);
+EVP_PKEY *TlsGenerateKeyGroup(uint16_t);
 EVP_PKEY *TlsGeneratePkeyGroup(TLS *, uint16_t);
+EVP_PKEY *TlsKeyShareGet(TLS *, uint16_t);
+EVP_PKEY *TlsKeyShareTake(TLS *, uint16_t);
+void TlsKeySharesFree(TLS *);
 EVP_PKEY *TlsGenerateParamGroup(uint16_t);
 int TlsDigestCachedRecords(TLS *);
 int TlsFinishMac(TLS *, const uint8_t *, size_t);
 int TlsHandshakeHash(TLS *, uint8_t *, size_t, size_t *);
+int TlsClientHelloHash(TLS *, const EVP_MD *, const uint8_t *, size_t);
 int TlsDeriveSecrets(TLS *, const EVP_MD *, const uint8_t *, const uint8_t *,
                         size_t, const uint8_t *, uint8_t *);
 int TlsDeriveFinishedKey(TLS *, const EVP_MD *, const uint8_t *, uint8_t *,
@@ -53,6 +58,8 @@ int TlsSetServerSigAlgs(TLS *);
 int TlsChooseSigalg(TLS *);
 const EVP_MD *TlsLookupMd(const SigAlgLookup *);
 int TlsDoCertVerify(TLS *, const uint8_t *, size_t, EVP_PKEY *, const EVP_MD *);
+int TlsSign(EVP_PKEY *, const EVP_MD *, bool, const uint8_t *, size_t,
+                uint8_t *, size_t *);
 size_t TlsFinalFinishMac(TLS *, const char *, size_t, uint8_t *);
 int TlsTakeMac(TLS *);
 QUIC_SESSION *TlsGetSession(TLS *s);
@@ -44,7 +44,7 @@ int TlsPutCipherList(TLS *tls, WPacket *pkt)
         return -1;
     }
 
-    hlist_for_each_entry(node, &tls->cipher_list, node)	{
+    hlist_for_each_entry(node, &tls->config->cipher_list, node)	{
         assert(node->cipher != NULL);
         if (WPacketPut2(pkt, node->cipher->id) < 0) {
             ret = -1;
@@ -9,6 +9,7 @@
 #include <openssl/hmac.h>
 #include <tbquic/types.h>
 #include <tbquic/quic.h>
+#include <tbquic/cipher.h>
 
 #include "extension.h"
 #include "quic_local.h"
@@ -19,7 +20,9 @@
 #include "format.h"
 #include "mem.h"
 #include "session.h"
+#include "evp.h"
 #include "asn1.h"
+#include "ticket_key.h"
 #include "log.h"
 
 #define TLS_NEW_SESS_TICKET_NUM     2
@@ -141,6 +144,49 @@ QuicFlowReturn TlsAccept(TLS *tls)
     return TlsHandshake(tls, server_proc, QUIC_NELEM(server_proc));
 }
 
+/*
+ * RFC 8446 4.2.10. Early data is accepted only with the first PSK of a
+ * ticket issued for early data, under the same cipher suite and ALPN.
+ */
+static int TlsSrvrEarlyDataCheck(TLS *s)
+{
+    QUIC *quic = QuicTlsTrans(s);
+    QUIC_SESSION *sess = quic->session;
+
+    if (s->ext.early_data != TLS_EARLY_DATA_REJECTED) {
+        return 0;
+    }
+
+    if (!s->hit || s->ext.tick_identity != 0 || s->max_early_data == 0) {
+        return 0;
+    }
+
+    if (!s->ext.early_data_fresh) {
+        return 0;
+    }
+
+    if (sess == NULL || sess->max_early_data == 0 ||
+            sess->cipher->id != s->handshake_cipher->id) {
+        return 0;
+    }
+
+    if (sess->alpn_selected.len != s->alpn_selected.len ||
+            (s->alpn_selected.len != 0 && !QuicDataEq(&sess->alpn_selected,
+                                                    &s->alpn_selected))) {
+        QUIC_LOG("ALPN changed, reject early data\n");
+        return 0;
+    }
+
+    if (QuicCreateZeroRttClientDecoders(quic) < 0) {
+        return -1;
+    }
+
+    s->ext.early_data = TLS_EARLY_DATA_ACCEPTED;
+    s->early_data_state = TLS_EARLY_DATA_READING;
+    s->early_data_count = 0;
+    return 0;
+}
+
 static QuicFlowReturn TlsClientHelloProc(TLS *s, void *packet)
 {
     RPacket *pkt = packet;
@@ -171,7 +217,7 @@ static QuicFlowReturn TlsClientHelloProc(TLS *s, void *packet)
         return QUIC_FLOW_RET_ERROR;
     }
 
-    hlist_for_each_entry(server_cipher, &s->cipher_list, node) {
+    hlist_for_each_entry(server_cipher, &s->config->cipher_list, node) {
         assert(server_cipher->cipher != NULL);
         cipher = TlsCipherMatchListById(&cipher_list,
                 server_cipher->cipher->id);
@@ -213,6 +259,10 @@ static QuicFlowReturn TlsClientHelloProc(TLS *s, void *packet)
         return QUIC_FLOW_RET_ERROR;
     }
 
+    if (TlsSrvrEarlyDataCheck(s) < 0) {
+        return QUIC_FLOW_RET_ERROR;
+    }
+
     return QUIC_FLOW_RET_FINISH;
 }
 
@@ -242,6 +292,12 @@ static QuicFlowReturn TlsSrvrFinishedProc(TLS *s, void *packet)
         return QUIC_FLOW_RET_ERROR;
     }
 
+    /* RFC 9001 4.9.3. 0-RTT packets are not expected after 1-RTT keys */
+    if (s->early_data_state == TLS_EARLY_DATA_READING) {
+        QuicZeroRttDiscard(quic, false);
+        s->early_data_state = TLS_EARLY_DATA_FINISHED_READING;
+    }
+
     QUIC_LOG("Finished\n");
     return QUIC_FLOW_RET_FINISH;
 }
@@ -286,8 +342,7 @@ static QuicFlowReturn TlsServerHelloBuild(TLS *s, void *packet)
 
 static QuicFlowReturn TlsSrvrEncryptedExtBuild(TLS *s, void *packet)
 {
-    if (TlsSrvrConstructExtensions(s, packet, TLSEXT_ENCRYPTED_EXT, NULL,
-                0) < 0) {
+    if (TlsSrvrConstructEncryptedExt(s, packet) < 0) {
         QUIC_LOG("Construct extension failed\n");
         return QUIC_FLOW_RET_ERROR;
     }
@@ -309,6 +364,10 @@ static QuicFlowReturn TlsSrvrServerCertBuild(TLS *s, void *packet)
     WPacket *pkt = packet;
     QuicCertPkey *cpk = s->tmp.cert;
 
+    if (s->ext.cert_comp_alg != 0) {
+        return TlsCompressedCertBuild(s, pkt, cpk, TlsSrvrConstructExtensions);
+    }
+
     if (WPacketPut1(pkt, 0) < 0) {
         QUIC_LOG("Put session ID len failed\n");
         return QUIC_FLOW_RET_ERROR;
@@ -343,8 +402,8 @@ int TlsConstructStatelessTicket(TLS *s, QUIC_SESSION *sess,
     EVP_CIPHER_CTX *ctx = NULL;
     HMAC_CTX *hctx = NULL;
     QuicSessionTicket *t = NULL;
-    const EVP_CIPHER *cipher = EVP_aes_256_cbc();
-    TlsTicketKey *tk = &s->ext.ticket_key;
+    const EVP_CIPHER *cipher = QuicFindCipherByAlg(QUIC_ALG_AES_256_CBC);
+    TlsTicketKey key = {};
     uint8_t *encdata1 = NULL;
     uint8_t *encdata2 = NULL;
     uint8_t *macdata1 = NULL;
@@ -368,6 +427,8 @@ int TlsConstructStatelessTicket(TLS *s, QUIC_SESSION *sess,
         goto err;
     }
 
+    TlsTicketKeyRingCurrent(s->ext.ticket_ring, &key);
+
     slen = i2dQuicSession(sess, NULL);
     if (slen <= 0) {
         goto err;
@@ -388,12 +449,12 @@ int TlsConstructStatelessTicket(TLS *s, QUIC_SESSION *sess,
         senc = QuicSessionTicketTest(senc, &slen);
     }
 #endif
-    ctx = EVP_CIPHER_CTX_new();
+    ctx = QuicEvpCipherCtxNew();
     if (ctx == NULL) {
         goto err;
     }
 
-    hctx = HMAC_CTX_new();
+    hctx = QuicHmacCtxNew();
     if (hctx == NULL) {
         goto err;
     }
@@ -408,16 +469,16 @@ int TlsConstructStatelessTicket(TLS *s, QUIC_SESSION *sess,
         iv_len = QuicSessionTicketIvTest(iv);
     }
 #endif
-    if (!EVP_EncryptInit_ex(ctx, cipher, NULL, tk->tick_aes_key, iv)) {
+    if (!EVP_EncryptInit_ex(ctx, cipher, NULL, key.tick_aes_key, iv)) {
         goto err;
     }
 
-    if (!HMAC_Init_ex(hctx, tk->tick_hmac_key, sizeof(tk->tick_hmac_key),
-                EVP_sha256(), NULL)) {
+    if (!HMAC_Init_ex(hctx, key.tick_hmac_key, sizeof(key.tick_hmac_key),
+                QuicMd(QUIC_DIGEST_SHA256), NULL)) {
         goto err;
     }
 
-    QuicMemcpy(key_name, tk->tick_key_name, sizeof(tk->tick_key_name));
+    QuicMemcpy(key_name, key.tick_key_name, sizeof(key.tick_key_name));
 
     if (WPacketPut4(pkt, t->lifetime_hint) < 0) {
         goto err;
@@ -511,12 +572,66 @@ int TlsConstructStatelessTicket(TLS *s, QUIC_SESSION *sess,
 
     err = 0;
 err:
+    OPENSSL_cleanse(&key, sizeof(key));
     QuicMemFree(senc);
-    HMAC_CTX_free(hctx);
-    EVP_CIPHER_CTX_free(ctx);
+    QuicHmacCtxFree(hctx);
+    QuicEvpCipherCtxFree(ctx);
     return err;
 }
 
+/*
+ * The secrets stay in the shared session cache, the ticket is only the
+ * random ID of the cache entry.
+ */
+static int TlsConstructStatefulTicket(TLS *s, QUIC_SESSION *sess,
+        WPacket *pkt, RPacket *tick_nonce)
+{
+    QuicSessionCache *cache = QuicTlsTrans(s)->ctx->session_cache;
+    QuicSessionTicket *t = NULL;
+    uint8_t id[QUIC_SESSION_CACHE_ID_LEN] = {};
+
+    t = QuicSessionTicketPickTail(sess);
+    if (t == NULL) {
+        return -1;
+    }
+
+    if (RAND_bytes(id, sizeof(id)) <= 0) {
+        return -1;
+    }
+
+    if (QuicSessionCacheAdd(cache, id, sess) < 0) {
+        return -1;
+    }
+
+    if (WPacketPut4(pkt, t->lifetime_hint) < 0) {
+        return -1;
+    }
+
+    if (WPacketPut4(pkt, t->age_add) < 0) {
+        return -1;
+    }
+
+    if (WPacketSubMemcpyU8(pkt, RPacketData(tick_nonce),
+                RPacketRemaining(tick_nonce)) < 0) {
+        return -1;
+    }
+
+    return WPacketSubMemcpyU16(pkt, id, sizeof(id));
+}
+
+/*
+ * A client resumed with a ticket of the current key still holds valid
+ * tickets, one replacement is enough. A full set is issued otherwise.
+ */
+static uint64_t TlsSrvrNewSessionTicketNum(TLS *s)
+{
+    if (s->hit && !s->ext.ticket_renew) {
+        return 1;
+    }
+
+    return TLS_NEW_SESS_TICKET_NUM;
+}
+
 static QuicFlowReturn TlsSrvrNewSessionTicketBuild(TLS *s, void *packet)
 {
     WPacket *pkt = packet;
@@ -539,6 +654,11 @@ static QuicFlowReturn TlsSrvrNewSessionTicketBuild(TLS *s, void *packet)
         goto err;
     }
 
+    sess->max_early_data = s->max_early_data;
+    if (QuicDataDup(&sess->alpn_selected, &s->alpn_selected) < 0) {
+        goto err;
+    }
+
     if (RAND_bytes(age_add_u.age_add_c, sizeof(age_add_u)) <= 0) {
         return QUIC_FLOW_RET_ERROR;
     }
@@ -566,7 +686,11 @@ static QuicFlowReturn TlsSrvrNewSessionTicketBuild(TLS *s, void *packet)
 
     QuicSessionTicketAdd(sess, t);
     t = NULL;
-    if (TlsConstructStatelessTicket(s, sess, pkt, &tnonce) < 0) {
+    if (QuicTlsTrans(s)->ctx->session_cache != NULL) {
+        if (TlsConstructStatefulTicket(s, sess, pkt, &tnonce) < 0) {
+            goto err;
+        }
+    } else if (TlsConstructStatelessTicket(s, sess, pkt, &tnonce) < 0) {
         goto err;
     }
 
@@ -580,7 +704,7 @@ static QuicFlowReturn TlsSrvrNewSessionTicketBuild(TLS *s, void *packet)
 
 err:
     QuicSessionTicketFree(t);
-    if (s->next_ticket_nonce >= TLS_NEW_SESS_TICKET_NUM) {
+    if (s->next_ticket_nonce >= TlsSrvrNewSessionTicketNum(s)) {
         s->handshake_state = TLS_ST_SW_HANDSHAKE_DONE;
     }
     return ret;
@@ -630,7 +754,8 @@ static int TlsServerWriteFinishedPostWork(TLS *s)
     QUIC *quic = QuicTlsTrans(s);
     size_t secret_size = 0;
 
-    if (TlsGenerateMasterSecret(s, s->master_secret, s->handshake_secret,
+    if (TlsGenerateMasterSecret(s, s->hs->master_secret,
+                                    s->hs->handshake_secret,
                                     &secret_size) < 0) {
         return -1;
     }
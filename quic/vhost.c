@@ -0,0 +1,185 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "vhost.h"
+
+#include <string.h>
+#include <ctype.h>
+
+#include "extension.h"
+#include "mem.h"
+#include "log.h"
+
+#define QUIC_VHOST_FNV_OFFSET   0xcbf29ce484222325ULL
+#define QUIC_VHOST_FNV_PRIME    0x100000001b3ULL
+
+/*
+ * Copy @hostname into @name in lower case, return the length or -1 if it
+ * does not fit.
+ */
+static int QuicVhostNameLower(char *name, const char *hostname)
+{
+    size_t i = 0;
+
+    for (i = 0; hostname[i] != 0; i++) {
+        if (i >= TLSEXT_MAXLEN_HOST_NAME) {
+            return -1;
+        }
+        name[i] = tolower((unsigned char)hostname[i]);
+    }
+
+    name[i] = 0;
+    return i;
+}
+
+static uint64_t QuicVhostHash(const char *name)
+{
+    uint64_t hash = QUIC_VHOST_FNV_OFFSET;
+    const uint8_t *p = (const uint8_t *)name;
+
+    for (; *p != 0; p++) {
+        hash ^= *p;
+        hash *= QUIC_VHOST_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static QuicVhost *QuicVhostFind(QuicVhostTable *table, const char *name)
+{
+    QuicVhost *v = NULL;
+    uint64_t hash = QuicVhostHash(name);
+
+    v = __atomic_load_n(&table->buckets[hash & table->mask], __ATOMIC_ACQUIRE);
+    for (; v != NULL; v = v->next) {
+        if (v->hash == hash && strcmp(v->hostname, name) == 0) {
+            return v;
+        }
+    }
+
+    return NULL;
+}
+
+QuicVhostTable *QuicVhostTableNew(size_t hosts)
+{
+    QuicVhostTable *table = NULL;
+    size_t num = 1;
+
+    if (hosts == 0 || hosts > QUIC_VHOST_TABLE_BUCKET_MAX) {
+        return NULL;
+    }
+
+    while (num < hosts) {
+        num <<= 1;
+    }
+
+    table = QuicMemCalloc(sizeof(*table) + num * sizeof(table->buckets[0]));
+    if (table == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&table->lock, NULL);
+    table->mask = num - 1;
+
+    return table;
+}
+
+void QuicVhostTableFree(QuicVhostTable *table)
+{
+    QuicVhost *v = NULL;
+    QuicVhost *n = NULL;
+    size_t i = 0;
+
+    if (table == NULL) {
+        return;
+    }
+
+    for (i = 0; i <= table->mask; i++) {
+        for (v = table->buckets[i]; v != NULL; v = n) {
+            n = v->next;
+            TlsConfigFree(v->config);
+            QuicMemFree(v->hostname);
+            QuicMemFree(v);
+        }
+    }
+
+    pthread_mutex_destroy(&table->lock);
+    QuicMemFree(table);
+}
+
+/*
+ * Serve @hostname with @config, a reference of it is taken. A leading
+ * "*." matches exactly one label.
+ */
+int QuicVhostTableAdd(QuicVhostTable *table, const char *hostname,
+                        TlsConfig *config)
+{
+    QuicVhost *v = NULL;
+    QuicVhost **bucket = NULL;
+    char name[TLSEXT_MAXLEN_HOST_NAME + 1];
+
+    if (QuicVhostNameLower(name, hostname) <= 0) {
+        return -1;
+    }
+
+    v = QuicMemCalloc(sizeof(*v));
+    if (v == NULL) {
+        return -1;
+    }
+
+    v->hostname = QuicMemStrDup(name);
+    if (v->hostname == NULL) {
+        QuicMemFree(v);
+        return -1;
+    }
+
+    v->hash = QuicVhostHash(name);
+    v->config = config;
+    TlsConfigUpRef(config);
+
+    pthread_mutex_lock(&table->lock);
+    bucket = &table->buckets[v->hash & table->mask];
+    v->next = *bucket;
+    /* Readers see the entry only once it is complete */
+    __atomic_store_n(bucket, v, __ATOMIC_RELEASE);
+    table->num++;
+    pthread_mutex_unlock(&table->lock);
+
+    return 0;
+}
+
+/*
+ * Return the config serving @hostname, an exact match first and then the
+ * wildcard of its parent domain, NULL if none. No reference is taken, it
+ * stays valid as long as the table.
+ */
+TlsConfig *QuicVhostTableLookup(QuicVhostTable *table, const char *hostname)
+{
+    QuicVhost *v = NULL;
+    char *dot = NULL;
+    char name[TLSEXT_MAXLEN_HOST_NAME + 2];
+
+    /* Room for the '*' replacing the first label */
+    if (QuicVhostNameLower(&name[1], hostname) <= 0) {
+        return NULL;
+    }
+
+    v = QuicVhostFind(table, &name[1]);
+    if (v != NULL) {
+        return v->config;
+    }
+
+    dot = strchr(&name[1], '.');
+    if (dot == NULL || dot[1] == 0) {
+        return NULL;
+    }
+
+    dot[-1] = '*';
+    v = QuicVhostFind(table, &dot[-1]);
+    if (v == NULL) {
+        return NULL;
+    }
+
+    return v->config;
+}
@@ -0,0 +1,40 @@
+#ifndef TBQUIC_QUIC_VHOST_H_
+#define TBQUIC_QUIC_VHOST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "tls_config.h"
+
+#define QUIC_VHOST_TABLE_BUCKET_MAX  (1 << 20)
+
+typedef struct QuicVhost QuicVhost;
+
+struct QuicVhost {
+    QuicVhost *next;
+    uint64_t hash;
+    /* Lower case, "*.example.com" for a wildcard */
+    char *hostname;
+    TlsConfig *config;
+};
+
+/*
+ * Server name to TLS config of the virtual host. Hosts are only ever
+ * prepended to the bucket lists, and a host added again shadows the old
+ * entry, so lookups walk the lists without a lock. Entries live as long as
+ * the table.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t mask;
+    size_t num;
+    QuicVhost *buckets[];
+} QuicVhostTable;
+
+QuicVhostTable *QuicVhostTableNew(size_t);
+void QuicVhostTableFree(QuicVhostTable *);
+int QuicVhostTableAdd(QuicVhostTable *, const char *, TlsConfig *);
+TlsConfig *QuicVhostTableLookup(QuicVhostTable *, const char *);
+
+#endif
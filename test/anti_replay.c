@@ -0,0 +1,107 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "anti_replay.h"
+
+#define ANTI_REPLAY_TEST_RATE       100
+#define ANTI_REPLAY_TEST_WINDOW     10
+#define ANTI_REPLAY_TEST_KEY_LEN    32
+
+static int QuicAntiReplayTestCheck(QuicAntiReplay *ar, uint8_t v, time_t now)
+{
+    uint8_t key[ANTI_REPLAY_TEST_KEY_LEN] = {};
+
+    memset(key, v, sizeof(key));
+    return QuicAntiReplayDoCheck(ar, key, sizeof(key), now);
+}
+
+int QuicAntiReplayTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QuicAntiReplay *ar = NULL;
+    /* First second of a generation */
+    time_t now = 2 * ANTI_REPLAY_TEST_WINDOW * 1000;
+    time_t gen = 2 * ANTI_REPLAY_TEST_WINDOW;
+    pid_t pid = 0;
+    int status = 0;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    if (QuicCtxSetAntiReplay(ctx, ANTI_REPLAY_TEST_RATE, 0) == 0) {
+        goto out;
+    }
+
+    if (QuicCtxSetAntiReplay(ctx, ANTI_REPLAY_TEST_RATE,
+                ANTI_REPLAY_TEST_WINDOW) < 0) {
+        goto out;
+    }
+
+    ar = ctx->anti_replay;
+    if (QuicAntiReplayTestCheck(ar, 1, now) < 0 ||
+            QuicAntiReplayTestCheck(ar, 2, now) < 0) {
+        printf("New key rejected\n");
+        goto out;
+    }
+
+    if (QuicAntiReplayTestCheck(ar, 1, now + gen - 1) == 0) {
+        printf("Replay in the same generation accepted\n");
+        goto out;
+    }
+
+    if (QuicAntiReplayTestCheck(ar, 2, now + gen) == 0) {
+        printf("Replay in the next generation accepted\n");
+        goto out;
+    }
+
+    /* 1 was only seen two generations ago */
+    if (QuicAntiReplayTestCheck(ar, 1, now + 2 * gen) < 0) {
+        printf("Expired key still recorded\n");
+        goto out;
+    }
+
+    if (QuicAntiReplayDoCheck(ar, (const uint8_t *)"short", 5, now) == 0) {
+        goto out;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        goto out;
+    }
+
+    if (pid == 0) {
+        _exit(QuicAntiReplayTestCheck(ar, 0xA5, now + 2 * gen) < 0);
+    }
+
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+        goto out;
+    }
+
+    if (QuicAntiReplayTestCheck(ar, 0xA5, now + 2 * gen) == 0) {
+        printf("Key recorded by another process accepted\n");
+        goto out;
+    }
+
+    if (QuicCtxSetAntiReplay(ctx, 0, 0) < 0 || ctx->anti_replay != NULL) {
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
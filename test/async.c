@@ -0,0 +1,253 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <tbquic/quic.h>
+
+#include "async.h"
+#include "evp.h"
+
+static int QuicAsyncTestSubmit(QUIC_ASYNC_JOB *job, void *arg)
+{
+    int *called = arg;
+
+    (*called)++;
+    QuicAsyncJobSign(job);
+    QuicAsyncJobDone(job);
+    return 0;
+}
+
+/* Keep the job, it is signed only when the test says so */
+static int QuicAsyncTestDefer(QUIC_ASYNC_JOB *job, void *arg)
+{
+    QUIC_ASYNC_JOB **pending = arg;
+
+    if (*pending != NULL) {
+        return -1;
+    }
+
+    *pending = job;
+    return 0;
+}
+
+static EVP_PKEY *QuicAsyncTestKey(void)
+{
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_PKEY *pkey = NULL;
+
+    pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    if (pctx == NULL) {
+        return NULL;
+    }
+
+    if (EVP_PKEY_keygen_init(pctx) <= 0) {
+        goto out;
+    }
+
+    if (EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx,
+                NID_X9_62_prime256v1) <= 0) {
+        goto out;
+    }
+
+    if (EVP_PKEY_keygen(pctx, &pkey) <= 0) {
+        pkey = NULL;
+    }
+out:
+    EVP_PKEY_CTX_free(pctx);
+    return pkey;
+}
+
+static int QuicAsyncTestVerify(EVP_PKEY *pkey, QUIC_ASYNC_JOB *job)
+{
+    EVP_MD_CTX *mctx = NULL;
+    int ret = -1;
+
+    if (QuicAsyncJobStatus(job) != QUIC_ASYNC_JOB_DONE) {
+        printf("Async job status %d\n", QuicAsyncJobStatus(job));
+        return -1;
+    }
+
+    mctx = QuicEvpMdCtxNew();
+    if (mctx == NULL) {
+        return -1;
+    }
+
+    if (EVP_DigestVerifyInit(mctx, NULL, EVP_sha256(), NULL, pkey) <= 0) {
+        goto out;
+    }
+
+    if (EVP_DigestVerify(mctx, job->sig, job->sig_len, job->tbs,
+                job->tbs_len) <= 0) {
+        printf("Async signature verify failed\n");
+        goto out;
+    }
+
+    ret = 0;
+out:
+    QuicEvpMdCtxFree(mctx);
+    return ret;
+}
+
+int QuicAsyncSignTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC_ASYNC_JOB *job = NULL;
+    EVP_PKEY *pkey = NULL;
+    struct pollfd pfd = {};
+    static const uint8_t tbs[] = "TLS 1.3, server CertificateVerify";
+    uint64_t v = 0;
+    int called = 0;
+    int case_num = -1;
+
+    pkey = QuicAsyncTestKey();
+    if (pkey == NULL) {
+        goto out;
+    }
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    if (QuicCtxSetAsyncWorkers(ctx, 2) < 0) {
+        printf("Create async workers failed\n");
+        goto out;
+    }
+
+    job = QuicAsyncJobNew(pkey, EVP_sha256(), false, tbs, sizeof(tbs));
+    if (job == NULL) {
+        goto out;
+    }
+
+    if (QuicAsyncJobSubmit(ctx, job) < 0) {
+        goto out;
+    }
+
+    pfd.fd = job->efd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 5000) != 1) {
+        printf("Async job not done\n");
+        goto out;
+    }
+
+    if (read(job->efd, &v, sizeof(v)) != sizeof(v) || v != 1) {
+        goto out;
+    }
+
+    if (QuicAsyncTestVerify(pkey, job) < 0) {
+        goto out;
+    }
+
+    QuicAsyncJobFree(job);
+    job = NULL;
+
+    QuicCtxSetAsyncCallback(ctx, QuicAsyncTestSubmit, &called);
+    job = QuicAsyncJobNew(pkey, EVP_sha256(), false, tbs, sizeof(tbs));
+    if (job == NULL) {
+        goto out;
+    }
+
+    if (QuicAsyncJobSubmit(ctx, job) < 0 || called != 1) {
+        printf("Async callback not called\n");
+        goto out;
+    }
+
+    if (QuicAsyncTestVerify(pkey, job) < 0) {
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicAsyncJobFree(job);
+    QuicCtxFree(ctx);
+    EVP_PKEY_free(pkey);
+
+    return case_num;
+}
+
+/*
+ * A real handshake whose server stops at CertificateVerify until the
+ * signature is done, and then goes on where it stopped.
+ */
+int QuicAsyncHandshakeTest(void)
+{
+    QUIC_CTX *sctx = NULL;
+    QUIC_CTX *cctx = NULL;
+    QUIC *server = NULL;
+    QUIC *client = NULL;
+    QUIC_ASYNC_JOB *pending = NULL;
+    struct pollfd pfd = {};
+    int fd[2] = { -1, -1 };
+    int ret = 0;
+    int case_num = -1;
+
+    sctx = QuicTestServerCtxNew();
+    cctx = QuicTestClientCtxNew();
+    if (sctx == NULL || cctx == NULL) {
+        goto out;
+    }
+
+    QuicCtxSetAsyncCallback(sctx, QuicAsyncTestDefer, &pending);
+    server = QuicNew(sctx);
+    client = QuicNew(cctx);
+    if (server == NULL || client == NULL) {
+        goto out;
+    }
+
+    if (QuicTestPairInit(client, server, fd) < 0) {
+        goto out;
+    }
+
+    ret = QuicDoHandshake(client);
+    if (ret == 0 || QUIC_get_error(client, ret) != QUIC_ERROR_WANT_READ) {
+        goto out;
+    }
+
+    ret = QuicDoHandshake(server);
+    if (ret == 0 || QUIC_get_error(server, ret) != QUIC_ERROR_WANT_ASYNC ||
+            pending == NULL) {
+        printf("Server handshake not paused\n");
+        goto out;
+    }
+
+    pfd.fd = QUIC_get_async_fd(server);
+    pfd.events = POLLIN;
+    if (pfd.fd < 0 || poll(&pfd, 1, 0) != 0) {
+        printf("Async fd not pending\n");
+        goto out;
+    }
+
+    /* Called again too early, still paused and nothing submitted again */
+    ret = QuicDoHandshake(server);
+    if (ret == 0 || QUIC_get_error(server, ret) != QUIC_ERROR_WANT_ASYNC) {
+        printf("Server handshake went on before signing\n");
+        goto out;
+    }
+
+    QuicAsyncJobSign(pending);
+    QuicAsyncJobDone(pending);
+    if (poll(&pfd, 1, 1000) != 1) {
+        printf("Async fd not ready\n");
+        goto out;
+    }
+
+    if (QuicTestHandshake(client, server) < 0) {
+        printf("Handshake not resumed\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicFree(client);
+    QuicFree(server);
+    QuicCtxFree(cctx);
+    QuicCtxFree(sctx);
+    QuicTestPairFree(fd);
+    return case_num;
+}
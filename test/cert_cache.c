@@ -0,0 +1,102 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "tls.h"
+#include "cert.h"
+#include "extension.h"
+#include "packet_local.h"
+
+#define CERT_CACHE_TEST_BUF_LEN     8192
+
+static int QuicCertChainBuildOnce(QUIC *quic, uint8_t *buf, size_t *len)
+{
+    TLS *s = &quic->tls;
+    WPacket pkt = {};
+    QuicFlowReturn ret = QUIC_FLOW_RET_ERROR;
+
+    WPacketStaticBufInit(&pkt, buf, CERT_CACHE_TEST_BUF_LEN);
+    ret = TlsCertChainBuild(s, &pkt, s->cert->key, TlsSrvrConstructExtensions);
+    *len = WPacket_get_written(&pkt);
+    WPacketCleanup(&pkt);
+
+    return ret == QUIC_FLOW_RET_FINISH ? 0 : -1;
+}
+
+int QuicCertChainCacheTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QuicCertChainCache *cache = NULL;
+    static uint8_t first[CERT_CACHE_TEST_BUF_LEN];
+    static uint8_t second[CERT_CACHE_TEST_BUF_LEN];
+    size_t first_len = 0;
+    size_t second_len = 0;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    if (QuicCtxUsePrivateKeyFile(ctx, quic_key, QUIC_FILE_TYPE_PEM) < 0) {
+        printf("Use Private Key file %s failed\n", quic_key);
+        goto out;
+    }
+
+    if (QuicCtxUseCertificateFile(ctx, quic_cert, QUIC_FILE_TYPE_PEM) < 0) {
+        printf("Use Private Cert file %s failed\n", quic_cert);
+        goto out;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    cache = ctx->cert->key->cache;
+    if (cache == NULL || quic->tls.cert->key->cache != cache) {
+        printf("Cert chain cache not shared\n");
+        goto out;
+    }
+
+    if (QuicCertChainBuildOnce(quic, first, &first_len) < 0) {
+        goto out;
+    }
+
+    if (cache->data == NULL || cache->len + 3 != first_len) {
+        printf("Cert chain not cached\n");
+        goto out;
+    }
+
+    if (QuicCertChainBuildOnce(quic, second, &second_len) < 0) {
+        goto out;
+    }
+
+    if (first_len != second_len || memcmp(first, second, first_len) != 0) {
+        printf("Cached cert chain mismatch\n");
+        goto out;
+    }
+
+    if (QuicCtxUseCertificateFile(ctx, quic_cert, QUIC_FILE_TYPE_PEM) < 0) {
+        goto out;
+    }
+
+    if (ctx->cert->key->cache == cache || ctx->cert->key->cache->data != NULL) {
+        printf("Cert chain cache not invalidated\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicFree(quic);
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
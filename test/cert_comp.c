@@ -0,0 +1,208 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+#include <tbquic/tls.h>
+
+#include "quic_local.h"
+#include "tls.h"
+#include "cert.h"
+#include "cert_comp.h"
+#include "extension.h"
+#include "packet_local.h"
+#include "mem.h"
+#include "common.h"
+
+#define CERT_COMP_TEST_BUF_LEN     8192
+
+static const uint16_t cert_comp_algs[] = {
+    TLSEXT_CERT_COMP_BROTLI,
+    TLSEXT_CERT_COMP_ZLIB,
+};
+
+static int QuicCertCompRoundTrip(uint16_t alg, const uint8_t *in, size_t len)
+{
+    uint8_t *comp = NULL;
+    uint8_t *plain = NULL;
+    size_t comp_len = 0;
+    int ret = -1;
+
+    if (TlsCertCompress(alg, in, len, &comp, &comp_len) < 0) {
+        printf("Compress with %u failed\n", alg);
+        return -1;
+    }
+
+    plain = QuicMemMalloc(len);
+    if (plain == NULL) {
+        goto out;
+    }
+
+    if (TlsCertDecompress(alg, comp, comp_len, plain, len) < 0 ||
+            memcmp(plain, in, len) != 0) {
+        printf("Decompress with %u failed\n", alg);
+        goto out;
+    }
+
+    /* A short uncompressed length must be refused */
+    if (TlsCertDecompress(alg, comp, comp_len, plain, len - 1) == 0) {
+        printf("Short length accepted by %u\n", alg);
+        goto out;
+    }
+
+    ret = 0;
+out:
+    QuicMemFree(plain);
+    QuicMemFree(comp);
+    return ret;
+}
+
+static int QuicCertCompBuild(QUIC *quic, uint8_t *buf, size_t *len)
+{
+    TLS *s = &quic->tls;
+    WPacket pkt = {};
+    QuicFlowReturn ret = QUIC_FLOW_RET_ERROR;
+
+    WPacketStaticBufInit(&pkt, buf, CERT_COMP_TEST_BUF_LEN);
+    ret = TlsCompressedCertBuild(s, &pkt, s->cert->key,
+                                    TlsSrvrConstructExtensions);
+    *len = WPacket_get_written(&pkt);
+    WPacketCleanup(&pkt);
+
+    return ret == QUIC_FLOW_RET_FINISH ? 0 : -1;
+}
+
+static int QuicCertCompDecode(QUIC *quic, const uint8_t *msg, size_t len,
+                                    const uint8_t *chain, size_t chain_len)
+{
+    RPacket pkt = {};
+    uint8_t *out = NULL;
+    size_t out_len = 0;
+    int ret = -1;
+
+    RPacketBufInit(&pkt, msg, len);
+    if (TlsCertDecompressMsg(&quic->tls, &pkt, &out, &out_len) < 0) {
+        return -1;
+    }
+
+    if (out_len == chain_len + 1 && out[0] == 0 &&
+            memcmp(out + 1, chain, chain_len) == 0) {
+        ret = 0;
+    }
+
+    QuicMemFree(out);
+    return ret;
+}
+
+int QuicCertCompressionTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QuicCertChainCache *cache = NULL;
+    WPacket pkt = {};
+    static uint8_t chain[CERT_COMP_TEST_BUF_LEN];
+    static uint8_t first[CERT_COMP_TEST_BUF_LEN];
+    static uint8_t second[CERT_COMP_TEST_BUF_LEN];
+    size_t chain_len = 0;
+    size_t first_len = 0;
+    size_t second_len = 0;
+    size_t i = 0;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    if (QuicCtxUsePrivateKeyFile(ctx, quic_key, QUIC_FILE_TYPE_PEM) < 0) {
+        printf("Use Private Key file %s failed\n", quic_key);
+        goto out;
+    }
+
+    if (QuicCtxUseCertificateFile(ctx, quic_cert, QUIC_FILE_TYPE_PEM) < 0) {
+        printf("Use Private Cert file %s failed\n", quic_cert);
+        goto out;
+    }
+
+    for (i = 0; i < QUIC_NELEM(cert_comp_algs); i++) {
+        if (!TlsCertCompSupported(cert_comp_algs[i])) {
+            /* Built without the compression libraries */
+            case_num = 0;
+            goto out;
+        }
+    }
+
+    if (QuicCtxCtrl(ctx, QUIC_CTRL_SET_CERT_COMPRESSION,
+                (void *)cert_comp_algs, QUIC_NELEM(cert_comp_algs)) < 0) {
+        goto out;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    WPacketStaticBufInit(&pkt, chain, sizeof(chain));
+    if (TlsCertChainBuild(&quic->tls, &pkt, quic->tls.cert->key,
+                TlsSrvrConstructExtensions) != QUIC_FLOW_RET_FINISH) {
+        goto out;
+    }
+    chain_len = WPacket_get_written(&pkt);
+    WPacketCleanup(&pkt);
+
+    for (i = 0; i < QUIC_NELEM(cert_comp_algs); i++) {
+        if (QuicCertCompRoundTrip(cert_comp_algs[i], chain, chain_len) < 0) {
+            goto out;
+        }
+    }
+
+    cache = quic->tls.cert->key->cache;
+    quic->tls.ext.cert_comp_alg = TLSEXT_CERT_COMP_ZLIB;
+    if (QuicCertCompBuild(quic, first, &first_len) < 0) {
+        goto out;
+    }
+
+    if (quic->tls.tmp.msg_type != TLS_MT_COMPRESSED_CERTIFICATE) {
+        printf("Message type not overridden\n");
+        goto out;
+    }
+
+    if (cache->comp[TLSEXT_CERT_COMP_ZLIB].data == NULL ||
+            cache->comp[TLSEXT_CERT_COMP_BROTLI].data != NULL) {
+        printf("Compressed chain not cached\n");
+        goto out;
+    }
+
+    if (QuicCertCompBuild(quic, second, &second_len) < 0) {
+        goto out;
+    }
+
+    if (first_len != second_len || memcmp(first, second, first_len) != 0) {
+        printf("Cached compressed chain mismatch\n");
+        goto out;
+    }
+
+    if (QuicCertCompDecode(quic, first, first_len, chain, chain_len) < 0) {
+        printf("Decode compressed chain failed\n");
+        goto out;
+    }
+
+    /* uncompressed_length is the u24 after the algorithm */
+    first[2] = 0xFF;
+    if (QuicCertCompDecode(quic, first, first_len, chain, chain_len) == 0) {
+        printf("Oversized length accepted\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    if (quic != NULL) {
+        QuicFree(quic);
+    }
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -0,0 +1,138 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <openssl/pem.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "cert.h"
+#include "cert_verify_cache.h"
+
+#define CERT_VERIFY_CACHE_TEST_TTL  600
+
+static int cert_verify_cache_cb_called;
+
+static int QuicCertVerifyCacheTestCb(bool ok, X509_STORE_CTX *store_ctx)
+{
+    cert_verify_cache_cb_called++;
+    return ok;
+}
+
+static STACK_OF(X509) *QuicCertVerifyCacheTestChain(void)
+{
+    STACK_OF(X509) *sk = NULL;
+    BIO *bio = NULL;
+    X509 *x = NULL;
+
+    bio = BIO_new_file(quic_cert, "r");
+    if (bio == NULL) {
+        return NULL;
+    }
+
+    x = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    if (x == NULL) {
+        return NULL;
+    }
+
+    sk = sk_X509_new_null();
+    if (sk == NULL || !sk_X509_push(sk, x)) {
+        sk_X509_free(sk);
+        X509_free(x);
+        return NULL;
+    }
+
+    return sk;
+}
+
+/* Return 0 if verified, -1 if not, -2 if the cache stats are not @hits */
+static int QuicCertVerifyCacheTestRun(QUIC_CTX *ctx, STACK_OF(X509) *sk,
+                                        uint64_t hits, uint64_t misses)
+{
+    QUIC *quic = NULL;
+    uint64_t h = 0;
+    uint64_t m = 0;
+    int ret = -1;
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        return -1;
+    }
+
+    ret = QuicVerifyCertChain(quic, sk);
+    QuicFree(quic);
+
+    QuicCtxCertVerifyCacheStats(ctx, &h, &m);
+    if (h != hits || m != misses) {
+        return -2;
+    }
+
+    return ret;
+}
+
+int QuicCertVerifyCacheTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    STACK_OF(X509) *sk = NULL;
+    uint8_t key[QUIC_CERT_VERIFY_KEY_LEN] = {};
+    int case_num = -1;
+
+    sk = QuicCertVerifyCacheTestChain();
+    if (sk == NULL) {
+        return -1;
+    }
+
+    ctx = QuicCtxNew(QuicClientMethod());
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    QUIC_CTX_set_verify(ctx, QUIC_TLS_VERIFY_PEER, NULL);
+    if (QuicCtxSetCertVerifyCache(ctx, 16, CERT_VERIFY_CACHE_TEST_TTL) < 0) {
+        goto out;
+    }
+
+    /* No trust anchor yet, failures are not cached */
+    if (QuicCertVerifyCacheTestRun(ctx, sk, 0, 1) != -1 ||
+            QuicCertVerifyCacheTestRun(ctx, sk, 0, 2) != -1) {
+        printf("Untrusted chain accepted\n");
+        goto out;
+    }
+
+    if (QuicCtxLoadVerifyLocations(ctx, quic_ca, NULL) == 0) {
+        goto out;
+    }
+
+    if (QuicCertVerifyCacheTestRun(ctx, sk, 0, 3) != 0 ||
+            QuicCertVerifyCacheTestRun(ctx, sk, 1, 3) != 0) {
+        printf("Verified chain not cached\n");
+        goto out;
+    }
+
+    /* Never trusted past the TTL */
+    if (QuicCertVerifyCacheKey(key, sk, ctx->param) < 0 ||
+            QuicCertVerifyCacheDoLookup(ctx->cert_verify_cache, key,
+                time(NULL) + CERT_VERIFY_CACHE_TEST_TTL + 1) == 0) {
+        printf("Expired result used\n");
+        goto out;
+    }
+
+    /* The callback decides on each chain, the cache is not even looked at */
+    QUIC_CTX_set_verify(ctx, QUIC_TLS_VERIFY_PEER, QuicCertVerifyCacheTestCb);
+    if (QuicCertVerifyCacheTestRun(ctx, sk, 1, 4) != 0 ||
+            cert_verify_cache_cb_called == 0) {
+        printf("Verify callback bypassed by cache\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicCtxFree(ctx);
+    sk_X509_pop_free(sk, X509_free);
+
+    return case_num;
+}
@@ -0,0 +1,174 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "session.h"
+#include "clnt_session_cache.h"
+#include "tls_cipher.h"
+
+#define CLNT_SESSION_CACHE_TEST_PORT        443
+#define CLNT_SESSION_CACHE_TEST_LIFETIME    7200
+#define CLNT_SESSION_CACHE_TEST_MAX_EARLY   1024
+
+static uint8_t clnt_session_cache_alpn[] = "\x02h3";
+
+static void QuicClntSessionCacheTestKey(QuicClntSessionKey *key,
+                                        const char *hostname, uint16_t port)
+{
+    static QUIC_DATA alpn = {
+        .data = clnt_session_cache_alpn,
+        .len = sizeof(clnt_session_cache_alpn) - 1,
+    };
+
+    key->hostname = hostname;
+    key->alpn = &alpn;
+    key->port = port;
+}
+
+static int QuicClntSessionCacheTestAdd(QuicClntSessionCache *cache,
+                                        const char *hostname, uint32_t age_add,
+                                        uint32_t lifetime_hint)
+{
+    QUIC_SESSION *sess = NULL;
+    QuicSessionTicket *t = NULL;
+    QuicClntSessionKey key = {};
+    int ret = -1;
+
+    sess = QuicSessionCreate();
+    if (sess == NULL) {
+        return -1;
+    }
+
+    sess->max_early_data = CLNT_SESSION_CACHE_TEST_MAX_EARLY;
+    t = QuicSessionTicketNew(lifetime_hint, age_add, (void *)hostname,
+                                strlen(hostname));
+    if (t == NULL) {
+        goto out;
+    }
+
+    memset(t->master_key, age_add, 32);
+    t->master_key_length = 32;
+    QuicSessionTicketAdd(sess, t);
+
+    QuicClntSessionCacheTestKey(&key, hostname, CLNT_SESSION_CACHE_TEST_PORT);
+    ret = QuicClntSessionCacheAdd(cache, &key,
+                    QuicGetTlsCipherById(TLS_CK_AES_128_GCM_SHA256), sess, t);
+out:
+    QuicSessionFree(sess);
+    return ret;
+}
+
+/* Return the age_add of the ticket handed out, -1 on a miss */
+static int QuicClntSessionCacheTestGet(QuicClntSessionCache *cache,
+                                        const char *hostname, uint16_t port)
+{
+    QUIC_SESSION *sess = NULL;
+    QuicSessionTicket *t = NULL;
+    QuicClntSessionKey key = {};
+    int age_add = -1;
+
+    QuicClntSessionCacheTestKey(&key, hostname, port);
+    sess = QuicClntSessionCacheGet(cache, &key);
+    if (sess == NULL) {
+        return -1;
+    }
+
+    t = QuicSessionTicketPickTail(sess);
+    if (t != NULL && sess->tick_identity == 1 && sess->cipher != NULL &&
+            sess->max_early_data == CLNT_SESSION_CACHE_TEST_MAX_EARLY &&
+            t->master_key_length == 32 && t->master_key[0] == t->age_add) {
+        age_add = t->age_add;
+    }
+
+    QuicSessionFree(sess);
+    return age_add;
+}
+
+int QuicClntSessionCacheTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QuicClntSessionCache *cache = NULL;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicClientMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    if (QuicCtxSetClientSessionCache(ctx, 2) < 0) {
+        goto out;
+    }
+
+    cache = ctx->clnt_session_cache;
+    if (QuicClntSessionCacheTestAdd(cache, "a.example", 1,
+                CLNT_SESSION_CACHE_TEST_LIFETIME) < 0 ||
+            QuicClntSessionCacheTestAdd(cache, "a.example", 2,
+                CLNT_SESSION_CACHE_TEST_LIFETIME) < 0) {
+        goto out;
+    }
+
+    if (QuicClntSessionCacheTestGet(cache, "a.example", 8443) >= 0) {
+        printf("Session of another port returned\n");
+        goto out;
+    }
+
+    /* Newest first, each ticket only once */
+    if (QuicClntSessionCacheTestGet(cache, "a.example",
+                CLNT_SESSION_CACHE_TEST_PORT) != 2 ||
+            QuicClntSessionCacheTestGet(cache, "a.example",
+                CLNT_SESSION_CACHE_TEST_PORT) != 1 ||
+            QuicClntSessionCacheTestGet(cache, "a.example",
+                CLNT_SESSION_CACHE_TEST_PORT) >= 0) {
+        printf("Tickets not used once\n");
+        goto out;
+    }
+
+    if (cache->num != 0) {
+        goto out;
+    }
+
+    /* Adding to a again makes b the least recently used */
+    if (QuicClntSessionCacheTestAdd(cache, "a.example", 3,
+                CLNT_SESSION_CACHE_TEST_LIFETIME) < 0 ||
+            QuicClntSessionCacheTestAdd(cache, "b.example", 4,
+                CLNT_SESSION_CACHE_TEST_LIFETIME) < 0 ||
+            QuicClntSessionCacheTestAdd(cache, "a.example", 5,
+                CLNT_SESSION_CACHE_TEST_LIFETIME) < 0 ||
+            QuicClntSessionCacheTestAdd(cache, "c.example", 6,
+                CLNT_SESSION_CACHE_TEST_LIFETIME) < 0) {
+        goto out;
+    }
+
+    if (QuicClntSessionCacheTestGet(cache, "b.example",
+                CLNT_SESSION_CACHE_TEST_PORT) >= 0 ||
+            QuicClntSessionCacheTestGet(cache, "a.example",
+                CLNT_SESSION_CACHE_TEST_PORT) != 5 ||
+            QuicClntSessionCacheTestGet(cache, "c.example",
+                CLNT_SESSION_CACHE_TEST_PORT) != 6) {
+        printf("LRU eviction failed\n");
+        goto out;
+    }
+
+    /* Expired already */
+    if (QuicClntSessionCacheTestAdd(cache, "d.example", 7, 0) == 0) {
+        printf("Expired ticket cached\n");
+        goto out;
+    }
+
+    if (QuicCtxSetClientSessionCache(ctx, 0) < 0 ||
+            ctx->clnt_session_cache != NULL) {
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -0,0 +1,153 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "extension.h"
+#include "tls_config.h"
+#include "common.h"
+
+#define EE_TEMPLATE_TEST_BUF_LEN    1024
+
+static uint8_t ee_template_cid[2][8] = {
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11 },
+    { 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22 },
+};
+
+/* Return 0 if the template output matches the one built field by field */
+static int QuicEeTemplateTestBuild(QUIC *quic, uint8_t *cid)
+{
+    static uint8_t expect[EE_TEMPLATE_TEST_BUF_LEN];
+    static uint8_t buf[EE_TEMPLATE_TEST_BUF_LEN];
+    WPacket pkt = {};
+    size_t expect_len = 0;
+    size_t len = 0;
+    int ret = -1;
+
+    quic->scid.data = cid;
+    quic->scid.len = sizeof(ee_template_cid[0]);
+
+    WPacketStaticBufInit(&pkt, expect, sizeof(expect));
+    ret = TlsSrvrConstructExtensions(&quic->tls, &pkt, TLSEXT_ENCRYPTED_EXT,
+                                        NULL, 0);
+    expect_len = WPacket_get_written(&pkt);
+    WPacketCleanup(&pkt);
+    if (ret < 0) {
+        return -1;
+    }
+
+    WPacketStaticBufInit(&pkt, buf, sizeof(buf));
+    ret = TlsSrvrConstructEncryptedExt(&quic->tls, &pkt);
+    len = WPacket_get_written(&pkt);
+    WPacketCleanup(&pkt);
+    if (ret < 0) {
+        return -1;
+    }
+
+    if (len != expect_len || memcmp(buf, expect, len) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static QUIC *QuicEeTemplateTestConnNew(QUIC_CTX *ctx)
+{
+    static const uint8_t alpn[] = "h3";
+    QUIC *quic = NULL;
+    QUIC_DATA selected = {
+        .data = (void *)alpn,
+        .len = sizeof(alpn) - 1,
+    };
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        return NULL;
+    }
+
+    QUIC_set_accept_state(quic);
+    if (QuicDataDup(&quic->tls.alpn_selected, &selected) < 0) {
+        QuicFree(quic);
+        return NULL;
+    }
+
+    return quic;
+}
+
+static void QuicEeTemplateTestConnFree(QUIC *quic)
+{
+    if (quic == NULL) {
+        return;
+    }
+
+    quic->scid.data = NULL;
+    QuicFree(quic);
+}
+
+int QuicEeTemplateTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *first = NULL;
+    QUIC *second = NULL;
+    TlsEeTemplateCache *cache = NULL;
+    uint64_t idle_timeout = 30000;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    first = QuicEeTemplateTestConnNew(ctx);
+    second = QuicEeTemplateTestConnNew(ctx);
+    if (first == NULL || second == NULL) {
+        goto out;
+    }
+
+    cache = &first->tls.config->ee_template;
+    if (QuicEeTemplateTestBuild(first, ee_template_cid[0]) < 0 ||
+            cache->num != 1) {
+        printf("Template not built\n");
+        goto out;
+    }
+
+    /* Same template, CID of the second connection patched in */
+    if (QuicEeTemplateTestBuild(second, ee_template_cid[1]) < 0 ||
+            cache->num != 1) {
+        printf("Template output differs\n");
+        goto out;
+    }
+
+    second->tls.ext.early_data = TLS_EARLY_DATA_ACCEPTED;
+    if (QuicEeTemplateTestBuild(second, ee_template_cid[1]) < 0 ||
+            cache->num != 2) {
+        printf("Early data template wrong\n");
+        goto out;
+    }
+
+    /* Own transport parameters, template not used */
+    if (QUIC_set_transport_parameter(first,
+                QUIC_TRANS_PARAM_MAX_IDLE_TIMEOUT, &idle_timeout,
+                sizeof(idle_timeout)) < 0) {
+        goto out;
+    }
+
+    if (QuicEeTemplateTestBuild(first, ee_template_cid[0]) < 0 ||
+            cache->num != 2) {
+        printf("Template used with own transport parameters\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicEeTemplateTestConnFree(second);
+    QuicEeTemplateTestConnFree(first);
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -0,0 +1,65 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <openssl/evp.h>
+
+#include "evp.h"
+
+int QuicEvpCtxPoolTest(void)
+{
+    EVP_CIPHER_CTX *ctx = NULL;
+    EVP_CIPHER_CTX *ctx2 = NULL;
+    EVP_MD_CTX *mctx = NULL;
+    EVP_MD_CTX *mctx2 = NULL;
+    int ret = -1;
+
+    QuicEvpCtxPoolFlush();
+
+    ctx = QuicEvpCipherCtxNew();
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    QuicEvpCipherCtxFree(ctx);
+    ctx2 = QuicEvpCipherCtxNew();
+    if (ctx2 != ctx) {
+        printf("Cipher ctx not reused\n");
+        goto out;
+    }
+
+    if (EVP_CIPHER_CTX_cipher(ctx2) != NULL) {
+        printf("Cipher ctx not reset\n");
+        goto out;
+    }
+
+    mctx = QuicEvpMdCtxNew();
+    if (mctx == NULL) {
+        goto out;
+    }
+
+    if (!EVP_DigestInit_ex(mctx, EVP_sha256(), NULL)) {
+        goto out;
+    }
+
+    QuicEvpMdCtxFree(mctx);
+    mctx2 = QuicEvpMdCtxNew();
+    if (mctx2 != mctx) {
+        printf("MD ctx not reused\n");
+        goto out;
+    }
+
+    if (EVP_MD_CTX_md(mctx2) != NULL) {
+        printf("MD ctx not reset\n");
+        goto out;
+    }
+
+    ret = 1;
+out:
+    QuicEvpCipherCtxFree(ctx2);
+    QuicEvpMdCtxFree(mctx2);
+    QuicEvpCtxPoolFlush();
+    return ret;
+}
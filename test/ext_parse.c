@@ -0,0 +1,222 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "extension.h"
+#include "transport.h"
+#include "common.h"
+
+/* More unknown types than fit in the inline slots */
+#define EXT_PARSE_TEST_MANY     200
+
+static int ext_parse_order[4];
+static int ext_parse_num;
+
+static int QuicExtParseTestRecord(TLS *s, RPacket *pkt, uint32_t type,
+                                    uint32_t len)
+{
+    if (RPacketRemaining(pkt) != len ||
+            ext_parse_num >= QUIC_NELEM(ext_parse_order)) {
+        return -1;
+    }
+
+    ext_parse_order[ext_parse_num++] = type;
+    return 0;
+}
+
+static int QuicExtParseTestAlpn(TLS *s, RPacket *pkt, uint32_t context,
+                                    X509 *x, size_t chainidx)
+{
+    return QuicExtParseTestRecord(s, pkt,
+                        EXT_TYPE_APPLICATION_LAYER_PROTOCOL_NEGOTIATION, 2);
+}
+
+static int QuicExtParseTestKeyShare(TLS *s, RPacket *pkt, uint32_t context,
+                                    X509 *x, size_t chainidx)
+{
+    return QuicExtParseTestRecord(s, pkt, EXT_TYPE_KEY_SHARE, 1);
+}
+
+/* Extensions with an empty body are parsed too */
+static int QuicExtParseTestEarlyData(TLS *s, RPacket *pkt, uint32_t context,
+                                    X509 *x, size_t chainidx)
+{
+    return QuicExtParseTestRecord(s, pkt, EXT_TYPE_EARLY_DATA, 0);
+}
+
+static const TlsExtParse ext_parse_test[] = {
+    {
+        .type = EXT_TYPE_KEY_SHARE,
+        .context = TLSEXT_CLIENT_HELLO,
+        .parse = QuicExtParseTestKeyShare,
+    },
+    {
+        .type = EXT_TYPE_APPLICATION_LAYER_PROTOCOL_NEGOTIATION,
+        .context = TLSEXT_CLIENT_HELLO,
+        .parse = QuicExtParseTestAlpn,
+    },
+    {
+        .type = EXT_TYPE_EARLY_DATA,
+        .context = TLSEXT_CLIENT_HELLO,
+        .parse = QuicExtParseTestEarlyData,
+    },
+};
+
+static int QuicExtParseTestRun(QUIC *quic, const uint8_t *data, size_t len)
+{
+    RPacket pkt = {};
+
+    ext_parse_num = 0;
+    RPacketBufInit(&pkt, data, len);
+    return TlsParseExtensions(&quic->tls, &pkt, TLSEXT_CLIENT_HELLO, NULL, 0,
+                                ext_parse_test, QUIC_NELEM(ext_parse_test));
+}
+
+static int QuicQtpParseTestRun(QUIC *quic, const uint8_t *data, size_t len)
+{
+    static const TlsExtQtpDefinition qtp[] = {
+        {
+            .type = QUIC_TRANS_PARAM_MAX_IDLE_TIMEOUT,
+            .parse = TlsExtQtpParseInteger,
+        },
+        {
+            .type = QUIC_TRANS_PARAM_INITIAL_MAX_DATA,
+            .parse = TlsExtQtpParseInteger,
+        },
+    };
+    RPacket pkt = {};
+
+    RPacketBufInit(&pkt, data, len);
+    return TlsParseQtpExtension(&quic->tls, &pkt, qtp, QUIC_NELEM(qtp));
+}
+
+/*
+ * @num distinct types not indexed, with the first one repeated at the end
+ * if @dup, as a GREASE heavy ClientHello would send.
+ */
+static int QuicExtParseTestMany(QUIC *quic, size_t num, bool dup)
+{
+    static uint8_t exts[2 + (EXT_PARSE_TEST_MANY + 1) * 4];
+    uint8_t *p = exts + 2;
+    size_t len = 0;
+    size_t i = 0;
+
+    for (i = 0; i < num + dup; i++) {
+        uint16_t type = TLSEXT_TYPE_INDEX_MAX + (i < num ? i : 0) * 0x101;
+
+        p[0] = type >> 8;
+        p[1] = type & 0xFF;
+        p[2] = p[3] = 0;
+        p += 4;
+    }
+
+    len = p - exts - 2;
+    exts[0] = len >> 8;
+    exts[1] = len & 0xFF;
+    return QuicExtParseTestRun(quic, exts, len + 2);
+}
+
+int QuicExtParseTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    /* GREASE, ALPN, early_data, key_share */
+    static const uint8_t exts[] = {
+        0x00, 0x13, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x10, 0x00, 0x02, 0x11,
+        0x22, 0x00, 0x2A, 0x00, 0x00, 0x00, 0x33, 0x00, 0x01, 0x33,
+    };
+    static const uint8_t dup_exts[] = {
+        0x00, 0x0A, 0x00, 0x33, 0x00, 0x01, 0x33, 0x00, 0x33, 0x00, 0x01,
+        0x33,
+    };
+    /* Same GREASE type twice */
+    static const uint8_t dup_high_exts[] = {
+        0x00, 0x08, 0x0A, 0x0A, 0x00, 0x00, 0x0A, 0x0A, 0x00, 0x00,
+    };
+    /* GREASE, idle timeout, initial max data */
+    static const uint8_t params[] = {
+        0x40, 0x5B, 0x00, 0x01, 0x02, 0x40, 0x64, 0x04, 0x02, 0x44, 0x00,
+    };
+    static const uint8_t dup_params[] = {
+        0x01, 0x01, 0x10, 0x01, 0x01, 0x20,
+    };
+    static const uint8_t dup_high_params[] = {
+        0x40, 0x5B, 0x00, 0x40, 0x5B, 0x00,
+    };
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    /* Parsers run in table order whatever the order on the wire */
+    if (QuicExtParseTestRun(quic, exts, sizeof(exts)) < 0 ||
+            ext_parse_num != 3 ||
+            ext_parse_order[0] != EXT_TYPE_KEY_SHARE ||
+            ext_parse_order[1] !=
+            EXT_TYPE_APPLICATION_LAYER_PROTOCOL_NEGOTIATION ||
+            ext_parse_order[2] != EXT_TYPE_EARLY_DATA) {
+        printf("Extensions not parsed in table order\n");
+        goto out;
+    }
+
+    if (QuicExtParseTestRun(quic, dup_exts, sizeof(dup_exts)) == 0 ||
+            ext_parse_num != 0) {
+        printf("Duplicate extension accepted\n");
+        goto out;
+    }
+
+    if (QuicExtParseTestRun(quic, dup_high_exts, sizeof(dup_high_exts)) == 0) {
+        printf("Duplicate unknown extension accepted\n");
+        goto out;
+    }
+
+    if (QuicExtParseTestMany(quic, EXT_PARSE_TEST_MANY, false) < 0) {
+        printf("Many unknown extensions refused\n");
+        goto out;
+    }
+
+    if (QuicExtParseTestMany(quic, EXT_PARSE_TEST_MANY, true) == 0) {
+        printf("Duplicate among many unknown extensions accepted\n");
+        goto out;
+    }
+
+    if (QuicQtpParseTestRun(quic, params, sizeof(params)) < 0 ||
+            quic->peer_param.max_idle_timeout != 100 ||
+            quic->peer_param.initial_max_data != 1024) {
+        printf("Transport parameters not parsed\n");
+        goto out;
+    }
+
+    if (QuicQtpParseTestRun(quic, dup_params, sizeof(dup_params)) == 0) {
+        printf("Duplicate transport parameter accepted\n");
+        goto out;
+    }
+
+    if (QuicQtpParseTestRun(quic, dup_high_params,
+                sizeof(dup_high_params)) == 0) {
+        printf("Duplicate unknown transport parameter accepted\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    if (quic != NULL) {
+        QuicFree(quic);
+    }
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -0,0 +1,113 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "group_cache.h"
+#include "tls_lib.h"
+#include "common.h"
+
+#define GROUP_CACHE_TEST_HOST       "www.example.org"
+/* Peer port of a socket pair */
+#define GROUP_CACHE_TEST_PORT       0
+
+static int QuicGroupCacheTestConnect(QUIC_CTX *cctx, QUIC_CTX *sctx,
+                                        bool predicted)
+{
+    QUIC *server = NULL;
+    QUIC *client = NULL;
+    int fd[2] = { -1, -1 };
+    int ret = -1;
+
+    server = QuicNew(sctx);
+    client = QuicNew(cctx);
+    if (server == NULL || client == NULL) {
+        goto out;
+    }
+
+    if (QuicTestPairInit(client, server, fd) < 0) {
+        goto out;
+    }
+
+    if (QuicTestHandshake(client, server) < 0) {
+        goto out;
+    }
+
+    if (client->tls.group_id != TLS_SUPPORTED_GROUPS_SECP384R1) {
+        printf("Group %u negotiated\n", client->tls.group_id);
+        goto out;
+    }
+
+    if (QuicKeySharePredicted(client) != predicted) {
+        printf("Key share predicted %d\n", !predicted);
+        goto out;
+    }
+
+    ret = 0;
+out:
+    QuicFree(client);
+    QuicFree(server);
+    QuicTestPairFree(fd);
+    return ret;
+}
+
+int QuicGroupCacheTest(void)
+{
+    QUIC_CTX *sctx = NULL;
+    QUIC_CTX *cctx = NULL;
+    uint16_t groups[] = {
+        TLS_SUPPORTED_GROUPS_SECP384R1,
+    };
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    int case_num = -1;
+
+    sctx = QuicTestServerCtxNew();
+    cctx = QuicTestClientCtxNew();
+    if (sctx == NULL || cctx == NULL) {
+        goto out;
+    }
+
+    /* Only the last group the client supports is acceptable */
+    if (QuicCtxCtrl(sctx, QUIC_CTRL_SET_GROUPS, groups,
+                QUIC_NELEM(groups)) < 0) {
+        goto out;
+    }
+
+    if (QuicCtxSetKeySharePredict(cctx, 16) < 0) {
+        goto out;
+    }
+
+    /* Nothing known, every group is offered */
+    if (QuicGroupCacheTestConnect(cctx, sctx, false) < 0) {
+        goto out;
+    }
+
+    if (TlsGroupCacheGet(cctx->group_cache, GROUP_CACHE_TEST_HOST,
+                GROUP_CACHE_TEST_PORT) != TLS_SUPPORTED_GROUPS_SECP384R1) {
+        printf("Selected group not learnt\n");
+        goto out;
+    }
+
+    /* Only the learnt group is offered now */
+    if (QuicGroupCacheTestConnect(cctx, sctx, true) < 0) {
+        goto out;
+    }
+
+    QuicCtxKeySharePredictStats(cctx, &hits, &misses);
+    if (hits != 1 || misses != 1) {
+        printf("Prediction stats wrong\n");
+        goto out;
+    }
+
+    case_num = 2;
+out:
+    QuicCtxFree(cctx);
+    QuicCtxFree(sctx);
+
+    return case_num;
+}
@@ -15,6 +15,7 @@
 #include <tbquic/stream.h>
 
 #include "quic_local.h"
+#include "common.h"
 
 #define QUIC_TEST_IP                "127.0.0.1"
 #define QUIC_TEST_PORT              6231
@@ -30,6 +31,114 @@ static void QuicSetAddr(struct sockaddr_in *addr)
     addr->sin_addr.s_addr = inet_addr(QUIC_TEST_IP);
 }
 
+QUIC_CTX *QuicTestServerCtxNew(void)
+{
+    QUIC_CTX *ctx = NULL;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    if (QuicCtxUsePrivateKeyFile(ctx, quic_key, QUIC_FILE_TYPE_PEM) < 0) {
+        goto err;
+    }
+
+    if (QuicCtxUseCertificateFile(ctx, quic_cert, QUIC_FILE_TYPE_PEM) < 0) {
+        goto err;
+    }
+
+    if (QuicCtxServerExtensionSet(ctx) < 0) {
+        goto err;
+    }
+
+    return ctx;
+err:
+    QuicCtxFree(ctx);
+    return NULL;
+}
+
+QUIC_CTX *QuicTestClientCtxNew(void)
+{
+    QUIC_CTX *ctx = NULL;
+
+    ctx = QuicCtxNew(QuicClientMethod());
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    QuicSetVerify(ctx, QUIC_TLS_VERIFY_PEER, quic_ca);
+    if (QuicTlsCtxClientExtensionSet(ctx) < 0) {
+        QuicCtxFree(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+/*
+ * Connect @client and @server through a datagram socket pair, so that both
+ * ends run in this process.
+ */
+int QuicTestPairInit(QUIC *client, QUIC *server, int *fd)
+{
+    if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0, fd) < 0) {
+        return -1;
+    }
+
+    QUIC_set_connect_state(client);
+    QUIC_set_accept_state(server);
+    if (QUIC_set_fd(client, fd[0]) < 0 || QUIC_set_fd(server, fd[1]) < 0) {
+        return -1;
+    }
+
+    return QuicTlsClientExtensionSet(client);
+}
+
+void QuicTestPairFree(int *fd)
+{
+    close(fd[0]);
+    close(fd[1]);
+}
+
+/*
+ * Drive both ends until the handshake completes on each of them. Returns
+ * 0 on success, or -1 once either side fails with anything other than
+ * WANT_READ.
+ */
+int QuicTestHandshake(QUIC *client, QUIC *server)
+{
+    QUIC *quic[2] = { client, server };
+    bool done[2] = {};
+    int round = 0;
+    int ret = 0;
+    int i = 0;
+
+    for (round = 0; round < QUIC_TEST_HANDSHAKE_ROUNDS; round++) {
+        for (i = 0; i < QUIC_NELEM(quic); i++) {
+            if (done[i]) {
+                continue;
+            }
+            ret = QuicDoHandshake(quic[i]);
+            if (ret == 0) {
+                done[i] = true;
+                continue;
+            }
+            if (QUIC_get_error(quic[i], ret) != QUIC_ERROR_WANT_READ) {
+                printf("%s handshake failed\n", i ? "Server" : "Client");
+                return -1;
+            }
+        }
+
+        if (done[0] && done[1]) {
+            return 0;
+        }
+    }
+
+    printf("Handshake not finished\n");
+    return -1;
+}
+
 static int QuicTlsClientMain(void)
 {
     QUIC_CTX *ctx = NULL;
@@ -322,3 +431,42 @@ int QuicHandshakeTest(void)
     close(fd[1]);
     return QuicTlsServer(fd[0]);
 }
+
+int QuicHandshakePairTest(void)
+{
+    QUIC_CTX *sctx = NULL;
+    QUIC_CTX *cctx = NULL;
+    QUIC *server = NULL;
+    QUIC *client = NULL;
+    int fd[2] = { -1, -1 };
+    int ret = -1;
+
+    sctx = QuicTestServerCtxNew();
+    cctx = QuicTestClientCtxNew();
+    if (sctx == NULL || cctx == NULL) {
+        goto out;
+    }
+
+    server = QuicNew(sctx);
+    client = QuicNew(cctx);
+    if (server == NULL || client == NULL) {
+        goto out;
+    }
+
+    if (QuicTestPairInit(client, server, fd) < 0) {
+        goto out;
+    }
+
+    if (QuicTestHandshake(client, server) < 0) {
+        goto out;
+    }
+
+    ret = 1;
+out:
+    QuicFree(client);
+    QuicFree(server);
+    QuicCtxFree(cctx);
+    QuicCtxFree(sctx);
+    QuicTestPairFree(fd);
+    return ret;
+}
@@ -0,0 +1,85 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ * RFC 9001 4.9. Discarding Unused Keys
+ */
+
+#include "quic_test.h"
+
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "tls.h"
+#include "buffer.h"
+#include "common.h"
+
+int QuicKeyDiscardTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QUIC_CRYPTO *init = NULL;
+    QUIC_DATA cid = {};
+    static uint8_t cid_data[] = {
+        0x83, 0x94, 0xc8, 0xf0, 0x3e, 0x51, 0x57, 0x08,
+    };
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicClientMethod());
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    QUIC_set_connect_state(quic);
+
+    cid.data = cid_data;
+    cid.len = sizeof(cid_data);
+    if (QuicCreateInitialDecoders(quic, QUIC_VERSION_1, &cid) < 0) {
+        printf("Create Initial decoders failed\n");
+        goto out;
+    }
+
+    init = &quic->initial;
+    if (init->decrypt.ciphers.pp_cipher.cipher.ctx == NULL) {
+        printf("Initial keys not created\n");
+        goto out;
+    }
+
+    QuicCryptoDiscard(quic, QUIC_PKT_TYPE_INITIAL);
+    if (!init->discarded || init->decrypt.ciphers.pp_cipher.cipher.ctx != NULL
+            || init->encrypt.ciphers.pp_cipher.cipher.ctx != NULL) {
+        printf("Initial keys not discarded\n");
+        goto out;
+    }
+
+    if (quic->tls.hs == NULL) {
+        printf("Handshake secrets freed too early\n");
+        goto out;
+    }
+
+    QuicHandshakeConfirmed(quic);
+    if (!quic->handshake.discarded || quic->tls.hs != NULL) {
+        printf("Handshake state not discarded\n");
+        goto out;
+    }
+
+    if (QUIC_GT(QuicBufLength(&quic->tls.buffer),
+                TLS_POST_HANDSHAKE_BUF_LEN)) {
+        printf("TLS buffer not shrunk, len %lu\n",
+                QuicBufLength(&quic->tls.buffer));
+        goto out;
+    }
+
+    /* Must be idempotent */
+    QuicHandshakeConfirmed(quic);
+
+    case_num = 1;
+out:
+    QuicFree(quic);
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -0,0 +1,129 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <tbquic/quic.h>
+#include <tbquic/ec.h>
+
+#include "quic_local.h"
+#include "tls_lib.h"
+#include "key_share.h"
+#include "common.h"
+
+#define KEY_SHARE_TEST_DEPTH    4
+
+static bool QuicKeyShareSame(EVP_PKEY *a, EVP_PKEY *b)
+{
+    unsigned char *pa = NULL;
+    unsigned char *pb = NULL;
+    size_t la = 0;
+    size_t lb = 0;
+    bool same = false;
+
+    la = EVP_PKEY_get1_tls_encodedpoint(a, &pa);
+    lb = EVP_PKEY_get1_tls_encodedpoint(b, &pb);
+    same = (la == lb && la != 0 && memcmp(pa, pb, la) == 0);
+    OPENSSL_free(pa);
+    OPENSSL_free(pb);
+
+    return same;
+}
+
+static int QuicKeySharePoolTake(QUIC *quic)
+{
+    TlsKeySharePool *pool = quic->ctx->key_share_pool;
+    EVP_PKEY *keys[KEY_SHARE_TEST_DEPTH + 1] = {};
+    size_t i = 0;
+    size_t j = 0;
+    int ret = -1;
+
+    for (i = 0; i < QUIC_NELEM(keys); i++) {
+        keys[i] = TlsGeneratePkeyGroup(&quic->tls, EC_NAMED_CURVE_X25519);
+        if (keys[i] == NULL) {
+            printf("Generate key %lu failed\n", i);
+            goto out;
+        }
+
+        for (j = 0; j < i; j++) {
+            if (keys[j] == keys[i] || QuicKeyShareSame(keys[j], keys[i])) {
+                printf("Key %lu reused\n", i);
+                goto out;
+            }
+        }
+    }
+
+    if (TlsKeySharePoolNum(pool, EC_NAMED_CURVE_X25519) != 0) {
+        printf("Pool not drained\n");
+        goto out;
+    }
+
+    ret = 0;
+out:
+    for (i = 0; i < QUIC_NELEM(keys); i++) {
+        EVP_PKEY_free(keys[i]);
+    }
+    return ret;
+}
+
+int QuicKeySharePoolTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    TlsKeySharePool *pool = NULL;
+    int i = 0;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicClientMethod());
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    if (QuicCtxSetKeySharePool(ctx, KEY_SHARE_TEST_DEPTH, false) < 0) {
+        goto out;
+    }
+
+    if (QuicCtxKeySharePoolRefill(ctx, KEY_SHARE_TEST_DEPTH * 2) !=
+            KEY_SHARE_TEST_DEPTH) {
+        printf("Refill more than depth\n");
+        goto out;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    /* The last key falls back to inline generation */
+    if (QuicKeySharePoolTake(quic) < 0) {
+        goto out;
+    }
+
+    if (QuicCtxSetKeySharePool(ctx, KEY_SHARE_TEST_DEPTH, true) < 0) {
+        goto out;
+    }
+
+    pool = ctx->key_share_pool;
+    for (i = 0; i < 500; i++) {
+        if (TlsKeySharePoolNum(pool, EC_NAMED_CURVE_X25519) ==
+                KEY_SHARE_TEST_DEPTH) {
+            break;
+        }
+        usleep(10000);
+    }
+
+    if (i == 500) {
+        printf("Pool not refilled in background\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicFree(quic);
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -0,0 +1,495 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ * RFC 9001 Appendix A.5
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <openssl/evp.h>
+#include <tbquic/quic.h>
+#include <tbquic/cipher.h>
+
+#include "cipher.h"
+#include "format.h"
+#include "evp.h"
+#include "common.h"
+#include "quic_local.h"
+#include "key_update.h"
+#include "tls_cipher.h"
+
+static char secret[] =
+    "9ac312a7f877468ebe69422748ad00a15443f18203a07d6060f688f30f21632b";
+static char ku_secret[] =
+    "1223504755036d556342ee9361d253421a826c9ecdf3c7148684b36b714881f9";
+
+int QuicKeyUpdateSecretTest(void)
+{
+    QuicPPCipher enc = {};
+    QuicPPCipher dec = {};
+    uint8_t enc_secret[EVP_MAX_MD_SIZE] = {};
+    uint8_t dec_secret[EVP_MAX_MD_SIZE] = {};
+    uint8_t expect[EVP_MAX_MD_SIZE] = {};
+    size_t secret_len = (sizeof(secret) - 1)/2;
+    int ret = -1;
+
+    str2hex(enc_secret, secret, secret_len);
+    str2hex(dec_secret, secret, secret_len);
+    str2hex(expect, ku_secret, secret_len);
+
+    if (QuicPPCipherKeyUpdate(&enc, QUIC_ALG_AES_128_GCM, EVP_sha256(),
+                enc_secret, QUIC_EVP_ENCRYPT) < 0) {
+        goto out;
+    }
+
+    if (memcmp(enc_secret, expect, secret_len) != 0) {
+        printf("Key update secret not match\n");
+        QuicPrint(enc_secret, secret_len);
+        goto out;
+    }
+
+    if (QuicPPCipherKeyUpdate(&dec, QUIC_ALG_AES_128_GCM, EVP_sha256(),
+                dec_secret, QUIC_EVP_DECRYPT) < 0) {
+        goto out;
+    }
+
+    if (memcmp(enc.iv, dec.iv, sizeof(enc.iv)) != 0) {
+        printf("Key update IV not match\n");
+        goto out;
+    }
+
+    /* The context must be reused by the next generation */
+    if (QuicPPCipherKeyUpdate(&enc, QUIC_ALG_AES_128_GCM, EVP_sha256(),
+                enc_secret, QUIC_EVP_ENCRYPT) < 0) {
+        goto out;
+    }
+
+    if (memcmp(enc_secret, expect, secret_len) == 0) {
+        printf("Key update secret not changed\n");
+        goto out;
+    }
+
+    ret = 1;
+out:
+    QuicPPCipherCtxFree(&enc);
+    QuicPPCipherCtxFree(&dec);
+    return ret;
+}
+
+static QUIC *QuicKeyUpdateTestNew(QUIC_CTX *ctx)
+{
+    QUIC *quic = NULL;
+    QUIC_CRYPTO *c = NULL;
+    uint8_t tmp[EVP_MAX_MD_SIZE] = {};
+    size_t secret_len = (sizeof(secret) - 1)/2;
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        return NULL;
+    }
+
+    QUIC_set_accept_state(quic);
+    quic->tls.handshake_cipher =
+        QuicGetTlsCipherById(TLS_CK_AES_128_GCM_SHA256);
+    str2hex(quic->tls.client_app_traffic_secret, secret, secret_len);
+    str2hex(quic->tls.server_app_traffic_secret, secret, secret_len);
+
+    c = &quic->application;
+    str2hex(tmp, secret, secret_len);
+    if (QuicPPCipherKeyUpdate(&c->decrypt.ciphers.pp_cipher,
+                QUIC_ALG_AES_128_GCM, EVP_sha256(), tmp,
+                QUIC_EVP_DECRYPT) < 0) {
+        goto err;
+    }
+
+    str2hex(tmp, secret, secret_len);
+    if (QuicPPCipherKeyUpdate(&c->encrypt.ciphers.pp_cipher,
+                QUIC_ALG_AES_128_GCM, EVP_sha256(), tmp,
+                QUIC_EVP_ENCRYPT) < 0) {
+        goto err;
+    }
+
+    c->decrypt.cipher_inited = true;
+    c->encrypt.cipher_inited = true;
+    if (QuicKeyUpdateInit(quic) < 0 || !quic->key_update.inited) {
+        goto err;
+    }
+
+    return quic;
+err:
+    QuicFree(quic);
+    return NULL;
+}
+
+/*
+ * RFC 9001 6.3. A packet with the other key phase is tried with the next
+ * keys, which are installed only after it is authenticated.
+ */
+int QuicKeyUpdateRxFlipTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QuicKeyUpdateState *ku = NULL;
+    QuicPPCipher *cur = NULL;
+    QuicPPCipher *pp = NULL;
+    EVP_CIPHER_CTX *next_ctx = NULL;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicKeyUpdateTestNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    ku = &quic->key_update;
+    cur = &quic->application.decrypt.ciphers.pp_cipher;
+    pp = QuicKeyUpdateGetDecryptor(quic, 0, 10);
+    if (pp != cur || QuicKeyUpdateOnDecrypted(quic, pp, 10) < 0 ||
+            ku->rx_phase != 0) {
+        printf("Current keys not used for current phase\n");
+        goto out;
+    }
+
+    pp = QuicKeyUpdateGetDecryptor(quic, 1, 20);
+    if (pp != &ku->next_decrypt) {
+        printf("Next keys not used for next phase\n");
+        goto out;
+    }
+
+    /* Not authenticated yet, nothing changes */
+    if (ku->rx_phase != 0 || ku->prev_valid || !ku->next_rx_ready) {
+        printf("Key phase flipped before packet authenticated\n");
+        goto out;
+    }
+
+    next_ctx = pp->cipher.ctx;
+    if (QuicKeyUpdateOnDecrypted(quic, pp, 20) < 0) {
+        goto out;
+    }
+
+    if (ku->rx_phase != 1 || cur->cipher.ctx != next_ctx ||
+            ku->next_rx_ready || !ku->prev_valid || ku->rx_first_pn != 20) {
+        printf("Read keys not installed\n");
+        goto out;
+    }
+
+    /* Update initiated by peer, respond with new write keys */
+    if (ku->tx_phase != 1 || QuicKeyUpdateTxPhase(quic) != 1) {
+        printf("Write keys not updated in response\n");
+        goto out;
+    }
+
+    if (QuicKeyUpdateGetDecryptor(quic, 1, 21) != cur) {
+        printf("Installed keys not used\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicFree(quic);
+    QuicCtxFree(ctx);
+    return case_num;
+}
+
+/*
+ * RFC 9001 6.5. Packets of the old phase sent before the update are still
+ * decrypted by the previous keys until 3 * PTO passed.
+ */
+int QuicKeyUpdatePrevKeyTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QUIC_CRYPTO *c = NULL;
+    QuicKeyUpdateState *ku = NULL;
+    QuicPPCipher *pp = NULL;
+    EVP_CIPHER_CTX *old_ctx = NULL;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicKeyUpdateTestNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    c = &quic->application;
+    ku = &quic->key_update;
+    old_ctx = c->decrypt.ciphers.pp_cipher.cipher.ctx;
+    c->arriv_time = 1000;
+    pp = QuicKeyUpdateGetDecryptor(quic, 1, 20);
+    if (pp == NULL || QuicKeyUpdateOnDecrypted(quic, pp, 20) < 0) {
+        goto out;
+    }
+
+    if (ku->prev_expire != c->arriv_time + QUIC_KEY_UPDATE_OLD_KEY_TIMEOUT) {
+        printf("Old keys expire time wrong\n");
+        goto out;
+    }
+
+    /* Reordered packet sent before the update */
+    pp = QuicKeyUpdateGetDecryptor(quic, 0, 15);
+    if (pp != &ku->prev_decrypt || pp->cipher.ctx != old_ctx) {
+        printf("Previous keys not used for late packet\n");
+        goto out;
+    }
+
+    if (QuicKeyUpdateOnDecrypted(quic, pp, 15) < 0 || ku->rx_phase != 1 ||
+            ku->rx_first_pn != 20) {
+        printf("Late packet changed key phase\n");
+        goto out;
+    }
+
+    c->arriv_time = ku->prev_expire - 1;
+    if (QuicKeyUpdateGetDecryptor(quic, 0, 16) != &ku->prev_decrypt) {
+        printf("Previous keys discarded too early\n");
+        goto out;
+    }
+
+    c->arriv_time = ku->prev_expire;
+    pp = QuicKeyUpdateGetDecryptor(quic, 0, 15);
+    if (ku->prev_valid || pp != &ku->next_decrypt || !ku->next_rx_ready) {
+        printf("Previous keys not discarded after 3 * PTO\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicFree(quic);
+    QuicCtxFree(ctx);
+    return case_num;
+}
+
+/*
+ * RFC 9001 6.3. A packet claiming another update before the old keys are
+ * discarded is only tried with keys derived aside, a forged one leaves the
+ * previous keys and the secret alone.
+ */
+int QuicKeyUpdateTentativeTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QUIC_CRYPTO *c = NULL;
+    QuicKeyUpdateState *ku = NULL;
+    QuicPPCipher *pp = NULL;
+    EVP_CIPHER_CTX *old_ctx = NULL;
+    uint8_t rx_secret[EVP_MAX_MD_SIZE] = {};
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicKeyUpdateTestNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    c = &quic->application;
+    ku = &quic->key_update;
+    c->arriv_time = 1000;
+    pp = QuicKeyUpdateGetDecryptor(quic, 1, 20);
+    if (pp == NULL || QuicKeyUpdateOnDecrypted(quic, pp, 20) < 0) {
+        goto out;
+    }
+
+    old_ctx = ku->prev_decrypt.cipher.ctx;
+    memcpy(rx_secret, quic->tls.client_app_traffic_secret, sizeof(rx_secret));
+    pp = QuicKeyUpdateGetDecryptor(quic, 0, 30);
+    if (pp != &ku->next_decrypt || !ku->next_rx_tentative) {
+        printf("Tentative keys not tried\n");
+        goto out;
+    }
+
+    /* Not authenticated, nothing is lost */
+    if (!ku->prev_valid || ku->rx_phase != 1 ||
+            memcmp(rx_secret, quic->tls.client_app_traffic_secret,
+                sizeof(rx_secret)) != 0) {
+        printf("State changed by an unauthenticated packet\n");
+        goto out;
+    }
+
+    pp = QuicKeyUpdateGetDecryptor(quic, 0, 15);
+    if (pp != &ku->prev_decrypt || pp->cipher.ctx != old_ctx) {
+        printf("Previous keys dropped\n");
+        goto out;
+    }
+
+    pp = QuicKeyUpdateGetDecryptor(quic, 0, 31);
+    if (pp != &ku->next_decrypt ||
+            QuicKeyUpdateOnDecrypted(quic, pp, 31) < 0) {
+        goto out;
+    }
+
+    if (ku->rx_phase != 0 || ku->next_rx_tentative || ku->rx_first_pn != 31 ||
+            memcmp(rx_secret, quic->tls.client_app_traffic_secret,
+                sizeof(rx_secret)) == 0) {
+        printf("Tentative keys not committed\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicFree(quic);
+    QuicCtxFree(ctx);
+    return case_num;
+}
+
+/*
+ * RFC 9001 6.1. Initiating a Key Update
+ */
+int QuicKeyUpdateTxFlipTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QUIC_CRYPTO *c = NULL;
+    QuicKeyUpdateState *ku = NULL;
+    QuicPPCipher *pp = NULL;
+    EVP_CIPHER_CTX *next_ctx = NULL;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicKeyUpdateTestNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    c = &quic->application;
+    ku = &quic->key_update;
+    if (QuicKeyUpdate(quic) == 0) {
+        printf("Key update allowed before handshake done\n");
+        goto out;
+    }
+
+    quic->statem.state = QUIC_STATEM_HANDSHAKE_DONE;
+    c->pkt_num = 9;
+    c->largest_acked = 9;
+    next_ctx = ku->next_encrypt.cipher.ctx;
+    if (QuicKeyUpdate(quic) < 0) {
+        printf("Key update failed\n");
+        goto out;
+    }
+
+    if (ku->tx_phase != 1 || ku->rx_phase != 0 || ku->next_tx_ready ||
+            c->encrypt.ciphers.pp_cipher.cipher.ctx != next_ctx ||
+            ku->tx_first_pn != 10 || QuicKeyUpdateTxPhase(quic) != 1) {
+        printf("Write keys not updated\n");
+        goto out;
+    }
+
+    if (QuicKeyUpdate(quic) == 0) {
+        printf("Key update allowed while in progress\n");
+        goto out;
+    }
+
+    /* Peer responds with the new phase, no more write keys update */
+    pp = QuicKeyUpdateGetDecryptor(quic, 1, 5);
+    if (pp != &ku->next_decrypt ||
+            QuicKeyUpdateOnDecrypted(quic, pp, 5) < 0) {
+        goto out;
+    }
+
+    if (ku->rx_phase != 1 || ku->tx_phase != 1 ||
+            c->encrypt.ciphers.pp_cipher.cipher.ctx != next_ctx) {
+        printf("Key update not confirmed\n");
+        goto out;
+    }
+
+    /* Next update waits for the old read keys to be discarded */
+    c->largest_acked = 20;
+    if (QuicKeyUpdate(quic) == 0) {
+        printf("Key update allowed with old keys\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicFree(quic);
+    QuicCtxFree(ctx);
+    return case_num;
+}
+
+/*
+ * RFC 9001 A.5. ChaCha20-Poly1305 Short Header Packet
+ */
+int QuicChaCha20PacketTest(void)
+{
+    static char protected[] =
+        "4cfe4189655e5cd55c41f69080575d7999c25a5bfb";
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QUIC_CRYPTO *c = NULL;
+    RPacket pkt = {};
+    QuicPacketFlags flags;
+    uint8_t tmp[EVP_MAX_MD_SIZE] = {};
+    uint8_t data[sizeof(protected)/2] = {};
+    uint8_t out[sizeof(protected)/2] = {};
+    size_t secret_len = (sizeof(secret) - 1)/2;
+    size_t data_len = (sizeof(protected) - 1)/2;
+    size_t out_len = 0;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicClientMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    QUIC_set_connect_state(quic);
+    c = &quic->application;
+    if (QUIC_set_hp_cipher(c, QuicCipherGetHPAlg(
+                    QUIC_ALG_CHACHA20POLY1305)) < 0 ||
+            QUIC_set_pp_cipher_space_alg(&c->decrypt,
+                QUIC_ALG_CHACHA20POLY1305) < 0) {
+        goto out;
+    }
+
+    str2hex(tmp, secret, secret_len);
+    if (QuicCiphersPrepare(&c->decrypt.ciphers, EVP_sha256(), tmp,
+                QUIC_EVP_DECRYPT) != 0) {
+        printf("ChaCha20 keys not derived\n");
+        goto out;
+    }
+
+    c->decrypt.cipher_inited = true;
+    c->largest_pn = 654360563;
+    str2hex(data, protected, data_len);
+    RPacketBufInit(&pkt, data, data_len);
+    if (QuicGetPktFlags(&flags, &pkt) < 0 ||
+            QuicSPacketHeaderParse(quic, &pkt) < 0) {
+        goto out;
+    }
+
+    if (QuicDecryptPacket(quic, c, &pkt, out, &out_len, sizeof(out),
+                QUIC_SPACKET_TYPE_RESV_MASK) < 0) {
+        printf("ChaCha20 packet not decrypted\n");
+        goto out;
+    }
+
+    if (c->largest_pn != 654360564 || out_len != 1 || out[0] != 0x01) {
+        printf("ChaCha20 packet content wrong\n");
+        QuicPrint(out, out_len);
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicFree(quic);
+    QuicCtxFree(ctx);
+    return case_num;
+}
@@ -0,0 +1,421 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ * Packet protection micro benchmark, results are printed as CSV:
+ * bench,suite,size,ns_per_pkt,gbps,cycles_per_byte
+ */
+
+#include "quic_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <tbquic/quic.h>
+#include <tbquic/cipher.h>
+
+#include "quic_local.h"
+#include "format.h"
+#include "cipher.h"
+#include "evp.h"
+#include "common.h"
+
+#define QUIC_BENCH_ITER_DEF     100000
+#define QUIC_BENCH_PKT_MAX_LEN  1500
+
+typedef struct {
+    const char *name;
+    uint32_t pp_alg;
+    uint32_t hp_alg;
+    uint32_t digest;
+} QuicBenchSuite;
+
+typedef struct {
+    uint64_t ns;
+    uint64_t cycles;
+} QuicBenchTime;
+
+static const QuicBenchSuite bench_suites[] = {
+    {
+        .name = "AES-128-GCM",
+        .pp_alg = QUIC_ALG_AES_128_GCM,
+        .hp_alg = QUIC_ALG_AES_128_ECB,
+        .digest = QUIC_DIGEST_SHA256,
+    },
+    {
+        .name = "AES-256-GCM",
+        .pp_alg = QUIC_ALG_AES_256_GCM,
+        .hp_alg = QUIC_ALG_AES_256_ECB,
+        .digest = QUIC_DIGEST_SHA384,
+    },
+    {
+        .name = "CHACHA20-POLY1305",
+        .pp_alg = QUIC_ALG_CHACHA20POLY1305,
+        .hp_alg = QUIC_ALG_CHACHA20,
+        .digest = QUIC_DIGEST_SHA256,
+    },
+};
+
+static const size_t bench_pkt_sizes[] = {
+    64, 128, 256, 512, 1024, 1200, 1452,
+};
+
+static uint8_t bench_cid[] = {
+    0x83, 0x94, 0xc8, 0xf0, 0x3e, 0x51, 0x57, 0x08,
+};
+
+static uint8_t bench_secret[EVP_MAX_MD_SIZE] = {
+    0xc0, 0x0c, 0xf1, 0x51, 0xca, 0x5b, 0xe0, 0x75,
+    0xed, 0x0e, 0xbf, 0xb5, 0xc8, 0x03, 0x23, 0xc4,
+    0x2d, 0x6b, 0x7d, 0xb6, 0x78, 0x81, 0x28, 0x9a,
+    0xf4, 0x00, 0x8f, 0x1f, 0x6c, 0x35, 0x7a, 0xea,
+};
+
+static const struct option long_opts[] = {
+    {"help", 0, 0, 'H'},
+    {"iterations", 0, 0, 'n'},
+    {0, 0, 0, 0}
+};
+
+static const char *options[] = {
+    "--iterations   		-n	Iterations of each case\n",
+    "--help         		-H	Print help information\n",
+};
+
+static void help(void)
+{
+    int     index;
+
+    fprintf(stdout, "\nOptions:\n");
+    for (index = 0; index < ARRAY_SIZE(options); index++) {
+        fprintf(stdout, "  %s", options[index]);
+    }
+}
+
+static void QuicBenchStart(QuicBenchTime *t)
+{
+    struct timespec ts = {};
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    t->ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#if defined(__x86_64__) || defined(__i386__)
+    t->cycles = __rdtsc();
+#endif
+}
+
+static void QuicBenchStop(QuicBenchTime *t)
+{
+    QuicBenchTime end = {};
+
+    QuicBenchStart(&end);
+    t->ns = end.ns - t->ns;
+    t->cycles = end.cycles - t->cycles;
+}
+
+static void QuicBenchReport(const char *bench, const char *suite, size_t size,
+                            int iter, QuicBenchTime *t)
+{
+    double bytes = (double)size * iter;
+
+    printf("%s,%s,%lu,%.1f,%.3f,%.3f\n", bench, suite, size,
+            (double)t->ns / iter, bytes * 8 / t->ns, t->cycles / bytes);
+}
+
+static QUIC *QuicBenchConnNew(QUIC_CTX *ctx, const QuicBenchSuite *suite)
+{
+    QUIC *quic = NULL;
+    QUIC_CRYPTO *c = NULL;
+    const EVP_MD *md = NULL;
+
+    md = QuicMd(suite->digest);
+    if (md == NULL) {
+        return NULL;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        return NULL;
+    }
+
+    QUIC_set_connect_state(quic);
+    quic->dcid.data = bench_cid;
+    quic->dcid.len = sizeof(bench_cid);
+    quic->scid.data = bench_cid;
+    quic->scid.len = sizeof(bench_cid);
+
+    /* Same keys in both directions so that we can decrypt what we send */
+    c = &quic->application;
+    c->encrypt.ciphers.hp_cipher.cipher.alg = suite->hp_alg;
+    c->encrypt.ciphers.pp_cipher.cipher.alg = suite->pp_alg;
+    c->decrypt.ciphers.hp_cipher.cipher.alg = suite->hp_alg;
+    c->decrypt.ciphers.pp_cipher.cipher.alg = suite->pp_alg;
+    if (QuicCiphersPrepare(&c->encrypt.ciphers, md, bench_secret,
+                QUIC_EVP_ENCRYPT) != 0) {
+        goto err;
+    }
+
+    if (QuicCiphersPrepare(&c->decrypt.ciphers, md, bench_secret,
+                QUIC_EVP_DECRYPT) != 0) {
+        goto err;
+    }
+
+    c->encrypt.cipher_inited = true;
+    c->decrypt.cipher_inited = true;
+
+    return quic;
+err:
+    quic->dcid.data = NULL;
+    quic->scid.data = NULL;
+    QuicFree(quic);
+    return NULL;
+}
+
+static void QuicBenchConnFree(QUIC *quic)
+{
+    quic->dcid.data = NULL;
+    quic->scid.data = NULL;
+    QuicFree(quic);
+}
+
+static int QuicBenchEncrypt(QUIC *quic, QBUFF *qb, uint8_t *out, size_t *len)
+{
+    WPacket pkt = {};
+    int ret = 0;
+
+    WPacketStaticBufInit(&pkt, out, QUIC_BENCH_PKT_MAX_LEN);
+    ret = QuicAppDataPacketBuild(quic, &pkt, qb, true);
+    *len = WPacket_get_written(&pkt);
+    WPacketCleanup(&pkt);
+
+    return ret;
+}
+
+static int QuicBenchDecrypt(QUIC *quic, uint8_t *data, size_t len,
+                            uint8_t *out, size_t *outl)
+{
+    QUIC_CRYPTO *c = &quic->application;
+    RPacket pkt = {};
+    QuicPacketFlags flags;
+
+    RPacketBufInit(&pkt, data, len);
+    if (QuicGetPktFlags(&flags, &pkt) < 0) {
+        return -1;
+    }
+
+    if (QuicSPacketHeaderParse(quic, &pkt) < 0) {
+        return -1;
+    }
+
+    /* Same packet number replayed, it is the last one sent */
+    c->largest_pn = c->pkt_num - 1;
+    *outl = 0;
+    return QuicDecryptPacket(quic, c, &pkt, out, outl, QUIC_BENCH_PKT_MAX_LEN,
+                                QUIC_SPACKET_TYPE_RESV_MASK);
+}
+
+static int QuicBenchPacket(QUIC *quic, const QuicBenchSuite *suite,
+                            size_t size, int iter)
+{
+    QBUFF *qb = NULL;
+    QuicBenchTime t = {};
+    static uint8_t pkt[QUIC_BENCH_PKT_MAX_LEN];
+    static uint8_t enc[QUIC_BENCH_PKT_MAX_LEN];
+    static uint8_t dec[QUIC_BENCH_PKT_MAX_LEN];
+    size_t pkt_len = 0;
+    size_t dec_len = 0;
+    int i = 0;
+    int ret = -1;
+
+    qb = QBuffNew(QUIC_PKT_TYPE_1RTT, size);
+    if (qb == NULL) {
+        return -1;
+    }
+
+    memset(QBuffHead(qb), 0xA5, size);
+    QBuffSetDataLen(qb, size);
+
+    QuicBenchStart(&t);
+    for (i = 0; i < iter; i++) {
+        if (QuicBenchEncrypt(quic, qb, pkt, &pkt_len) < 0) {
+            goto out;
+        }
+    }
+    QuicBenchStop(&t);
+    QuicBenchReport("encrypt", suite->name, size, iter, &t);
+
+    memcpy(enc, pkt, pkt_len);
+    QuicBenchStart(&t);
+    for (i = 0; i < iter; i++) {
+        /* Header protection is removed in place */
+        memcpy(pkt, enc, pkt_len);
+        if (QuicBenchDecrypt(quic, pkt, pkt_len, dec, &dec_len) < 0) {
+            goto out;
+        }
+    }
+    QuicBenchStop(&t);
+    QuicBenchReport("decrypt", suite->name, size, iter, &t);
+
+    if (dec_len != size || memcmp(dec, QBuffHead(qb), size) != 0) {
+        fprintf(stderr, "%s: decrypted data not match\n", suite->name);
+        goto out;
+    }
+
+    ret = 0;
+out:
+    QBuffFree(qb);
+    return ret;
+}
+
+static int QuicBenchHeader(QUIC *quic, const QuicBenchSuite *suite, int iter)
+{
+    QuicHPCipher *hp = &quic->application.decrypt.ciphers.hp_cipher;
+    QuicBenchTime t = {};
+    RPacket pkt = {};
+    uint8_t data[1 + QUIC_PACKET_NUM_MAX_LEN + QUIC_SAMPLE_LEN] = {};
+    uint32_t pkt_num = 0;
+    uint8_t pkt_num_len = 0;
+    int i = 0;
+
+    QuicBenchStart(&t);
+    for (i = 0; i < iter; i++) {
+        RPacketBufInit(&pkt, data, sizeof(data));
+        RPacketForward(&pkt, 1);
+        pkt_num = 0;
+        if (QuicDecryptHeader(hp, &pkt_num, &pkt_num_len, &pkt,
+                    QUIC_SPACKET_TYPE_RESV_MASK) < 0) {
+            return -1;
+        }
+    }
+    QuicBenchStop(&t);
+    QuicBenchReport("header", suite->name, QUIC_SAMPLE_LEN, iter, &t);
+
+    return 0;
+}
+
+static int QuicBenchVarLen(int iter)
+{
+    static const uint64_t values[] = {
+        37, 15293, 494878333, 151288809941952652,
+    };
+    QuicBenchTime t = {};
+    RPacket pkt = {};
+    uint8_t buf[QUIC_VARIABLE_LEN_MAX_SIZE * ARRAY_SIZE(values)] = {};
+    uint64_t v = 0;
+    size_t len = 0;
+    int i = 0;
+    int j = 0;
+    int n = 0;
+
+    QuicBenchStart(&t);
+    for (i = 0; i < iter; i++) {
+        len = 0;
+        for (j = 0; j < ARRAY_SIZE(values); j++) {
+            n = QuicVariableLengthEncode(&buf[len], sizeof(buf) - len,
+                                            values[j]);
+            if (n < 0) {
+                return -1;
+            }
+            len += n;
+        }
+    }
+    QuicBenchStop(&t);
+    QuicBenchReport("varint_encode", "-", len, iter, &t);
+
+    QuicBenchStart(&t);
+    for (i = 0; i < iter; i++) {
+        RPacketBufInit(&pkt, buf, len);
+        for (j = 0; j < ARRAY_SIZE(values); j++) {
+            if (QuicVariableLengthDecode(&pkt, &v) < 0 || v != values[j]) {
+                return -1;
+            }
+        }
+    }
+    QuicBenchStop(&t);
+    QuicBenchReport("varint_decode", "-", len, iter, &t);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    const QuicBenchSuite *suite = NULL;
+    int iter = QUIC_BENCH_ITER_DEF;
+    int i = 0;
+    int j = 0;
+    int c = 0;
+    int ret = -1;
+
+    while ((c = getopt_long(argc, argv, "Hn:", long_opts, NULL)) != -1) {
+        switch (c) {
+            case 'H':
+                help();
+                return 0;
+            case 'n':
+                iter = atoi(optarg);
+                break;
+            default:
+                help();
+                return -1;
+        }
+    }
+
+    if (iter <= 0) {
+        fprintf(stderr, "Invalid iterations %d\n", iter);
+        return -1;
+    }
+
+    if (QuicInit() < 0) {
+        return -1;
+    }
+
+    ctx = QuicCtxNew(QuicClientMethod());
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    printf("bench,suite,size,ns_per_pkt,gbps,cycles_per_byte\n");
+    for (i = 0; i < ARRAY_SIZE(bench_suites); i++) {
+        suite = &bench_suites[i];
+        quic = QuicBenchConnNew(ctx, suite);
+        if (quic == NULL) {
+            fprintf(stderr, "%s: cipher set up failed\n", suite->name);
+            goto out;
+        }
+
+        for (j = 0; j < ARRAY_SIZE(bench_pkt_sizes); j++) {
+            if (QuicBenchPacket(quic, suite, bench_pkt_sizes[j], iter) < 0) {
+                fprintf(stderr, "%s: packet %lu failed\n", suite->name,
+                        bench_pkt_sizes[j]);
+                goto out;
+            }
+        }
+
+        if (QuicBenchHeader(quic, suite, iter) < 0) {
+            fprintf(stderr, "%s: header protection failed\n", suite->name);
+            goto out;
+        }
+
+        QuicBenchConnFree(quic);
+        quic = NULL;
+    }
+
+    if (QuicBenchVarLen(iter) < 0) {
+        fprintf(stderr, "Variable length failed\n");
+        goto out;
+    }
+
+    ret = 0;
+out:
+    if (quic != NULL) {
+        QuicBenchConnFree(quic);
+    }
+    QuicCtxFree(ctx);
+    QuicExit();
+    return ret;
+}
@@ -37,6 +37,118 @@ static QuicFuncTest test_funcs[] = {
         .test = QuicHkdfExpandLabel,
         .err_msg = "HKDF Expand Label",
     },
+    {
+        .test = QuicKeyUpdateSecretTest,
+        .err_msg = "Key Update Secret",
+    },
+    {
+        .test = QuicKeyUpdateRxFlipTest,
+        .err_msg = "Key Update RX Phase Flip",
+    },
+    {
+        .test = QuicKeyUpdatePrevKeyTest,
+        .err_msg = "Key Update Previous Keys",
+    },
+    {
+        .test = QuicKeyUpdateTentativeTest,
+        .err_msg = "Key Update Tentative Keys",
+    },
+    {
+        .test = QuicKeyUpdateTxFlipTest,
+        .err_msg = "Key Update TX Phase Flip",
+    },
+    {
+        .test = QuicChaCha20PacketTest,
+        .err_msg = "ChaCha20 Short Header",
+    },
+    {
+        .test = QuicKeyDiscardTest,
+        .err_msg = "Key Discard",
+    },
+    {
+        .test = QuicEvpCtxPoolTest,
+        .err_msg = "EVP Context Pool",
+    },
+    {
+        .test = QuicAsyncSignTest,
+        .err_msg = "Async Sign",
+    },
+    {
+        .test = QuicKeySharePoolTest,
+        .err_msg = "Key Share Pool",
+    },
+    {
+        .test = QuicGroupCacheTest,
+        .err_msg = "Key Share Predict",
+    },
+    {
+        .test = QuicTlsConfigTest,
+        .err_msg = "TLS Config",
+    },
+    {
+        .test = QuicExtParseTest,
+        .err_msg = "Extension Parse",
+    },
+    {
+        .test = QuicEeTemplateTest,
+        .err_msg = "EncryptedExtensions Template",
+    },
+    {
+        .test = QuicTranscriptHashTest,
+        .err_msg = "Transcript Hash",
+    },
+    {
+        .test = QuicCertVerifyCacheTest,
+        .err_msg = "Cert Verify Cache",
+    },
+    {
+        .test = QuicVhostTest,
+        .err_msg = "SNI Virtual Host",
+    },
+    {
+        .test = QuicStreamTableTest,
+        .err_msg = "Stream Table",
+    },
+    {
+        .test = QuicStreamReasmTest,
+        .err_msg = "Stream Reassembly",
+    },
+    {
+        .test = QuicStreamZeroCopyRecvTest,
+        .err_msg = "Stream Zero Copy Receive",
+    },
+    {
+        .test = QuicStreamZeroCopySendTest,
+        .err_msg = "Stream Zero Copy Send",
+    },
+    {
+        .test = QuicCertChainCacheTest,
+        .err_msg = "Cert Chain Cache",
+    },
+    {
+        .test = QuicCertCompressionTest,
+        .err_msg = "Cert Compression",
+    },
+    {
+        .test = QuicSessionCacheTest,
+        .err_msg = "Session Cache",
+    },
+    {
+        .test = QuicTicketKeyRingTest,
+        .err_msg = "Ticket Key Ring",
+    },
+    {
+        .test = QuicZeroRttTest,
+        .err_msg = "Zero RTT",
+    },
+    {
+        .test = QuicAntiReplayTest,
+        .err_msg = "Anti Replay",
+    },
+    {
+        .test = QuicClntSessionCacheTest,
+        .err_msg = "Client Session Cache",
+    },
     {
         .test = QuicPktFormatTestClient,
         .err_msg = "Packet Format Client",
@@ -105,6 +217,26 @@ static QuicFuncTest test_funcs[] = {
         .test = QuicDecryptStatelessTicket,
         .err_msg = "Decrypt Stateless Ticket",
     },
+    {
+        .test = QuicHandshakePairTest,
+        .err_msg = "QUIC Handshake Pair",
+    },
+    {
+        .test = QuicZeroRttAcceptTest,
+        .err_msg = "Zero RTT Accept",
+    },
+    {
+        .test = QuicZeroRttRejectTest,
+        .err_msg = "Zero RTT Reject",
+    },
+    {
+        .test = QuicZeroRttTicketAgeTest,
+        .err_msg = "Zero RTT Ticket Age",
+    },
+    {
+        .test = QuicAsyncHandshakeTest,
+        .err_msg = "Async Handshake",
+    },
     {
         .test = QuicHandshakeTest,
         .err_msg = "QUIC Handshake",
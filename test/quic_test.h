@@ -15,6 +15,7 @@
 #define QUIC_TEST_BUF_LEN 2048
 #define QUIC_RECORD_MSS_LEN  1250
 #define QUIC_TEST_EVENT_MAX_NUM   10
+#define QUIC_TEST_HANDSHAKE_ROUNDS  32
 
 typedef union UdpConnKey {
 	struct sockaddr 		addr;
@@ -83,9 +84,47 @@ int QuicCtxServerExtensionSet(QUIC_CTX *);
 void QuicTestStreamIovecInit(QUIC_STREAM_IOVEC *, QuicTestBuff *, size_t);
 void QuicSetVerify(void *, int, char *);
 void AddEpollEvent(int, struct epoll_event *, int);
+QUIC_CTX *QuicTestServerCtxNew(void);
+QUIC_CTX *QuicTestClientCtxNew(void);
+int QuicTestPairInit(QUIC *, QUIC *, int *);
+void QuicTestPairFree(int *);
+int QuicTestHandshake(QUIC *, QUIC *);
+int QuicHandshakePairTest(void);
 int QuicVariableLengthDecodeTest(void);
 int QuicHkdfExtractExpandTest(void);
 int QuicHkdfExpandLabel(void);
+int QuicKeyUpdateSecretTest(void);
+int QuicKeyUpdateRxFlipTest(void);
+int QuicKeyUpdatePrevKeyTest(void);
+int QuicKeyUpdateTentativeTest(void);
+int QuicKeyUpdateTxFlipTest(void);
+int QuicChaCha20PacketTest(void);
+int QuicKeyDiscardTest(void);
+int QuicEvpCtxPoolTest(void);
+int QuicAsyncSignTest(void);
+int QuicAsyncHandshakeTest(void);
+int QuicKeySharePoolTest(void);
+int QuicGroupCacheTest(void);
+int QuicTlsConfigTest(void);
+int QuicExtParseTest(void);
+int QuicEeTemplateTest(void);
+int QuicTranscriptHashTest(void);
+int QuicCertVerifyCacheTest(void);
+int QuicVhostTest(void);
+int QuicStreamTableTest(void);
+int QuicStreamReasmTest(void);
+int QuicStreamZeroCopyRecvTest(void);
+int QuicStreamZeroCopySendTest(void);
+int QuicCertChainCacheTest(void);
+int QuicCertCompressionTest(void);
+int QuicSessionCacheTest(void);
+int QuicTicketKeyRingTest(void);
+int QuicZeroRttTest(void);
+int QuicZeroRttAcceptTest(void);
+int QuicZeroRttRejectTest(void);
+int QuicZeroRttTicketAgeTest(void);
+int QuicAntiReplayTest(void);
+int QuicClntSessionCacheTest(void);
 int QuicPktFormatTestClient(void);
 int QuicPktFormatTestServer(void);
 int QuicPktNumberEncodeTest(void);
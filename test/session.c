@@ -11,6 +11,7 @@
 #include "tls.h"
 #include "common.h"
 #include "tls_lib.h"
+#include "ticket_key.h"
 
 static char ticket_iv[] = "7999f26550626926eaf65877bf4568f9";
 static char ticket_aes_key[] =
@@ -64,6 +65,8 @@ int QuicSessionAsn1Test(void)
         goto err;
     }
 
+    /* Issued in the past, not the time it is decoded */
+    t->time -= 100;
     QuicSessionTicketAdd(sess, t);
 
     len = i2dQuicSession(sess, NULL);
@@ -101,6 +104,10 @@ int QuicSessionAsn1Test(void)
         goto err;
     }
 
+    if (t->time != rt->time) {
+        goto err;
+    }
+
     if (QuicDataEq(&t->ticket, &rt->ticket) == false) {
         goto err;
     }
@@ -147,7 +154,8 @@ static int QuicStatelessTicketTest(int enc)
     QUIC_SESSION *sess = NULL;
     QUIC_SESSION *rsess = NULL;
     QuicSessionTicket *t = NULL;
-    TlsTicketKey *tk = NULL;
+    TlsTicketKeyRing *ring = NULL;
+    TlsTicketKey tk = {};
     WPacket pkt;
     TLS tls = {};
     RPacket tick_nonce = {};
@@ -168,10 +176,19 @@ static int QuicStatelessTicketTest(int enc)
     }
 
     sess->cipher = QuicGetTlsCipherById(TLS_CK_AES_256_GCM_SHA384); 
-    tk = &tls.ext.ticket_key;
-    str2hex(tk->tick_aes_key, ticket_aes_key, strlen(ticket_aes_key)/2);
-    str2hex(tk->tick_hmac_key, ticket_hmac_key, strlen(ticket_hmac_key)/2);
-    str2hex(tk->tick_key_name, ticket_key_name, strlen(ticket_key_name)/2);
+    str2hex(tk.tick_aes_key, ticket_aes_key, strlen(ticket_aes_key)/2);
+    str2hex(tk.tick_hmac_key, ticket_hmac_key, strlen(ticket_hmac_key)/2);
+    str2hex(tk.tick_key_name, ticket_key_name, strlen(ticket_key_name)/2);
+    ring = TlsTicketKeyRingNew();
+    if (ring == NULL) {
+        goto err;
+    }
+
+    if (TlsTicketKeyRingRotate(ring, &tk) < 0) {
+        goto err;
+    }
+
+    tls.ext.ticket_ring = ring;
 
     t = QuicSessionTicketNew(lifetime_hint, age_add, ticket, sizeof(ticket));
     if (t == NULL) {
@@ -214,6 +231,7 @@ static int QuicStatelessTicketTest(int enc)
 
     ret = 0;
 err:
+    TlsTicketKeyRingFree(ring);
     QuicSessionFree(rsess);
     QuicSessionFree(sess);
     return ret;
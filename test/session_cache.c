@@ -0,0 +1,166 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "session.h"
+#include "session_cache.h"
+#include "tls_cipher.h"
+#include "mem.h"
+
+#define SESSION_CACHE_TEST_TTL      60
+
+static void QuicSessionCacheTestId(uint8_t *id, uint8_t v)
+{
+    memset(id, 0, QUIC_SESSION_CACHE_ID_LEN);
+    /* All in the same stripe */
+    id[QUIC_SESSION_CACHE_ID_LEN - 1] = v;
+}
+
+static int QuicSessionCacheTestAdd(QuicSessionCache *cache, uint8_t v,
+                                    uint32_t lifetime_hint)
+{
+    QUIC_SESSION *sess = NULL;
+    QuicSessionTicket *t = NULL;
+    uint8_t id[QUIC_SESSION_CACHE_ID_LEN] = {};
+    int ret = -1;
+
+    sess = QuicSessionCreate();
+    if (sess == NULL) {
+        return -1;
+    }
+
+    sess->cipher = QuicGetTlsCipherById(TLS_CK_AES_128_GCM_SHA256);
+    sess->max_early_data = v;
+    t = QuicSessionTicketNew(lifetime_hint, v, NULL, 0);
+    if (t == NULL) {
+        goto out;
+    }
+
+    memset(t->master_key, v, 32);
+    t->master_key_length = 32;
+    QuicSessionTicketAdd(sess, t);
+
+    QuicSessionCacheTestId(id, v);
+    ret = QuicSessionCacheAdd(cache, id, sess);
+out:
+    QuicSessionFree(sess);
+    return ret;
+}
+
+static bool QuicSessionCacheTestHit(QuicSessionCache *cache, uint8_t v)
+{
+    QUIC_SESSION *sess = NULL;
+    QuicSessionTicket *t = NULL;
+    uint8_t id[QUIC_SESSION_CACHE_ID_LEN] = {};
+    uint8_t master_key[32] = {};
+    bool hit = false;
+
+    QuicSessionCacheTestId(id, v);
+    sess = QuicSessionCacheLookup(cache, id, sizeof(id));
+    if (sess == NULL) {
+        return false;
+    }
+
+    memset(master_key, v, sizeof(master_key));
+    t = QuicSessionTicketPickTail(sess);
+    if (t != NULL && sess->max_early_data == v && t->age_add == v &&
+            t->master_key_length == sizeof(master_key) &&
+            memcmp(t->master_key, master_key, sizeof(master_key)) == 0 &&
+            t->ticket.len == sizeof(id) &&
+            memcmp(t->ticket.data, id, sizeof(id)) == 0) {
+        hit = true;
+    }
+
+    QuicSessionFree(sess);
+    return hit;
+}
+
+int QuicSessionCacheTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QuicSessionCache *cache = NULL;
+    pid_t pid = 0;
+    int status = 0;
+    int i = 0;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    if (QuicCtxSetSessionCache(ctx, QUIC_SESSION_CACHE_WAYS,
+                SESSION_CACHE_TEST_TTL) < 0) {
+        goto out;
+    }
+
+    cache = ctx->session_cache;
+    if (cache->stripe_num != 1) {
+        goto out;
+    }
+
+    for (i = 0; i < QUIC_SESSION_CACHE_WAYS; i++) {
+        if (QuicSessionCacheTestAdd(cache, i, SESSION_CACHE_TEST_TTL) < 0) {
+            goto out;
+        }
+    }
+
+    /* Touch 0, so 1 is the least recently used */
+    if (!QuicSessionCacheTestHit(cache, 0)) {
+        printf("Session 0 lost\n");
+        goto out;
+    }
+
+    if (QuicSessionCacheTestAdd(cache, i, SESSION_CACHE_TEST_TTL) < 0) {
+        goto out;
+    }
+
+    if (QuicSessionCacheTestHit(cache, 1) || !QuicSessionCacheTestHit(cache, 0)
+            || !QuicSessionCacheTestHit(cache, i)) {
+        printf("LRU eviction failed\n");
+        goto out;
+    }
+
+    /* Lifetime hint shorter than the TTL */
+    if (QuicSessionCacheTestAdd(cache, 1, 0) < 0) {
+        goto out;
+    }
+
+    if (QuicSessionCacheTestHit(cache, 1)) {
+        printf("Expired session returned\n");
+        goto out;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        goto out;
+    }
+
+    if (pid == 0) {
+        _exit(QuicSessionCacheTestAdd(cache, 0xA5, SESSION_CACHE_TEST_TTL));
+    }
+
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+        goto out;
+    }
+
+    if (!QuicSessionCacheTestHit(cache, 0xA5)) {
+        printf("Session added by another process not found\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -0,0 +1,202 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+#include <tbquic/stream.h>
+
+#include "quic_local.h"
+#include "stream.h"
+#include "common.h"
+
+#define STREAM_REASM_TEST_OFO_LEN       (512 * 1024)
+#define STREAM_REASM_TEST_BUF_LEN       (STREAM_REASM_TEST_OFO_LEN + 128)
+#define STREAM_REASM_TEST_LIMIT         (1 << 30)
+
+typedef struct {
+    int64_t start;
+    int64_t end;
+} QuicStreamReasmTestRange;
+
+static QUIC_DATA_BUF *stream_reasm_buf;
+
+static int QuicStreamReasmTestAdd(QUIC *quic, QuicStreamInstance *si,
+                                    int64_t start, int64_t end)
+{
+    QuicStreamData *sd = NULL;
+    uint8_t *data = stream_reasm_buf->buf.data;
+
+    sd = QuicStreamDataCreate(stream_reasm_buf, start, &data[start],
+                                end - start);
+    if (sd == NULL) {
+        return -1;
+    }
+
+    QuicStreamDataAdd(quic, sd, si);
+    return 0;
+}
+
+/* Return 0 if the queue holds exactly @range, in order */
+static int QuicStreamReasmTestCheck(QuicStreamInstance *si,
+                    const QuicStreamReasmTestRange *range, size_t num)
+{
+    QuicStreamData *sd = NULL;
+    uint64_t bytes = 0;
+    size_t i = 0;
+
+    list_for_each_entry(sd, &si->queue, node) {
+        if (i >= num || sd->offset != range[i].start ||
+                sd->offset + sd->len != range[i].end) {
+            return -1;
+        }
+        bytes += sd->len;
+        i++;
+    }
+
+    if (i != num || bytes != si->reasm_bytes) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int QuicStreamReasmTest(void)
+{
+    static const QuicStreamReasmTestRange ofo[] = {
+        { 10, 25 }, { 25, 30 }, { 40, 50 },
+    };
+    static const QuicStreamReasmTestRange filled[] = {
+        { 0, 12 }, { 12, 25 }, { 25, 30 }, { 40, 50 },
+    };
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QuicStreamInstance *si = NULL;
+    QuicTransParams *peer = NULL;
+    uint8_t *data = NULL;
+    uint8_t rbuf[64] = {};
+    QuicStreamData *last = NULL;
+    int64_t ofo_end = 0;
+    int i = 0;
+    int case_num = -1;
+
+    stream_reasm_buf = QuicDataBufCreate(STREAM_REASM_TEST_BUF_LEN);
+    if (stream_reasm_buf == NULL) {
+        return -1;
+    }
+
+    data = stream_reasm_buf->buf.data;
+    for (i = 0; i < STREAM_REASM_TEST_BUF_LEN; i++) {
+        data[i] = i;
+    }
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    QUIC_set_accept_state(quic);
+    peer = &quic->peer_param;
+    quic->tls.ext.trans_param.initial_max_stream_bidi = 1;
+    peer->initial_max_stream_data_bidi_remote = STREAM_REASM_TEST_LIMIT;
+    peer->initial_max_data = STREAM_REASM_TEST_LIMIT;
+    if (QuicStreamInit(quic) < 0) {
+        goto out;
+    }
+
+    si = QuicStreamGetInstance(quic, 0);
+    if (si == NULL) {
+        goto out;
+    }
+
+    /* Overlaps trimmed, duplicate dropped */
+    if (QuicStreamReasmTestAdd(quic, si, 20, 30) < 0 ||
+            QuicStreamReasmTestAdd(quic, si, 10, 25) < 0 ||
+            QuicStreamReasmTestAdd(quic, si, 40, 50) < 0 ||
+            QuicStreamReasmTestAdd(quic, si, 42, 48) < 0) {
+        goto out;
+    }
+
+    if (QuicStreamReasmTestCheck(si, ofo, QUIC_NELEM(ofo)) < 0 ||
+            si->stat_bytes.recvd != 30 || si->contig != 0) {
+        printf("Out of order segments not merged\n");
+        goto out;
+    }
+
+    if (QuicStreamReasmTestAdd(quic, si, 0, 12) < 0 ||
+            QuicStreamReasmTestCheck(si, filled, QUIC_NELEM(filled)) < 0 ||
+            si->contig != 30) {
+        printf("Contiguous point not advanced\n");
+        goto out;
+    }
+
+    if (QuicStreamReasmTestAdd(quic, si, 30, 40) < 0 || si->contig != 50) {
+        goto out;
+    }
+
+    if (QuicStreamRecv(quic, 0, NULL, rbuf, sizeof(rbuf)) != 50 ||
+            memcmp(rbuf, data, 50) != 0 || !list_empty(&si->queue) ||
+            si->reasm_bytes != 0) {
+        printf("Reassembled data wrong\n");
+        goto out;
+    }
+
+    /*
+     * Everything inside the window is kept however far out of order, a
+     * one byte segment does not hold on to its datagram
+     */
+    ofo_end = 51 + STREAM_REASM_TEST_OFO_LEN;
+    if (QuicStreamReasmTestAdd(quic, si, 51, ofo_end) < 0 ||
+            QuicStreamReasmTestAdd(quic, si, ofo_end + 10,
+                ofo_end + 11) < 0) {
+        goto out;
+    }
+
+    last = list_last_entry(&si->queue, QuicStreamData, node);
+    if (si->reasm_bytes != STREAM_REASM_TEST_OFO_LEN + 1 ||
+            si->reasm_segs != 2 || last->origin_buf == stream_reasm_buf) {
+        printf("Out of order data dropped\n");
+        goto out;
+    }
+
+    if (QuicStreamReasmTestAdd(quic, si, 50, 51) < 0 ||
+            si->contig != ofo_end) {
+        printf("In order data dropped\n");
+        goto out;
+    }
+
+    /* Contiguous up to the last segment, but short of the final size */
+    si->final_size = ofo_end + 20;
+    si->recv_state = QUIC_STREAM_STATE_SIZE_KNOWN;
+    if (QuicStreamReasmTestAdd(quic, si, ofo_end, ofo_end + 10) < 0 ||
+            si->contig != ofo_end + 11 ||
+            si->recv_state != QUIC_STREAM_STATE_SIZE_KNOWN) {
+        printf("Stream complete before final size\n");
+        goto out;
+    }
+
+    if (QuicStreamReasmTestAdd(quic, si, ofo_end + 11, ofo_end + 20) < 0 ||
+            si->recv_state != QUIC_STREAM_STATE_DATA_RECVD) {
+        printf("Stream not complete at final size\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    if (quic != NULL) {
+        QuicFree(quic);
+    }
+    if (ctx != NULL) {
+        QuicCtxFree(ctx);
+    }
+    QuicDataBufFree(stream_reasm_buf);
+
+    return case_num;
+}
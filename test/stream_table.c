@@ -0,0 +1,165 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <tbquic/quic.h>
+#include <tbquic/stream.h>
+
+#include "quic_local.h"
+#include "stream.h"
+#include "frame.h"
+#include "packet_local.h"
+#include "common.h"
+
+#define STREAM_TABLE_TEST_MAX_STREAMS   1000
+#define STREAM_TABLE_TEST_NUM           100
+
+/* Client initiated bidirectional stream @n, opened by the peer */
+#define STREAM_TABLE_TEST_ID(n)  ((int64_t)(n) << QUIC_STREAM_ID_MASK_BITS)
+
+static void QuicStreamTableTestFinish(QuicStreamInstance *si)
+{
+    si->recv_state = QUIC_STREAM_STATE_DATA_READ;
+    si->send_state = QUIC_STREAM_STATE_DATA_RECVD;
+}
+
+int QuicStreamTableTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QuicStreamConf *scf = NULL;
+    QuicStreamInstance *si = NULL;
+    QuicStreamInstance *reclaimed = NULL;
+    RPacket pkt = {};
+    int closed[] = { 90, 3, 2 };
+    /* STREAM with LEN, ID filled in, 3 bytes at offset 0 */
+    uint8_t late[] = {
+        QUIC_FRAME_TYPE_STREAM | QUIC_FRAME_STREAM_BIT_LEN, 0, 3, 'a', 'b', 'c',
+    };
+    int64_t id = 0;
+    int i = 0;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    QUIC_set_accept_state(quic);
+    quic->tls.ext.trans_param.initial_max_stream_bidi =
+        STREAM_TABLE_TEST_MAX_STREAMS;
+    quic->peer_param.initial_max_stream_bidi = STREAM_TABLE_TEST_MAX_STREAMS;
+    if (QuicStreamInit(quic) < 0) {
+        goto out;
+    }
+
+    /* Nothing allocated for streams never used */
+    scf = &quic->stream;
+    if (QuicStreamGetInstance(quic, QUIC_STREAM_INITIATED_BY_SERVER) != NULL ||
+            scf->num != 0) {
+        printf("Local stream not opened found\n");
+        goto out;
+    }
+
+    for (i = STREAM_TABLE_TEST_NUM - 1; i >= 0; i--) {
+        si = QuicStreamGetInstance(quic, STREAM_TABLE_TEST_ID(i));
+        if (si == NULL || si->id != STREAM_TABLE_TEST_ID(i) ||
+                si->recv_state != QUIC_STREAM_STATE_RECV) {
+            printf("Peer stream %d not opened\n", i);
+            goto out;
+        }
+    }
+
+    /* Same instances after the table grew */
+    for (i = 0; i < STREAM_TABLE_TEST_NUM; i++) {
+        si = QuicStreamGetInstance(quic, STREAM_TABLE_TEST_ID(i));
+        if (si == NULL || si->id != STREAM_TABLE_TEST_ID(i)) {
+            goto out;
+        }
+    }
+
+    if (scf->num != STREAM_TABLE_TEST_NUM) {
+        goto out;
+    }
+
+    /* Stream 0 stays open, closed ones far ahead of it are remembered */
+    for (i = 0; i < QUIC_NELEM(closed); i++) {
+        si = QuicStreamGetInstance(quic, STREAM_TABLE_TEST_ID(closed[i]));
+        QuicStreamTableTestFinish(si);
+        if (!QuicStreamTryReclaim(quic, si)) {
+            printf("Stream %d not reclaimed\n", closed[i]);
+            goto out;
+        }
+    }
+
+    if (scf->closed[0].num != 2 || scf->closed[0].range[0].start != 2 ||
+            scf->closed[0].range[0].end != 4) {
+        printf("Closed ranges not merged\n");
+        goto out;
+    }
+
+    reclaimed = QuicStreamGetInstance(quic, STREAM_TABLE_TEST_ID(1));
+    if (QuicStreamTryReclaim(quic, reclaimed)) {
+        printf("Open stream reclaimed\n");
+        goto out;
+    }
+
+    QuicStreamTableTestFinish(reclaimed);
+    if (!QuicStreamTryReclaim(quic, reclaimed) ||
+            scf->num != STREAM_TABLE_TEST_NUM - QUIC_NELEM(closed) - 1 ||
+            scf->closed[0].num != 2 || scf->closed[0].range[0].start != 1) {
+        printf("Finished stream not reclaimed\n");
+        goto out;
+    }
+
+    /* A late STREAM frame for it is dropped, not a parse error */
+    late[1] = STREAM_TABLE_TEST_ID(1);
+    RPacketBufInit(&pkt, late, sizeof(late));
+    if (QuicFrameDoParser(quic, &pkt, &quic->application,
+                QUIC_PKT_TYPE_1RTT, NULL) < 0 ||
+            RPacketRemaining(&pkt) != 0 ||
+            scf->num != STREAM_TABLE_TEST_NUM - QUIC_NELEM(closed) - 1) {
+        printf("Late frame of closed stream not skipped\n");
+        goto out;
+    }
+
+    /* Still an error for a stream that never existed */
+    late[1] = QUIC_STREAM_INITIATED_BY_SERVER;
+    RPacketBufInit(&pkt, late, sizeof(late));
+    if (QuicFrameDoParser(quic, &pkt, &quic->application,
+                QUIC_PKT_TYPE_1RTT, NULL) == 0) {
+        printf("Frame of unopened local stream accepted\n");
+        goto out;
+    }
+
+    /* Instance handed out again from the slab */
+    id = STREAM_TABLE_TEST_ID(STREAM_TABLE_TEST_NUM);
+    si = QuicStreamGetInstance(quic, id);
+    if (si != reclaimed) {
+        printf("Reclaimed instance not reused\n");
+        goto out;
+    }
+
+    id = QuicStreamOpen(quic, false);
+    if (id != QUIC_STREAM_INITIATED_BY_SERVER ||
+            QuicStreamGetInstance(quic, id) == NULL) {
+        printf("Local stream not opened\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    if (quic != NULL) {
+        QuicFree(quic);
+    }
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
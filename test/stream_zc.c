@@ -0,0 +1,170 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+#include <tbquic/stream.h>
+
+#include "quic_local.h"
+#include "stream.h"
+#include "common.h"
+
+#define STREAM_ZC_TEST_BUF_LEN      64
+#define STREAM_ZC_TEST_LIMIT        (1 << 20)
+#define STREAM_ZC_TEST_SEG_LEN      1200
+/* Out of order datagrams queued while a loan is held */
+#define STREAM_ZC_TEST_OFO_NUM      400
+
+static int QuicStreamZcTestAdd(QUIC *quic, QuicStreamInstance *si,
+                        QUIC_DATA_BUF *buf, int64_t start, int64_t end)
+{
+    QuicStreamData *sd = NULL;
+    uint8_t *data = buf->buf.data;
+
+    sd = QuicStreamDataCreate(buf, start, &data[start], end - start);
+    if (sd == NULL) {
+        return -1;
+    }
+
+    QuicStreamDataAdd(quic, sd, si);
+    return 0;
+}
+
+/* One full datagram per segment from @start on */
+static int QuicStreamZcTestAddOfo(QUIC *quic, QuicStreamInstance *si,
+                                    int64_t start)
+{
+    QUIC_DATA_BUF *seg = NULL;
+    QuicStreamData *sd = NULL;
+    int i = 0;
+
+    for (i = 0; i < STREAM_ZC_TEST_OFO_NUM; i++) {
+        seg = QuicDataBufCreate(STREAM_ZC_TEST_SEG_LEN);
+        if (seg == NULL) {
+            return -1;
+        }
+
+        sd = QuicStreamDataCreate(seg, start + i*STREAM_ZC_TEST_SEG_LEN,
+                                seg->buf.data, STREAM_ZC_TEST_SEG_LEN);
+        QuicDataBufFree(seg);
+        if (sd == NULL) {
+            return -1;
+        }
+
+        QuicStreamDataAdd(quic, sd, si);
+    }
+
+    return 0;
+}
+
+int QuicStreamZeroCopyRecvTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QuicStreamInstance *si = NULL;
+    QuicTransParams *peer = NULL;
+    QUIC_DATA_BUF *buf = NULL;
+    QUIC_STREAM_LOAN *loan = NULL;
+    QUIC_STREAM_IOVEC iov[4] = {};
+    uint8_t *data = NULL;
+    int case_num = -1;
+
+    buf = QuicDataBufCreate(STREAM_ZC_TEST_BUF_LEN);
+    if (buf == NULL) {
+        return -1;
+    }
+
+    data = buf->buf.data;
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        goto out;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    QUIC_set_accept_state(quic);
+    peer = &quic->peer_param;
+    quic->tls.ext.trans_param.initial_max_stream_bidi = 1;
+    peer->initial_max_stream_data_bidi_remote = STREAM_ZC_TEST_LIMIT;
+    peer->initial_max_data = STREAM_ZC_TEST_LIMIT;
+    if (QuicStreamInit(quic) < 0) {
+        goto out;
+    }
+
+    si = QuicStreamGetInstance(quic, 0);
+    if (si == NULL) {
+        goto out;
+    }
+
+    if (QuicStreamZcTestAdd(quic, si, buf, 0, 10) < 0 ||
+            QuicStreamZcTestAdd(quic, si, buf, 10, 20) < 0 ||
+            QuicStreamZcTestAdd(quic, si, buf, 30, 40) < 0) {
+        goto out;
+    }
+
+    /* In order segments lent in place, the gap stops the loan */
+    if (QuicStreamRecvBorrow(quic, 0, NULL, iov, QUIC_NELEM(iov),
+                &loan) != 2 || loan == NULL ||
+            iov[0].iov_base != data || iov[0].data_len != 10 ||
+            iov[1].iov_base != &data[10] || iov[1].data_len != 10) {
+        printf("Data not lent in place\n");
+        goto out;
+    }
+
+    /* Buffer held by the loan only, not by the out of order segment */
+    if (buf->ref != 3 || si->offset != 20 || si->lent_bytes != 20) {
+        printf("Loan not accounted\n");
+        goto out;
+    }
+
+    QuicStreamRecvRelease(quic, loan);
+    loan = NULL;
+    if (buf->ref != 1 || si->lent_bytes != 0) {
+        printf("Loan not released\n");
+        goto out;
+    }
+
+    if (QuicStreamZcTestAdd(quic, si, buf, 20, 30) < 0 ||
+            QuicStreamRecvBorrow(quic, 0, NULL, iov, 1, &loan) != 1 ||
+            iov[0].iov_base != &data[20]) {
+        printf("Filled gap not lent\n");
+        goto out;
+    }
+
+    /* The small out of order segment was copied off the datagram */
+    QuicStreamRecvRelease(quic, loan);
+    loan = NULL;
+    if (QuicStreamRecvBorrow(quic, 0, NULL, iov, QUIC_NELEM(iov),
+                &loan) != 1 || iov[0].data_len != 10 ||
+            memcmp(iov[0].iov_base, &data[30], 10) != 0 ||
+            si->reasm_bytes != 0) {
+        goto out;
+    }
+
+    /* Data lent out does not crowd out data inside the window */
+    if (QuicStreamZcTestAddOfo(quic, si, 100) < 0 ||
+            si->reasm_bytes != STREAM_ZC_TEST_OFO_NUM*STREAM_ZC_TEST_SEG_LEN ||
+            si->lent_bytes != 10) {
+        printf("Out of order data dropped while lent\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    if (quic != NULL) {
+        QuicStreamRecvRelease(quic, loan);
+        QuicFree(quic);
+    }
+    if (ctx != NULL) {
+        QuicCtxFree(ctx);
+    }
+    QuicDataBufFree(buf);
+
+    return case_num;
+}
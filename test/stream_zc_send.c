@@ -0,0 +1,293 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+#include <tbquic/stream.h>
+#include <tbquic/cipher.h>
+
+#include "quic_local.h"
+#include "stream.h"
+#include "frame.h"
+#include "q_buff.h"
+#include "format.h"
+#include "cipher.h"
+#include "mem.h"
+#include "common.h"
+
+#define STREAM_ZC_SEND_TEST_LEN     4000
+#define STREAM_ZC_SEND_TEST_HLEN    8
+#define STREAM_ZC_SEND_TEST_PLEN    256
+#define STREAM_ZC_SEND_TEST_OUT_LEN 1500
+
+static uint8_t stream_zc_send_data[STREAM_ZC_SEND_TEST_LEN] = {
+    0x08, 0x01, 0x40, 0x80, 0x55, 0xAA, 0x11, 0x22,
+};
+static int stream_zc_send_called;
+static bool stream_zc_send_acked;
+
+static void QuicStreamZcSendTestCb(QUIC_STREAM_HANDLE h, void *data,
+                                    size_t len, bool acked, void *arg)
+{
+    if (data == stream_zc_send_data && len == STREAM_ZC_SEND_TEST_LEN) {
+        stream_zc_send_called++;
+        stream_zc_send_acked = acked;
+    }
+}
+
+static QuicStreamSendBuf *QuicStreamZcSendTestBuf(int64_t id)
+{
+    QuicStreamSendBuf *sb = NULL;
+
+    sb = QuicMemCalloc(sizeof(*sb));
+    if (sb == NULL) {
+        return NULL;
+    }
+
+    sb->ref = 1;
+    sb->id = id;
+    sb->data = stream_zc_send_data;
+    sb->len = sizeof(stream_zc_send_data);
+    sb->unacked = sb->len;
+    sb->cb = QuicStreamZcSendTestCb;
+    stream_zc_send_called = 0;
+
+    return sb;
+}
+
+/* Return the number of packets referencing the data in place, -1 if not */
+static int QuicStreamZcSendTestCheck(QBuffQueueHead *h, int64_t id)
+{
+    QBUFF *qb = NULL;
+    RPacket pkt = {};
+    uint64_t type = 0;
+    uint64_t v = 0;
+    size_t offset = 0;
+    int num = 0;
+
+    list_for_each_entry(qb, &h->queue, node) {
+        if (qb->ext != &stream_zc_send_data[offset] ||
+                QBuffGetDataLen(qb) > QBuffLen(qb)) {
+            return -1;
+        }
+
+        /* Header only in the packet buffer */
+        RPacketBufInit(&pkt, QBuffHead(qb), qb->data_len);
+        if (QuicVariableLengthDecode(&pkt, &type) < 0 ||
+                !(type & QUIC_FRAME_STREAM_BIT_LEN) ||
+                QuicVariableLengthDecode(&pkt, &v) < 0 || v != id) {
+            return -1;
+        }
+
+        if (offset != 0 && (!(type & QUIC_FRAME_STREAM_BIT_OFF) ||
+                    QuicVariableLengthDecode(&pkt, &v) < 0 || v != offset)) {
+            return -1;
+        }
+
+        if (QuicVariableLengthDecode(&pkt, &v) < 0 || v != qb->ext_len ||
+                RPacketRemaining(&pkt) != 0) {
+            return -1;
+        }
+
+        qb->pkt_num = ++num;
+        offset += qb->ext_len;
+    }
+
+    if (offset != sizeof(stream_zc_send_data)) {
+        return -1;
+    }
+
+    return num;
+}
+
+/* Seal @qb in an Initial packet, always with the same packet number */
+static int QuicStreamZcSendTestSeal(QUIC *quic, QBUFF *qb, uint8_t *out,
+                                    size_t *len)
+{
+    WPacket pkt = {};
+    int ret = 0;
+
+    quic->initial.pkt_num = 0;
+    WPacketStaticBufInit(&pkt, out, STREAM_ZC_SEND_TEST_OUT_LEN);
+    ret = QuicInitialPacketBuild(quic, &pkt, qb, false);
+    *len = WPacket_get_written(&pkt);
+    WPacketCleanup(&pkt);
+
+    return ret;
+}
+
+/* Same packet whether the data is copied or encrypted in place */
+static int QuicStreamZcSendTestEncrypt(QUIC *quic)
+{
+    static uint8_t cid_data[] = "\x83\x94\xC8\xF0\x3E\x51\x57\x08";
+    static uint8_t out[2][STREAM_ZC_SEND_TEST_OUT_LEN];
+    QUIC_DATA cid = {
+        .data = cid_data,
+        .len = sizeof(cid_data) - 1,
+    };
+    QBUFF *flat = NULL;
+    QBUFF *zc = NULL;
+    uint8_t *data = stream_zc_send_data;
+    size_t len[2] = {};
+    size_t plen = STREAM_ZC_SEND_TEST_HLEN + STREAM_ZC_SEND_TEST_PLEN;
+    int ret = -1;
+
+    if (QuicCreateInitialDecoders(quic, QUIC_VERSION_1, &cid) < 0) {
+        return -1;
+    }
+
+    flat = QBuffNew(QUIC_PKT_TYPE_INITIAL, plen);
+    zc = QBuffNew(QUIC_PKT_TYPE_INITIAL, STREAM_ZC_SEND_TEST_HLEN);
+    if (flat == NULL || zc == NULL) {
+        goto out;
+    }
+
+    QuicMemcpy(QBuffHead(flat), data, plen);
+    QBuffSetDataLen(flat, plen);
+    QuicMemcpy(QBuffHead(zc), data, STREAM_ZC_SEND_TEST_HLEN);
+    QBuffSetDataLen(zc, STREAM_ZC_SEND_TEST_HLEN);
+    zc->ext = &data[STREAM_ZC_SEND_TEST_HLEN];
+    zc->ext_len = STREAM_ZC_SEND_TEST_PLEN;
+
+    if (QuicStreamZcSendTestSeal(quic, flat, out[0], &len[0]) < 0 ||
+            QuicStreamZcSendTestSeal(quic, zc, out[1], &len[1]) < 0) {
+        goto out;
+    }
+
+    if (len[0] == 0 || len[0] != len[1] ||
+            memcmp(out[0], out[1], len[0]) != 0) {
+        goto out;
+    }
+
+    ret = 0;
+out:
+    QBuffFree(zc);
+    QBuffFree(flat);
+    return ret;
+}
+
+int QuicStreamZeroCopySendTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QuicStreamSendBuf *sb = NULL;
+    QuicStreamInstance *si = NULL;
+    QBuffQueueHead sent = {};
+    int64_t id = 0;
+    int num = 0;
+    int case_num = -1;
+
+    QBuffQueueHeadInit(&sent);
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    QUIC_set_accept_state(quic);
+    quic->tls.ext.trans_param.initial_max_stream_bidi = 4;
+    quic->peer_param.initial_max_stream_bidi = 4;
+    if (QUIC_set_pp_cipher_space_alg(&quic->application.encrypt,
+                QUIC_ALG_AES_128_GCM) < 0 || QuicStreamInit(quic) < 0) {
+        goto out;
+    }
+
+    id = QuicStreamOpen(quic, false);
+    si = QuicStreamGetInstance(quic, id);
+    sb = QuicStreamZcSendTestBuf(id);
+    if (si == NULL || sb == NULL) {
+        goto out;
+    }
+
+    if (QuicStreamFrameBuildZc(quic, sb, QUIC_PKT_TYPE_1RTT) < 0) {
+        goto out;
+    }
+
+    num = QuicStreamZcSendTestCheck(&quic->tx_queue, id);
+    if (num < 2 || si->send_offset != sizeof(stream_zc_send_data)) {
+        printf("Stream data not referenced in place\n");
+        goto out;
+    }
+
+    list_splice_init(&quic->tx_queue.queue, &sent.queue);
+    QBufAckSentPkt(quic, &sent, 1, num - 1, NULL);
+    if (stream_zc_send_called != 0) {
+        printf("Completion before all data acked\n");
+        goto out;
+    }
+
+    QBufAckSentPkt(quic, &sent, num, num, NULL);
+    if (stream_zc_send_called != 1 || !stream_zc_send_acked) {
+        printf("Completion not called on ack\n");
+        goto out;
+    }
+
+    QuicStreamSendBufPut(sb);
+    sb = NULL;
+    if (stream_zc_send_called != 1) {
+        goto out;
+    }
+
+    /* Dropped unacked, completion tells so once */
+    sb = QuicStreamZcSendTestBuf(id);
+    if (sb == NULL || QuicStreamFrameBuildZc(quic, sb,
+                QUIC_PKT_TYPE_1RTT) < 0) {
+        goto out;
+    }
+
+    QuicStreamSendBufPut(sb);
+    sb = NULL;
+    QBuffQueueDestroy(&quic->tx_queue);
+    if (stream_zc_send_called != 1 || stream_zc_send_acked) {
+        printf("Completion not called on drop\n");
+        goto out;
+    }
+
+    /* Nothing to reference, no completion */
+    if (QuicStreamSendZeroCopy(quic, id, stream_zc_send_data, 0,
+                QuicStreamZcSendTestCb, NULL) >= 0) {
+        printf("Empty zero copy send accepted\n");
+        goto out;
+    }
+
+    /* Queued frames keep @data even if writing them out fails */
+    stream_zc_send_called = 0;
+    if (QuicStreamSendZeroCopy(quic, id, stream_zc_send_data,
+                sizeof(stream_zc_send_data), QuicStreamZcSendTestCb,
+                NULL) != sizeof(stream_zc_send_data) ||
+            stream_zc_send_called != 0) {
+        printf("Queued zero copy send reported failed\n");
+        goto out;
+    }
+
+    QBuffQueueDestroy(&quic->tx_queue);
+    if (stream_zc_send_called != 1 || stream_zc_send_acked) {
+        printf("Completion not called for queued data\n");
+        goto out;
+    }
+
+    if (QuicStreamZcSendTestEncrypt(quic) < 0) {
+        printf("Data encrypted in place differs\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QBuffQueueDestroy(&sent);
+    if (sb != NULL) {
+        QuicStreamSendBufPut(sb);
+    }
+    if (quic != NULL) {
+        QuicFree(quic);
+    }
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -0,0 +1,157 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "session.h"
+#include "ticket_key.h"
+#include "tls_lib.h"
+#include "tls_cipher.h"
+
+#define TICKET_KEY_TEST_BUF_LEN     1024
+/* lifetime, age_add, nonce and ticket length */
+#define TICKET_KEY_TEST_OFFSET      (4 + 4 + 1 + TICKET_NONCE_SIZE + 2)
+
+typedef struct {
+    uint8_t buf[TICKET_KEY_TEST_BUF_LEN];
+    size_t len;
+} QuicTicketKeyTestTicket;
+
+static int QuicTicketKeyTestIssue(TLS *s, QUIC_SESSION *sess,
+                                    QuicTicketKeyTestTicket *tick)
+{
+    WPacket pkt = {};
+    RPacket nonce = {};
+    uint8_t tick_nonce[TICKET_NONCE_SIZE] = {};
+    int ret = 0;
+
+    WPacketStaticBufInit(&pkt, tick->buf, sizeof(tick->buf));
+    RPacketBufInit(&nonce, tick_nonce, sizeof(tick_nonce));
+    ret = TlsConstructStatelessTicket(s, sess, &pkt, &nonce);
+    tick->len = WPacket_get_written(&pkt);
+    WPacketCleanup(&pkt);
+
+    return ret;
+}
+
+/* Return 1 if the ticket needs renewal, 0 if not, -1 if rejected */
+static int QuicTicketKeyTestAccept(TLS *s, QuicTicketKeyTestTicket *tick)
+{
+    QUIC_SESSION *sess = NULL;
+
+    s->ext.ticket_renew = false;
+    if (TlsDecryptTicket(s, tick->buf + TICKET_KEY_TEST_OFFSET,
+                tick->len - TICKET_KEY_TEST_OFFSET, &sess) < 0) {
+        return -1;
+    }
+
+    QuicSessionFree(sess);
+    return s->ext.ticket_renew;
+}
+
+int QuicTicketKeyRingTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    QUIC_SESSION *sess = NULL;
+    QuicSessionTicket *t = NULL;
+    TlsTicketKey current = {};
+    TLS *s = NULL;
+    static QuicTicketKeyTestTicket old;
+    static QuicTicketKeyTestTicket cur;
+    uint8_t key[QUIC_TICKET_KEY_LEN] = {};
+    size_t i = 0;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    s = &quic->tls;
+    sess = QuicSessionCreate();
+    if (sess == NULL) {
+        goto out;
+    }
+
+    sess->cipher = QuicGetTlsCipherById(TLS_CK_AES_128_GCM_SHA256);
+    t = QuicSessionTicketNew(7200, 0, NULL, 0);
+    if (t == NULL) {
+        goto out;
+    }
+    t->master_key_length = 32;
+    QuicSessionTicketAdd(sess, t);
+
+    if (QuicTicketKeyTestIssue(s, sess, &old) < 0 ||
+            QuicTicketKeyTestAccept(s, &old) != 0) {
+        printf("Ticket of current key failed\n");
+        goto out;
+    }
+
+    if (QuicCtxRotateTicketKey(ctx, NULL, 0) < 0) {
+        goto out;
+    }
+
+    if (QuicTicketKeyTestAccept(s, &old) != 1) {
+        printf("Ticket of old key not marked for renewal\n");
+        goto out;
+    }
+
+    if (QuicTicketKeyTestIssue(s, sess, &cur) < 0 ||
+            QuicTicketKeyTestAccept(s, &cur) != 0) {
+        printf("Ticket of rotated key failed\n");
+        goto out;
+    }
+
+    for (i = 0; i < sizeof(key); i++) {
+        key[i] = i;
+    }
+
+    if (QuicCtxRotateTicketKey(ctx, key, sizeof(key) - 1) == 0) {
+        goto out;
+    }
+
+    if (QuicCtxSetTicketKeyNum(ctx, 2) < 0) {
+        goto out;
+    }
+
+    if (QuicCtxRotateTicketKey(ctx, key, sizeof(key)) < 0) {
+        goto out;
+    }
+
+    TlsTicketKeyRingCurrent(ctx->ext.ticket_keys, &current);
+    if (memcmp(current.tick_key_name, key, TLSEXT_KEYNAME_LENGTH) != 0) {
+        printf("Given key not used\n");
+        goto out;
+    }
+
+    if (QuicTicketKeyTestAccept(s, &old) >= 0) {
+        printf("Ticket of dropped key accepted\n");
+        goto out;
+    }
+
+    if (QuicTicketKeyTestAccept(s, &cur) != 1) {
+        printf("Ticket of previous key rejected\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicSessionFree(sess);
+    if (quic != NULL) {
+        QuicFree(quic);
+    }
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
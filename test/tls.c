@@ -316,8 +316,7 @@ int TlsClientHandshakeReadTest(void)
     QuicBufAddDataLength(buf, msg_len);
 
     tls = &quic->tls;
-    tls->kexch_key = TlsGeneratePkeyGroup(tls, EC_NAMED_CURVE_X25519);
-    if (tls->kexch_key == NULL) {
+    if (TlsKeyShareGet(tls, EC_NAMED_CURVE_X25519) == NULL) {
         printf("TLS Gen Pkey Group failed!\n");
         goto out;
     }
@@ -396,20 +395,21 @@ int TlsGenerateMasterSecretTest(void)
     }
 
     s = &quic->tls;
-    str2hex(s->handshake_secret, insecret, sizeof(s->handshake_secret));
+    str2hex(s->hs->handshake_secret, insecret, sizeof(s->hs->handshake_secret));
     s->handshake_cipher = QuicGetTlsCipherById(TLS_CK_AES_256_GCM_SHA384);
     if (s->handshake_cipher == NULL) {
         printf("Find handshake cipher failed\n");
         goto out;
     }
 
-    if (TlsGenerateMasterSecret(s, s->master_secret, s->handshake_secret,
-                                 &secret_size) < 0) {
+    if (TlsGenerateMasterSecret(s, s->hs->master_secret,
+                                    s->hs->handshake_secret,
+                                    &secret_size) < 0) {
         goto out;
     }
 
     str2hex(secret, outsecret, sizeof(secret));
-    if (memcmp(secret, s->master_secret, secret_size) != 0) {
+    if (memcmp(secret, s->hs->master_secret, secret_size) != 0) {
         goto out;
     }
 
@@ -457,7 +457,7 @@ int TlsPskDoBinderTest(void)
         goto out;
     }
  
-    if (memcmp(s->early_secret, early_secret, hashsize) != 0) {
+    if (memcmp(s->hs->early_secret, early_secret, hashsize) != 0) {
         printf("Early secert not match\n");
         goto out;
     }
@@ -0,0 +1,97 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "tls_config.h"
+#include "common.h"
+
+int QuicTlsConfigTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *first = NULL;
+    QUIC *second = NULL;
+    QUIC *third = NULL;
+    TlsConfig *conf = NULL;
+    const uint8_t alpn[] = "\x02h3";
+    const uint8_t own_alpn[] = "\x05h3-29";
+    uint16_t groups[] = {
+        TLS_SUPPORTED_GROUPS_SECP256R1,
+    };
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicClientMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    if (QUIC_CTX_set_alpn_protos(ctx, alpn, sizeof(alpn) - 1) < 0) {
+        goto out;
+    }
+
+    first = QuicNew(ctx);
+    second = QuicNew(ctx);
+    if (first == NULL || second == NULL) {
+        goto out;
+    }
+
+    conf = first->tls.config;
+    if (second->tls.config != conf || conf->refcnt != 3 ||
+            second->tls.ext.alpn.data != conf->alpn.data ||
+            second->tls.cert != conf->cert) {
+        printf("Config not shared\n");
+        goto out;
+    }
+
+    if (QUIC_set_alpn_protos(second, own_alpn, sizeof(own_alpn) - 1) < 0 ||
+            QuicCtrl(second, QUIC_CTRL_SET_GROUPS, groups,
+                QUIC_NELEM(groups)) < 0) {
+        goto out;
+    }
+
+    if (second->tls.ext.alpn.data == conf->alpn.data ||
+            second->tls.ext.supported_groups.data ==
+            conf->supported_groups.data ||
+            first->tls.ext.alpn.data != conf->alpn.data ||
+            !QuicDataEq(&conf->alpn, &ctx->ext.alpn)) {
+        printf("Connection setting leaked into config\n");
+        goto out;
+    }
+
+    /* Changing the context only affects the new connections */
+    if (QUIC_CTX_set_alpn_protos(ctx, own_alpn, sizeof(own_alpn) - 1) < 0) {
+        goto out;
+    }
+
+    third = QuicNew(ctx);
+    if (third == NULL) {
+        goto out;
+    }
+
+    if (third->tls.config == conf || conf->refcnt != 2 ||
+            first->tls.ext.alpn.len != sizeof(alpn) - 1 ||
+            third->tls.ext.alpn.len != sizeof(own_alpn) - 1) {
+        printf("Config not rebuilt\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    if (third != NULL) {
+        QuicFree(third);
+    }
+    if (second != NULL) {
+        QuicFree(second);
+    }
+    if (first != NULL) {
+        QuicFree(first);
+    }
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -125,8 +125,8 @@ int TlsGenerateServerSecretTest(void)
     str2hex(msg, clienthello_serverhello, msg_len);
     QuicBufSetDataLength(buf, msg_len);
     tls = &quic->tls;
-    str2hex(tls->handshake_secret, handshake_insecret,
-            sizeof(tls->handshake_secret));
+    str2hex(tls->hs->handshake_secret, handshake_insecret,
+            sizeof(tls->hs->handshake_secret));
     tls->handshake_cipher = QuicGetTlsCipherById(TLS_CK_AES_256_GCM_SHA384);
     if (tls->handshake_cipher == NULL) {
         printf("Find handshake cipher failed\n");
@@ -189,7 +189,7 @@ int TlsTlsFinalFinishMacTest(void)
         goto out;
     }
     hash_len = (sizeof(server_finished_secret) - 1)/2;
-    str2hex(s->server_finished_secret, server_finished_secret, hash_len);
+    str2hex(s->hs->server_finished_secret, server_finished_secret, hash_len);
     str2hex(hash, server_finished_hash, hash_len);
     s->handshake_msg_len = 16;
     if (TlsDigestCachedRecords(s) < 0) {
@@ -199,13 +199,13 @@ int TlsTlsFinalFinishMacTest(void)
  
     QuicTlsFinalFinishMacHashHook = TlsFinalFinishMacHashHook;
     if (TlsFinalFinishMac(s, tls_md_server_finish_label,
-                TLS_MD_SERVER_FINISH_LABEL_LEN, s->peer_finish_md) < 0) {
+                TLS_MD_SERVER_FINISH_LABEL_LEN, s->hs->peer_finish_md) < 0) {
         printf("Final Finish Mac failed\n");
         goto out;
     }
 
-    if (memcmp(hash, s->peer_finish_md, hash_len)) {
-        QuicPrint(s->peer_finish_md, hash_len);
+    if (memcmp(hash, s->hs->peer_finish_md, hash_len)) {
+        QuicPrint(s->hs->peer_finish_md, hash_len);
         QuicPrint(hash, hash_len);
     }
 
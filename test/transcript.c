@@ -0,0 +1,89 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "tls_lib.h"
+#include "evp.h"
+#include "common.h"
+
+#define TRANSCRIPT_TEST_MSG_LEN     8
+
+static const uint8_t transcript_msg[][TRANSCRIPT_TEST_MSG_LEN] = {
+    "client",
+    "server",
+};
+
+int QuicTranscriptHashTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC *quic = NULL;
+    TLS *s = NULL;
+    EVP_MD_CTX *copy = NULL;
+    uint8_t hash[EVP_MAX_MD_SIZE] = {};
+    uint8_t expect[EVP_MAX_MD_SIZE] = {};
+    unsigned int elen = 0;
+    size_t hlen = 0;
+    size_t i = 0;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicClientMethod());
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        goto out;
+    }
+
+    s = &quic->tls;
+    s->handshake_dgst = QuicEvpMdCtxNew();
+    if (s->handshake_dgst == NULL ||
+            !EVP_DigestInit_ex(s->handshake_dgst, EVP_sha256(), NULL)) {
+        goto out;
+    }
+
+    for (i = 0; i < QUIC_NELEM(transcript_msg); i++) {
+        if (TlsFinishMac(s, transcript_msg[i],
+                    sizeof(transcript_msg[i])) < 0) {
+            goto out;
+        }
+
+        if (TlsHandshakeHash(s, hash, sizeof(hash), &hlen) < 0) {
+            goto out;
+        }
+
+        /* Messages are laid out back to back */
+        if (!EVP_Digest(transcript_msg, (i + 1) * TRANSCRIPT_TEST_MSG_LEN,
+                    expect, &elen, EVP_sha256(), NULL)) {
+            goto out;
+        }
+
+        if (hlen != elen || memcmp(hash, expect, hlen) != 0) {
+            printf("Transcript hash %lu wrong\n", i);
+            goto out;
+        }
+
+        /* Running digest untouched, same scratch context every time */
+        if (copy != NULL && s->handshake_dgst_copy != copy) {
+            printf("Hash context not reused\n");
+            goto out;
+        }
+        copy = s->handshake_dgst_copy;
+    }
+
+    case_num = 1;
+out:
+    if (quic != NULL) {
+        QuicFree(quic);
+    }
+    QuicCtxFree(ctx);
+
+    return case_num;
+}
@@ -0,0 +1,148 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+
+#include "quic_local.h"
+#include "extension.h"
+#include "common.h"
+
+#define VHOST_TEST_BUF_LEN  512
+
+static const uint8_t vhost_alpn_a[] = "\x02h3";
+static const uint8_t vhost_alpn_b[] = "\x02hq";
+
+/* Feed a ClientHello extension block with only server_name in it */
+static int QuicVhostTestSni(QUIC *quic, const char *hostname)
+{
+    uint8_t buf[VHOST_TEST_BUF_LEN] = {};
+    WPacket wpkt = {};
+    RPacket rpkt = {};
+    size_t len = strlen(hostname);
+    int ret = -1;
+
+    WPacketStaticBufInit(&wpkt, buf, sizeof(buf));
+    if (WPacketStartSubU16(&wpkt) < 0 ||
+            WPacketPut2(&wpkt, EXT_TYPE_SERVER_NAME) < 0 ||
+            WPacketStartSubU16(&wpkt) < 0 ||
+            WPacketStartSubU16(&wpkt) < 0 ||
+            WPacketPut1(&wpkt, TLSEXT_NAMETYPE_HOST_NAME) < 0 ||
+            WPacketSubMemcpyU16(&wpkt, hostname, len) < 0 ||
+            WPacketClose(&wpkt) < 0 || WPacketClose(&wpkt) < 0 ||
+            WPacketClose(&wpkt) < 0) {
+        goto out;
+    }
+
+    RPacketBufInit(&rpkt, buf, WPacket_get_written(&wpkt));
+    ret = TlsSrvrParseExtensions(&quic->tls, &rpkt, TLSEXT_CLIENT_HELLO,
+                                    NULL, 0);
+out:
+    WPacketCleanup(&wpkt);
+    return ret;
+}
+
+/* Return the ALPN list the connection ends up with for @hostname */
+static int QuicVhostTestSelect(QUIC_CTX *ctx, const char *hostname,
+                                const uint8_t *alpn, size_t alpn_len)
+{
+    QUIC *quic = NULL;
+    QUIC_DATA *sel = NULL;
+    int ret = -1;
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        return -1;
+    }
+
+    QUIC_set_accept_state(quic);
+    if (QuicVhostTestSni(quic, hostname) < 0) {
+        goto out;
+    }
+
+    sel = &quic->tls.ext.alpn;
+    if (sel->len == alpn_len && (alpn_len == 0 ||
+                memcmp(sel->data, alpn, alpn_len) == 0) &&
+            quic->tls.cert == quic->tls.config->cert) {
+        ret = 0;
+    }
+out:
+    QuicFree(quic);
+    return ret;
+}
+
+int QuicVhostTest(void)
+{
+    QUIC_CTX *ctx = NULL;
+    QUIC_CTX *a = NULL;
+    QUIC_CTX *b = NULL;
+    int case_num = -1;
+
+    ctx = QuicCtxNew(QuicServerMethod());
+    a = QuicCtxNew(QuicServerMethod());
+    b = QuicCtxNew(QuicServerMethod());
+    if (ctx == NULL || a == NULL || b == NULL) {
+        goto out;
+    }
+
+    if (QUIC_CTX_set_alpn_protos(a, vhost_alpn_a,
+                sizeof(vhost_alpn_a) - 1) < 0 ||
+            QUIC_CTX_set_alpn_protos(b, vhost_alpn_b,
+                sizeof(vhost_alpn_b) - 1) < 0) {
+        goto out;
+    }
+
+    if (QuicCtxAddVhost(ctx, "www.a.example", a) == 0) {
+        printf("Host added without a table\n");
+        goto out;
+    }
+
+    if (QuicCtxSetVhostTable(ctx, 16) < 0 ||
+            QuicCtxAddVhost(ctx, "www.a.example", a) < 0 ||
+            QuicCtxAddVhost(ctx, "*.b.example", b) < 0) {
+        goto out;
+    }
+
+    /* The contexts of the hosts may go, their configs stay */
+    QuicCtxFree(a);
+    a = NULL;
+    QuicCtxFree(b);
+    b = NULL;
+
+    if (QuicVhostTestSelect(ctx, "WWW.A.Example", vhost_alpn_a,
+                sizeof(vhost_alpn_a) - 1) < 0) {
+        printf("Exact host not matched\n");
+        goto out;
+    }
+
+    if (QuicVhostTestSelect(ctx, "x.b.example", vhost_alpn_b,
+                sizeof(vhost_alpn_b) - 1) < 0) {
+        printf("Wildcard host not matched\n");
+        goto out;
+    }
+
+    /* Wildcard covers one label only */
+    if (QuicVhostTestSelect(ctx, "y.x.b.example", NULL, 0) < 0 ||
+            QuicVhostTestSelect(ctx, "b.example", NULL, 0) < 0 ||
+            QuicVhostTestSelect(ctx, "a.example", NULL, 0) < 0) {
+        printf("Unknown host matched\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    if (b != NULL) {
+        QuicCtxFree(b);
+    }
+    if (a != NULL) {
+        QuicCtxFree(a);
+    }
+    if (ctx != NULL) {
+        QuicCtxFree(ctx);
+    }
+
+    return case_num;
+}
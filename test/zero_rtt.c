@@ -0,0 +1,505 @@
+/*
+ * Remy Lewis(remyknight1119@gmail.com)
+ */
+
+#include "quic_test.h"
+
+#include <string.h>
+#include <tbquic/quic.h>
+#include <tbquic/stream.h>
+
+#include "quic_local.h"
+#include "format.h"
+#include "frame.h"
+#include "session.h"
+#include "tls_cipher.h"
+#include "q_buff.h"
+#include "stream.h"
+
+#define ZERO_RTT_TEST_PKT_LEN       256
+#define ZERO_RTT_TEST_PAYLOAD_LEN   32
+#define ZERO_RTT_TEST_MAX_EARLY     1024
+#define ZERO_RTT_TEST_STREAM_LEN    20
+/* Ticket age skew allowed by the server, in seconds */
+#define ZERO_RTT_TEST_WINDOW        10
+#define ZERO_RTT_TEST_REPLAY_RATE   16
+
+static const uint8_t zero_rtt_alpn[] = "hq-interop";
+static const uint8_t zero_rtt_data[] = "GET /index.html";
+
+static uint8_t zero_rtt_cid[] = {
+    0x83, 0x94, 0xc8, 0xf0, 0x3e, 0x51, 0x57, 0x08,
+};
+
+static QUIC *QuicZeroRttTestConnNew(QUIC_CTX *ctx, bool server)
+{
+    QUIC *quic = NULL;
+    TLS *s = NULL;
+
+    quic = QuicNew(ctx);
+    if (quic == NULL) {
+        return NULL;
+    }
+
+    quic->dcid.data = zero_rtt_cid;
+    quic->dcid.len = sizeof(zero_rtt_cid);
+    quic->scid.data = zero_rtt_cid;
+    quic->scid.len = sizeof(zero_rtt_cid);
+
+    quic->session = QuicSessionCreate();
+    if (quic->session == NULL) {
+        goto err;
+    }
+
+    quic->session->cipher = QuicGetTlsCipherById(TLS_CK_AES_128_GCM_SHA256);
+    quic->session->max_early_data = ZERO_RTT_TEST_MAX_EARLY;
+
+    /* Both sides derive the same keys from these */
+    s = &quic->tls;
+    memset(s->hs->early_secret, 0x5A, sizeof(s->hs->early_secret));
+    memset(s->hs->client_hello_hash, 0xC3, sizeof(s->hs->client_hello_hash));
+
+    if (server) {
+        QUIC_set_accept_state(quic);
+        if (QuicCreateZeroRttClientDecoders(quic) < 0) {
+            goto err;
+        }
+        s->max_early_data = ZERO_RTT_TEST_MAX_EARLY;
+        s->early_data_state = TLS_EARLY_DATA_READING;
+        s->ext.trans_param.initial_max_stream_bidi = 1;
+        quic->peer_param.initial_max_stream_data_bidi_remote =
+            ZERO_RTT_TEST_MAX_EARLY;
+        quic->peer_param.initial_max_data = ZERO_RTT_TEST_MAX_EARLY;
+        if (QuicStreamInit(quic) < 0) {
+            goto err;
+        }
+    } else {
+        QUIC_set_connect_state(quic);
+        if (QuicCreateZeroRttClientEncoders(quic) < 0) {
+            goto err;
+        }
+        s->early_data_state = TLS_EARLY_DATA_WRITING;
+    }
+
+    return quic;
+err:
+    quic->dcid.data = NULL;
+    quic->scid.data = NULL;
+    QuicFree(quic);
+    return NULL;
+}
+
+static void QuicZeroRttTestConnFree(QUIC *quic)
+{
+    if (quic == NULL) {
+        return;
+    }
+
+    quic->dcid.data = NULL;
+    quic->scid.data = NULL;
+    QuicFree(quic);
+}
+
+static QBUFF *QuicZeroRttTestBuff(const uint8_t *frame, size_t len)
+{
+    QBUFF *qb = NULL;
+    uint8_t *data = NULL;
+
+    qb = QBuffNew(QUIC_PKT_TYPE_0RTT, ZERO_RTT_TEST_PAYLOAD_LEN);
+    if (qb == NULL) {
+        return NULL;
+    }
+
+    /* Padding after the frame for the header protection sample */
+    data = QBuffHead(qb);
+    memset(data, QUIC_FRAME_TYPE_PADDING, ZERO_RTT_TEST_PAYLOAD_LEN);
+    memcpy(data, frame, len);
+    QBuffSetDataLen(qb, ZERO_RTT_TEST_PAYLOAD_LEN);
+
+    return qb;
+}
+
+static int QuicZeroRttTestSendFrame(QUIC *client, QUIC *server,
+                                    const uint8_t *frame, size_t frame_len)
+{
+    QBUFF *qb = NULL;
+    WPacket wpkt = {};
+    RPacket rpkt = {};
+    static uint8_t buf[ZERO_RTT_TEST_PKT_LEN];
+    size_t len = 0;
+    int ret = -1;
+
+    qb = QuicZeroRttTestBuff(frame, frame_len);
+    if (qb == NULL) {
+        return -1;
+    }
+
+    WPacketStaticBufInit(&wpkt, buf, sizeof(buf));
+    if (QBuffBuildPkt(client, &wpkt, qb, false) < 0) {
+        WPacketCleanup(&wpkt);
+        goto out;
+    }
+    len = WPacket_get_written(&wpkt);
+    WPacketCleanup(&wpkt);
+
+    /* Skip first byte, version and connection IDs */
+    RPacketBufInit(&rpkt, buf, len);
+    if (RPacketPull(&rpkt, 1 + 4 + 1 + sizeof(zero_rtt_cid) + 1 +
+                sizeof(zero_rtt_cid)) < 0) {
+        goto out;
+    }
+
+    ret = QuicPktBodyParse(server, &rpkt, QUIC_PKT_TYPE_0RTT);
+out:
+    QBuffFree(qb);
+    return ret;
+}
+
+static int QuicZeroRttTestSend(QUIC *client, QUIC *server, uint8_t frame_type)
+{
+    return QuicZeroRttTestSendFrame(client, server, &frame_type, 1);
+}
+
+static int QuicZeroRttTestReplay(QUIC *client)
+{
+    QUIC_CRYPTO *c = QuicGetOneRttCrypto(client);
+    QBUFF *sent = NULL;
+    QBUFF *unsent = NULL;
+    QBUFF *qb = NULL;
+    uint8_t ping = QUIC_FRAME_TYPE_PING;
+    int num = 0;
+
+    sent = QuicZeroRttTestBuff(&ping, 1);
+    unsent = QuicZeroRttTestBuff(&ping, 1);
+    if (sent == NULL || unsent == NULL) {
+        QBuffFree(sent);
+        QBuffFree(unsent);
+        return -1;
+    }
+
+    QBuffQueueAdd(&c->sent_queue, sent);
+    QBuffQueueAdd(&client->tx_queue, unsent);
+    QuicZeroRttDiscard(client, true);
+
+    if (client->zero_rtt.cipher_inited || !QBuffQueueEmpty(&c->sent_queue)) {
+        return -1;
+    }
+
+    list_for_each_entry(qb, &client->tx_queue.queue, node) {
+        if (qb->pkt_type != QUIC_PKT_TYPE_1RTT) {
+            return -1;
+        }
+        num++;
+    }
+
+    /* Unsent data goes first */
+    if (num != 2 || QBUF_FIRST_NODE(&client->tx_queue) != unsent) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int QuicZeroRttTest(void)
+{
+    QUIC_CTX *cctx = NULL;
+    QUIC_CTX *sctx = NULL;
+    QUIC *client = NULL;
+    QUIC *server = NULL;
+    /* STREAM 0 with LEN, data follows */
+    uint8_t stream[3 + ZERO_RTT_TEST_STREAM_LEN] = {
+        QUIC_FRAME_TYPE_STREAM | QUIC_FRAME_STREAM_BIT_LEN, 0,
+        ZERO_RTT_TEST_STREAM_LEN,
+    };
+    int case_num = -1;
+
+    cctx = QuicCtxNew(QuicClientMethod());
+    if (cctx == NULL) {
+        goto out;
+    }
+
+    sctx = QuicCtxNew(QuicServerMethod());
+    if (sctx == NULL) {
+        goto out;
+    }
+
+    client = QuicZeroRttTestConnNew(cctx, false);
+    if (client == NULL) {
+        goto out;
+    }
+
+    server = QuicZeroRttTestConnNew(sctx, true);
+    if (server == NULL) {
+        goto out;
+    }
+
+    if (QuicZeroRttTestSend(client, server, QUIC_FRAME_TYPE_PADDING) < 0 ||
+            server->application.largest_pn != client->application.pkt_num) {
+        printf("0-RTT packet not accepted\n");
+        goto out;
+    }
+
+    if (QuicZeroRttTestSend(client, server,
+                QUIC_FRAME_TYPE_HANDSHAKE_DONE) == 0) {
+        printf("HANDSHAKE_DONE accepted in 0-RTT\n");
+        goto out;
+    }
+
+    /* More stream data than the ticket allowed */
+    server->tls.max_early_data = ZERO_RTT_TEST_STREAM_LEN - 1;
+    if (QuicZeroRttTestSendFrame(client, server, stream,
+                sizeof(stream)) == 0 ||
+            server->tls.early_data_count != ZERO_RTT_TEST_STREAM_LEN) {
+        printf("Early data over the limit accepted\n");
+        goto out;
+    }
+
+    /* Rejected, the packet is dropped silently */
+    server->tls.early_data_state = TLS_EARLY_DATA_NONE;
+    if (QuicZeroRttTestSend(client, server, QUIC_FRAME_TYPE_PADDING) < 0 ||
+            server->application.largest_pn == client->application.pkt_num) {
+        printf("0-RTT packet not dropped\n");
+        goto out;
+    }
+
+    if (QuicZeroRttTestReplay(client) < 0) {
+        printf("Rejected 0-RTT data not replayed\n");
+        goto out;
+    }
+
+    case_num = 1;
+out:
+    QuicZeroRttTestConnFree(server);
+    QuicZeroRttTestConnFree(client);
+    QuicCtxFree(sctx);
+    QuicCtxFree(cctx);
+
+    return case_num;
+}
+
+static int QuicZeroRttTestCtxNew(QUIC_CTX **cctx, QUIC_CTX **sctx)
+{
+    *sctx = QuicTestServerCtxNew();
+    *cctx = QuicTestClientCtxNew();
+    if (*sctx == NULL || *cctx == NULL) {
+        return -1;
+    }
+
+    if (QUIC_CTX_set_max_early_data(*sctx, ZERO_RTT_TEST_MAX_EARLY) < 0) {
+        return -1;
+    }
+
+    return QuicCtxSetAntiReplay(*sctx, ZERO_RTT_TEST_REPLAY_RATE,
+                                ZERO_RTT_TEST_WINDOW);
+}
+
+/*
+ * Run a full handshake and return the session the client got from the
+ * server's NewSessionTicket, NULL if it does not allow early data.
+ */
+static QUIC_SESSION *QuicZeroRttTestTicket(QUIC_CTX *cctx, QUIC_CTX *sctx)
+{
+    QUIC *server = NULL;
+    QUIC *client = NULL;
+    QUIC_SESSION *sess = NULL;
+    int fd[2] = { -1, -1 };
+
+    server = QuicNew(sctx);
+    client = QuicNew(cctx);
+    if (server == NULL || client == NULL) {
+        goto out;
+    }
+
+    if (QuicTestPairInit(client, server, fd) < 0) {
+        goto out;
+    }
+
+    if (QuicTestHandshake(client, server) < 0) {
+        goto out;
+    }
+
+    sess = QUIC_get1_session(client);
+    if (sess != NULL && (sess->max_early_data != ZERO_RTT_TEST_MAX_EARLY ||
+                list_empty(&sess->ticket_queue))) {
+        printf("No ticket for early data\n");
+        QuicSessionFree(sess);
+        sess = NULL;
+    }
+
+out:
+    QuicFree(client);
+    QuicFree(server);
+    QuicTestPairFree(fd);
+    return sess;
+}
+
+/*
+ * Resume @sess with early data on a stream. Returns the early data state
+ * both ends agreed on, or -1 if they did not or the handshake failed.
+ */
+static int QuicZeroRttTestResume(QUIC_CTX *cctx, QUIC_CTX *sctx,
+                                QUIC_SESSION *sess, const uint8_t *alpn,
+                                size_t alpn_len)
+{
+    QUIC *server = NULL;
+    QUIC *client = NULL;
+    QUIC_STREAM_HANDLE h = -1;
+    uint8_t buf[sizeof(zero_rtt_data)] = {};
+    uint32_t flags = 0;
+    int fd[2] = { -1, -1 };
+    int ret = -1;
+
+    server = QuicNew(sctx);
+    client = QuicNew(cctx);
+    if (server == NULL || client == NULL) {
+        goto out;
+    }
+
+    if (QuicTestPairInit(client, server, fd) < 0) {
+        goto out;
+    }
+
+    if (alpn != NULL && QUIC_set_alpn_protos(client, alpn, alpn_len) < 0) {
+        goto out;
+    }
+
+    QUIC_set_session(client, sess);
+    if (QuicStreamSendEarlyData(client, &h, false, (void *)zero_rtt_data,
+                sizeof(zero_rtt_data)) != sizeof(zero_rtt_data)) {
+        printf("Early data not sent\n");
+        goto out;
+    }
+
+    if (client->tls.early_data_count != sizeof(zero_rtt_data)) {
+        printf("Early data count %lu\n",
+                (unsigned long)client->tls.early_data_count);
+        goto out;
+    }
+
+    if (QuicTestHandshake(client, server) < 0) {
+        goto out;
+    }
+
+    if (client->tls.ext.early_data != server->tls.ext.early_data) {
+        printf("Early data state differs\n");
+        goto out;
+    }
+
+    /* Rejected early data is sent again in 1-RTT packets */
+    if (QuicStreamRecv(server, h, &flags, buf, sizeof(buf)) != sizeof(buf) ||
+            memcmp(buf, zero_rtt_data, sizeof(buf)) != 0) {
+        printf("Early data not received\n");
+        goto out;
+    }
+
+    ret = server->tls.ext.early_data;
+out:
+    QuicFree(client);
+    QuicFree(server);
+    QuicTestPairFree(fd);
+    return ret;
+}
+
+static int QuicZeroRttHandshake(const uint8_t *alpn, size_t alpn_len)
+{
+    QUIC_CTX *sctx = NULL;
+    QUIC_CTX *cctx = NULL;
+    QUIC_SESSION *sess = NULL;
+    int ret = -1;
+
+    if (QuicZeroRttTestCtxNew(&cctx, &sctx) < 0) {
+        goto out;
+    }
+
+    sess = QuicZeroRttTestTicket(cctx, sctx);
+    if (sess == NULL) {
+        goto out;
+    }
+
+    ret = QuicZeroRttTestResume(cctx, sctx, sess, alpn, alpn_len);
+out:
+    QuicSessionFree(sess);
+    QuicCtxFree(cctx);
+    QuicCtxFree(sctx);
+    return ret;
+}
+
+int QuicZeroRttAcceptTest(void)
+{
+    if (QuicZeroRttHandshake(NULL, 0) != TLS_EARLY_DATA_ACCEPTED) {
+        return -1;
+    }
+
+    return 1;
+}
+
+/*
+ * RFC 8446 4.2.10. A resumption with another ALPN must not carry over the
+ * early data.
+ */
+int QuicZeroRttRejectTest(void)
+{
+    if (QuicZeroRttHandshake(zero_rtt_alpn, sizeof(zero_rtt_alpn) - 1) !=
+            TLS_EARLY_DATA_REJECTED) {
+        return -1;
+    }
+
+    return 1;
+}
+
+/*
+ * Resume with a ticket the client believes is @shift seconds older than
+ * the server does.
+ */
+static int QuicZeroRttTestAged(QUIC_CTX *cctx, QUIC_CTX *sctx, time_t shift)
+{
+    QUIC_SESSION *sess = NULL;
+    QuicSessionTicket *t = NULL;
+    int ret = -1;
+
+    sess = QuicZeroRttTestTicket(cctx, sctx);
+    if (sess == NULL) {
+        return -1;
+    }
+
+    list_for_each_entry(t, &sess->ticket_queue, node) {
+        t->time -= shift;
+    }
+
+    ret = QuicZeroRttTestResume(cctx, sctx, sess, NULL, 0);
+    QuicSessionFree(sess);
+    return ret;
+}
+
+/*
+ * RFC 8446 8.3. Early data is only accepted if the ticket age the client
+ * reports is within the window of the one the server computes.
+ */
+int QuicZeroRttTicketAgeTest(void)
+{
+    QUIC_CTX *sctx = NULL;
+    QUIC_CTX *cctx = NULL;
+    int case_num = -1;
+
+    if (QuicZeroRttTestCtxNew(&cctx, &sctx) < 0) {
+        goto out;
+    }
+
+    if (QuicZeroRttTestAged(cctx, sctx, ZERO_RTT_TEST_WINDOW / 2) !=
+            TLS_EARLY_DATA_ACCEPTED) {
+        printf("Ticket age inside the window rejected\n");
+        goto out;
+    }
+
+    if (QuicZeroRttTestAged(cctx, sctx, ZERO_RTT_TEST_WINDOW * 2) !=
+            TLS_EARLY_DATA_REJECTED) {
+        printf("Ticket age outside the window accepted\n");
+        goto out;
+    }
+
+    case_num = 2;
+out:
+    QuicCtxFree(cctx);
+    QuicCtxFree(sctx);
+    return case_num;
+}